@@ -62,7 +62,7 @@ SHMKDIR?=mkdir
 DIRSP=/
 
 LINKB?=
-LINK= $(LINKB)
+LINK= $(LINKB) -lpthread -lm
 
 OBB=_obj_
 OBD=$(OBB)$(DIRSP)
@@ -0,0 +1,678 @@
+/**
+**  \file
+**  \brief     Assembler context
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Owns every object necessary for an assembly (compile state, sections,
+**  symbol table, bindata, macros, conditionals, include stack, dependency
+**  list), so an application may be assembled without any global state. This
+**  is the interface of the librrpgeasm library: several contexts may exist in
+**  a process, and they may be used on different threads (one thread for a
+**  context at a time).
+*/
+
+
+#include "asmctx.h"
+#include "compst.h"
+#include "section.h"
+#include "symtab.h"
+#include "bindata.h"
+#include "macro.h"
+#include "cond.h"
+#include "incstk.h"
+#include "deplst.h"
+#include "incmem.h"
+#include "frag.h"
+#include "srcrd.h"
+#include "relax.h"
+#include "peep.h"
+#include "cflow.h"
+#include "reach.h"
+#include "fault.h"
+#include "firead.h"
+#include "pass1.h"
+#include "pass2.h"
+#include "pass3.h"
+#include "objfile.h"
+#include "objlib.h"
+
+
+/* Assembler context object structure - definition */
+struct asmctx_s{
+ compst_t*  cst;        /* Compilation state */
+ section_t* sec;        /* Sections */
+ symtab_t*  stb;        /* Symbol table */
+ bindata_t* bdt;        /* Binary data */
+ macro_t*   mac;        /* Macros */
+ cond_t*    cnd;        /* Conditional assembly */
+ reach_t*   rch;        /* Procedures and their reachability */
+ incstk_t*  ist;        /* Include stack */
+ deplst_t*  dls;        /* Dependency list */
+ incmem_t*  mem;        /* Include memoization (NULL: off) */
+ frag_t*    frg;        /* Parallel first pass (NULL: off) */
+ auint      thc;        /* Thread count for the parallel first pass and resolving */
+ srcrd_t*   rdr;        /* Pipelined source reader (NULL: off) */
+ relax_t*   rlx;        /* Relaxation of jumps and immediates */
+ peep_t*    pep;        /* Peephole optimizer (NULL: off) */
+ cflow_t*   cfl;        /* Control flow optimizer (NULL: off) */
+ auint      rce;        /* Elimination of procedures not reachable if nonzero */
+ fprov_t    prv;        /* File provider */
+ auint      vrb;        /* Print progress if nonzero */
+};
+
+
+
+/* Creates a new assembler context. Returns NULL if it is not possible to
+** allocate it. */
+asmctx_t* asmctx_new(void)
+{
+ asmctx_t* hnd = (asmctx_t*)(calloc(1U, sizeof(asmctx_t)));
+
+ if (hnd == NULL){ return NULL; }
+ hnd->cst = compst_new();
+ hnd->sec = section_new();
+ hnd->stb = symtab_new();
+ hnd->bdt = bindata_new();
+ hnd->mac = macro_new();
+ hnd->cnd = cond_new();
+ hnd->rch = reach_new();
+ hnd->ist = incstk_new();
+ hnd->dls = deplst_new();
+ hnd->rlx = relax_new();
+ if ( (hnd->cst == NULL) ||
+      (hnd->sec == NULL) ||
+      (hnd->stb == NULL) ||
+      (hnd->bdt == NULL) ||
+      (hnd->mac == NULL) ||
+      (hnd->cnd == NULL) ||
+      (hnd->rch == NULL) ||
+      (hnd->ist == NULL) ||
+      (hnd->dls == NULL) ||
+      (hnd->rlx == NULL) ){
+  asmctx_delete(hnd);
+  return NULL;
+ }
+ asmctx_setprov(hnd, NULL);
+ hnd->vrb = 1U;
+
+ return hnd;
+}
+
+
+
+/* Deletes an assembler context. */
+void  asmctx_delete(asmctx_t* hnd)
+{
+ if (hnd != NULL){
+  compst_delete(hnd->cst);
+  section_delete(hnd->sec);
+  symtab_delete(hnd->stb);
+  bindata_delete(hnd->bdt);
+  macro_delete(hnd->mac);
+  cond_delete(hnd->cnd);
+  reach_delete(hnd->rch);
+  incstk_delete(hnd->ist);
+  deplst_delete(hnd->dls);
+  incmem_delete(hnd->mem);
+  frag_delete(hnd->frg);
+  srcrd_delete(hnd->rdr);
+  relax_delete(hnd->rlx);
+  peep_delete(hnd->pep);
+  cflow_delete(hnd->cfl);
+ }
+ free(hnd);
+}
+
+
+
+/* Sets the file provider to use for every file read or written by the
+** assembler. NULL selects the default (filesystem) provider, which is also
+** used after creation. The provider is copied, but its context must exist
+** while the assembler context uses it. */
+void  asmctx_setprov(asmctx_t* hnd, fprov_t const* prv)
+{
+ if (prv == NULL){ prv = fprov_getdef(); }
+ hnd->prv = *prv;
+}
+
+
+
+/* Sets whether the progress of the assembly (passes) is printed. Nonzero
+** (TRUE) enables it, which is the default after creation. Faults are always
+** printed. */
+void  asmctx_setverb(asmctx_t* hnd, auint vrb)
+{
+ hnd->vrb = vrb;
+}
+
+
+
+/* Turns include memoization on (nonzero 'ena') or off. When on, the effects
+** of the first pass over includes are remembered in the context, and if an
+** include is met again in a later assembly in the same state, those are
+** replayed without parsing it. Off after creation. Returns nonzero (TRUE) if
+** it can not be turned on (no memory). */
+auint asmctx_setmemo(asmctx_t* hnd, auint ena)
+{
+ if (ena == 0U){
+  incmem_delete(hnd->mem);
+  hnd->mem = NULL;
+ }else if (hnd->mem == NULL){
+  hnd->mem = incmem_new();
+  if (hnd->mem == NULL){ return 1U; }
+ }
+ return 0U;
+}
+
+
+
+/* Turns the parallel first pass on (nonzero 'ena') or off. When on, the
+** includes of the primary source are assembled ahead on 'thc' threads (0: by
+** the number of processors) as fragments, merged in by the first pass where
+** their contents do not depend on the state they are included in (see
+** frag.h). The application binary is the same either way. The file provider
+** must then be usable from several threads. Off after creation. Returns
+** nonzero (TRUE) if it can not be turned on (no memory). The thread count
+** also applies to resolving symbols in large tables (see symtab_resolve()),
+** which uses the number of processors after creation. */
+auint asmctx_setpar(asmctx_t* hnd, auint ena, auint thc)
+{
+ if (ena == 0U){
+  frag_delete(hnd->frg);
+  hnd->frg = NULL;
+ }else if (hnd->frg == NULL){
+  hnd->frg = frag_new();
+  if (hnd->frg == NULL){ return 1U; }
+ }
+ hnd->thc = thc;
+ return 0U;
+}
+
+
+
+/* Turns the pipelined source reader on (nonzero 'ena') or off. When on, the
+** source and its includes are read on a thread of their own ahead of the
+** first pass. The file provider must then be usable from an other thread.
+** Off after creation. Returns nonzero (TRUE) if it can not be turned on (no
+** memory). */
+auint asmctx_setpipe(asmctx_t* hnd, auint ena)
+{
+ if (ena == 0U){
+  srcrd_delete(hnd->rdr);
+  hnd->rdr = NULL;
+ }else if (hnd->rdr == NULL){
+  hnd->rdr = srcrd_new();
+  if (hnd->rdr == NULL){ return 1U; }
+ }
+ return 0U;
+}
+
+
+
+/* Turns the peephole optimizer on (nonzero 'ena') or off. When on, redundant
+** instructions are removed by the first pass (see peep.h), each reported by
+** a note. The includes are then neither memoized nor assembled in parallel.
+** Off after creation. Returns nonzero (TRUE) if it can not be turned on (no
+** memory). */
+auint asmctx_setpeep(asmctx_t* hnd, auint ena)
+{
+ if (ena == 0U){
+  peep_delete(hnd->pep);
+  hnd->pep = NULL;
+ }else if (hnd->pep == NULL){
+  hnd->pep = peep_new();
+  if (hnd->pep == NULL){ return 1U; }
+ }
+ return 0U;
+}
+
+
+
+/* Turns the control flow optimizer on (nonzero 'ena') or off. When on, the
+** branches of an application are rewritten after resolving the symbols
+** (see cflow.h), each reported by a note. The includes are then neither
+** memoized nor assembled in parallel. Relocatable objects are not affected.
+** Off after creation. Returns nonzero (TRUE) if it can not be turned on (no
+** memory). */
+auint asmctx_setcflow(asmctx_t* hnd, auint ena)
+{
+ if (ena == 0U){
+  cflow_delete(hnd->cfl);
+  hnd->cfl = NULL;
+ }else if (hnd->cfl == NULL){
+  hnd->cfl = cflow_new();
+  if (hnd->cfl == NULL){ return 1U; }
+ }
+ return 0U;
+}
+
+
+
+/* Turns the elimination of procedures not reachable on (nonzero 'ena') or
+** off. When on, the procedures of an application (enclosed in 'proc' and
+** 'endp') not reachable from its start by the symbols used are removed,
+** repeating the assembly without them (see reach.h), each reported by a
+** note. The includes are then neither memoized nor assembled in parallel.
+** Relocatable objects are not affected. Off after creation. */
+void  asmctx_setreach(asmctx_t* hnd, auint ena)
+{
+ hnd->rce = ena;
+}
+
+
+
+/* Internal function to reset every object of the context for a new
+** assembly. */
+static void  asmctx_i_init(asmctx_t* hnd)
+{
+ compst_init(hnd->cst);
+ section_init(hnd->sec);
+ symtab_init(hnd->stb, hnd->sec, hnd->cst);
+ symtab_setthr(hnd->stb, hnd->thc);
+ bindata_init(hnd->bdt, hnd->dls, &(hnd->prv));
+ macro_init(hnd->mac);
+ cond_init(hnd->cnd);
+ reach_init(hnd->rch, hnd->rce);
+ incstk_init(hnd->ist);
+ deplst_init(hnd->dls);
+ if (hnd->pep != NULL){
+  peep_init(hnd->pep);
+  symtab_setpeep(hnd->stb, hnd->pep);
+ }
+ if (hnd->cfl != NULL){
+  cflow_init(hnd->cfl);
+ }
+}
+
+
+
+/* Internal function to run the first pass over the source 'src', using the
+** include memoization 'mem' (NULL: none). Returns nonzero (TRUE) on failure,
+** fault code printed. */
+static auint asmctx_i_pass1(asmctx_t* hnd, uint8 const* src, incmem_t* mem)
+{
+ fprov_file_t* fp;
+ srcrd_t*   rdr = hnd->rdr;
+ frag_t*    frg = hnd->frg;
+ auint      t;
+
+ if ( (hnd->pep != NULL) ||  /* The optimizers have to see every instruction */
+      (symtab_getcflow(hnd->stb) != NULL) ||
+      (hnd->rce != 0U) ){
+  mem = NULL;
+  frg = NULL;
+ }
+
+ if (firead_open(src, hnd->cst, &(hnd->prv), &fp)){ return 1U; }
+ if (deplst_add(hnd->dls, src, hnd->cst)){ firead_close(fp); return 1U; }
+
+ if (hnd->vrb){ printf("Compilation pass1\n"); }
+ if (frg != NULL){ frag_start(frg, src, &(hnd->prv), hnd->thc, symtab_getrlx(hnd->stb)); }
+ if ((rdr != NULL) && srcrd_start(rdr, fp, hnd->cst, &(hnd->prv))){
+  rdr = NULL;           /* No thread for it, read the source directly */
+ }
+ t = pass1_run(fp, hnd->stb, hnd->bdt, hnd->mac, hnd->cnd, hnd->rch, hnd->ist, hnd->dls, &(hnd->prv), mem, frg, rdr);
+ if (rdr != NULL){ srcrd_stop(rdr); }
+ if (frg != NULL){ frag_stop(frg); }
+ firead_close(fp);
+ if (t && (mem != NULL)){ incmem_abort(mem, hnd->stb); }
+
+ return t;
+}
+
+
+
+/* Internal function to run the second pass. Returns nonzero (TRUE) on
+** failure, fault code printed. */
+static auint asmctx_i_pass2(asmctx_t* hnd)
+{
+ if (hnd->vrb){ printf("Compilation pass2\n"); }
+ return pass2_run(hnd->stb);
+}
+
+
+
+/* Internal function to run the first and the second pass over the source
+** 'src', repeating them while jumps or immediates get relaxed, or earlier
+** instructions get dropped by the peephole optimizer, or procedures not
+** reachable get dropped (see relax.h). The faults of each round are
+** collected, and only those of the last are output (if no temporary file is
+** available for collecting them, they are discarded, and the last round is
+** repeated with them output). Returns nonzero (TRUE) on failure, fault code
+** printed. */
+static auint asmctx_i_relax(asmctx_t* hnd, uint8 const* src)
+{
+ FILE*     ofl = fault_getout();
+ FILE*     flt = NULL;
+ incmem_t* mem = hnd->mem;
+ auint     dis = 0U;         /* 1: Faults discarded, 2: Repeating the last round */
+ auint     cnt;
+ auint     t;
+
+ relax_init(hnd->rlx);
+
+ while (1){
+
+  asmctx_i_init(hnd);
+  symtab_setrlx(hnd->stb, hnd->rlx);
+  symtab_setcflow(hnd->stb, hnd->cfl);
+  if (dis == 0U){
+   flt = tmpfile();
+   if (flt == NULL){ dis = 1U; }
+  }
+  if      (flt != NULL){ fault_setout(flt); }
+  else if (dis == 1U)  { fault_setdiscard(1U); }
+  cnt = relax_count(hnd->rlx);
+
+  t = asmctx_i_pass1(hnd, src, mem);
+  if (t == 0U){ t = reach_run(hnd->rch, hnd->stb); }
+  if (t == 0U){ t = asmctx_i_pass2(hnd); }
+
+  fault_setout(ofl);
+  fault_setdiscard(0U);
+  if (flt != NULL){
+   if (relax_count(hnd->rlx) == cnt){
+    fault_replay(flt);
+    fclose(flt);
+    return t;
+   }
+   fclose(flt);
+   flt = NULL;
+  }else{
+   if (dis == 2U){ return t; }
+   if (relax_count(hnd->rlx) == cnt){
+    dis = 2U;            /* Last round: repeat it with the faults output */
+    continue;
+   }
+  }
+
+  /* Some lines need an other form, assemble again. The includes memoized
+  ** would replay them in their old form, so the memoization is not used any
+  ** more. */
+
+  mem = NULL;
+  if (hnd->vrb){ printf("Relaxing (%u changes)\n", relax_count(hnd->rlx)); }
+
+ }
+}
+
+
+
+/* Internal function to produce the output 'out' after the first pass (or
+** after reading the objects of a link): either an object file (if 'obj' is
+** nonzero), or an application binary by the third pass (the second must be
+** done). If 'dep' is not NULL, the dependency file is also written. Returns
+** nonzero (TRUE) on failure, fault code printed. */
+static auint asmctx_i_out(asmctx_t* hnd, uint8 const* out, uint8 const* dep, auint obj)
+{
+ uint8      s[80];
+ uint8      e[80];
+ uint8 const* fnm;
+ fprov_file_t* of;
+
+ /* Pass3 or object */
+
+ fnm = out;
+ of = fprov_open(&(hnd->prv), out, FPROV_M_WRB); /* Open destination file */
+ if (of == NULL){ goto fault_ofo; }
+ if (obj){
+  if (hnd->vrb){ printf("Writing object\n"); }
+  if (objfile_write(hnd->stb, of)){ fprov_close(of); goto fault_ofw; }
+ }else{
+  if (hnd->vrb){ printf("Compilation pass3\n"); }
+  if (pass3_run(of, hnd->stb, hnd->bdt)){ fprov_close(of); goto fault_oth; }
+ }
+
+ /* Done, try to close file and be happy */
+
+ if (hnd->vrb){ printf("Compilation complete\n"); }
+ if (fprov_close(of)){ goto fault_ofc; }
+
+ /* Write dependency file if it was requested */
+
+ if (dep != NULL){
+  fnm = dep;
+  of = fprov_open(&(hnd->prv), dep, FPROV_M_WRT);
+  if (of == NULL){ goto fault_ofo; }
+  if (deplst_out(hnd->dls, out, of)){ fprov_close(of); goto fault_oth; }
+  if (fprov_close(of)){ goto fault_ofc; }
+ }
+
+ return 0U;
+
+fault_ofw:
+
+ strerror_r(errno, (char*)(&e[0]), 80U);
+ e[79] = 0U;
+ snprintf((char*)(&s[0]), 80U, "Failed to write object: %.55s", (char const*)(&e[0]));
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
+
+fault_ofc:
+
+ strerror_r(errno, (char*)(&e[0]), 80U);
+ e[79] = 0U;
+ snprintf((char*)(&s[0]), 80U, "Failed to close \'%.27s\': %.32s", (char const*)(fnm), (char const*)(&e[0]));
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
+
+fault_ofo:
+
+ strerror_r(errno, (char*)(&e[0]), 80U);
+ e[79] = 0U;
+ snprintf((char*)(&s[0]), 80U, "Failed to open \'%.28s\': %.32s", (char const*)(fnm), (char const*)(&e[0]));
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
+
+fault_oth:
+
+ return 1U;
+}
+
+
+
+/* Assembles an application from the source 'src' into the application binary
+** 'out'. If 'dep' is not NULL, a make style dependency file is also written
+** into it with 'out' as target. The context is reset before the assembly, so
+** it may be reused for any number of assemblies. Returns nonzero (TRUE) on
+** failure, fault code printed. */
+auint asmctx_assemble(asmctx_t* hnd, uint8 const* src, uint8 const* out,
+                      uint8 const* dep)
+{
+ if (asmctx_i_relax(hnd, src)){ return 1U; }
+ if (symtab_getcflow(hnd->stb) != NULL){
+  if (hnd->vrb){ printf("Control flow optimization\n"); }
+  cflow_run(hnd->cfl, hnd->stb);
+ }
+ return asmctx_i_out(hnd, out, dep, 0U);
+}
+
+
+
+/* Assembles the source 'src' into the relocatable object file 'out' (see
+** objfile.h), to be linked later by asmctx_link(). The dependency file is
+** written like by asmctx_assemble(). Returns nonzero (TRUE) on failure, fault
+** code printed. */
+auint asmctx_object(asmctx_t* hnd, uint8 const* src, uint8 const* out,
+                    uint8 const* dep)
+{
+ asmctx_i_init(hnd);
+ if (asmctx_i_pass1(hnd, src, hnd->mem)){ return 1U; }
+ return asmctx_i_out(hnd, out, dep, 1U);
+}
+
+
+
+/* Internal function to free the archives of a link (NULL entries are the
+** objects). */
+static void  asmctx_i_freearc(objlib_t** arc, auint cnt)
+{
+ auint i;
+
+ if (arc == NULL){ return; }
+ for (i = 0U; i < cnt; i++){ objlib_delete(arc[i]); }
+ free(arc);
+}
+
+
+
+/* Links the 'cnt' object files or archives in 'obj' into the application
+** binary 'out'. The code, data and zero sections of the objects are placed in
+** the order they are given, then the members of the archives needed by them
+** are added. Returns nonzero (TRUE) on failure, fault code printed. */
+auint asmctx_link(asmctx_t* hnd, uint8 const* const* obj, auint cnt,
+                  uint8 const* out)
+{
+ uint8      s[80];
+ uint8      e[80];
+ fprov_file_t* fp;
+ objlib_t** arc;
+ auint      i;
+ auint      n;
+ auint      t;
+
+ asmctx_i_init(hnd);
+ arc = (objlib_t**)(calloc(cnt + 1U, sizeof(objlib_t*)));
+ if (arc == NULL){ goto fault_mem; }
+
+ /* Objects, in order, remembering the archives */
+
+ if (hnd->vrb){ printf("Reading objects\n"); }
+ for (i = 0U; i < cnt; i++){
+  fp = fprov_open(&(hnd->prv), obj[i], FPROV_M_RDB);
+  if (fp == NULL){ goto fault_ifo; }
+  arc[i] = objlib_new();
+  if (arc[i] == NULL){ fprov_close(fp); goto fault_mem; }
+  n = objlib_read(arc[i], fp);
+  fprov_close(fp);        /* It was read only, don't care for errors here */
+  if (n == OBJLIB_ERR){ goto fault_ird; }
+  if (n == OBJLIB_NARC){  /* Not an archive, so an object */
+   objlib_delete(arc[i]);
+   arc[i] = NULL;
+   fp = fprov_open(&(hnd->prv), obj[i], FPROV_M_RDB);
+   if (fp == NULL){ goto fault_ifo; }
+   n = objfile_read(hnd->stb, fp, obj[i]);
+   fprov_close(fp);
+   if (n){ goto fault_oth; }
+  }
+ }
+
+ /* Archive members needed, until no more is necessary */
+
+ do{
+  n = 0U;
+  for (i = 0U; i < cnt; i++){
+   if (arc[i] != NULL){
+    if (objlib_pull(arc[i], hnd->stb, obj[i], &n)){ goto fault_oth; }
+   }
+  }
+ }while (n != 0U);
+
+ if (asmctx_i_pass2(hnd)){ goto fault_oth; }
+ t = asmctx_i_out(hnd, out, NULL, 0U);
+ asmctx_i_freearc(arc, cnt);
+ return t;
+
+fault_ird:
+
+ strerror_r(errno, (char*)(&e[0]), 80U);
+ e[79] = 0U;
+ snprintf((char*)(&s[0]), 80U, "Unable to read archive \'%.20s\': %.32s", (char const*)(obj[i]), (char const*)(&e[0]));
+ fault_printgen(FAULT_FAIL, &s[0]);
+ goto fault_oth;
+
+fault_ifo:
+
+ strerror_r(errno, (char*)(&e[0]), 80U);
+ e[79] = 0U;
+ snprintf((char*)(&s[0]), 80U, "Failed to open \'%.28s\': %.32s", (char const*)(obj[i]), (char const*)(&e[0]));
+ fault_printgen(FAULT_FAIL, &s[0]);
+ goto fault_oth;
+
+fault_mem:
+
+ snprintf((char*)(&s[0]), 80U, "Not enough memory for linking");
+ fault_printgen(FAULT_FAIL, &s[0]);
+
+fault_oth:
+
+ asmctx_i_freearc(arc, cnt);
+ return 1U;
+}
+
+
+
+/* Creates the archive 'out' from the 'cnt' object files in 'obj'. Each
+** object is read to check it and to collect the symbols it defines for the
+** index of the archive. Returns nonzero (TRUE) on failure, fault code
+** printed. */
+auint asmctx_archive(asmctx_t* hnd, uint8 const* const* obj, auint cnt,
+                     uint8 const* out)
+{
+ uint8      s[80];
+ uint8      e[80];
+ uint8 const* fnm;
+ fprov_file_t* fp;
+ objlib_t*  lib;
+ auint      i;
+ auint      t;
+
+ lib = objlib_new();
+ if (lib == NULL){ goto fault_mem; }
+
+ if (hnd->vrb){ printf("Reading objects\n"); }
+ for (i = 0U; i < cnt; i++){
+  fnm = obj[i];
+  asmctx_i_init(hnd);
+  fp = fprov_open(&(hnd->prv), fnm, FPROV_M_RDB);
+  if (fp == NULL){ goto fault_ifo; }
+  t = objfile_read(hnd->stb, fp, fnm);
+  fprov_close(fp);        /* It was read only, don't care for errors here */
+  if (t){ goto fault_oth; }
+  if (objlib_add(lib, fnm, &(hnd->prv), hnd->stb)){ goto fault_ifo; }
+ }
+
+ if (hnd->vrb){ printf("Writing archive\n"); }
+ fnm = out;
+ fp = fprov_open(&(hnd->prv), out, FPROV_M_WRB);
+ if (fp == NULL){ goto fault_ifo; }
+ if (objlib_write(lib, fp)){ fprov_close(fp); goto fault_afw; }
+ if (fprov_close(fp)){ goto fault_afw; }
+
+ objlib_delete(lib);
+ return 0U;
+
+fault_afw:
+
+ strerror_r(errno, (char*)(&e[0]), 80U);
+ e[79] = 0U;
+ snprintf((char*)(&s[0]), 80U, "Failed to write archive: %.54s", (char const*)(&e[0]));
+ fault_printgen(FAULT_FAIL, &s[0]);
+ objlib_delete(lib);
+ return 1U;
+
+fault_ifo:
+
+ strerror_r(errno, (char*)(&e[0]), 80U);
+ e[79] = 0U;
+ snprintf((char*)(&s[0]), 80U, "Failed to open \'%.28s\': %.32s", (char const*)(fnm), (char const*)(&e[0]));
+ fault_printgen(FAULT_FAIL, &s[0]);
+ objlib_delete(lib);
+ return 1U;
+
+fault_mem:
+
+ snprintf((char*)(&s[0]), 80U, "Not enough memory for the archive");
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
+
+fault_oth:
+
+ objlib_delete(lib);
+ return 1U;
+}
@@ -0,0 +1,141 @@
+/**
+**  \file
+**  \brief     Assembler context
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Owns every object necessary for an assembly (compile state, sections,
+**  symbol table, bindata, include stack, dependency list), so an application
+**  may be assembled without any global state. This is the interface of the
+**  librrpgeasm library: several contexts may exist in a process, and they may
+**  be used on different threads (one thread for a context at a time).
+*/
+
+
+#ifndef ASMCTX_H
+#define ASMCTX_H
+
+
+#include "types.h"
+#include "fprov.h"
+
+
+/* Assembler context object structure */
+typedef struct asmctx_s asmctx_t;
+
+
+
+/* Creates a new assembler context. Returns NULL if it is not possible to
+** allocate it. */
+asmctx_t* asmctx_new(void);
+
+
+/* Deletes an assembler context. */
+void  asmctx_delete(asmctx_t* hnd);
+
+
+/* Sets the file provider to use for every file read or written by the
+** assembler. NULL selects the default (filesystem) provider, which is also
+** used after creation. The provider is copied, but its context must exist
+** while the assembler context uses it. */
+void  asmctx_setprov(asmctx_t* hnd, fprov_t const* prv);
+
+
+/* Sets whether the progress of the assembly (passes) is printed. Nonzero
+** (TRUE) enables it, which is the default after creation. Faults are always
+** printed. */
+void  asmctx_setverb(asmctx_t* hnd, auint vrb);
+
+
+/* Turns include memoization on (nonzero 'ena') or off. When on, the effects
+** of the first pass over includes are remembered in the context, and if an
+** include is met again in a later assembly in the same state, those are
+** replayed without parsing it. Off after creation. Returns nonzero (TRUE) if
+** it can not be turned on (no memory). */
+auint asmctx_setmemo(asmctx_t* hnd, auint ena);
+
+
+/* Turns the parallel first pass on (nonzero 'ena') or off. When on, the
+** includes of the primary source are assembled ahead on 'thc' threads (0: by
+** the number of processors) as fragments, merged in by the first pass where
+** their contents do not depend on the state they are included in (see
+** frag.h). The application binary is the same either way. The file provider
+** must then be usable from several threads. Off after creation. Returns
+** nonzero (TRUE) if it can not be turned on (no memory). The thread count
+** also applies to resolving symbols in large tables (see symtab_resolve()),
+** which uses the number of processors after creation. */
+auint asmctx_setpar(asmctx_t* hnd, auint ena, auint thc);
+
+
+/* Turns the pipelined source reader on (nonzero 'ena') or off. When on, the
+** source and its includes are read on a thread of their own ahead of the
+** first pass. The file provider must then be usable from an other thread.
+** Off after creation. Returns nonzero (TRUE) if it can not be turned on (no
+** memory). */
+auint asmctx_setpipe(asmctx_t* hnd, auint ena);
+
+
+/* Turns the peephole optimizer on (nonzero 'ena') or off. When on, redundant
+** instructions are removed by the first pass (see peep.h), each reported by
+** a note. The includes are then neither memoized nor assembled in parallel.
+** Off after creation. Returns nonzero (TRUE) if it can not be turned on (no
+** memory). */
+auint asmctx_setpeep(asmctx_t* hnd, auint ena);
+
+
+/* Turns the control flow optimizer on (nonzero 'ena') or off. When on, the
+** branches of an application are rewritten after resolving the symbols
+** (see cflow.h), each reported by a note. The includes are then neither
+** memoized nor assembled in parallel. Relocatable objects are not affected.
+** Off after creation. Returns nonzero (TRUE) if it can not be turned on (no
+** memory). */
+auint asmctx_setcflow(asmctx_t* hnd, auint ena);
+
+
+/* Turns the elimination of procedures not reachable on (nonzero 'ena') or
+** off. When on, the procedures of an application (enclosed in 'proc' and
+** 'endp') not reachable from its start by the symbols used are removed,
+** repeating the assembly without them (see reach.h), each reported by a
+** note. The includes are then neither memoized nor assembled in parallel.
+** Relocatable objects are not affected. Off after creation. */
+void  asmctx_setreach(asmctx_t* hnd, auint ena);
+
+
+/* Assembles an application from the source 'src' into the application binary
+** 'out'. If 'dep' is not NULL, a make style dependency file is also written
+** into it with 'out' as target. The context is reset before the assembly, so
+** it may be reused for any number of assemblies. Returns nonzero (TRUE) on
+** failure, fault code printed. */
+auint asmctx_assemble(asmctx_t* hnd, uint8 const* src, uint8 const* out,
+                      uint8 const* dep);
+
+
+/* Assembles the source 'src' into the relocatable object file 'out' (see
+** objfile.h), to be linked later by asmctx_link(). The dependency file is
+** written like by asmctx_assemble(). Returns nonzero (TRUE) on failure, fault
+** code printed. */
+auint asmctx_object(asmctx_t* hnd, uint8 const* src, uint8 const* out,
+                    uint8 const* dep);
+
+
+/* Links the 'cnt' object files or archives in 'obj' into the application
+** binary 'out'. The code, data and zero sections of the objects are placed in
+** the order they are given, then the members of the archives needed by them
+** are added. Returns nonzero (TRUE) on failure, fault code printed. */
+auint asmctx_link(asmctx_t* hnd, uint8 const* const* obj, auint cnt,
+                  uint8 const* out);
+
+
+/* Creates the archive 'out' from the 'cnt' object files in 'obj'. Each
+** object is read to check it and to collect the symbols it defines for the
+** index of the archive. Returns nonzero (TRUE) on failure, fault code
+** printed. */
+auint asmctx_archive(asmctx_t* hnd, uint8 const* const* obj, auint cnt,
+                     uint8 const* out);
+
+
+#endif
@@ -0,0 +1,298 @@
+/**
+**  \file
+**  \brief     Batch assembly
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Assembles the projects listed in a manifest file concurrently, on a pool
+**  of worker threads. Each line of the manifest holds an entry source and the
+**  output application binary's name (either may be a string literal if it
+**  contains spaces). Empty lines and comments (';' or '#') are skipped.
+**
+**  The files read during a batch are cached, so sources shared by several
+**  projects (such as headers) are only read once from the disk.
+*/
+
+
+#include "batch.h"
+#include "asmctx.h"
+#include "fcache.h"
+#include "fault.h"
+#include "strpr.h"
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/* Project of the batch */
+typedef struct{
+ uint8  src[FILE_MAX];  /* Entry source */
+ uint8  out[FILE_MAX];  /* Output application binary */
+ auint  res;            /* Result: nonzero if failed */
+ auint  tus;            /* Time taken in microseconds */
+}batch_prj_t;
+
+/* Batch state shared by the workers */
+typedef struct{
+ batch_prj_t*    prj;   /* Projects */
+ auint           cnt;   /* Count of projects */
+ auint           nxt;   /* Next project to take */
+ pthread_mutex_t pmx;   /* Lock for taking projects */
+ fcache_t*       fca;   /* File cache */
+ fprov_t         prv;   /* Caching file provider */
+}batch_t;
+
+
+
+/* Gets a monotonic time in microseconds */
+static auint batch_i_time(void)
+{
+ struct timespec t;
+ clock_gettime(CLOCK_MONOTONIC, &t);
+ return (auint)(t.tv_sec * 1000000U) + (auint)(t.tv_nsec / 1000U);
+}
+
+
+
+/* Extracts a file name from a manifest line at the given position. It may be
+** a string literal, or anything up to the next whitespace. Returns the end
+** position, or zero if there is no name. */
+static auint batch_i_extnam(uint8* dst, uint8 const* src)
+{
+ auint i = 0U;
+
+ if ((src[0] == (uint8)('\"')) || (src[0] == (uint8)('\''))){
+  return strpr_extstr(dst, src, FILE_MAX);
+ }
+ while ((!strpr_isspc(src[i])) && (!strpr_isend(src[i]))){
+  if (i < (FILE_MAX - 1U)){ dst[i] = src[i]; }
+  i++;
+ }
+ if (i < FILE_MAX){ dst[i] = 0U; }
+ else{              dst[FILE_MAX - 1U] = 0U; }
+ return i;
+}
+
+
+
+/* Parses a project line (entry source and output) at the given position,
+** such as a line of a manifest. Returns zero if it was successful, otherwise
+** the character position of the problem + 1. */
+auint batch_parsel(uint8 const* src, auint beg, uint8* ent, uint8* out)
+{
+ auint i;
+
+ beg = strpr_nextnw(src, beg);
+ i = batch_i_extnam(ent, &(src[beg]));
+ if (i == 0U){ return beg + 1U; }
+ beg = strpr_nextnw(src, beg + i);
+ i = batch_i_extnam(out, &(src[beg]));
+ if (i == 0U){ return beg + 1U; }
+ beg = strpr_nextnw(src, beg + i);
+ if (!strpr_isend(src[beg])){ return beg + 1U; }
+
+ return 0U;
+}
+
+
+
+/* Reads in the manifest, filling up the projects. Returns nonzero (TRUE) on
+** failure, fault printed. */
+static auint batch_i_readman(batch_t* bat, uint8 const* man)
+{
+ uint8        s[80];
+ uint8        e[80];
+ uint8        l[LINE_MAX];
+ fault_off_t  fof;
+ FILE*        fp;
+ auint        beg;
+ auint        i;
+ batch_prj_t* prj;
+
+ fof.fil = man;
+ fof.lin = 0U;
+ fof.chr = 0U;
+
+ fp = fopen((char const*)(man), "r");
+ if (fp == NULL){ goto fault_op; }
+
+ while (fgets((char*)(&l[0]), LINE_MAX, fp) != NULL){
+  fof.lin ++;
+  i = (auint)(strlen((char const*)(&l[0])));
+  while ((i != 0U) && ((l[i - 1U] == (uint8)('\n')) || (l[i - 1U] == (uint8)('\r')))){
+   i--;
+   l[i] = 0U;
+  }
+  beg = strpr_nextnw(&l[0], 0U);
+  if (strpr_isend(l[beg])){ continue; } /* Empty line or comment */
+
+  if ((bat->cnt) >= BATCH_MAX){ goto fault_mx; }
+  prj = &(bat->prj[bat->cnt]);
+  i = batch_parsel(&l[0], beg, &(prj->src[0]), &(prj->out[0]));
+  if (i != 0U){ fof.chr = i - 1U; goto fault_ln; }
+  prj->res = 1U;
+  prj->tus = 0U;
+  (bat->cnt)++;
+ }
+
+ if (ferror(fp)){ goto fault_rd; }
+ fclose(fp);
+ return 0U;
+
+fault_op:
+
+ strerror_r(errno, (char*)(&e[0]), 80U);
+ e[79] = 0U;
+ snprintf((char*)(&s[0]), 80U, "Failed to open manifest: %.54s", (char const*)(&e[0]));
+ fault_print(FAULT_FAIL, &s[0], &fof);
+ return 1U;
+
+fault_rd:
+
+ strerror_r(errno, (char*)(&e[0]), 80U);
+ e[79] = 0U;
+ fclose(fp);
+ snprintf((char*)(&s[0]), 80U, "Failed to read manifest: %.54s", (char const*)(&e[0]));
+ fault_print(FAULT_FAIL, &s[0], &fof);
+ return 1U;
+
+fault_mx:
+
+ fclose(fp);
+ snprintf((char*)(&s[0]), 80U, "Too many projects in manifest");
+ fault_print(FAULT_FAIL, &s[0], &fof);
+ return 1U;
+
+fault_ln:
+
+ fclose(fp);
+ snprintf((char*)(&s[0]), 80U, "Malformed manifest line (needs source and output)");
+ fault_print(FAULT_FAIL, &s[0], &fof);
+ return 1U;
+}
+
+
+
+/* Worker thread: takes projects until there are none left, assembling them
+** with its own context. */
+static void* batch_i_worker(void* arg)
+{
+ batch_t*     bat = (batch_t*)(arg);
+ asmctx_t*    ctx = asmctx_new();
+ batch_prj_t* prj;
+ auint        i;
+ auint        t;
+
+ if (ctx != NULL){
+  asmctx_setverb(ctx, 0U);
+  asmctx_setprov(ctx, &(bat->prv));
+  asmctx_setpar(ctx, 0U, 1U);  /* Projects are already assembled in parallel */
+ }
+
+ while (1){
+
+  pthread_mutex_lock(&(bat->pmx));
+  i = bat->nxt;
+  if (i < (bat->cnt)){ (bat->nxt)++; }
+  pthread_mutex_unlock(&(bat->pmx));
+  if (i >= (bat->cnt)){ break; }
+
+  prj = &(bat->prj[i]);
+  t   = batch_i_time();
+  if (ctx != NULL){
+   prj->res = asmctx_assemble(ctx, &(prj->src[0]), &(prj->out[0]), NULL);
+  }else{
+   prj->res = 1U;              /* Could not create context */
+  }
+  prj->tus = batch_i_time() - t;
+
+ }
+
+ asmctx_delete(ctx);
+ return NULL;
+}
+
+
+
+/* Runs a batch assembly using the given manifest file. 'thc' is the count of
+** worker threads to use, 0 selects it by the number of processors. A summary
+** of the projects is printed at the end. Returns nonzero (TRUE) if any of the
+** projects failed or the manifest could not be processed (fault printed). */
+auint batch_run(uint8 const* man, auint thc)
+{
+ uint8        s[80];
+ batch_t      bat;
+ pthread_t    thr[BATCH_THR];
+ auint        i;
+ auint        fct = 0U;
+ auint        t;
+
+ memset(&bat, 0U, sizeof(bat));
+ bat.prj = (batch_prj_t*)(malloc(sizeof(batch_prj_t) * BATCH_MAX));
+ bat.fca = fcache_new();
+ if ((bat.prj == NULL) || (bat.fca == NULL)){ goto fault_mem; }
+ if (batch_i_readman(&bat, man)){ goto fault_oth; }
+
+ fcache_getprov(bat.fca, &(bat.prv));
+ pthread_mutex_init(&(bat.pmx), NULL);
+
+ /* Start workers. The calling thread also works, so one less is started */
+
+ if (thc == 0U){
+#ifdef _SC_NPROCESSORS_ONLN
+  thc = (auint)(sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+ }
+ if (thc > (bat.cnt)){ thc = bat.cnt; }
+ if (thc > BATCH_THR){ thc = BATCH_THR; }
+ if (thc == 0U){       thc = 1U; }
+
+ printf("Assembling %u projects on %u threads\n", bat.cnt, thc);
+ t = batch_i_time();
+ for (i = 1U; i < thc; i++){
+  if (pthread_create(&thr[i], NULL, &batch_i_worker, (void*)(&bat)) != 0){ break; }
+ }
+ thc = i;
+ batch_i_worker((void*)(&bat));
+ for (i = 1U; i < thc; i++){
+  pthread_join(thr[i], NULL);
+ }
+ t = batch_i_time() - t;
+
+ /* Summary */
+
+ printf("\n");
+ for (i = 0U; i < (bat.cnt); i++){
+  if (bat.prj[i].res != 0U){ fct++; }
+  printf("%s %6u.%03u ms  %s -> %s\n",
+         (bat.prj[i].res != 0U) ? "FAIL" : "OK  ",
+         bat.prj[i].tus / 1000U, bat.prj[i].tus % 1000U,
+         (char const*)(&(bat.prj[i].src[0])),
+         (char const*)(&(bat.prj[i].out[0])));
+ }
+ printf("\nProjects: %u, failed: %u, total time: %u.%03u ms\n",
+        bat.cnt, fct, t / 1000U, t % 1000U);
+
+ /* Clean up */
+
+ pthread_mutex_destroy(&(bat.pmx));
+ fcache_delete(bat.fca);
+ free(bat.prj);
+
+ return (fct != 0U);
+
+fault_mem:
+
+ snprintf((char*)(&s[0]), 80U, "Not enough memory for the batch");
+ fault_printgen(FAULT_FAIL, &s[0]);
+
+fault_oth:
+
+ fcache_delete(bat.fca);
+ free(bat.prj);
+ return 1U;
+}
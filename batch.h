@@ -0,0 +1,49 @@
+/**
+**  \file
+**  \brief     Batch assembly
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Assembles the projects listed in a manifest file concurrently, on a pool
+**  of worker threads. Each line of the manifest holds an entry source and the
+**  output application binary's name (either may be a string literal if it
+**  contains spaces). Empty lines and comments (';' or '#') are skipped.
+**
+**  The files read during a batch are cached, so sources shared by several
+**  projects (such as headers) are only read once from the disk.
+*/
+
+
+#ifndef BATCH_H
+#define BATCH_H
+
+
+#include "types.h"
+
+
+/* Maximal number of projects in a manifest. */
+#define BATCH_MAX   4096U
+
+/* Maximal number of worker threads. */
+#define BATCH_THR   64U
+
+
+
+/* Parses a project line (entry source and output) at the given position,
+** such as a line of a manifest. Returns zero if it was successful, otherwise
+** the character position of the problem + 1. */
+auint batch_parsel(uint8 const* src, auint beg, uint8* ent, uint8* out);
+
+
+/* Runs a batch assembly using the given manifest file. 'thc' is the count of
+** worker threads to use, 0 selects it by the number of processors. A summary
+** of the projects is printed at the end. Returns nonzero (TRUE) if any of the
+** projects failed or the manifest could not be processed (fault printed). */
+auint batch_run(uint8 const* man, auint thc);
+
+
+#endif
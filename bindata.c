@@ -10,8 +10,7 @@
 **
 **  Manages the processing of "bindata" directives, creating a list of binary
 **  includes, to be evaulated in pass3. This also includes performing the
-**  necessary operations on the binary include files. Currently singleton, but
-**  designed so it is possible to extend later.
+**  necessary operations on the binary include files.
 */
 
 
@@ -19,6 +18,10 @@
 #include "strpr.h"
 
 
+/* Size of the read buffer for direct processing of binary includes */
+#define BINDATA_BUF 4096U
+
+
 /* Bindata definition structure for FILE section bindatas */
 /* Note: Like in symtab, quite inefficient memory-wise due to the large "fil"
 ** arrays. Some file name pool needed later. */
@@ -32,32 +35,65 @@ typedef struct{
 
 /* Bindata manager object */
 struct bindata_s{
+ deplst_t*      dls;    /* Bound dependency list */
+ fprov_t const* prv;    /* Bound file provider */
  bindata_def_t* def;    /* Bindata definition */
  auint          dct;    /* Count of definitions */
  auint          dsi;    /* Size of definition array */
+ auint          pct;    /* Count of bindata directives processed */
 };
 
 
 
-/* Built-in singleton object's components */
-static bindata_def_t bindata_def[BINDATA_MAX];
-static bindata_t     bindata_tab = {
- bindata_def, 0U, BINDATA_MAX
-};
+/* Creates a new bindata object. Returns NULL if it is not possible to
+** allocate it. The object has to be initialized before use. */
+bindata_t* bindata_new(void)
+{
+ bindata_t* hnd = (bindata_t*)(calloc(1U, sizeof(bindata_t)));
 
+ if (hnd == NULL){ return NULL; }
+ hnd->def = (bindata_def_t*)(malloc(sizeof(bindata_def_t) * BINDATA_MAX));
+ if (hnd->def == NULL){
+  free(hnd);
+  return NULL;
+ }
+ hnd->dsi = BINDATA_MAX;
+
+ return hnd;
+}
 
 
-/* Get built-in singleton object handle. */
-bindata_t* bindata_getobj(void)
+
+/* Deletes a bindata object. */
+void  bindata_delete(bindata_t* hnd)
 {
- return &bindata_tab;
+ if (hnd != NULL){
+  free(hnd->def);
+ }
+ free(hnd);
 }
 
 
-/* Initializes or resets a bindata object. */
-void  bindata_init(bindata_t* hnd)
+
+/* Initializes or resets a bindata object. The given dependency list and file
+** provider are bound to it: binary includes are read through the provider,
+** and are added to the dependency list. */
+void  bindata_init(bindata_t* hnd, deplst_t* dls, fprov_t const* prv)
 {
+ hnd->dls = dls;
+ hnd->prv = prv;
  hnd->dct = 0U;
+ hnd->pct = 0U;
+}
+
+
+
+/* Returns the count of bindata directives processed since initialization.
+** The include memoization uses it to tell whether an include depended on
+** binary data. */
+auint bindata_getcnt(bindata_t* hnd)
+{
+ return hnd->pct;
 }
 
 
@@ -76,10 +112,10 @@ auint bindata_proc(bindata_t* hnd, symtab_t* stb)
  compst_t*    cst = symtab_getcompst(stb);
  uint8 const* src = compst_getsstrcoff(cst);
  auint        beg = strpr_nextnw(src, 0U);
- FILE*        bif;
- size_t       frv;
+ fprov_file_t* bif;
+ auint        frv;
  auint        i;
- uint8        c;
+ uint8        c[BINDATA_BUF];
 
  /* Check if it is a bindata */
 
@@ -95,6 +131,7 @@ auint bindata_proc(bindata_t* hnd, symtab_t* stb)
  beg = strpr_nextnw(src, beg + i);
  if (!strpr_isend(src[beg])){ goto fault_in0; }
  compst_setcoffrel(cst, beg);
+ hnd->pct ++;
 
  /* Depending on section, process it */
 
@@ -102,19 +139,19 @@ auint bindata_proc(bindata_t* hnd, symtab_t* stb)
 
   if (section_getsect(sec) == SECT_ZERO){ goto fault_zr0; }
 
-  bif = fopen((char const*)(&(ste[0])), "rb");
+  bif = fprov_open(hnd->prv, &(ste[0]), FPROV_M_RDB);
   if (bif == NULL){ goto fault_op0; }
+  if (deplst_add(hnd->dls, &(ste[0]), cst)){ goto fault_dp0; }
 
   while (1){
-   frv = fread(&c, 1U, 1U, bif);
-   if (frv != (size_t)(1U)){
-    if (feof(bif)){ break; } /* End of bindata */
-    else{ goto fault_rd0; }
+   if (fprov_read(bif, &c[0], sizeof(c), &frv)){ goto fault_rd0; }
+   if (frv != 0U){
+    if (section_pushbs(sec, &c[0], frv) != 0U){ goto fault_se0; }
    }
-   if (section_pushb(sec, (auint)(c)) != 0U){ goto fault_se0; }
+   if (frv != sizeof(c)){ break; } /* End of bindata */
   }
 
-  fclose(bif);               /* It was read only, don't care for errors here */
+  fprov_close(bif);               /* It was read only, don't care for errors here */
 
  }else{                      /* Process into table */
 
@@ -151,18 +188,23 @@ fault_rd0:
 
  strerror_r(errno, (char*)(&e[0]), 80U);
  e[79] = 0U;
- fclose(bif);
+ fprov_close(bif);
  snprintf((char*)(&s[0]), 80U, "Unable to read %s: %s", (char const*)(&ste[0]), (char const*)(&e[0]));
  fault_printat(FAULT_FAIL, &s[0], cst);
  return PARSER_ERR;
 
 fault_se0:
 
- fclose(bif);
+ fprov_close(bif);
  snprintf((char*)(&s[0]), 80U, "Overlap or out of section encountered");
  fault_printat(FAULT_FAIL, &s[0], cst);
  return PARSER_ERR;
 
+fault_dp0:
+
+ fprov_close(bif);
+ return PARSER_ERR;
+
 fault_uns:
 
  snprintf((char*)(&s[0]), 80U, "No FILE section support yet");
@@ -175,7 +217,7 @@ fault_uns:
 /* Processes bindata table, and produces the according output in the passed
 ** file. The output is sequential, no seeking is performed on the target file.
 ** Returns nonzero on failure, fault code printed. */
-auint bindata_out(bindata_t* hnd, FILE* ofl)
+auint bindata_out(bindata_t* hnd, fprov_file_t* ofl)
 {
  /* No FILE section support yet, so no problem. */
 
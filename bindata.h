@@ -10,8 +10,7 @@
 **
 **  Manages the processing of "bindata" directives, creating a list of binary
 **  includes, to be evaulated in pass3. This also includes performing the
-**  necessary operations on the binary include files. Currently singleton, but
-**  designed so it is possible to extend later.
+**  necessary operations on the binary include files.
 */
 
 
@@ -21,6 +20,8 @@
 
 #include "types.h"
 #include "symtab.h"
+#include "deplst.h"
+#include "fprov.h"
 
 
 
@@ -33,12 +34,19 @@ typedef struct bindata_s bindata_t;
 
 
 
-/* Get built-in singleton object handle. */
-bindata_t* bindata_getobj(void);
+/* Creates a new bindata object. Returns NULL if it is not possible to
+** allocate it. The object has to be initialized before use. */
+bindata_t* bindata_new(void);
 
 
-/* Initializes or resets a bindata object. */
-void  bindata_init(bindata_t* hnd);
+/* Deletes a bindata object. */
+void  bindata_delete(bindata_t* hnd);
+
+
+/* Initializes or resets a bindata object. The given dependency list and file
+** provider are bound to it: binary includes are read through the provider,
+** and are added to the dependency list. */
+void  bindata_init(bindata_t* hnd, deplst_t* dls, fprov_t const* prv);
 
 
 /* Checks the current source line at the current position for a valid bindata
@@ -49,10 +57,16 @@ void  bindata_init(bindata_t* hnd);
 auint bindata_proc(bindata_t* hnd, symtab_t* stb);
 
 
+/* Returns the count of bindata directives processed since initialization.
+** The include memoization uses it to tell whether an include depended on
+** binary data. */
+auint bindata_getcnt(bindata_t* hnd);
+
+
 /* Processes bindata table, and produces the according output in the passed
 ** file. The output is sequential, no seeking is performed on the target file.
 ** Returns nonzero on failure, fault code printed. */
-auint bindata_out(bindata_t* hnd, FILE* ofl);
+auint bindata_out(bindata_t* hnd, fprov_file_t* ofl);
 
 
 #endif
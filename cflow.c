@@ -0,0 +1,348 @@
+/**
+**  \file
+**  \brief     Control flow optimizer
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  The branches are kept in an array, sorted by offset before the rewrite,
+**  so the branch at a target is found by a binary search. Branches which
+**  overlap (by 'org' within the code) are left alone.
+*/
+
+
+#include "cflow.h"
+#include "compst.h"
+#include "section.h"
+#include "fault.h"
+#include "strpr.h"
+
+
+/* Initial size of the branch array */
+#define CFLOW_BSI   256U
+/* Maximal count of jumps followed along a chain */
+#define CFLOW_HOPS  16U
+
+/* Branch kinds: Left alone */
+#define CFLOW_K_NONE 0U
+/* Branch kinds: Unconditional jump (JMS, JMR, JMA) to an immediate */
+#define CFLOW_K_JMP  1U
+/* Branch kinds: Function call (JFR, JFA) */
+#define CFLOW_K_CALL 2U
+/* Branch kinds: Plain return (RFN X3, X3) */
+#define CFLOW_K_RFN  3U
+
+
+/* Branch */
+typedef struct{
+ auint  off;            /* Offset of the instruction in the code */
+ auint  len;            /* Length of the instruction in words */
+ auint  knd;            /* Kind (CFLOW_K_ values) */
+ auint  rel;            /* Nonzero if a long immediate target is relative */
+ auint  prc;            /* Count of function parameters */
+ uint8  fil[FILE_MAX];  /* File name for notes */
+ auint  lin;            /* Line for notes */
+ auint  chr;            /* Character offset for notes */
+}cflow_br_t;
+
+
+/* Control flow optimizer object structure - definition */
+struct cflow_s{
+ cflow_br_t* br;        /* Branches */
+ auint       cnt;       /* Count of branches */
+ auint       bsi;       /* Size of the branch array */
+};
+
+
+
+/* Compares branches by offset for qsort() */
+static int   cflow_i_brcmp(void const* a, void const* b)
+{
+ auint oa = ((cflow_br_t const*)(a))->off;
+ auint ob = ((cflow_br_t const*)(b))->off;
+ return (oa > ob) - (oa < ob);
+}
+
+
+
+/* Finds the branch at offset 'off' (the array must be sorted). Returns the
+** count of branches if there is none. */
+static auint cflow_i_find(cflow_t const* hnd, auint off)
+{
+ auint b = 0U;
+ auint e = hnd->cnt;
+ auint m;
+
+ while (b < e){
+  m = (b + e) >> 1;
+  if      (hnd->br[m].off < off){ b = m + 1U; }
+  else if (hnd->br[m].off > off){ e = m; }
+  else{ return m; }
+ }
+
+ return hnd->cnt;
+}
+
+
+
+/* Gets the target of a branch from the code section (selected). Returns
+** nonzero (TRUE) if it has an immediate target, then placed in 'tgt'. */
+static auint cflow_i_gettgt(section_t* sec, cflow_br_t const* br, auint* tgt)
+{
+ uint16 w[2];
+ auint  v;
+
+ section_read(sec, br->off, &(w[0]), 2U);
+
+ if (br->len == 1U){
+  if ((w[0] & 0xFC00U) == 0x8C00U){   /* JMS: 10 bit relative */
+   v = w[0] & 0x3FFU;
+   if ((v & 0x200U) != 0U){ v |= 0xFC00U; }
+   *tgt = (br->off + v) & 0xFFFFU;
+   return 1U;
+  }
+  if ((w[0] & 0x30U) == 0x00U){       /* Short immediate */
+   *tgt = w[0] & 0xFU;
+   return 1U;
+  }
+  return 0U;
+ }
+
+ if ((w[0] & 0x3CU) != 0x20U){ return 0U; } /* Not a long immediate */
+ v = ((w[0] & 0x3U) << 14) | (w[1] & 0x3FFFU);
+ if (br->rel != 0U){ v = (br->off + v) & 0xFFFFU; }
+ *tgt = v;
+ return 1U;
+}
+
+
+
+/* Sets the target of a branch in the code section (selected) if it can be
+** encoded in the form the branch has. Returns nonzero (TRUE) if set. */
+static auint cflow_i_settgt(section_t* sec, cflow_br_t const* br, auint tgt)
+{
+ uint16 w[2];
+ auint  v;
+
+ section_read(sec, br->off, &(w[0]), 2U);
+
+ if (br->len == 1U){
+  if ((w[0] & 0xFC00U) != 0x8C00U){ return 0U; } /* Short immediate: stays */
+  v = (tgt - br->off) & 0xFFFFU;
+  if ((v > 0x01FFU) && (v < 0xFE00U)){ return 0U; } /* Out of JMS range */
+  section_fsetw(sec, br->off, 0x8C00U | (v & 0x3FFU));
+  return 1U;
+ }
+
+ if ((w[0] & 0x3CU) != 0x20U){ return 0U; }
+ v = tgt;
+ if (br->rel != 0U){ v = (tgt - br->off) & 0xFFFFU; }
+ section_fsetw(sec, br->off,      (w[0] & 0xFFFCU) | ((v >> 14) & 0x3U));
+ section_fsetw(sec, br->off + 1U, (w[1] & 0xC000U) | (v & 0x3FFFU));
+ return 1U;
+}
+
+
+
+/* Prints a note for a branch. */
+static void  cflow_i_note(cflow_br_t const* br, uint8 const* dsc)
+{
+ fault_off_t fof;
+
+ fof.fil = &(br->fil[0]);
+ fof.lin = br->lin;
+ fof.chr = br->chr;
+ fault_print(FAULT_NOTE, dsc, &fof);
+}
+
+
+
+/* Creates a new control flow optimizer. Returns NULL if it is not possible
+** to allocate it. The object has to be initialized before use. */
+cflow_t* cflow_new(void)
+{
+ return (cflow_t*)(calloc(1U, sizeof(cflow_t)));
+}
+
+
+
+/* Deletes a control flow optimizer. */
+void  cflow_delete(cflow_t* hnd)
+{
+ if (hnd != NULL){
+  free(hnd->br);
+ }
+ free(hnd);
+}
+
+
+
+/* Initializes or resets a control flow optimizer for a new first pass. */
+void  cflow_init(cflow_t* hnd)
+{
+ hnd->cnt = 0U;
+}
+
+
+
+/* Submits the decoded instruction 'ods' of the current source line after it
+** was encoded from the offset 'off' of the current section to the current
+** offset. Returns nonzero (TRUE) if it is not possible to record it (no
+** memory), fault printed. */
+auint cflow_ins(cflow_t* hnd, symtab_t* stb, opcdec_ds_t const* ods, auint off)
+{
+ section_t*   sec = symtab_getsectob(stb);
+ compst_t*    cst = symtab_getcompst(stb);
+ cflow_br_t*  br;
+ auint  knd;
+ auint  rel;
+ auint  i;
+
+ /* Only the branches are of interest */
+
+ if ((ods->id & (OPCDEC_I_R | OPCDEC_I_RB | OPCDEC_I_RS | OPCDEC_I_C)) != 0U){
+  return 0U;
+ }
+
+ switch (ods->id & OPCDEC_I_MASK){
+  case OPCDEC_I_JMS:
+  case OPCDEC_I_JMR:
+  case OPCDEC_I_JMA:
+  case OPCDEC_I_JMP:
+   if ( (ods->opc != 1U) ||
+        (((ods->op[0] >> OPCDEC_S_ADR) & 0x3FU) != 0x20U) ){ return 0U; }
+   knd = CFLOW_K_JMP;
+   break;
+  case OPCDEC_I_JFR:
+  case OPCDEC_I_JFA:
+   knd = CFLOW_K_CALL;
+   break;
+  case OPCDEC_I_RFN:
+   if (ods->opc != 0U){ return 0U; }
+   knd = CFLOW_K_RFN;
+   break;
+  default:
+   return 0U;
+ }
+ rel = ( ((ods->id & OPCDEC_I_MASK) == OPCDEC_I_JMR) ||
+         ((ods->id & OPCDEC_I_MASK) == OPCDEC_I_JFR) );
+
+ /* Add it */
+
+ if ((hnd->cnt) == (hnd->bsi)){
+  i = ((hnd->bsi) == 0U) ? CFLOW_BSI : ((hnd->bsi) << 1);
+  br = (cflow_br_t*)(realloc(hnd->br, sizeof(cflow_br_t) * i));
+  if (br == NULL){ goto fault_mem; }
+  hnd->br = br;
+  hnd->bsi = i;
+ }
+
+ br = &(hnd->br[hnd->cnt]);
+ br->off = off;
+ br->len = section_getoffw(sec) - off;
+ br->knd = knd;
+ br->rel = rel;
+ br->prc = ods->prc;
+ strpr_copy(&(br->fil[0]), compst_getfile(cst), FILE_MAX);
+ br->lin = compst_getline(cst);
+ br->chr = compst_getcoff(cst);
+ hnd->cnt ++;
+
+ return 0U;
+
+fault_mem:
+
+ fault_printat(FAULT_FAIL, (uint8 const*)("Not enough memory for the control flow graph"), cst);
+ return 1U;
+}
+
+
+
+/* Rewrites the code section of the symbol table's bound section object by
+** the branches recorded, after the symbols were resolved into it. Notes are
+** printed for the rewrites. */
+void  cflow_run(cflow_t* hnd, symtab_t* stb)
+{
+ uint8  s[80];
+ section_t*   sec = symtab_getsectob(stb);
+ cflow_br_t*  br = hnd->br;
+ auint  hop[CFLOW_HOPS];
+ auint  ssc = section_getsect(sec);
+ auint  bas;
+ auint  tgt;
+ auint  cur;
+ auint  n;
+ auint  i;
+ auint  j;
+ uint16 w;
+
+ if (hnd->cnt == 0U){ return; }
+
+ section_setsect(sec, SECT_CODE);
+ bas = section_getaddr(sec, 0U);
+
+ /* Sort the branches, dropping those overlapping */
+
+ qsort(br, hnd->cnt, sizeof(cflow_br_t), &cflow_i_brcmp);
+ for (i = 1U; i < (hnd->cnt); i++){
+  if ((br[i - 1U].off + br[i - 1U].len) > br[i].off){
+   br[i - 1U].knd = CFLOW_K_NONE;
+   br[i].knd = CFLOW_K_NONE;
+  }
+ }
+
+ /* Calls without parameters right before a return become jumps */
+
+ for (i = 0U; i < (hnd->cnt); i++){
+  if ((br[i].knd != CFLOW_K_CALL) || (br[i].prc != 0U)){ continue; }
+  j = cflow_i_find(hnd, br[i].off + br[i].len);
+  if ((j == (hnd->cnt)) || (br[j].knd != CFLOW_K_RFN)){ continue; }
+  section_read(sec, br[i].off, &w, 1U);
+  if       ((w & 0xFFC0U) == 0x4540U){ /* JFA -> JMA */
+   section_fsetw(sec, br[i].off, 0x8500U | (w & 0x3FU));
+  }else if ((w & 0xFFC0U) == 0x4440U){ /* JFR -> JMR */
+   section_fsetw(sec, br[i].off, 0x8400U | (w & 0x3FU));
+  }else{
+   continue;
+  }
+  br[i].knd = CFLOW_K_JMP;
+  cflow_i_note(&(br[i]), (uint8 const*)("Call before return turned into a jump"));
+ }
+
+ /* Branches to unconditional jumps get the target at the end of the chain
+ ** (or the farthest along it which can be encoded) */
+
+ for (i = 0U; i < (hnd->cnt); i++){
+  if ((br[i].knd != CFLOW_K_JMP) && (br[i].knd != CFLOW_K_CALL)){ continue; }
+  if (cflow_i_gettgt(sec, &(br[i]), &tgt) == 0U){ continue; }
+
+  cur = tgt;
+  n = 0U;
+  while (n < CFLOW_HOPS){
+   j = cflow_i_find(hnd, (tgt - bas) & 0xFFFFU);
+   if ((j == (hnd->cnt)) || (br[j].knd != CFLOW_K_JMP)){ break; }
+   if (cflow_i_gettgt(sec, &(br[j]), &tgt) == 0U){ break; }
+   if (tgt == cur){ n = 0U; break; } /* Loop: left alone */
+   for (j = 0U; j < n; j++){
+    if (hop[j] == tgt){ break; }
+   }
+   if (j != n){ n = 0U; break; }
+   hop[n] = tgt;
+   n ++;
+  }
+
+  while (n != 0U){
+   if (cflow_i_settgt(sec, &(br[i]), hop[n - 1U])){
+    snprintf((char*)(&s[0]), 80U, "Target moved past %u jump(s) to 0x%04X", n, hop[n - 1U]);
+    cflow_i_note(&(br[i]), &s[0]);
+    break;
+   }
+   n --;
+  }
+ }
+
+ section_setsect(sec, ssc);
+}
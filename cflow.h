@@ -0,0 +1,69 @@
+/**
+**  \file
+**  \brief     Control flow optimizer
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Collects the branches of the code section during the first pass (jumps,
+**  function calls and returns, by their offsets), and once the symbols are
+**  resolved, reads their targets from the encoded code, so forming a control
+**  flow graph. By it the following is rewritten in place (the code does not
+**  move):
+**
+**  - A function call with no parameters right before a plain 'rfn' (one
+**    returning X3 as is) becomes a jump (JFA to JMA, JFR to JMR): the called
+**    function returns in place of the caller. The 'rfn' is kept, it may be
+**    reached otherwise. The function then runs in the frame of the caller, so
+**    it must not rely on the stack pointer at its entry.
+**  - A jump or call to an unconditional jump gets the target of that (along
+**    a chain of such), where it can be encoded in the same form.
+**
+**  Every rewrite is reported by a note on its line.
+*/
+
+
+#ifndef CFLOW_H
+#define CFLOW_H
+
+
+#include "types.h"
+#include "symtab.h"
+#include "opcdec.h"
+
+
+/* Control flow optimizer object structure */
+typedef struct cflow_s cflow_t;
+
+
+
+/* Creates a new control flow optimizer. Returns NULL if it is not possible
+** to allocate it. The object has to be initialized before use. */
+cflow_t* cflow_new(void);
+
+
+/* Deletes a control flow optimizer. */
+void  cflow_delete(cflow_t* hnd);
+
+
+/* Initializes or resets a control flow optimizer for a new first pass. */
+void  cflow_init(cflow_t* hnd);
+
+
+/* Submits the decoded instruction 'ods' of the current source line after it
+** was encoded from the offset 'off' of the current section to the current
+** offset. Returns nonzero (TRUE) if it is not possible to record it (no
+** memory), fault printed. */
+auint cflow_ins(cflow_t* hnd, symtab_t* stb, opcdec_ds_t const* ods, auint off);
+
+
+/* Rewrites the code section of the symbol table's bound section object by
+** the branches recorded, after the symbols were resolved into it. Notes are
+** printed for the rewrites. */
+void  cflow_run(cflow_t* hnd, symtab_t* stb);
+
+
+#endif
@@ -24,15 +24,19 @@ struct compst_s{
 };
 
 
-/* Built-in singleton object */
-static compst_t compst_obj;
+/* Creates a new compilation state object. Returns NULL if it is not possible
+** to allocate it. The object has to be initialized before use. */
+compst_t* compst_new(void)
+{
+ return (compst_t*)(malloc(sizeof(compst_t)));
+}
 
 
 
-/* Get built-in singleton object handle. */
-compst_t* compst_getobj(void)
+/* Deletes a compilation state object. */
+void  compst_delete(compst_t* hnd)
 {
- return &compst_obj;
+ free(hnd);
 }
 
 
@@ -140,6 +144,15 @@ void  compst_setgsym(compst_t* hnd, uint8 const* src)
 
 
 
+/* Gets last global symbol (empty string if there is none yet). Persists only
+** until setting a new global symbol. */
+uint8 const* compst_getgsym(compst_t* hnd)
+{
+ return &(hnd->lgb[0]);
+}
+
+
+
 /* Sets file name the compilation is performing from */
 void  compst_setfile(compst_t* hnd, uint8 const* src)
 {
@@ -32,8 +32,13 @@ typedef struct compst_s compst_t;
 
 
 
-/* Get built-in singleton object handle. */
-compst_t* compst_getobj(void);
+/* Creates a new compilation state object. Returns NULL if it is not possible
+** to allocate it. The object has to be initialized before use. */
+compst_t* compst_new(void);
+
+
+/* Deletes a compilation state object. */
+void  compst_delete(compst_t* hnd);
 
 
 /* Inits a compilation state object */
@@ -60,6 +65,11 @@ auint compst_issymequ(compst_t* hnd, uint8 const* s0, uint8 const* s1);
 void  compst_setgsym(compst_t* hnd, uint8 const* src);
 
 
+/* Gets last global symbol (empty string if there is none yet). Persists only
+** until setting a new global symbol. */
+uint8 const* compst_getgsym(compst_t* hnd);
+
+
 /* Sets file name the compilation is performing from (copied in) */
 void  compst_setfile(compst_t* hnd, uint8 const* src);
 
@@ -0,0 +1,290 @@
+/**
+**  \file
+**  \brief     Conditional assembly
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Only the conditionals met in assembled lines get a level on the stack.
+**  Within a branch not taken only a count of the nested conditionals is
+**  kept, so skipping a line is just a look at its first characters.
+*/
+
+
+#include "cond.h"
+#include "compst.h"
+#include "litpr.h"
+#include "fault.h"
+#include "strpr.h"
+
+
+/* Directives: None (an ordinary line) */
+#define COND_D_NONE   0U
+/* Directives: 'if' */
+#define COND_D_IF     1U
+/* Directives: 'ifdef' */
+#define COND_D_IFDEF  2U
+/* Directives: 'ifndef' */
+#define COND_D_IFNDEF 3U
+/* Directives: 'else' */
+#define COND_D_ELSE   4U
+/* Directives: 'endif' */
+#define COND_D_ENDIF  5U
+
+
+/* Level of an open conditional */
+typedef struct{
+ auint  act;            /* Nonzero if the current branch is assembled */
+ auint  els;            /* Nonzero if the 'else' was met */
+ uint8  fil[FILE_MAX];  /* File of the conditional */
+ auint  lin;            /* Line of the conditional */
+ auint  chr;            /* Character offset of the conditional */
+}cond_lvl_t;
+
+
+/* Conditional assembly object structure - definition */
+struct cond_s{
+ cond_lvl_t stk[COND_DEP]; /* Open conditionals */
+ auint      dep;        /* Count of open conditionals */
+ auint      skp;        /* Conditionals open within the branch skipped */
+ auint      cnt;        /* Count of directives processed */
+};
+
+
+
+/* Checks for the keyword 'kw' (not a label of the same name) at 'src'.
+** Returns nonzero (TRUE) if it is there. */
+static auint cond_i_iskw(uint8 const* src, char const* kw)
+{
+ return ( (compst_issymequ(NULL, src, (uint8 const*)(kw))) &&
+          (src[strlen(kw)] != (uint8)(':')) );
+}
+
+
+
+/* Gets the directive at 'src' (COND_D_ values). */
+static auint cond_i_dir(uint8 const* src)
+{
+ if       (src[0] == (uint8)('i')){
+  if (cond_i_iskw(src, "if")){     return COND_D_IF; }
+  if (cond_i_iskw(src, "ifdef")){  return COND_D_IFDEF; }
+  if (cond_i_iskw(src, "ifndef")){ return COND_D_IFNDEF; }
+ }else if (src[0] == (uint8)('e')){
+  if (cond_i_iskw(src, "else")){   return COND_D_ELSE; }
+  if (cond_i_iskw(src, "endif")){  return COND_D_ENDIF; }
+ }else{}
+
+ return COND_D_NONE;
+}
+
+
+
+/* Creates a new conditional assembly object. Returns NULL if it is not
+** possible to allocate it. The object has to be initialized before use. */
+cond_t* cond_new(void)
+{
+ return (cond_t*)(calloc(1U, sizeof(cond_t)));
+}
+
+
+
+/* Deletes a conditional assembly object. */
+void  cond_delete(cond_t* hnd)
+{
+ free(hnd);
+}
+
+
+
+/* Initializes or resets a conditional assembly object for a new first pass
+** (no conditionals open). */
+void  cond_init(cond_t* hnd)
+{
+ hnd->dep = 0U;
+ hnd->skp = 0U;
+ hnd->cnt = 0U;
+}
+
+
+
+/* Checks the current source line for a conditional directive, processing
+** it. Returns PARSER_OK if the line has to be assembled, PARSER_END if it
+** was a directive or it is skipped, PARSER_ERR on failure (fault printed). */
+auint cond_proc(cond_t* hnd, symtab_t* stb)
+{
+ uint8        s[80];
+ uint8        nam[SYMB_MAX];
+ compst_t*    cst = symtab_getcompst(stb);
+ uint8 const* src = compst_getsstr(cst);
+ cond_lvl_t*  lvl = NULL;
+ auint        beg = strpr_nextnw(src, 0U);
+ auint        cof = beg;
+ auint        dir = cond_i_dir(&(src[beg]));
+ auint        u;
+ auint        t;
+ auint        v;
+
+ if (hnd->dep != 0U){ lvl = &(hnd->stk[hnd->dep - 1U]); }
+
+ /* In a branch not taken only the nesting is tracked */
+
+ if ( (lvl != NULL) && (lvl->act == 0U) ){
+  if       ( (dir == COND_D_IF) || (dir == COND_D_IFDEF) ||
+             (dir == COND_D_IFNDEF) ){
+   hnd->skp ++;
+  }else if (dir == COND_D_ENDIF){
+   if (hnd->skp != 0U){ hnd->skp --; }
+   else{ hnd->dep --; hnd->cnt ++; }
+  }else if ( (dir == COND_D_ELSE) && (hnd->skp == 0U) ){
+   if (lvl->els){ goto fault_els; }
+   lvl->act = 1U;
+   lvl->els = 1U;
+   hnd->cnt ++;
+  }else{}
+  return PARSER_END;
+ }
+
+ if (dir == COND_D_NONE){ return PARSER_OK; }
+ hnd->cnt ++;
+
+ switch (dir){
+
+  case COND_D_IF:
+
+   if (hnd->dep == COND_DEP){ goto fault_dep; }
+   beg = strpr_nextnw(src, beg + 2U);
+   compst_setcoff(cst, beg);
+   t = litpr_getval(&(src[beg]), &u, &v, stb);
+   if (t == LITPR_INV){ return PARSER_ERR; }
+   if ((t & LITPR_VAL) == 0U){ goto fault_unk; }
+   beg = strpr_nextnw(src, beg + u);
+   if (!strpr_isend(src[beg])){ goto fault_ext; }
+   t = (v != 0U);
+   break;
+
+  case COND_D_IFDEF:
+  case COND_D_IFNDEF:
+
+   if (hnd->dep == COND_DEP){ goto fault_dep; }
+   beg = strpr_nextnw(src, beg + ((dir == COND_D_IFDEF) ? 5U : 6U));
+   if (!strpr_issym(src[beg])){ goto fault_sym; }
+   compst_copysym(cst, &(nam[0]), &(src[beg]));
+   while (strpr_issym(src[beg])){ beg ++; }
+   beg = strpr_nextnw(src, beg);
+   if (!strpr_isend(src[beg])){ goto fault_ext; }
+   t = (symtab_isbound(stb, &(nam[0])) != 0U);
+   if (dir == COND_D_IFNDEF){ t = !t; }
+   break;
+
+  case COND_D_ELSE:
+
+   if (hnd->dep == 0U){ goto fault_nif; }
+   if (lvl->els){ goto fault_els; }
+   beg = strpr_nextnw(src, beg + 4U);
+   if (!strpr_isend(src[beg])){ goto fault_ext; }
+   lvl->act = 0U;
+   lvl->els = 1U;
+   return PARSER_END;
+
+  default:               /* COND_D_ENDIF */
+
+   if (hnd->dep == 0U){ goto fault_nif; }
+   beg = strpr_nextnw(src, beg + 5U);
+   if (!strpr_isend(src[beg])){ goto fault_ext; }
+   hnd->dep --;
+   return PARSER_END;
+
+ }
+
+ /* Open the conditional ('t' tells whether it is taken) */
+
+ lvl = &(hnd->stk[hnd->dep]);
+ lvl->act = t;
+ lvl->els = 0U;
+ strpr_copy(&(lvl->fil[0]), compst_getfile(cst), FILE_MAX);
+ lvl->lin = compst_getline(cst);
+ lvl->chr = cof;
+ hnd->dep ++;
+
+ return PARSER_END;
+
+
+fault_els:
+
+ compst_setcoff(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Multiple \'else\' for a conditional");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_dep:
+
+ compst_setcoff(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Conditionals nested too deep (at most %u)", COND_DEP);
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_unk:
+
+ compst_setcoff(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Condition is not known in the first pass");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_ext:
+
+ compst_setcoff(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Extra characters after conditional");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_sym:
+
+ compst_setcoff(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Symbol expected");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_nif:
+
+ compst_setcoff(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Conditional directive without \'if\'");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+}
+
+
+
+/* Checks at the end of the source file 'fil' (NULL: the end of the first
+** pass) that no conditional begun in it is left open. Returns nonzero
+** (TRUE) if one is, fault printed. */
+auint cond_chkend(cond_t* hnd, uint8 const* fil)
+{
+ uint8        s[80];
+ cond_lvl_t const* lvl;
+ fault_off_t  fof;
+
+ if (hnd->dep == 0U){ return 0U; }
+ lvl = &(hnd->stk[hnd->dep - 1U]);
+ if ( (fil != NULL) &&
+      (strcmp((char const*)(&(lvl->fil[0])), (char const*)(fil)) != 0) ){ return 0U; }
+
+ fof.fil = &(lvl->fil[0]);
+ fof.lin = lvl->lin;
+ fof.chr = lvl->chr;
+ snprintf((char*)(&s[0]), 80U, "Conditional not closed by \'endif\'");
+ fault_print(FAULT_FAIL, &s[0], &fof);
+ return 1U;
+}
+
+
+
+/* Returns the count of conditional directives processed since
+** initialization. The include memoization and the fragments use it to tell
+** whether an include depended on conditionals. */
+auint cond_getcnt(cond_t* hnd)
+{
+ return hnd->cnt;
+}
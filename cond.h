@@ -0,0 +1,72 @@
+/**
+**  \file
+**  \brief     Conditional assembly
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Manages the 'if', 'ifdef', 'ifndef', 'else' and 'endif' directives of the
+**  first pass. The conditions are evaluated when the directive is met: an
+**  'if' needs a value known at that point, an 'ifdef' tells whether the
+**  symbol is defined earlier in the source.
+**
+**  The lines of a branch not taken are only looked at for these directives
+**  to track the nesting (the conditions within are not evaluated), then
+**  skipped without parsing them any further.
+*/
+
+
+#ifndef COND_H
+#define COND_H
+
+
+#include "types.h"
+#include "symtab.h"
+
+
+/* Conditional assembly object structure */
+typedef struct cond_s cond_t;
+
+
+/* Maximal depth of nested conditionals (only counting those in assembled
+** lines) */
+#define COND_DEP  64U
+
+
+
+/* Creates a new conditional assembly object. Returns NULL if it is not
+** possible to allocate it. The object has to be initialized before use. */
+cond_t* cond_new(void);
+
+
+/* Deletes a conditional assembly object. */
+void  cond_delete(cond_t* hnd);
+
+
+/* Initializes or resets a conditional assembly object for a new first pass
+** (no conditionals open). */
+void  cond_init(cond_t* hnd);
+
+
+/* Checks the current source line for a conditional directive, processing
+** it. Returns PARSER_OK if the line has to be assembled, PARSER_END if it
+** was a directive or it is skipped, PARSER_ERR on failure (fault printed). */
+auint cond_proc(cond_t* hnd, symtab_t* stb);
+
+
+/* Checks at the end of the source file 'fil' (NULL: the end of the first
+** pass) that no conditional begun in it is left open. Returns nonzero
+** (TRUE) if one is, fault printed. */
+auint cond_chkend(cond_t* hnd, uint8 const* fil);
+
+
+/* Returns the count of conditional directives processed since
+** initialization. The include memoization and the fragments use it to tell
+** whether an include depended on conditionals. */
+auint cond_getcnt(cond_t* hnd);
+
+
+#endif
@@ -0,0 +1,143 @@
+/**
+**  \file
+**  \brief     Dependency list
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Collects the names of every file read during the compilation (sources
+**  and binary includes), so a make style dependency file can be produced for
+**  the application binary.
+*/
+
+
+#include "deplst.h"
+#include "fault.h"
+#include "strpr.h"
+
+
+/* Dependency list object structure - definition */
+struct deplst_s{
+ auint cnt;                       /* Count of dependencies */
+ uint8 fnm[DEPLST_MAX][FILE_MAX]; /* File names */
+};
+
+
+
+/* Writes a file name escaped for make (spaces, '#' and '$' need special
+** treatment). Returns nonzero on failure. */
+static auint deplst_wrnam(uint8 const* nam, fprov_file_t* ofl)
+{
+ auint i = 0U;
+
+ while (nam[i] != 0U){
+  if ( (nam[i] == (uint8)(' ')) ||
+       (nam[i] == (uint8)('#')) ){
+   if (fprov_write(ofl, (uint8 const*)("\\"), 1U)){ return 1U; }
+  }
+  if (nam[i] == (uint8)('$')){
+   if (fprov_write(ofl, (uint8 const*)("$"), 1U)){ return 1U; }
+  }
+  if (fprov_write(ofl, &(nam[i]), 1U)){ return 1U; }
+  i++;
+ }
+
+ return 0U;
+}
+
+
+
+/* Creates a new dependency list object. Returns NULL if it is not possible to
+** allocate it. The object has to be initialized before use. */
+deplst_t* deplst_new(void)
+{
+ return (deplst_t*)(malloc(sizeof(deplst_t)));
+}
+
+
+
+/* Deletes a dependency list object. */
+void  deplst_delete(deplst_t* hnd)
+{
+ free(hnd);
+}
+
+
+
+/* Initializes or resets a dependency list object as empty. */
+void  deplst_init(deplst_t* hnd)
+{
+ hnd->cnt = 0U;
+}
+
+
+
+/* Adds a file name to the dependency list. Names already on the list are
+** ignored (the name must match exactly). Prints fault using the compile state
+** and returns nonzero (TRUE) if the list is full. */
+auint deplst_add(deplst_t* hnd, uint8 const* fnam, compst_t* cst)
+{
+ uint8 s[80];
+ auint i;
+
+ for (i = 0U; i < (hnd->cnt); i++){
+  if (strcmp((char const*)(fnam), (char const*)(&(hnd->fnm[i][0]))) == 0){
+   return 0U;            /* Already on the list */
+  }
+ }
+
+ if ((hnd->cnt) >= DEPLST_MAX){ goto fault_dmx; }
+ strpr_copy(&(hnd->fnm[hnd->cnt][0]), fnam, FILE_MAX);
+ (hnd->cnt)++;
+ return 0U;
+
+fault_dmx:
+
+ snprintf((char*)(&s[0]), 80U, "Too many dependencies");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return 1U;
+}
+
+
+
+/* Writes out the dependency list in make syntax into the passed file, using
+** 'tgt' as the target. Every dependency also gets an empty rule, so make
+** does not fail when one of them is removed. Returns nonzero on failure,
+** fault code printed. */
+auint deplst_out(deplst_t* hnd, uint8 const* tgt, fprov_file_t* ofl)
+{
+ uint8 s[80];
+ uint8 e[80];
+ auint i;
+
+ /* Target line with all the dependencies */
+
+ if (deplst_wrnam(tgt, ofl)){ goto fault_wrt; }
+ if (fprov_write(ofl, (uint8 const*)(":"), 1U)){ goto fault_wrt; }
+ for (i = 0U; i < (hnd->cnt); i++){
+  if (fprov_write(ofl, (uint8 const*)(" \\\n "), 4U)){ goto fault_wrt; }
+  if (deplst_wrnam(&(hnd->fnm[i][0]), ofl)){ goto fault_wrt; }
+ }
+ if (fprov_write(ofl, (uint8 const*)("\n"), 1U)){ goto fault_wrt; }
+
+ /* Empty rules for each dependency */
+
+ for (i = 0U; i < (hnd->cnt); i++){
+  if (fprov_write(ofl, (uint8 const*)("\n"), 1U)){ goto fault_wrt; }
+  if (deplst_wrnam(&(hnd->fnm[i][0]), ofl)){ goto fault_wrt; }
+  if (fprov_write(ofl, (uint8 const*)(":\n"), 2U)){ goto fault_wrt; }
+ }
+
+ return 0U;
+
+fault_wrt:
+
+ strerror_r(errno, (char*)(&e[0]), 80U);
+ e[79] = 0U;
+ snprintf((char*)(&s[0]), 80U, "Failed to write dependencies: %.49s", (char const*)(&e[0]));
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
+}
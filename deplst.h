@@ -0,0 +1,61 @@
+/**
+**  \file
+**  \brief     Dependency list
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Collects the names of every file read during the compilation (sources
+**  and binary includes), so a make style dependency file can be produced for
+**  the application binary.
+*/
+
+
+#ifndef DEPLST_H
+#define DEPLST_H
+
+
+#include "types.h"
+#include "compst.h"
+#include "fprov.h"
+
+
+/* Dependency list object structure */
+typedef struct deplst_s deplst_t;
+
+
+/* Maximal number of distinct dependencies. */
+#define DEPLST_MAX  1024U
+
+
+
+/* Creates a new dependency list object. Returns NULL if it is not possible to
+** allocate it. The object has to be initialized before use. */
+deplst_t* deplst_new(void);
+
+
+/* Deletes a dependency list object. */
+void  deplst_delete(deplst_t* hnd);
+
+
+/* Initializes or resets a dependency list object as empty. */
+void  deplst_init(deplst_t* hnd);
+
+
+/* Adds a file name to the dependency list. Names already on the list are
+** ignored (the name must match exactly). Prints fault using the compile state
+** and returns nonzero (TRUE) if the list is full. */
+auint deplst_add(deplst_t* hnd, uint8 const* fnam, compst_t* cst);
+
+
+/* Writes out the dependency list in make syntax into the passed file, using
+** 'tgt' as the target. Every dependency also gets an empty rule, so make
+** does not fail when one of them is removed. Returns nonzero on failure,
+** fault code printed. */
+auint deplst_out(deplst_t* hnd, uint8 const* tgt, fprov_file_t* ofl);
+
+
+#endif
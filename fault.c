@@ -15,18 +15,78 @@
 
 
 
+/* Stream where faults are output (NULL: standard output), per thread */
+static _Thread_local FILE* fault_out = NULL;
+
+/* Nonzero if faults are discarded, per thread */
+static _Thread_local auint fault_dis = 0U;
+
+
+
+/* Sets the stream where faults are output. NULL selects the standard output
+** (default). Note that this is set for the calling thread only. */
+void fault_setout(FILE* ofl)
+{
+ fault_out = ofl;
+}
+
+
+
+/* Gets the stream where faults are output on the calling thread (NULL:
+** standard output). */
+FILE* fault_getout(void)
+{
+ return fault_out;
+}
+
+
+
+/* Sets whether faults are discarded (nonzero) instead of being output on the
+** calling thread (default: output). */
+void fault_setdiscard(auint dis)
+{
+ fault_dis = dis;
+}
+
+
+
+/* Outputs the faults collected in a stream (set by fault_setout(), such as
+** on an other thread) from its beginning, as if they were printed now. */
+void fault_replay(FILE* src)
+{
+ char   b[256];
+ size_t l;
+
+ if (fault_dis){ return; }
+ fflush(src);
+ rewind(src);
+ while (1){
+  l = fread(&b[0], 1U, sizeof(b), src);
+  if (l == 0U){ break; }
+  fwrite(&b[0], 1U, l, (fault_out != NULL) ? fault_out : stdout);
+ }
+}
+
+
+
 /* Prints out a failure message, sev is the severity, dsc is the reason of
-** failure, off is it's offset. */
+** failure, off is it's offset. The message is assembled first, and output in
+** one write, so messages of assemblies running on different threads don't
+** get mixed up. */
 void fault_print(auint sev, uint8 const* dsc, fault_off_t const* off)
 {
- if      (sev == FAULT_NOTE){ printf("Note ..: "); }
- else if (sev == FAULT_WARN){ printf("Warning: "); }
- else                       { printf("Error .: "); }
+ char const* sst;
+ char        s[256];
+
+ if (fault_dis){ return; }
 
- printf("%s\n", (char const*)(dsc));
+ if      (sev == FAULT_NOTE){ sst = "Note ..: "; }
+ else if (sev == FAULT_WARN){ sst = "Warning: "; }
+ else                       { sst = "Error .: "; }
 
- printf("File ..: %s\n", (char const*)(off->fil));
- printf("At ....: Line %d, Character %d\n", off->lin, off->chr);
+ snprintf(&s[0], 256U, "%s%s\nFile ..: %s\nAt ....: Line %d, Character %d\n",
+          sst, (char const*)(dsc), (char const*)(off->fil), off->lin, off->chr);
+ fputs(&s[0], (fault_out != NULL) ? fault_out : stdout);
 }
 
 
@@ -33,8 +33,28 @@ typedef struct{
 #define FAULT_FAIL 2U
 
 
+/* Sets the stream where faults are output. NULL selects the standard output
+** (default). Note that this is set for the calling thread only. */
+void fault_setout(FILE* ofl);
+
+
+/* Gets the stream where faults are output on the calling thread (NULL:
+** standard output). */
+FILE* fault_getout(void);
+
+
+/* Sets whether faults are discarded (nonzero) instead of being output on the
+** calling thread (default: output). */
+void fault_setdiscard(auint dis);
+
+
+/* Outputs the faults collected in a stream (set by fault_setout(), such as
+** on an other thread) from its beginning, as if they were printed now. */
+void fault_replay(FILE* src);
+
+
 /* Prints out a failure message, sev is the severity, dsc is the reason of
-** failure, off is it's offset. */
+** failure, off is it's offset. The message is output in one write. */
 void fault_print(auint sev, uint8 const* dsc, fault_off_t const* off);
 
 
@@ -0,0 +1,266 @@
+/**
+**  \file
+**  \brief     File cache
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Caches the contents of files read through it, so they are only read once
+**  from the disk. It provides a file provider: files opened for reading are
+**  served from the cache (loading them through the default provider on first
+**  use), writes go directly to the default provider.
+**
+**  The cache may be used by several assembler contexts on different threads
+**  at once. Cached files are never changed, only dropped, which must only be
+**  done while no assembly uses the cache.
+*/
+
+
+#include "fcache.h"
+#include "compst.h"
+#include "strpr.h"
+#include <pthread.h>
+
+
+/* Cached file */
+typedef struct fcache_fil_s{
+ struct fcache_fil_s* nxt; /* Next cached file */
+ uint8  nam[FILE_MAX];     /* File name */
+ uint8* dat;               /* Contents */
+ auint  len;               /* Size of contents */
+}fcache_fil_t;
+
+/* Cache provider file handle */
+typedef struct{
+ fcache_fil_t* fil;     /* Cached file (NULL: written through the default) */
+ auint  pos;            /* Read position */
+ void*  fh;             /* Default provider's file handle for writes */
+}fcache_hnd_t;
+
+/* File cache object structure - definition */
+struct fcache_s{
+ pthread_mutex_t mtx;   /* Lock for the list of files */
+ fcache_fil_t*   fil;   /* Cached files */
+ void (*lcb)(void* ctx, uint8 const* fnam); /* Load callback */
+ void*           lct;   /* Load callback context */
+};
+
+
+
+/* Reads in a file fully through the default provider into a new cached file
+** structure. Returns NULL on failure (errno set). */
+static fcache_fil_t* fcache_i_load(uint8 const* fnam, auint mod)
+{
+ fprov_t const* def = fprov_getdef();
+ fcache_fil_t*  fil;
+ void*          fh;
+ uint8*         t;
+ auint          siz = 4096U;
+ auint          r;
+
+ fil = (fcache_fil_t*)(malloc(sizeof(fcache_fil_t)));
+ if (fil == NULL){ errno = ENOMEM; return NULL; }
+ fil->dat = (uint8*)(malloc(siz));
+ if (fil->dat == NULL){ free(fil); errno = ENOMEM; return NULL; }
+ fil->len = 0U;
+ strpr_copy(&(fil->nam[0]), fnam, FILE_MAX);
+
+ fh = def->opn(def->ctx, fnam, mod);
+ if (fh == NULL){ goto fault_rd; }
+ while (1){
+  if (def->red(def->ctx, fh, &(fil->dat[fil->len]), siz - (fil->len), &r)){
+   def->cls(def->ctx, fh);
+   goto fault_rd;
+  }
+  fil->len += r;
+  if ((fil->len) != siz){ break; } /* End of file */
+  t = (uint8*)(realloc(fil->dat, siz << 1));
+  if (t == NULL){ def->cls(def->ctx, fh); errno = ENOMEM; goto fault_rd; }
+  fil->dat = t;
+  siz    <<= 1;
+ }
+ def->cls(def->ctx, fh);       /* It was read only, don't care for errors */
+
+ return fil;
+
+fault_rd:
+
+ free(fil->dat);
+ free(fil);
+ return NULL;
+}
+
+
+
+/* Cache provider: open */
+static void* fcache_p_opn(void* ctx, uint8 const* fnam, auint mod)
+{
+ fcache_t*      hnd = (fcache_t*)(ctx);
+ fprov_t const* def = fprov_getdef();
+ fcache_hnd_t*  ch;
+ fcache_fil_t*  fil;
+
+ ch = (fcache_hnd_t*)(malloc(sizeof(fcache_hnd_t)));
+ if (ch == NULL){ errno = ENOMEM; return NULL; }
+ ch->fil = NULL;
+ ch->pos = 0U;
+ ch->fh  = NULL;
+
+ if ((mod & 2U) != 0U){        /* Write: no caching */
+  ch->fh = def->opn(def->ctx, fnam, mod);
+  if (ch->fh == NULL){ free(ch); return NULL; }
+  return (void*)(ch);
+ }
+
+ pthread_mutex_lock(&(hnd->mtx));
+ fil = hnd->fil;
+ while (fil != NULL){
+  if (strcmp((char const*)(fnam), (char const*)(&(fil->nam[0]))) == 0){ break; }
+  fil = fil->nxt;
+ }
+ if (fil == NULL){             /* Not cached yet */
+  fil = fcache_i_load(fnam, mod);
+  if (fil != NULL){
+   fil->nxt = hnd->fil;
+   hnd->fil = fil;
+   if (hnd->lcb != NULL){ hnd->lcb(hnd->lct, &(fil->nam[0])); }
+  }
+ }
+ pthread_mutex_unlock(&(hnd->mtx));
+
+ if (fil == NULL){ free(ch); return NULL; }
+ ch->fil = fil;
+ return (void*)(ch);
+}
+
+
+
+/* Cache provider: read. Cached files are never changed, so no locking is
+** necessary. */
+static auint fcache_p_red(void* ctx, void* fh, uint8* dst, auint len, auint* rct)
+{
+ fcache_hnd_t* ch = (fcache_hnd_t*)(fh);
+
+ if (len > ((ch->fil->len) - (ch->pos))){ len = (ch->fil->len) - (ch->pos); }
+ memcpy(dst, &(ch->fil->dat[ch->pos]), len);
+ ch->pos += len;
+ *rct = len;
+ return 0U;
+}
+
+
+
+/* Cache provider: write */
+static auint fcache_p_wrt(void* ctx, void* fh, uint8 const* src, auint len)
+{
+ fprov_t const* def = fprov_getdef();
+ fcache_hnd_t*  ch  = (fcache_hnd_t*)(fh);
+
+ return def->wrt(def->ctx, ch->fh, src, len);
+}
+
+
+
+/* Cache provider: close */
+static auint fcache_p_cls(void* ctx, void* fh)
+{
+ fprov_t const* def = fprov_getdef();
+ fcache_hnd_t*  ch  = (fcache_hnd_t*)(fh);
+ auint          r   = 0U;
+
+ if (ch->fh != NULL){
+  r = def->cls(def->ctx, ch->fh);
+ }
+ free(ch);
+ return r;
+}
+
+
+
+/* Creates a new (empty) file cache. Returns NULL if it is not possible to
+** allocate it. */
+fcache_t* fcache_new(void)
+{
+ fcache_t* hnd = (fcache_t*)(calloc(1U, sizeof(fcache_t)));
+
+ if (hnd == NULL){ return NULL; }
+ if (pthread_mutex_init(&(hnd->mtx), NULL) != 0){
+  free(hnd);
+  return NULL;
+ }
+
+ return hnd;
+}
+
+
+
+/* Deletes a file cache with all the files cached in it. */
+void  fcache_delete(fcache_t* hnd)
+{
+ fcache_fil_t* fil;
+
+ if (hnd == NULL){ return; }
+ while (hnd->fil != NULL){
+  fil = hnd->fil;
+  hnd->fil = fil->nxt;
+  free(fil->dat);
+  free(fil);
+ }
+ pthread_mutex_destroy(&(hnd->mtx));
+ free(hnd);
+}
+
+
+
+/* Fills up a file provider using the cache. */
+void  fcache_getprov(fcache_t* hnd, fprov_t* prv)
+{
+ prv->opn = &fcache_p_opn;
+ prv->red = &fcache_p_red;
+ prv->wrt = &fcache_p_wrt;
+ prv->cls = &fcache_p_cls;
+ prv->ctx = (void*)(hnd);
+}
+
+
+
+/* Sets a callback which is called with the file name whenever a file is
+** loaded into the cache (NULL to remove it). */
+void  fcache_setlcb(fcache_t* hnd, void (*lcb)(void* ctx, uint8 const* fnam), void* ctx)
+{
+ pthread_mutex_lock(&(hnd->mtx));
+ hnd->lcb = lcb;
+ hnd->lct = ctx;
+ pthread_mutex_unlock(&(hnd->mtx));
+}
+
+
+
+/* Drops a file from the cache, so it is loaded again on next use. Returns
+** nonzero (TRUE) if the file was in the cache. */
+auint fcache_drop(fcache_t* hnd, uint8 const* fnam)
+{
+ fcache_fil_t** pfl;
+ fcache_fil_t*  fil;
+ auint          r = 0U;
+
+ pthread_mutex_lock(&(hnd->mtx));
+ pfl = &(hnd->fil);
+ while ((*pfl) != NULL){
+  fil = *pfl;
+  if (strcmp((char const*)(fnam), (char const*)(&(fil->nam[0]))) == 0){
+   *pfl = fil->nxt;
+   free(fil->dat);
+   free(fil);
+   r = 1U;
+   break;
+  }
+  pfl = &(fil->nxt);
+ }
+ pthread_mutex_unlock(&(hnd->mtx));
+
+ return r;
+}
@@ -0,0 +1,58 @@
+/**
+**  \file
+**  \brief     File cache
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Caches the contents of files read through it, so they are only read once
+**  from the disk. It provides a file provider: files opened for reading are
+**  served from the cache (loading them through the default provider on first
+**  use), writes go directly to the default provider.
+**
+**  The cache may be used by several assembler contexts on different threads
+**  at once. Cached files are never changed, only dropped, which must only be
+**  done while no assembly uses the cache.
+*/
+
+
+#ifndef FCACHE_H
+#define FCACHE_H
+
+
+#include "types.h"
+#include "fprov.h"
+
+
+/* File cache object structure */
+typedef struct fcache_s fcache_t;
+
+
+
+/* Creates a new (empty) file cache. Returns NULL if it is not possible to
+** allocate it. */
+fcache_t* fcache_new(void);
+
+
+/* Deletes a file cache with all the files cached in it. */
+void  fcache_delete(fcache_t* hnd);
+
+
+/* Fills up a file provider using the cache. */
+void  fcache_getprov(fcache_t* hnd, fprov_t* prv);
+
+
+/* Sets a callback which is called with the file name whenever a file is
+** loaded into the cache (NULL to remove it). */
+void  fcache_setlcb(fcache_t* hnd, void (*lcb)(void* ctx, uint8 const* fnam), void* ctx);
+
+
+/* Drops a file from the cache, so it is loaded again on next use. Returns
+** nonzero (TRUE) if the file was in the cache. */
+auint fcache_drop(fcache_t* hnd, uint8 const* fnam);
+
+
+#endif
@@ -14,19 +14,19 @@
 #include "fault.h"
 
 
-/* Opens source file for reading, and sets up the compile state to point at
-** the start of this file, with the 0th line read in. If the file can not be
-** opened, it outputs a fault accordingly. Returns 0 (FALSE) if the open was
-** succesful, nonzero (TRUE) if for some error it failed. Populates the passed
-** FILE pointer with the file handle, reading is at the end of the first line
-** (so subsequent firead_read() calls may work with it). fp is set NULL if the
-** open fails. */
-auint firead_open(uint8 const* fnam, compst_t* hnd, FILE** fp)
+/* Opens source file for reading through the given file provider, and sets
+** up the compile state to point at the start of this file, with the 0th line
+** read in. If the file can not be opened, it outputs a fault accordingly.
+** Returns 0 (FALSE) if the open was succesful, nonzero (TRUE) if for some
+** error it failed. Populates the passed file pointer with the file handle,
+** reading is at the end of the first line (so subsequent firead_read() calls
+** may work with it). fp is set NULL if the open fails. */
+auint firead_open(uint8 const* fnam, compst_t* hnd, fprov_t const* prv, fprov_file_t** fp)
 {
  uint8  s[80];
  uint8  serrn[80];
 
- *fp = fopen((char const*)(fnam), "r");
+ *fp = fprov_open(prv, fnam, FPROV_M_RDT);
  if (*fp == NULL){ goto fault_fil; }
 
  compst_setfile(hnd, fnam);
@@ -46,17 +46,44 @@ fault_fil:
 
 
 
+/* Reads the next line from the given file into 'dst' (LINE_MAX bytes), from
+** current position, terminating it. If the line does not fit, it is
+** truncated, and 'lng' is set nonzero. Returns nonzero (TRUE) on failure
+** (errno set). Reaching or reading past the end of file produces empty
+** lines. */
+auint firead_getline(fprov_file_t* fp, uint8* dst, auint* lng)
+{
+ uint8  c;
+ auint  i = 0U;
+ auint  r;
+
+ while (1){
+  if (fprov_read(fp, &c, 1U, &r)){ return 1U; }
+  if (r == 0U){ break; }            /* Reached end of file */
+  if (c == (uint8)('\n')){ break; } /* Readched end of line */
+  if (i < LINE_MAX){ dst[i] = c; }
+  i++;
+ }
+
+ *lng = (i >= LINE_MAX);
+ if (i >= LINE_MAX){ dst[LINE_MAX - 1U] = 0U; }
+ else              { dst[i] = 0U; }
+
+ return 0U;
+}
+
+
+
 /* Reads next line into the compile state from the given file, from current
 ** position. May produce fault, returns nonzero (TRUE) if so, 0 (FALSE)
 ** otherwise. Note that reaching or reading past the end of file is not
 ** considered a fault, empty lines are produced from this point. */
-auint firead_read(compst_t* hnd, FILE* fp)
+auint firead_read(compst_t* hnd, fprov_file_t* fp)
 {
  uint8  s[80];
  uint8  serrn[80];
  uint8  t[LINE_MAX];
- uint8  c;
- auint  i = 0U;
+ auint  lng;
 
  /* Start next line in compile state */
 
@@ -65,24 +92,13 @@ auint firead_read(compst_t* hnd, FILE* fp)
 
  /* Read one line from the file */
 
- while (1){
-  if (fread(&c, 1U, 1U, fp) == 0U){
-   if (feof(fp)){ break; }
-   goto fault_red;
-  }
-  if (c == (uint8)('\n')){ break; } /* Readched end of line */
-  if (i < LINE_MAX){ t[i] = c; }
-  i++;
- }
+ if (firead_getline(fp, &t[0], &lng)){ goto fault_red; }
 
- /* Test for too long line (also terminating string as needed) */
+ /* Test for too long line */
 
- if (i >= LINE_MAX){
+ if (lng){
   snprintf((char*)(&s[0]), 80U, "Source line too long");
   fault_printat(FAULT_NOTE, &s[0], hnd);
-  t[LINE_MAX - 1U] = 0U;
- }else{
-  t[i] = 0U;
  }
 
  /* Submit new line and return */
@@ -102,19 +118,19 @@ fault_red:
 
 
 /* Checks end of file. Returns nonzero (TRUE) if so. Just a wrapper for an
-** feof() call, but taking care for not skipping the last line. */
-auint firead_iseof(compst_t* hnd, FILE* fp)
+** fprov_iseof() call, but taking care for not skipping the last line. */
+auint firead_iseof(compst_t* hnd, fprov_file_t* fp)
 {
  uint8 const* src = compst_getsstr(hnd);
  if (src[0] != 0U){ return 0U; } /* Don't skip the last line! */
- if (feof(fp)){ return 1U; }
+ if (fprov_iseof(fp)){ return 1U; }
  return 0U;
 }
 
 
 
-/* Closes a file. Just a wrapper for an fclose() call. */
-void  firead_close(FILE* fp)
+/* Closes a file. Just a wrapper for an fprov_close() call. */
+void  firead_close(fprov_file_t* fp)
 {
- fclose(fp);
+ fprov_close(fp);              /* It was read only, don't care for errors */
 }
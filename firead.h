@@ -16,32 +16,41 @@
 
 #include "types.h"
 #include "compst.h"
+#include "fprov.h"
 
 
-/* Opens source file for reading, and sets up the compile state to point at
-** the start of this file, with the 0th line read in. If the file can not be
-** opened, it outputs a fault accordingly. Returns 0 (FALSE) if the open was
-** succesful, nonzero (TRUE) if for some error it failed. Populates the passed
-** FILE pointer with the file handle, reading is at the end of the first line
-** (so subsequent firead_read() calls may work with it). fp is set NULL if the
-** open fails. */
-auint firead_open(uint8 const* fnam, compst_t* hnd, FILE** fp);
+/* Opens source file for reading through the given file provider, and sets
+** up the compile state to point at the start of this file, with the 0th line
+** read in. If the file can not be opened, it outputs a fault accordingly.
+** Returns 0 (FALSE) if the open was succesful, nonzero (TRUE) if for some
+** error it failed. Populates the passed file pointer with the file handle,
+** reading is at the end of the first line (so subsequent firead_read() calls
+** may work with it). fp is set NULL if the open fails. */
+auint firead_open(uint8 const* fnam, compst_t* hnd, fprov_t const* prv, fprov_file_t** fp);
+
+
+/* Reads the next line from the given file into 'dst' (LINE_MAX bytes), from
+** current position, terminating it. If the line does not fit, it is
+** truncated, and 'lng' is set nonzero. Returns nonzero (TRUE) on failure
+** (errno set). Reaching or reading past the end of file produces empty
+** lines. */
+auint firead_getline(fprov_file_t* fp, uint8* dst, auint* lng);
 
 
 /* Reads next line into the compile state from the given file, from current
 ** position. May produce fault, returns nonzero (TRUE) if so, 0 (FALSE)
 ** otherwise. Note that reaching or reading past the end of file is not
 ** considered a fault, empty lines are produced from this point. */
-auint firead_read(compst_t* hnd, FILE* fp);
+auint firead_read(compst_t* hnd, fprov_file_t* fp);
 
 
 /* Checks end of file. Returns nonzero (TRUE) if so. Just a wrapper for an
-** feof() call, but taking care for not skipping the last line. */
-auint firead_iseof(compst_t* hnd, FILE* fp);
+** fprov_iseof() call, but taking care for not skipping the last line. */
+auint firead_iseof(compst_t* hnd, fprov_file_t* fp);
 
 
-/* Closes a file. Just a wrapper for an fclose() call. */
-void  firead_close(FILE* fp);
+/* Closes a file. Just a wrapper for an fprov_close() call. */
+void  firead_close(fprov_file_t* fp);
 
 
 #endif
@@ -0,0 +1,363 @@
+/**
+**  \file
+**  \brief     File provider
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Every file the assembler reads or writes (sources, binary includes, the
+**  application binary and the dependency file) goes through a file provider.
+**  A provider is a set of callbacks for opening, reading, writing and closing
+**  files. The default provider maps these to the filesystem, while the memory
+**  provider serves files from memory (optionally falling back to an other
+**  provider for names it does not have), and captures outputs into caller
+**  supplied buffers.
+**
+**  Providers report failures through errno, so the usual fault messages can
+**  be produced for them.
+*/
+
+
+#include "fprov.h"
+
+
+/* File opened through a provider - definition */
+struct fprov_file_s{
+ fprov_t const* prv;    /* Provider */
+ void*  fh;             /* Provider's file handle */
+ auint  mod;            /* Open mode */
+ auint  pve;            /* Provider reached the end of the file */
+ auint  eof;            /* A read reached the end of the file */
+ auint  pos;            /* Read position in buffer */
+ auint  len;            /* Count of bytes in buffer */
+ uint8  buf[FPROV_BUF]; /* Read or write buffer */
+};
+
+
+/* Memory provider file handle */
+typedef struct{
+ fprov_mfile_t* fil;    /* In-memory file (NULL: fallback provider's file) */
+ auint  pos;            /* Position within the in-memory file */
+ void*  fh;             /* Fallback provider's file handle */
+}fprov_mhnd_t;
+
+
+
+/* Filesystem provider: open */
+static void* fprov_fs_opn(void* ctx, uint8 const* fnam, auint mod)
+{
+ static char const* const mst[4] = {"r", "rb", "w", "wb"};
+ return (void*)(fopen((char const*)(fnam), mst[mod & 3U]));
+}
+
+
+
+/* Filesystem provider: read */
+static auint fprov_fs_red(void* ctx, void* fh, uint8* dst, auint len, auint* rct)
+{
+ *rct = (auint)(fread(dst, 1U, len, (FILE*)(fh)));
+ if ((*rct) != len){
+  if (ferror((FILE*)(fh))){ return 1U; }
+ }
+ return 0U;
+}
+
+
+
+/* Filesystem provider: write */
+static auint fprov_fs_wrt(void* ctx, void* fh, uint8 const* src, auint len)
+{
+ if (fwrite(src, 1U, len, (FILE*)(fh)) != len){ return 1U; }
+ return 0U;
+}
+
+
+
+/* Filesystem provider: close */
+static auint fprov_fs_cls(void* ctx, void* fh)
+{
+ if (fclose((FILE*)(fh)) != 0){ return 1U; }
+ return 0U;
+}
+
+
+
+/* The default (filesystem) provider */
+static fprov_t const fprov_def = {
+ &fprov_fs_opn,
+ &fprov_fs_red,
+ &fprov_fs_wrt,
+ &fprov_fs_cls,
+ NULL};
+
+
+
+/* Memory provider: open */
+static void* fprov_mem_opn(void* ctx, uint8 const* fnam, auint mod)
+{
+ fprov_mem_t*  mem = (fprov_mem_t*)(ctx);
+ fprov_mhnd_t* mh;
+ auint         i;
+
+ mh = (fprov_mhnd_t*)(malloc(sizeof(fprov_mhnd_t)));
+ if (mh == NULL){ errno = ENOMEM; return NULL; }
+ mh->pos = 0U;
+ mh->fh  = NULL;
+
+ for (i = 0U; i < (mem->cnt); i++){
+  if (strcmp((char const*)(fnam), (char const*)(mem->fil[i].nam)) == 0){
+   mh->fil = &(mem->fil[i]);
+   if ((mod & 2U) != 0U){ mh->fil->wct = 0U; } /* Write from the beginning */
+   return (void*)(mh);
+  }
+ }
+
+ mh->fil = NULL;
+ if (mem->fbk != NULL){
+  mh->fh = mem->fbk->opn(mem->fbk->ctx, fnam, mod);
+ }else{
+  errno = ENOENT;
+ }
+ if (mh->fh == NULL){ free(mh); return NULL; }
+ return (void*)(mh);
+}
+
+
+
+/* Memory provider: read */
+static auint fprov_mem_red(void* ctx, void* fh, uint8* dst, auint len, auint* rct)
+{
+ fprov_mem_t*  mem = (fprov_mem_t*)(ctx);
+ fprov_mhnd_t* mh  = (fprov_mhnd_t*)(fh);
+
+ if (mh->fil == NULL){
+  return mem->fbk->red(mem->fbk->ctx, mh->fh, dst, len, rct);
+ }
+
+ if (len > ((mh->fil->len) - (mh->pos))){ len = (mh->fil->len) - (mh->pos); }
+ memcpy(dst, &(mh->fil->dat[mh->pos]), len);
+ mh->pos += len;
+ *rct = len;
+ return 0U;
+}
+
+
+
+/* Memory provider: write */
+static auint fprov_mem_wrt(void* ctx, void* fh, uint8 const* src, auint len)
+{
+ fprov_mem_t*  mem = (fprov_mem_t*)(ctx);
+ fprov_mhnd_t* mh  = (fprov_mhnd_t*)(fh);
+
+ if (mh->fil == NULL){
+  return mem->fbk->wrt(mem->fbk->ctx, mh->fh, src, len);
+ }
+
+ if (len > ((mh->fil->len) - (mh->fil->wct))){ errno = ENOSPC; return 1U; }
+ memcpy(&(mh->fil->dat[mh->fil->wct]), src, len);
+ mh->fil->wct += len;
+ return 0U;
+}
+
+
+
+/* Memory provider: close */
+static auint fprov_mem_cls(void* ctx, void* fh)
+{
+ fprov_mem_t*  mem = (fprov_mem_t*)(ctx);
+ fprov_mhnd_t* mh  = (fprov_mhnd_t*)(fh);
+ auint         r   = 0U;
+
+ if (mh->fil == NULL){
+  r = mem->fbk->cls(mem->fbk->ctx, mh->fh);
+ }
+ free(mh);
+ return r;
+}
+
+
+
+/* Gets the default provider which maps to the filesystem. */
+fprov_t const* fprov_getdef(void)
+{
+ return &fprov_def;
+}
+
+
+
+/* Sets up a memory provider using the passed context. The context (and the
+** in-memory files it refers) must exist while the provider is in use. Writes
+** into in-memory files start from the beginning, and fail if they would
+** exceed its capacity. */
+void  fprov_initmem(fprov_t* prv, fprov_mem_t* mem)
+{
+ prv->opn = &fprov_mem_opn;
+ prv->red = &fprov_mem_red;
+ prv->wrt = &fprov_mem_wrt;
+ prv->cls = &fprov_mem_cls;
+ prv->ctx = (void*)(mem);
+}
+
+
+
+/* Opens a file through a provider in the given mode. Returns NULL on failure
+** (errno set). */
+fprov_file_t* fprov_open(fprov_t const* prv, uint8 const* fnam, auint mod)
+{
+ fprov_file_t* fp = (fprov_file_t*)(malloc(sizeof(fprov_file_t)));
+
+ if (fp == NULL){ errno = ENOMEM; return NULL; }
+ fp->fh = prv->opn(prv->ctx, fnam, mod);
+ if (fp->fh == NULL){ free(fp); return NULL; }
+ fp->prv = prv;
+ fp->mod = mod;
+ fp->pve = 0U;
+ fp->eof = 0U;
+ fp->pos = 0U;
+ fp->len = 0U;
+
+ return fp;
+}
+
+
+
+/* Reads at most 'len' bytes from a file. The count of bytes read is returned
+** in 'rct', less than 'len' if the end of the file was reached. Returns
+** nonzero (TRUE) on failure (errno set). */
+auint fprov_read(fprov_file_t* fp, uint8* dst, auint len, auint* rct)
+{
+ auint i = 0U;
+ auint t;
+
+ while (i < len){
+  if ((fp->pos) == (fp->len)){ /* Buffer empty: refill it */
+   if (fp->pve){ fp->eof = 1U; break; }
+   fp->pos = 0U;
+   fp->len = 0U;
+   if (fp->prv->red(fp->prv->ctx, fp->fh, &(fp->buf[0]), FPROV_BUF, &t)){
+    *rct = i;
+    return 1U;
+   }
+   fp->len = t;
+   if (t != FPROV_BUF){ fp->pve = 1U; } /* Provider reached the end */
+   continue;
+  }
+  t = len - i;
+  if (t > ((fp->len) - (fp->pos))){ t = (fp->len) - (fp->pos); }
+  memcpy(&(dst[i]), &(fp->buf[fp->pos]), t);
+  fp->pos += t;
+  i       += t;
+ }
+
+ *rct = i;
+ return 0U;
+}
+
+
+
+/* Writes 'len' bytes into a file. Returns nonzero (TRUE) on failure (errno
+** set). */
+auint fprov_write(fprov_file_t* fp, uint8 const* src, auint len)
+{
+ if (((fp->len) + len) > FPROV_BUF){ /* Flush buffer first */
+  if ((fp->len) != 0U){
+   if (fp->prv->wrt(fp->prv->ctx, fp->fh, &(fp->buf[0]), fp->len)){ return 1U; }
+   fp->len = 0U;
+  }
+  if (len > FPROV_BUF){       /* Large block: pass it directly */
+   return fp->prv->wrt(fp->prv->ctx, fp->fh, src, len);
+  }
+ }
+ memcpy(&(fp->buf[fp->len]), src, len);
+ fp->len += len;
+ return 0U;
+}
+
+
+
+/* Writes a 32 bit value into a file (big endian). Returns nonzero (TRUE) on
+** failure (errno set). */
+auint fprov_wru32(fprov_file_t* fp, auint val)
+{
+ uint8 b[4];
+
+ b[0] = (val >> 24) & 0xFFU;
+ b[1] = (val >> 16) & 0xFFU;
+ b[2] = (val >>  8) & 0xFFU;
+ b[3] =  val        & 0xFFU;
+ return fprov_write(fp, &b[0], 4U);
+}
+
+
+
+/* Reads a 32 bit value (big endian) from a file. Returns nonzero (TRUE) on
+** failure, including reaching the end of the file (errno set). */
+auint fprov_rdu32(fprov_file_t* fp, auint* val)
+{
+ uint8 b[4];
+ auint r;
+
+ if (fprov_read(fp, &b[0], 4U, &r)){ return 1U; }
+ if (r != 4U){ errno = EIO; return 1U; }
+ *val = ((auint)(b[0]) << 24) |
+        ((auint)(b[1]) << 16) |
+        ((auint)(b[2]) <<  8) |
+         (auint)(b[3]);
+ return 0U;
+}
+
+
+
+/* Writes a string into a file with its terminator. Returns nonzero (TRUE) on
+** failure (errno set). */
+auint fprov_wrstr(fprov_file_t* fp, uint8 const* str)
+{
+ return fprov_write(fp, str, strlen((char const*)(str)) + 1U);
+}
+
+
+
+/* Reads a string written by fprov_wrstr() into 'dst' of 'len' size. Returns
+** nonzero (TRUE) on failure, including a string longer than the destination
+** (errno set). */
+auint fprov_rdstr(fprov_file_t* fp, uint8* dst, auint len)
+{
+ auint i;
+ auint r;
+
+ for (i = 0U; i < len; i++){
+  if (fprov_read(fp, &(dst[i]), 1U, &r)){ return 1U; }
+  if (r != 1U){ errno = EIO; return 1U; }
+  if (dst[i] == 0U){ return 0U; }
+ }
+ errno = EIO;
+ return 1U;
+}
+
+
+
+/* Checks end of file. Returns nonzero (TRUE) if a read already reached the
+** end of the file (like feof()). */
+auint fprov_iseof(fprov_file_t* fp)
+{
+ return fp->eof;
+}
+
+
+
+/* Closes a file, flushing any pending write. Returns nonzero (TRUE) on
+** failure (errno set). The file is closed even if it fails. */
+auint fprov_close(fprov_file_t* fp)
+{
+ auint r = 0U;
+
+ if ( (((fp->mod) & 2U) != 0U) && ((fp->len) != 0U) ){
+  r = fp->prv->wrt(fp->prv->ctx, fp->fh, &(fp->buf[0]), fp->len);
+ }
+ if (fp->prv->cls(fp->prv->ctx, fp->fh)){ r = 1U; }
+ free(fp);
+ return r;
+}
@@ -0,0 +1,144 @@
+/**
+**  \file
+**  \brief     File provider
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Every file the assembler reads or writes (sources, binary includes, the
+**  application binary and the dependency file) goes through a file provider.
+**  A provider is a set of callbacks for opening, reading, writing and closing
+**  files. The default provider maps these to the filesystem, while the memory
+**  provider serves files from memory (optionally falling back to an other
+**  provider for names it does not have), and captures outputs into caller
+**  supplied buffers.
+**
+**  Providers report failures through errno, so the usual fault messages can
+**  be produced for them.
+*/
+
+
+#ifndef FPROV_H
+#define FPROV_H
+
+
+#include "types.h"
+
+
+/* File provider structure. The callbacks get the context pointer (ctx) as
+** their first parameter. */
+typedef struct{
+ /* Opens a file in the given mode (FPROV_M_*). Returns the provider's handle
+ ** for the file, or NULL on failure (errno set). */
+ void* (*opn)(void* ctx, uint8 const* fnam, auint mod);
+ /* Reads at most 'len' bytes. The count of bytes read is returned in 'rct',
+ ** less than 'len' if the end of the file was reached. Returns nonzero
+ ** (TRUE) on failure (errno set). */
+ auint (*red)(void* ctx, void* fh, uint8* dst, auint len, auint* rct);
+ /* Writes 'len' bytes. Returns nonzero (TRUE) on failure (errno set). */
+ auint (*wrt)(void* ctx, void* fh, uint8 const* src, auint len);
+ /* Closes the file. Returns nonzero (TRUE) on failure (errno set). */
+ auint (*cls)(void* ctx, void* fh);
+ /* Context of the provider */
+ void* ctx;
+}fprov_t;
+
+
+/* File opened through a provider */
+typedef struct fprov_file_s fprov_file_t;
+
+
+/* In-memory file for the memory provider */
+typedef struct{
+ uint8 const* nam;      /* File name */
+ uint8*       dat;      /* Data (read from for inputs, written for outputs) */
+ auint        len;      /* Size of data (capacity for outputs) */
+ auint        wct;      /* Count of bytes written (outputs only) */
+}fprov_mfile_t;
+
+
+/* Memory provider context */
+typedef struct{
+ fprov_mfile_t*  fil;   /* In-memory files */
+ auint           cnt;   /* Count of in-memory files */
+ fprov_t const*  fbk;   /* Fallback provider for other names (may be NULL) */
+}fprov_mem_t;
+
+
+/* File open modes */
+/* Read text (sources) */
+#define FPROV_M_RDT  0U
+/* Read binary */
+#define FPROV_M_RDB  1U
+/* Write text */
+#define FPROV_M_WRT  2U
+/* Write binary */
+#define FPROV_M_WRB  3U
+
+/* Size of the buffer within an opened file in bytes */
+#define FPROV_BUF    4096U
+
+
+
+/* Gets the default provider which maps to the filesystem. */
+fprov_t const* fprov_getdef(void);
+
+
+/* Sets up a memory provider using the passed context. The context (and the
+** in-memory files it refers) must exist while the provider is in use. Writes
+** into in-memory files start from the beginning, and fail if they would
+** exceed its capacity. */
+void  fprov_initmem(fprov_t* prv, fprov_mem_t* mem);
+
+
+/* Opens a file through a provider in the given mode. Returns NULL on failure
+** (errno set). */
+fprov_file_t* fprov_open(fprov_t const* prv, uint8 const* fnam, auint mod);
+
+
+/* Reads at most 'len' bytes from a file. The count of bytes read is returned
+** in 'rct', less than 'len' if the end of the file was reached. Returns
+** nonzero (TRUE) on failure (errno set). */
+auint fprov_read(fprov_file_t* fp, uint8* dst, auint len, auint* rct);
+
+
+/* Writes 'len' bytes into a file. Returns nonzero (TRUE) on failure (errno
+** set). */
+auint fprov_write(fprov_file_t* fp, uint8 const* src, auint len);
+
+
+/* Writes a 32 bit value into a file (big endian). Returns nonzero (TRUE) on
+** failure (errno set). */
+auint fprov_wru32(fprov_file_t* fp, auint val);
+
+
+/* Reads a 32 bit value (big endian) from a file. Returns nonzero (TRUE) on
+** failure, including reaching the end of the file (errno set). */
+auint fprov_rdu32(fprov_file_t* fp, auint* val);
+
+
+/* Writes a string into a file with its terminator. Returns nonzero (TRUE) on
+** failure (errno set). */
+auint fprov_wrstr(fprov_file_t* fp, uint8 const* str);
+
+
+/* Reads a string written by fprov_wrstr() into 'dst' of 'len' size. Returns
+** nonzero (TRUE) on failure, including a string longer than the destination
+** (errno set). */
+auint fprov_rdstr(fprov_file_t* fp, uint8* dst, auint len);
+
+
+/* Checks end of file. Returns nonzero (TRUE) if a read already reached the
+** end of the file (like feof()). */
+auint fprov_iseof(fprov_file_t* fp);
+
+
+/* Closes a file, flushing any pending write. Returns nonzero (TRUE) on
+** failure (errno set). The file is closed even if it fails. */
+auint fprov_close(fprov_file_t* fp);
+
+
+#endif
@@ -0,0 +1,880 @@
+/**
+**  \file
+**  \brief     Parallel first pass over includes (fragments)
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Every include of the primary source is a job assembled in up to two
+**  waves. The first wave assembles it knowing nothing. The second is only
+**  done if it used constants defined by the first wave of earlier jobs: then
+**  it is assembled again with those defined (so it waits for those jobs).
+**  The tasks are taken in order, first every first wave, then the second
+**  waves.
+**
+**  See frag.h for the conditions of merging.
+*/
+
+
+#include "frag.h"
+#include "compst.h"
+#include "section.h"
+#include "bindata.h"
+#include "macro.h"
+#include "cond.h"
+#include "reach.h"
+#include "firead.h"
+#include "fault.h"
+#include "strpr.h"
+#include "objfile.h"
+#include "pass1.h"
+#include <pthread.h>
+#include <unistd.h>
+
+
+/* Task states */
+#define FRAG_ST_PEND 0U
+#define FRAG_ST_RUN  1U
+#define FRAG_ST_DONE 2U
+#define FRAG_ST_SKIP 3U
+
+
+/* Growable buffer */
+typedef struct{
+ uint8* d;              /* Data */
+ auint  l;              /* Length of data */
+ auint  c;              /* Capacity */
+}frag_buf_t;
+
+/* Symbol of a fragment */
+typedef struct{
+ auint  nam;            /* Offset of the name in the names buffer */
+ auint  res;            /* Exports: resolvable. Imports: seeded */
+ auint  val;            /* Value if resolvable or seeded */
+}frag_sym_t;
+
+/* Run of words occupied by a fragment */
+typedef struct{
+ auint  s;              /* Section */
+ auint  off;            /* Start offset */
+ auint  len;            /* Length in words */
+}frag_run_t;
+
+/* Result of assembling a fragment */
+typedef struct{
+ auint        val;      /* Nonzero if valid (may be merged) */
+ FILE*        flt;      /* Faults output while assembling it */
+ frag_buf_t   obj;      /* The object */
+ frag_buf_t   nam;      /* Names of the symbols, each terminated */
+ frag_buf_t   exp;      /* Symbols defined (frag_sym_t) */
+ frag_buf_t   imp;      /* Symbols used but not defined (frag_sym_t) */
+ frag_buf_t   inc;      /* Nested includes, each terminated */
+ frag_buf_t   run;      /* Runs occupied (frag_run_t) */
+ auint        lcl;      /* Uses a local symbol without a global one */
+ auint        sel;      /* Selected a section */
+ auint        org;      /* Mask of sections whose pointer was set */
+ section_ps_t ps;       /* Section pointers at the end */
+ uint8        gsy[SYMB_MAX]; /* Last global symbol at the end */
+}frag_res_t;
+
+/* Job: an include of the primary source */
+typedef struct{
+ uint8        nam[FILE_MAX]; /* Name of the include */
+ auint        st[2];    /* States of the waves */
+ frag_res_t   res[2];   /* Results of the waves */
+}frag_job_t;
+
+/* Fragment assembler object structure - definition */
+struct frag_s{
+ frag_job_t      job[FRAG_MAX]; /* Jobs */
+ auint           cnt;   /* Count of jobs */
+ auint           nxt;   /* Next task to take (2nd waves follow the 1st) */
+ auint           stp;   /* Nonzero if stopping */
+ auint           thc;   /* Count of workers started */
+ pthread_t       thr[FRAG_THR];
+ pthread_mutex_t mtx;   /* Lock of the states */
+ pthread_cond_t  cnd;   /* Signals state changes */
+ fprov_t         prv;   /* File provider */
+ relax_t*        rlx;   /* Relaxation (NULL: none) */
+};
+
+/* Objects of a worker for assembling */
+typedef struct{
+ compst_t*  cst;
+ section_t* sec;
+ symtab_t*  stb;
+ bindata_t* bdt;
+ macro_t*   mac;
+ cond_t*    cnd;
+ reach_t*   rch;
+ incstk_t*  ist;
+ deplst_t*  dls;
+}frag_wrk_t;
+
+/* Context for collecting the imports */
+typedef struct{
+ frag_res_t*       res;
+ frag_buf_t const* sdn; /* Names of the seeds */
+ frag_buf_t const* sdv; /* Seeds (frag_sym_t) */
+ auint             err; /* Set if out of memory */
+}frag_imc_t;
+
+
+
+/* Appends data to a buffer. Returns nonzero (TRUE) on failure (errno set). */
+static auint frag_i_put(frag_buf_t* buf, void const* src, auint len)
+{
+ uint8* t;
+ auint  c;
+
+ if (((buf->c) - (buf->l)) < len){
+  c = ((buf->c) == 0U) ? 256U : (buf->c);
+  while ((c - (buf->l)) < len){ c <<= 1; }
+  t = (uint8*)(realloc(buf->d, c));
+  if (t == NULL){ errno = ENOMEM; return 1U; }
+  buf->d = t;
+  buf->c = c;
+ }
+ memcpy(&(buf->d[buf->l]), src, len);
+ buf->l += len;
+ return 0U;
+}
+
+
+
+/* Appends a terminated name to a buffer, returning its offset in 'off'.
+** Returns nonzero (TRUE) on failure (errno set). */
+static auint frag_i_putnam(frag_buf_t* buf, uint8 const* nam, auint* off)
+{
+ *off = buf->l;
+ return frag_i_put(buf, nam, strlen((char const*)(nam)) + 1U);
+}
+
+
+
+/* Frees a buffer. */
+static void  frag_i_free(frag_buf_t* buf)
+{
+ free(buf->d);
+ memset(buf, 0U, sizeof(frag_buf_t));
+}
+
+
+
+/* Drops a result. */
+static void  frag_i_drop(frag_res_t* res)
+{
+ if (res->flt != NULL){ fclose(res->flt); }
+ frag_i_free(&(res->obj));
+ frag_i_free(&(res->nam));
+ frag_i_free(&(res->exp));
+ frag_i_free(&(res->imp));
+ frag_i_free(&(res->inc));
+ frag_i_free(&(res->run));
+ memset(res, 0U, sizeof(frag_res_t));
+}
+
+
+
+/* Buffer provider for writing the object: open. */
+static void* frag_i_bopn(void* ctx, uint8 const* fnam, auint mod)
+{
+ ((frag_buf_t*)(ctx))->l = 0U;
+ return ctx;
+}
+
+/* Buffer provider for writing the object: read (not supported). */
+static auint frag_i_bred(void* ctx, void* fh, uint8* dst, auint len, auint* rct)
+{
+ errno = EIO;
+ return 1U;
+}
+
+/* Buffer provider for writing the object: write. */
+static auint frag_i_bwrt(void* ctx, void* fh, uint8 const* src, auint len)
+{
+ return frag_i_put((frag_buf_t*)(fh), src, len);
+}
+
+/* Buffer provider for writing the object: close. */
+static auint frag_i_bcls(void* ctx, void* fh)
+{
+ return 0U;
+}
+
+
+
+/* Collects an import of the fragment (callback of symtab_undefs()). */
+static void  frag_i_import(void* ctx, uint8 const* nam)
+{
+ frag_imc_t*       imc = (frag_imc_t*)(ctx);
+ frag_sym_t const* sdv = (frag_sym_t const*)(imc->sdv->d);
+ frag_sym_t        sym;
+ auint             i;
+
+ if (nam[0] == '@'){ return; }     /* Section bases, relocated */
+ if (nam[0] == '.'){ imc->res->lcl = 1U; }
+
+ sym.res = 0U;
+ sym.val = 0U;
+ for (i = 0U; i < ((imc->sdv->l) / sizeof(frag_sym_t)); i++){
+  if (strcmp((char const*)(&(imc->sdn->d[sdv[i].nam])), (char const*)(nam)) == 0){
+   sym.res = 1U;
+   sym.val = sdv[i].val;
+  }
+ }
+
+ if (frag_i_putnam(&(imc->res->nam), nam, &(sym.nam))){ imc->err = 1U; }
+ if (frag_i_put(&(imc->res->imp), &sym, sizeof(frag_sym_t))){ imc->err = 1U; }
+}
+
+
+
+/* Collects the state of a fragment assembled successfully into its result.
+** Returns nonzero (TRUE) on failure (no memory). */
+static auint frag_i_collect(frag_wrk_t* wrk, frag_res_t* res,
+                            frag_buf_t const* sdn, frag_buf_t const* sdv)
+{
+ frag_imc_t    imc;
+ frag_sym_t    sym;
+ frag_run_t    run;
+ fprov_t       prv;
+ fprov_file_t* fp;
+ uint8 const*  nam;
+ auint         pos = 0U;
+ auint         i;
+
+ /* Exports */
+
+ while (1){
+  nam = symtab_getbound(wrk->stb, &pos);
+  if (nam == NULL){ break; }
+  if (nam[0] == '.'){ res->lcl = 1U; }
+  sym.val = 0U;
+  sym.res = symtab_resolvenam(wrk->stb, nam, &(sym.val));
+  if (frag_i_putnam(&(res->nam), nam, &(sym.nam))){ return 1U; }
+  if (frag_i_put(&(res->exp), &sym, sizeof(frag_sym_t))){ return 1U; }
+ }
+
+ /* Imports */
+
+ imc.res = res;
+ imc.sdn = sdn;
+ imc.sdv = sdv;
+ imc.err = 0U;
+ if (symtab_undefs(wrk->stb, &frag_i_import, &imc)){ return 1U; }
+ if (imc.err){ return 1U; }
+
+ /* Nested includes */
+
+ i = 0U;
+ while (1){
+  nam = incstk_getinc(wrk->ist, i);
+  if (nam == NULL){ break; }
+  if (frag_i_putnam(&(res->inc), nam, &pos)){ return 1U; }
+  i++;
+ }
+
+ /* Occupied runs */
+
+ for (run.s = 0U; run.s <= SECT_ZERO; run.s++){
+  run.off = 0U;
+  while (1){
+   run.off = section_nexttrk(wrk->sec, run.s, run.off, &(run.len));
+   if (run.off >= 0x10000U){ break; }
+   if (frag_i_put(&(res->run), &run, sizeof(frag_run_t))){ return 1U; }
+   run.off += run.len;
+  }
+ }
+
+ /* Pointers and global symbol */
+
+ section_getps(wrk->sec, &(res->ps));
+ strpr_copy(&(res->gsy[0]), compst_getgsym(wrk->cst), SYMB_MAX);
+
+ /* The object */
+
+ prv.opn = &frag_i_bopn;
+ prv.red = &frag_i_bred;
+ prv.wrt = &frag_i_bwrt;
+ prv.cls = &frag_i_bcls;
+ prv.ctx = &(res->obj);
+ fp = fprov_open(&prv, (uint8 const*)(""), FPROV_M_WRB);
+ if (fp == NULL){ return 1U; }
+ if (objfile_write(wrk->stb, fp)){ fprov_close(fp); return 1U; }
+ if (fprov_close(fp)){ return 1U; }
+
+ return 0U;
+}
+
+
+
+/* Assembles a fragment into a result, with the given seeds defined. */
+static void  frag_i_asm(frag_t* hnd, frag_wrk_t* wrk, frag_job_t* job,
+                        frag_res_t* res, frag_buf_t const* sdn, frag_buf_t* sdv)
+{
+ frag_sym_t*   sym = (frag_sym_t*)(sdv->d);
+ fprov_file_t* fp = NULL;
+ uint8 const*  src;
+ auint         sel;
+ auint         i;
+ auint         t;
+
+ compst_init(wrk->cst);
+ section_init(wrk->sec);
+ symtab_init(wrk->stb, wrk->sec, wrk->cst);
+ symtab_setrlx(wrk->stb, hnd->rlx);
+ bindata_init(wrk->bdt, wrk->dls, &(hnd->prv));
+ macro_init(wrk->mac);
+ cond_init(wrk->cnd);
+ reach_init(wrk->rch, 0U);
+ incstk_init(wrk->ist);
+ deplst_init(wrk->dls);
+ if (section_settrk(wrk->sec, 1U)){ return; }
+ section_setdtr(wrk->sec, OBJFILE_REL);
+
+ res->flt = tmpfile();
+ if (res->flt == NULL){ return; }
+ fault_setout(res->flt);
+
+ /* Seeds: bound while assembling, left anonymous in the object (the
+ ** fragment's uses refer them by ID) */
+
+ t = 0U;
+ for (i = 0U; i < ((sdv->l) / sizeof(frag_sym_t)); i++){
+  sym[i].res = symtab_addsymdef(wrk->stb, SYMTAB_CMD_MOV, sym[i].val, NULL, 0U, NULL);
+  if (sym[i].res == 0U){ t = 1U; break; }
+  if (symtab_bind(wrk->stb, &(sdn->d[sym[i].nam]), sym[i].res)){ t = 1U; break; }
+ }
+
+ if (t == 0U){
+  t = firead_open(&(job->nam[0]), wrk->cst, &(hnd->prv), &fp);
+  if (t == 0U){
+   src = compst_getsstr(wrk->cst);
+   if (compst_issymequ(NULL, &(src[strpr_nextnw(src, 0U)]), (uint8 const*)("include"))){
+    t = 1U;              /* When included, the first line is not checked for includes */
+   }
+  }
+  if (t == 0U){
+   t = pass1_run(fp, wrk->stb, wrk->bdt, wrk->mac, wrk->cnd, wrk->rch, wrk->ist, wrk->dls, &(hnd->prv), NULL, NULL, NULL);
+  }
+  if (fp != NULL){ firead_close(fp); }
+ }
+ if (bindata_getcnt(wrk->bdt) != 0U){ t = 1U; }
+ if (macro_getcnt(wrk->mac) != 0U){ t = 1U; }
+ if (cond_getcnt(wrk->cnd) != 0U){ t = 1U; }
+ if (section_getdtr(wrk->sec, &sel, &(res->org))){ t = 1U; }
+ res->sel = sel;
+
+ for (i = 0U; i < ((sdv->l) / sizeof(frag_sym_t)); i++){
+  if (sym[i].res != 0U){ symtab_unbind(wrk->stb, sym[i].res); }
+ }
+
+ if (t == 0U){
+  if (frag_i_collect(wrk, res, sdn, sdv) == 0U){ res->val = 1U; }
+ }
+
+ fault_setout(NULL);
+}
+
+
+
+/* Collects the seeds for the second wave of a job: the constants used by
+** its first wave which are defined by earlier jobs (by their latest result,
+** the latest job defining it wins). Called with the lock held. Returns
+** nonzero (TRUE) on failure (no memory). */
+static auint frag_i_seeds(frag_t* hnd, auint k, frag_buf_t* sdn, frag_buf_t* sdv)
+{
+ frag_res_t const* rk = &(hnd->job[k].res[0]);
+ frag_res_t const* rj;
+ frag_sym_t const* imp = (frag_sym_t const*)(rk->imp.d);
+ frag_sym_t const* exp;
+ frag_sym_t        sym;
+ uint8 const*      nam;
+ auint             i;
+ auint             j;
+ auint             e;
+ auint             f;
+
+ for (i = 0U; i < ((rk->imp.l) / sizeof(frag_sym_t)); i++){
+  nam = &(rk->nam.d[imp[i].nam]);
+  f = 0U;
+  for (j = 0U; j < k; j++){
+   rj = NULL;
+   if      (hnd->job[j].st[1] == FRAG_ST_DONE){ rj = &(hnd->job[j].res[1]); }
+   else if (hnd->job[j].st[0] == FRAG_ST_DONE){ rj = &(hnd->job[j].res[0]); }
+   if (rj == NULL){ continue; }
+   exp = (frag_sym_t const*)(rj->exp.d);
+   for (e = 0U; e < ((rj->exp.l) / sizeof(frag_sym_t)); e++){
+    if ( (exp[e].res) &&
+         (strcmp((char const*)(&(rj->nam.d[exp[e].nam])), (char const*)(nam)) == 0) ){
+     f = 1U;
+     sym.val = exp[e].val;
+    }
+   }
+  }
+  if (f){
+   sym.res = 0U;
+   if (frag_i_putnam(sdn, nam, &(sym.nam))){ return 1U; }
+   if (frag_i_put(sdv, &sym, sizeof(frag_sym_t))){ return 1U; }
+  }
+ }
+
+ return 0U;
+}
+
+
+
+/* Checks whether any earlier job (or the first wave of this one) runs.
+** Called with the lock held. */
+static auint frag_i_running(frag_t* hnd, auint k)
+{
+ auint j;
+
+ if (hnd->job[k].st[0] == FRAG_ST_RUN){ return 1U; }
+ for (j = 0U; j < k; j++){
+  if ( (hnd->job[j].st[0] == FRAG_ST_RUN) ||
+       (hnd->job[j].st[1] == FRAG_ST_RUN) ){ return 1U; }
+ }
+ return 0U;
+}
+
+
+
+/* Worker thread: takes the tasks in order until none remains. */
+static void* frag_i_worker(void* ptr)
+{
+ frag_t*    hnd = (frag_t*)(ptr);
+ frag_wrk_t wrk;
+ frag_buf_t sdn;
+ frag_buf_t sdv;
+ auint      t;
+ auint      k;
+ auint      w;
+ auint      st;
+ auint      bad;
+
+ memset(&sdn, 0U, sizeof(frag_buf_t));
+ memset(&sdv, 0U, sizeof(frag_buf_t));
+ wrk.cst = compst_new();
+ wrk.sec = section_new();
+ wrk.stb = symtab_new();
+ wrk.bdt = bindata_new();
+ wrk.mac = macro_new();
+ wrk.cnd = cond_new();
+ wrk.rch = reach_new();
+ wrk.ist = incstk_new();
+ wrk.dls = deplst_new();
+ bad = ( (wrk.cst == NULL) ||
+        (wrk.sec == NULL) ||
+        (wrk.stb == NULL) ||
+        (wrk.bdt == NULL) ||
+        (wrk.mac == NULL) ||
+        (wrk.cnd == NULL) ||
+        (wrk.rch == NULL) ||
+        (wrk.ist == NULL) ||
+        (wrk.dls == NULL) );   /* Then the tasks taken are skipped */
+
+ while (1){
+
+  /* Take the next pending task */
+
+  pthread_mutex_lock(&(hnd->mtx));
+  t = (hnd->cnt) << 1;
+  while ((hnd->stp == 0U) && ((hnd->nxt) < ((hnd->cnt) << 1))){
+   k = hnd->nxt;
+   hnd->nxt ++;
+   if (hnd->job[k % (hnd->cnt)].st[k / (hnd->cnt)] == FRAG_ST_PEND){ t = k; break; }
+  }
+  if (t >= ((hnd->cnt) << 1)){
+   pthread_mutex_unlock(&(hnd->mtx));
+   break;
+  }
+  k = t % (hnd->cnt);
+  w = t / (hnd->cnt);
+  hnd->job[k].st[w] = FRAG_ST_RUN;
+
+  /* Second wave: wait for the earlier jobs, then get the seeds */
+
+  sdn.l = 0U;
+  sdv.l = 0U;
+  st = (bad) ? FRAG_ST_SKIP : FRAG_ST_DONE;
+  if ((w != 0U) && (st == FRAG_ST_DONE)){
+   while (frag_i_running(hnd, k)){ pthread_cond_wait(&(hnd->cnd), &(hnd->mtx)); }
+   if ( (hnd->stp) ||
+        (hnd->job[k].st[0] != FRAG_ST_DONE) ||
+        (frag_i_seeds(hnd, k, &sdn, &sdv)) ||
+        (sdv.l == 0U) ){ st = FRAG_ST_SKIP; }
+  }
+  pthread_mutex_unlock(&(hnd->mtx));
+
+  /* Assemble */
+
+  if (st == FRAG_ST_DONE){
+   frag_i_asm(hnd, &wrk, &(hnd->job[k]), &(hnd->job[k].res[w]), &sdn, &sdv);
+  }
+
+  pthread_mutex_lock(&(hnd->mtx));
+  hnd->job[k].st[w] = st;
+  pthread_cond_broadcast(&(hnd->cnd));
+  pthread_mutex_unlock(&(hnd->mtx));
+
+ }
+
+ frag_i_free(&sdn);
+ frag_i_free(&sdv);
+ compst_delete(wrk.cst);
+ section_delete(wrk.sec);
+ symtab_delete(wrk.stb);
+ bindata_delete(wrk.bdt);
+ macro_delete(wrk.mac);
+ cond_delete(wrk.cnd);
+ reach_delete(wrk.rch);
+ incstk_delete(wrk.ist);
+ deplst_delete(wrk.dls);
+ return NULL;
+}
+
+
+
+/* Collects the includes of the primary source as jobs. */
+static void  frag_i_scan(frag_t* hnd, uint8 const* src)
+{
+ uint8         lin[LINE_MAX];
+ uint8         ste[LINE_MAX];
+ frag_buf_t    buf;
+ fprov_file_t* fp;
+ auint         p = 0U;
+ auint         l;
+ auint         beg;
+ auint         i;
+ auint         r;
+
+ /* Read the whole source */
+
+ memset(&buf, 0U, sizeof(frag_buf_t));
+ fp = fprov_open(&(hnd->prv), src, FPROV_M_RDT);
+ if (fp == NULL){ return; }
+ while (1){
+  if (frag_i_put(&buf, &lin[0], LINE_MAX)){ break; } /* Make room */
+  buf.l -= LINE_MAX;
+  if (fprov_read(fp, &(buf.d[buf.l]), LINE_MAX, &r)){ r = 0U; }
+  buf.l += r;
+  if (r != LINE_MAX){ break; }
+ }
+ fprov_close(fp);
+
+ /* Look for includes line by line */
+
+ while ((p < buf.l) && ((hnd->cnt) < FRAG_MAX)){
+  l = 0U;
+  while ((p < buf.l) && (buf.d[p] != '\n')){
+   if (l < (LINE_MAX - 1U)){ lin[l] = buf.d[p]; l++; }
+   p++;
+  }
+  p++;
+  lin[l] = 0U;
+
+  beg = strpr_nextnw(&lin[0], 0U);
+  if (!compst_issymequ(NULL, &(lin[beg]), (uint8 const*)("include"))){ continue; }
+  beg = strpr_nextnw(&lin[0], beg + 7U);
+  if (strpr_extstr(&ste[0], &(lin[beg]), LINE_MAX) == 0U){ continue; }
+  if (strlen((char const*)(&ste[0])) >= FILE_MAX){ continue; }
+  for (i = 0U; i < (hnd->cnt); i++){
+   if (strcmp((char const*)(&(hnd->job[i].nam[0])), (char const*)(&ste[0])) == 0){ break; }
+  }
+  if (i != (hnd->cnt)){ continue; }  /* Already listed */
+  memset(&(hnd->job[i]), 0U, sizeof(frag_job_t));
+  strpr_copy(&(hnd->job[i].nam[0]), &ste[0], FILE_MAX);
+  hnd->cnt ++;
+ }
+
+ frag_i_free(&buf);
+}
+
+
+
+/* Checks a result against the state of the first pass, filling in the
+** displacements of the sections. Returns nonzero (TRUE) if it may be
+** merged. */
+static auint frag_i_valid(frag_res_t const* res, symtab_t* stb,
+                          incstk_t* ist, auint* dlt)
+{
+ section_t*        sec = symtab_getsectob(stb);
+ compst_t*         cst = symtab_getcompst(stb);
+ frag_sym_t const* sym;
+ frag_run_t const* run;
+ section_ps_t      ps;
+ uint8 const*      nam;
+ auint             i;
+ auint             v;
+
+ section_getps(sec, &ps);
+ for (i = 0U; i < SECT_CNT; i++){
+  dlt[i] = 0U;
+  if (((OBJFILE_REL >> i) & 1U) != 0U){
+   if (ps.b[i] != 0U){ return 0U; }
+   dlt[i] = ps.p[i];
+  }
+ }
+
+ if ((res->lcl) && ((compst_getgsym(cst))[0] != 0U)){ return 0U; }
+
+ for (i = 0U; i < (res->inc.l); i += strlen((char const*)(nam)) + 1U){
+  nam = &(res->inc.d[i]);
+  if (incstk_isinc(ist, nam)){ return 0U; }
+ }
+
+ sym = (frag_sym_t const*)(res->exp.d);
+ for (i = 0U; i < ((res->exp.l) / sizeof(frag_sym_t)); i++){
+  if (symtab_isbound(stb, &(res->nam.d[sym[i].nam]))){ return 0U; }
+ }
+
+ sym = (frag_sym_t const*)(res->imp.d);
+ for (i = 0U; i < ((res->imp.l) / sizeof(frag_sym_t)); i++){
+  if (symtab_resolvenam(stb, &(res->nam.d[sym[i].nam]), &v)){
+   if ((sym[i].res == 0U) || (v != sym[i].val)){ return 0U; }
+  }else{
+   if (sym[i].res != 0U){ return 0U; }
+  }
+ }
+
+ run = (frag_run_t const*)(res->run.d);
+ for (i = 0U; i < ((res->run.l) / sizeof(frag_run_t)); i++){
+  if (!section_isfree(sec, run[i].s, run[i].off + dlt[run[i].s], run[i].len)){ return 0U; }
+ }
+
+ return 1U;
+}
+
+
+
+/* Merges a valid result into the state of the first pass. Returns one of
+** the FRAG_ results. */
+static auint frag_i_apply(frag_res_t const* res, uint8 const* fnam,
+                          symtab_t* stb, incstk_t* ist, deplst_t* dls,
+                          auint const* dlt)
+{
+ uint8         s[80];
+ uint8         fil[FILE_MAX];
+ uint8         gsy[SYMB_MAX + 1U];
+ section_t*    sec = symtab_getsectob(stb);
+ compst_t*     cst = symtab_getcompst(stb);
+ fprov_mfile_t mfl;
+ fprov_mem_t   mct;
+ fprov_t       prv;
+ fprov_file_t* fp;
+ section_ps_t  ps;
+ uint8 const*  nam;
+ auint         lin;
+ auint         chr;
+ auint         i;
+ auint         t;
+
+ fault_replay(res->flt);
+
+ /* The object, displaced to the current pointers */
+
+ strpr_copy(&fil[0], compst_getfile(cst), FILE_MAX);
+ lin = compst_getline(cst);
+ chr = compst_getcoff(cst);
+ section_getps(sec, &ps);
+
+ mfl.nam = fnam;
+ mfl.dat = res->obj.d;
+ mfl.len = res->obj.l;
+ mfl.wct = 0U;
+ mct.fil = &mfl;
+ mct.cnt = 1U;
+ mct.fbk = NULL;
+ fprov_initmem(&prv, &mct);
+ fp = fprov_open(&prv, fnam, FPROV_M_RDB);
+ if (fp == NULL){ goto fault_mem; }
+ t = objfile_readat(stb, fp, fnam, dlt);
+ fprov_close(fp);
+
+ compst_setfile(cst, &fil[0]);
+ compst_setline(cst, lin);
+ compst_setcoff(cst, chr);
+ if (t){ return FRAG_ERR; }
+
+ /* Pointers and global symbol as the fragment left them */
+
+ for (i = 0U; i < SECT_CNT; i++){
+  if (((OBJFILE_REL >> i) & 1U) != 0U){
+   ps.p[i] = dlt[i] + res->ps.p[i];
+   ps.b[i] = res->ps.b[i];
+  }else if (((res->org >> i) & 1U) != 0U){
+   ps.p[i] = res->ps.p[i];
+   ps.b[i] = res->ps.b[i];
+  }
+ }
+ if (res->sel){ ps.s = res->ps.s; }
+ section_setps(sec, &ps);
+
+ if (res->gsy[0] != 0U){
+  t = strpr_copy(&gsy[0], &(res->gsy[0]), SYMB_MAX);
+  gsy[t] = ':';
+  gsy[t + 1U] = 0U;
+  compst_setgsym(cst, &gsy[0]);
+ }
+
+ /* Nested includes */
+
+ for (i = 0U; i < (res->inc.l); i += strlen((char const*)(nam)) + 1U){
+  nam = &(res->inc.d[i]);
+  if (incstk_addinc(ist, nam)){ goto fault_imx; }
+  if (deplst_add(dls, nam, cst)){ return FRAG_ERR; }
+ }
+
+ return FRAG_MRG;
+
+fault_imx:
+
+ snprintf((char*)(&s[0]), 80U, "Too many includes");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return FRAG_ERR;
+
+fault_mem:
+
+ snprintf((char*)(&s[0]), 80U, "Not enough memory for merging \'%s\'", (char const*)(fnam));
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return FRAG_ERR;
+}
+
+
+
+/* Creates a new fragment assembler. Returns NULL if it is not possible to
+** allocate it. */
+frag_t* frag_new(void)
+{
+ return (frag_t*)(calloc(1U, sizeof(frag_t)));
+}
+
+
+
+/* Deletes a fragment assembler, stopping it if necessary. */
+void  frag_delete(frag_t* hnd)
+{
+ if (hnd == NULL){ return; }
+ frag_stop(hnd);
+ free(hnd);
+}
+
+
+
+/* Starts assembling the includes of the primary source 'src' as fragments
+** on 'thc' threads (0: by the number of processors). Files are read through
+** the provider. Relaxable jumps and immediates are encoded by the relaxation
+** 'rlx' (if not NULL), which must not change until frag_stop(). It is not an error if
+** it can not be started (such as if the source can not be read): then there
+** will be no fragments to merge. */
+void  frag_start(frag_t* hnd, uint8 const* src, fprov_t const* prv, auint thc,
+                 relax_t* rlx)
+{
+ auint i;
+
+ frag_stop(hnd);
+ hnd->prv = *prv;
+ hnd->rlx = rlx;
+ frag_i_scan(hnd, src);
+ if ((hnd->cnt) == 0U){ return; }
+
+ if (thc == 0U){
+#ifdef _SC_NPROCESSORS_ONLN
+  thc = (auint)(sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+ }
+ if (thc > ((hnd->cnt) << 1)){ thc = (hnd->cnt) << 1; }
+ if (thc > FRAG_THR){ thc = FRAG_THR; }
+ if (thc == 0U){       thc = 1U; }
+
+ pthread_mutex_init(&(hnd->mtx), NULL);
+ pthread_cond_init(&(hnd->cnd), NULL);
+ for (i = 0U; i < thc; i++){
+  if (pthread_create(&(hnd->thr[i]), NULL, &frag_i_worker, (void*)(hnd)) != 0){ break; }
+ }
+ hnd->thc = i;
+}
+
+
+
+/* Called by the first pass for an include about to be parsed (already added
+** to the include list and the dependencies): merges its fragment if it
+** exists and is valid in the current state, waiting for it if necessary. An
+** include whose fragment is not started yet is not waited for. Returns one
+** of the FRAG_ results. */
+auint frag_merge(frag_t* hnd, uint8 const* fnam, symtab_t* stb,
+                 incstk_t* ist, deplst_t* dls)
+{
+ frag_job_t* job;
+ auint       dlt[SECT_CNT];
+ auint       i;
+ auint       w;
+
+ if ((hnd->thc) == 0U){ return FRAG_PAR; }
+ for (i = 0U; i < (hnd->cnt); i++){
+  if (strcmp((char const*)(&(hnd->job[i].nam[0])), (char const*)(fnam)) == 0){ break; }
+ }
+ if (i == (hnd->cnt)){ return FRAG_PAR; }
+ job = &(hnd->job[i]);
+
+ /* Claim the waves not started, wait for the others. The first waves of
+ ** the first jobs are always waited for, every worker takes one at once. */
+
+ pthread_mutex_lock(&(hnd->mtx));
+ if (i < (hnd->thc)){     /* Taken by a worker as soon as it starts */
+  while (job->st[0] == FRAG_ST_PEND){ pthread_cond_wait(&(hnd->cnd), &(hnd->mtx)); }
+ }
+ for (w = 0U; w < 2U; w++){
+  if (job->st[w] == FRAG_ST_PEND){ job->st[w] = FRAG_ST_SKIP; }
+ }
+ pthread_cond_broadcast(&(hnd->cnd));
+ while ( (job->st[0] == FRAG_ST_RUN) ||
+         (job->st[1] == FRAG_ST_RUN) ){ pthread_cond_wait(&(hnd->cnd), &(hnd->mtx)); }
+ pthread_mutex_unlock(&(hnd->mtx));
+
+ /* Merge the latest valid result */
+
+ for (w = 2U; w != 0U; w--){
+  if ( (job->st[w - 1U] == FRAG_ST_DONE) &&
+       (job->res[w - 1U].val) &&
+       (frag_i_valid(&(job->res[w - 1U]), stb, ist, &dlt[0])) ){
+   return frag_i_apply(&(job->res[w - 1U]), fnam, stb, ist, dls, &dlt[0]);
+  }
+ }
+
+ return FRAG_PAR;
+}
+
+
+
+/* Stops the workers, and drops the fragments. */
+void  frag_stop(frag_t* hnd)
+{
+ auint i;
+
+ if ((hnd->thc) != 0U){
+  pthread_mutex_lock(&(hnd->mtx));
+  hnd->stp = 1U;
+  pthread_cond_broadcast(&(hnd->cnd));
+  pthread_mutex_unlock(&(hnd->mtx));
+  for (i = 0U; i < (hnd->thc); i++){
+   pthread_join(hnd->thr[i], NULL);
+  }
+  pthread_mutex_destroy(&(hnd->mtx));
+  pthread_cond_destroy(&(hnd->cnd));
+ }
+
+ for (i = 0U; i < (hnd->cnt); i++){
+  frag_i_drop(&(hnd->job[i].res[0]));
+  frag_i_drop(&(hnd->job[i].res[1]));
+ }
+ hnd->cnt = 0U;
+ hnd->nxt = 0U;
+ hnd->stp = 0U;
+ hnd->thc = 0U;
+}
@@ -0,0 +1,105 @@
+/**
+**  \file
+**  \brief     Parallel first pass over includes (fragments)
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  The includes of the primary source are assembled ahead on a pool of
+**  threads, each on its own into a fragment: a relocatable object (see
+**  objfile.h) along with the state it depends on. When the first pass
+**  reaches the include, its fragment is merged in, placed at the current
+**  offsets of the sections, if it is valid in the actual state:
+**
+**  - It does not depend on the state of the sections it was entered with:
+**    it selects a section before using one, does not 'org' within the
+**    relocated sections (code, data and zero), and sets its offset before
+**    using any other section.
+**  - The symbols it uses but does not define resolve the same way in the
+**    first pass as they did for the fragment (so it would have produced the
+**    same instruction forms).
+**  - It uses no local symbol without a global one, unless the state has no
+**    global symbol either.
+**  - The words it occupies are free, and it contains no includes already
+**    included.
+**
+**  Otherwise the include is simply parsed. Includes using binary data,
+**  conditionals or defining macros, and includes after a macro definition
+**  are always parsed.
+**
+**  A fragment can not know the symbols defined before it, so those it uses
+**  would not resolve. To avoid parsing most includes for this, fragments
+**  using constants defined by earlier fragments are assembled again knowing
+**  those (such as an include using the symbols of "rrpge.asm").
+**
+**  Notes and warnings of a fragment are output when it is merged.
+*/
+
+
+#ifndef FRAG_H
+#define FRAG_H
+
+
+#include "types.h"
+#include "symtab.h"
+#include "incstk.h"
+#include "deplst.h"
+#include "fprov.h"
+#include "relax.h"
+
+
+/* Fragment assembler object structure */
+typedef struct frag_s frag_t;
+
+
+/* Maximal number of includes assembled ahead. */
+#define FRAG_MAX   64U
+
+/* Maximal number of worker threads. */
+#define FRAG_THR   64U
+
+/* Results of frag_merge(): Merged, the include must not be parsed. */
+#define FRAG_MRG   0U
+/* Results of frag_merge(): Not merged, the include has to be parsed. */
+#define FRAG_PAR   1U
+/* Results of frag_merge(): Failed, fault printed. */
+#define FRAG_ERR   2U
+
+
+
+/* Creates a new fragment assembler. Returns NULL if it is not possible to
+** allocate it. */
+frag_t* frag_new(void);
+
+
+/* Deletes a fragment assembler, stopping it if necessary. */
+void  frag_delete(frag_t* hnd);
+
+
+/* Starts assembling the includes of the primary source 'src' as fragments
+** on 'thc' threads (0: by the number of processors). Files are read through
+** the provider. Relaxable jumps and immediates are encoded by the relaxation
+** 'rlx' (if not NULL), which must not change until frag_stop(). It is not an error if
+** it can not be started (such as if the source can not be read): then there
+** will be no fragments to merge. */
+void  frag_start(frag_t* hnd, uint8 const* src, fprov_t const* prv, auint thc,
+                 relax_t* rlx);
+
+
+/* Called by the first pass for an include about to be parsed (already added
+** to the include list and the dependencies): merges its fragment if it
+** exists and is valid in the current state, waiting for it if necessary. An
+** include whose fragment is not started yet is not waited for. Returns one
+** of the FRAG_ results. */
+auint frag_merge(frag_t* hnd, uint8 const* fnam, symtab_t* stb,
+                 incstk_t* ist, deplst_t* dls);
+
+
+/* Stops the workers, and drops the fragments. */
+void  frag_stop(frag_t* hnd);
+
+
+#endif
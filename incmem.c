@@ -0,0 +1,743 @@
+/**
+**  \file
+**  \brief     Include memoization
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Remembers the effects of the first pass over includes, so when the same
+**  include is met again (such as in a later assembly with the same context)
+**  in the same state, it can be replayed without parsing it.
+**
+**  While an include is parsed, the symbol table operations (definitions,
+**  bindings, usages) are recorded, and the section words it occupied are
+**  tracked. At its end the record is stored keyed by the include's name, its
+**  content hash and the state it was entered with: the section pointers and
+**  the last global label. The symbols it referred but did not define are
+**  also stored with their values at that point, as those may have decided
+**  instruction forms.
+**
+**  Only includes not containing further includes or bindata are memoized,
+**  and not using conditionals, or using or defining macros.
+**  Notes and warnings of the include are only printed when it is parsed.
+*/
+
+
+#include "incmem.h"
+#include "strpr.h"
+#include "fault.h"
+
+
+/* Recorded operations */
+#define INCMEM_OP_ADD  0U
+#define INCMEM_OP_GET  1U
+#define INCMEM_OP_BIND 2U
+#define INCMEM_OP_USE  3U
+
+
+/* Recorded symbol table operation. Definition IDs are recorded as the index
+** of the operation which produced them, names as offsets in the name pool. */
+typedef struct{
+ auint op;              /* Operation */
+ auint cmd;             /* ADD: Command */
+ auint v0;              /* ADD: Source 0 value / ID; BIND, USE: ID */
+ auint v1;              /* ADD: Source 1 value / ID */
+ auint n0;              /* ADD: Source 0 name; GET, BIND: name */
+ auint n1;              /* ADD: Source 1 name */
+ auint sec;             /* USE: Section */
+ auint off;             /* USE: Offset within section */
+ auint use;             /* USE: Data type (as defined in valwr.h) */
+ auint lin;             /* Line of the operation for fault */
+ auint chr;             /* Character of the operation for fault */
+}incmem_op_t;
+
+/* Symbol referred from outside the include with its value */
+typedef struct{
+ auint nam;             /* Name */
+ auint res;             /* Nonzero if it was resolved */
+ auint val;             /* Value if resolved */
+}incmem_chk_t;
+
+/* Run of words occupied by the include */
+typedef struct{
+ auint sec;             /* Section */
+ auint off;             /* Start offset */
+ auint len;             /* Length in words */
+ auint dat;             /* Start of data in the data array */
+}incmem_run_t;
+
+/* Symbol ID to operation index map entry */
+typedef struct{
+ auint id;              /* Symbol definition ID */
+ auint op;              /* Operation index */
+}incmem_map_t;
+
+/* Record of an include */
+typedef struct incmem_ent_s{
+ struct incmem_ent_s* nxt; /* Next record */
+ uint8         nam[FILE_MAX]; /* File name of include */
+ uint64        hsh;     /* Content hash */
+ section_ps_t  eps;     /* Section pointers at entry */
+ section_ps_t  xps;     /* Section pointers at exit */
+ uint8         egs[SYMB_MAX]; /* Last global label at entry */
+ uint8         xgs[SYMB_MAX]; /* Last global label at exit */
+ incmem_op_t*  ops;     /* Operations */
+ auint         oct;     /* Count of operations */
+ auint         osi;     /* Size of operation array */
+ uint8*        str;     /* Name pool */
+ auint         sct;     /* Used size of name pool */
+ auint         ssi;     /* Size of name pool */
+ incmem_chk_t* chk;     /* Symbols referred from outside */
+ auint         cct;     /* Count of symbols referred */
+ auint         csi;     /* Size of referred symbol array */
+ incmem_run_t* run;     /* Occupied runs */
+ auint         rct;     /* Count of runs */
+ auint         rsi;     /* Size of run array */
+ uint16*       dat;     /* Data of the runs */
+ auint         dct;     /* Count of data words */
+ auint         dsi;     /* Size of data array */
+}incmem_ent_t;
+
+
+/* Include memoization object structure - definition */
+struct incmem_s{
+ incmem_ent_t* ent;     /* Records, most recent first */
+ auint         ect;     /* Count of records */
+ incmem_ent_t* rec;     /* Record in progress (NULL: none) */
+ auint         bad;     /* Nonzero if the record in progress is unusable */
+ incmem_map_t* imp;     /* Map of IDs defined in the include (ascending) */
+ auint         ict;     /* Count of defined IDs */
+ auint         isi;     /* Size of defined ID map */
+ incmem_map_t* xmp;     /* Map of IDs referred from outside */
+ auint         xct;     /* Count of referred IDs */
+ auint         xsi;     /* Size of referred ID map */
+};
+
+
+
+/* Grows an array if necessary, so it can hold 'cnt' elements of 'esz' size.
+** Returns the array (possibly moved), or NULL if it is not possible (then the
+** original is intact). */
+static void* incmem_i_grow(void* arr, auint* siz, auint cnt, auint esz)
+{
+ void* t;
+ auint n = *siz;
+
+ if (cnt <= n){ return arr; }
+ if (n == 0U){ n = 64U; }
+ while (n < cnt){ n <<= 1; }
+ t = realloc(arr, n * esz);
+ if (t != NULL){ *siz = n; }
+ return t;
+}
+
+
+
+/* Frees a record. */
+static void  incmem_i_free(incmem_ent_t* ent)
+{
+ if (ent != NULL){
+  free(ent->ops);
+  free(ent->str);
+  free(ent->chk);
+  free(ent->run);
+  free(ent->dat);
+ }
+ free(ent);
+}
+
+
+
+/* Calculates the content hash (FNV-1a, 64 bits) of a file. Returns nonzero
+** (TRUE) if the file can not be read. */
+static auint incmem_i_hash(uint8 const* fnam, fprov_t const* prv, uint64* hsh)
+{
+ fprov_file_t* fp;
+ uint8  b[4096];
+ uint64 h = 0xCBF29CE484222325ULL;
+ auint  r;
+ auint  i;
+
+ fp = fprov_open(prv, fnam, FPROV_M_RDB);
+ if (fp == NULL){ return 1U; }
+ while (1){
+  if (fprov_read(fp, &b[0], sizeof(b), &r)){ fprov_close(fp); return 1U; }
+  for (i = 0U; i < r; i++){
+   h = (h ^ b[i]) * 0x100000001B3ULL;
+  }
+  if (r != sizeof(b)){ break; }
+ }
+ fprov_close(fp);          /* It was read only, don't care for errors here */
+
+ *hsh = h;
+ return 0U;
+}
+
+
+
+/* Adds a name to the name pool of the record in progress (if it is not there
+** yet). Returns nonzero (TRUE) on failure. */
+static auint incmem_i_addnam(incmem_t* hnd, uint8 const* nam, auint* idx)
+{
+ incmem_ent_t* ent = hnd->rec;
+ uint8* t;
+ auint  i = 0U;
+ auint  l = strlen((char const*)(nam)) + 1U;
+
+ while (i < (ent->sct)){
+  if (strcmp((char const*)(nam), (char const*)(&(ent->str[i]))) == 0){
+   *idx = i;
+   return 0U;
+  }
+  i += strlen((char const*)(&(ent->str[i]))) + 1U;
+ }
+
+ t = (uint8*)(incmem_i_grow(ent->str, &(ent->ssi), ent->sct + l, 1U));
+ if (t == NULL){ return 1U; }
+ ent->str = t;
+ memcpy(&(ent->str[ent->sct]), nam, l);
+ *idx = ent->sct;
+ ent->sct += l;
+ return 0U;
+}
+
+
+
+/* Adds an ID to one of the ID maps (defined: 'ext' zero, referred: 'ext'
+** nonzero). Returns nonzero (TRUE) on failure. */
+static auint incmem_i_mapadd(incmem_t* hnd, auint ext, auint id, auint op)
+{
+ incmem_map_t* t;
+
+ if (ext == 0U){
+  t = (incmem_map_t*)(incmem_i_grow(hnd->imp, &(hnd->isi), hnd->ict + 1U, sizeof(incmem_map_t)));
+  if (t == NULL){ return 1U; }
+  hnd->imp = t;
+  t = &(hnd->imp[hnd->ict]);
+  hnd->ict ++;
+ }else{
+  t = (incmem_map_t*)(incmem_i_grow(hnd->xmp, &(hnd->xsi), hnd->xct + 1U, sizeof(incmem_map_t)));
+  if (t == NULL){ return 1U; }
+  hnd->xmp = t;
+  t = &(hnd->xmp[hnd->xct]);
+  hnd->xct ++;
+ }
+ t->id = id;
+ t->op = op;
+ return 0U;
+}
+
+
+
+/* Finds the operation index producing a symbol ID. Returns nonzero (TRUE) if
+** the ID was not produced within the include. */
+static auint incmem_i_mapget(incmem_t* hnd, auint id, auint* op)
+{
+ auint lo = 0U;
+ auint hi = hnd->ict;
+ auint m;
+
+ while (lo < hi){          /* Defined IDs are ascending */
+  m = (lo + hi) >> 1;
+  if      ((hnd->imp[m].id) < id){ lo = m + 1U; }
+  else if ((hnd->imp[m].id) > id){ hi = m; }
+  else{ *op = hnd->imp[m].op; return 0U; }
+ }
+
+ for (m = 0U; m < (hnd->xct); m++){
+  if ((hnd->xmp[m].id) == id){ *op = hnd->xmp[m].op; return 0U; }
+ }
+
+ return 1U;
+}
+
+
+
+/* Adds an operation to the record in progress. Returns NULL on failure. */
+static incmem_op_t* incmem_i_addop(incmem_t* hnd, compst_t* cst, auint op)
+{
+ incmem_ent_t* ent = hnd->rec;
+ incmem_op_t*  t;
+
+ t = (incmem_op_t*)(incmem_i_grow(ent->ops, &(ent->osi), ent->oct + 1U, sizeof(incmem_op_t)));
+ if (t == NULL){ return NULL; }
+ ent->ops = t;
+ t = &(ent->ops[ent->oct]);
+ ent->oct ++;
+ memset(t, 0U, sizeof(incmem_op_t));
+ t->op  = op;
+ t->lin = compst_getline(cst);
+ t->chr = compst_getcoff(cst);
+ return t;
+}
+
+
+
+/* Checks whether a record is valid in the current state: the symbols it
+** referred must have the same values, and the words it occupied must be
+** free. Returns nonzero (TRUE) if it is valid. */
+static auint incmem_i_valid(incmem_ent_t* ent, symtab_t* stb)
+{
+ section_t* sec = symtab_getsectob(stb);
+ auint      i;
+ auint      r;
+ auint      v;
+
+ for (i = 0U; i < (ent->cct); i++){
+  r = symtab_resolvenam(stb, &(ent->str[ent->chk[i].nam]), &v);
+  if ((r != 0U) != (ent->chk[i].res != 0U)){ return 0U; }
+  if ((r != 0U) && (v != (ent->chk[i].val))){ return 0U; }
+ }
+
+ for (i = 0U; i < (ent->rct); i++){
+  if (!section_isfree(sec, ent->run[i].sec, ent->run[i].off, ent->run[i].len)){ return 0U; }
+ }
+
+ return 1U;
+}
+
+
+
+/* Replays a record into the symbol table and sections. Returns nonzero
+** (TRUE) on failure, fault printed. */
+static auint incmem_i_replay(incmem_ent_t* ent, symtab_t* stb)
+{
+ uint8        s[80];
+ uint8        fil[FILE_MAX];
+ uint8        gsm[SYMB_MAX + 1U];
+ compst_t*    cst = symtab_getcompst(stb);
+ section_t*   sec = symtab_getsectob(stb);
+ incmem_op_t* op;
+ auint*       rid;
+ auint        lin;
+ auint        i;
+ auint        j;
+ auint        s0v;
+ auint        s1v;
+
+ rid = (auint*)(malloc((ent->oct + 1U) * sizeof(auint)));
+ if (rid == NULL){ goto fault_mem; }
+
+ strpr_copy(&fil[0], compst_getfile(cst), FILE_MAX);
+ lin = compst_getline(cst);
+ compst_setfile(cst, &(ent->nam[0]));
+
+ /* Symbol table operations, at their original locations for faults */
+
+ for (i = 0U; i < (ent->oct); i++){
+  op = &(ent->ops[i]);
+  compst_setline(cst, op->lin);
+  compst_setcoff(cst, op->chr);
+  rid[i] = 0U;
+  switch (op->op){
+
+   case INCMEM_OP_ADD:
+    s0v = op->v0;
+    s1v = op->v1;
+    if ((op->cmd & SYMTAB_CMD_S0I) != 0U){ s0v = rid[s0v]; }
+    if ((op->cmd & SYMTAB_CMD_S1I) != 0U){ s1v = rid[s1v]; }
+    rid[i] = symtab_addsymdef(stb, op->cmd,
+                              s0v, ((op->cmd & SYMTAB_CMD_S0N) != 0U) ? &(ent->str[op->n0]) : NULL,
+                              s1v, ((op->cmd & SYMTAB_CMD_S1N) != 0U) ? &(ent->str[op->n1]) : NULL);
+    if (rid[i] == 0U){ goto fault_oth; }
+    break;
+
+   case INCMEM_OP_GET:
+    rid[i] = symtab_getsymdef(stb, &(ent->str[op->n0]));
+    if (rid[i] == 0U){ goto fault_oth; }
+    break;
+
+   case INCMEM_OP_BIND:
+    if (symtab_bind(stb, &(ent->str[op->n0]), rid[op->v0])){ goto fault_oth; }
+    break;
+
+   default:
+    section_setsect(sec, op->sec);
+    if (symtab_use(stb, rid[op->v0], op->off, op->use)){ goto fault_oth; }
+    break;
+
+  }
+ }
+
+ /* Section contents */
+
+ for (i = 0U; i < (ent->rct); i++){
+  section_setsect(sec, ent->run[i].sec);
+  section_setoffw(sec, ent->run[i].off);
+  if (ent->run[i].sec == SECT_ZERO){
+   if (section_reserve(sec, ent->run[i].len, &j) != SECT_ERR_OK){ goto fault_sec; }
+  }else{
+   if (section_pushws(sec, &(ent->dat[ent->run[i].dat]), ent->run[i].len) != SECT_ERR_OK){ goto fault_sec; }
+  }
+ }
+ section_setps(sec, &(ent->xps));
+
+ /* Last global label */
+
+ if (strcmp((char const*)(&(ent->xgs[0])), (char const*)(compst_getgsym(cst))) != 0){
+  j = strpr_copy(&gsm[0], &(ent->xgs[0]), SYMB_MAX);
+  gsm[j] = ':';
+  gsm[j + 1U] = 0U;
+  compst_setgsym(cst, &gsm[0]);
+ }
+
+ compst_setfile(cst, &fil[0]);
+ compst_setline(cst, lin);
+ free(rid);
+ return 0U;
+
+fault_sec:
+
+ snprintf((char*)(&s[0]), 80U, "Overlap or out of section encountered");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ compst_setfile(cst, &fil[0]);
+ compst_setline(cst, lin);
+ free(rid);
+ return 1U;
+
+fault_oth:
+
+ compst_setfile(cst, &fil[0]);
+ compst_setline(cst, lin);
+ free(rid);
+ return 1U;
+
+fault_mem:
+
+ snprintf((char*)(&s[0]), 80U, "Not enough memory to replay include");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return 1U;
+}
+
+
+
+/* Creates a new (empty) include memoization object. Returns NULL if it is
+** not possible to allocate it. */
+incmem_t* incmem_new(void)
+{
+ return (incmem_t*)(calloc(1U, sizeof(incmem_t)));
+}
+
+
+
+/* Deletes an include memoization object. */
+void  incmem_delete(incmem_t* hnd)
+{
+ incmem_ent_t* ent;
+
+ if (hnd != NULL){
+  while (hnd->ent != NULL){
+   ent = hnd->ent;
+   hnd->ent = ent->nxt;
+   incmem_i_free(ent);
+  }
+  incmem_i_free(hnd->rec);
+  free(hnd->imp);
+  free(hnd->xmp);
+ }
+ free(hnd);
+}
+
+
+
+/* Called before parsing an include. If a matching record exists, it is
+** replayed into the symbol table (and its sections), otherwise the recording
+** of the include is started. The file is read through the provider for its
+** content hash. Returns one of the INCMEM_ results. */
+auint incmem_begin(incmem_t* hnd, uint8 const* fnam, symtab_t* stb, fprov_t const* prv)
+{
+ compst_t*     cst = symtab_getcompst(stb);
+ section_t*    sec = symtab_getsectob(stb);
+ incmem_ent_t* ent;
+ section_ps_t  ps;
+ uint64        hsh;
+
+ incmem_abort(hnd, stb);
+ if (incmem_i_hash(fnam, prv, &hsh)){ return INCMEM_PAR; } /* Parsing will fault */
+ section_getps(sec, &ps);
+
+ /* Look for a matching record */
+
+ ent = hnd->ent;
+ while (ent != NULL){
+  if ( (ent->hsh == hsh) &&
+       (strcmp((char const*)(fnam), (char const*)(&(ent->nam[0]))) == 0) &&
+       (memcmp(&ps, &(ent->eps), sizeof(ps)) == 0) &&
+       (strcmp((char const*)(compst_getgsym(cst)), (char const*)(&(ent->egs[0]))) == 0) &&
+       (incmem_i_valid(ent, stb)) ){
+   if (incmem_i_replay(ent, stb)){ return INCMEM_ERR; }
+   return INCMEM_REP;
+  }
+  ent = ent->nxt;
+ }
+
+ /* Not found: start recording it */
+
+ ent = (incmem_ent_t*)(calloc(1U, sizeof(incmem_ent_t)));
+ if (ent == NULL){ return INCMEM_PAR; }
+ if (section_settrk(sec, 1U)){ free(ent); return INCMEM_PAR; }
+ strpr_copy(&(ent->nam[0]), fnam, FILE_MAX);
+ strpr_copy(&(ent->egs[0]), compst_getgsym(cst), SYMB_MAX);
+ ent->hsh = hsh;
+ ent->eps = ps;
+
+ hnd->rec = ent;
+ hnd->bad = 0U;
+ hnd->ict = 0U;
+ hnd->xct = 0U;
+ symtab_setrec(stb, hnd);
+
+ return INCMEM_PAR;
+}
+
+
+
+/* Called at the end of the include being recorded, storing the record. */
+void  incmem_end(incmem_t* hnd, symtab_t* stb)
+{
+ compst_t*     cst = symtab_getcompst(stb);
+ section_t*    sec = symtab_getsectob(stb);
+ incmem_ent_t* ent = hnd->rec;
+ incmem_ent_t** pen;
+ void*  t;
+ uint8* bnd = NULL;
+ auint  s;
+ auint  i;
+ auint  o;
+ auint  l;
+
+ if (ent == NULL){ return; }
+ if (hnd->bad){ goto fault_abt; }
+
+ section_getps(sec, &(ent->xps));
+ strpr_copy(&(ent->xgs[0]), compst_getgsym(cst), SYMB_MAX);
+
+ /* A word partially filled at entry is not tracked, so the include must not
+ ** have continued it. It is only possible to get back to a partially filled
+ ** word by continuing it, so it is enough to check the pointers. */
+
+ for (s = 0U; s < SECT_CNT; s++){
+  if ( (ent->eps.b[s] != 0U) &&
+       ( (ent->eps.p[s] != ent->xps.p[s]) ||
+         (ent->eps.b[s] != ent->xps.b[s]) ) ){ goto fault_abt; }
+ }
+
+ /* Collect the words occupied */
+
+ for (s = 0U; s <= SECT_ZERO; s++){
+  o = 0U;
+  while (1){
+   o = section_nexttrk(sec, s, o, &l);
+   if (o >= 0x10000U){ break; }
+   t = incmem_i_grow(ent->run, &(ent->rsi), ent->rct + 1U, sizeof(incmem_run_t));
+   if (t == NULL){ goto fault_abt; }
+   ent->run = (incmem_run_t*)(t);
+   ent->run[ent->rct].sec = s;
+   ent->run[ent->rct].off = o;
+   ent->run[ent->rct].len = l;
+   ent->run[ent->rct].dat = ent->dct;
+   ent->rct ++;
+   if (s != SECT_ZERO){
+    t = incmem_i_grow(ent->dat, &(ent->dsi), ent->dct + l, sizeof(uint16));
+    if (t == NULL){ goto fault_abt; }
+    ent->dat = (uint16*)(t);
+    section_setsect(sec, s);
+    section_read(sec, o, &(ent->dat[ent->dct]), l);
+    ent->dct += l;
+   }
+   o += l;
+  }
+ }
+ section_setps(sec, &(ent->xps));
+
+ /* Collect names referred but not bound by the include, with their values
+ ** (marks: 1: bound, 2: already collected) */
+
+ bnd = (uint8*)(calloc(ent->sct + 1U, 1U));
+ if (bnd == NULL){ goto fault_abt; }
+ for (i = 0U; i < (ent->oct); i++){
+  if (ent->ops[i].op == INCMEM_OP_BIND){ bnd[ent->ops[i].n0] = 1U; }
+ }
+ for (i = 0U; i < (ent->oct); i++){
+  for (s = 0U; s < 2U; s++){
+   o = 0x10000U;
+   if (ent->ops[i].op == INCMEM_OP_GET){
+    if (s == 0U){ o = ent->ops[i].n0; }
+   }else if (ent->ops[i].op == INCMEM_OP_ADD){
+    if ((s == 0U) && ((ent->ops[i].cmd & SYMTAB_CMD_S0N) != 0U)){ o = ent->ops[i].n0; }
+    if ((s == 1U) && ((ent->ops[i].cmd & SYMTAB_CMD_S1N) != 0U)){ o = ent->ops[i].n1; }
+   }
+   if ((o == 0x10000U) || (bnd[o] != 0U)){ continue; }
+   bnd[o] = 2U;
+   t = incmem_i_grow(ent->chk, &(ent->csi), ent->cct + 1U, sizeof(incmem_chk_t));
+   if (t == NULL){ goto fault_abt; }
+   ent->chk = (incmem_chk_t*)(t);
+   ent->chk[ent->cct].nam = o;
+   ent->chk[ent->cct].val = 0U;
+   ent->chk[ent->cct].res = symtab_resolvenam(stb, &(ent->str[o]), &(ent->chk[ent->cct].val));
+   ent->cct ++;
+  }
+ }
+ free(bnd);
+
+ /* Store it replacing earlier records of the include in the same state, and
+ ** those of different content */
+
+ hnd->rec = NULL;
+ symtab_setrec(stb, NULL);
+ section_settrk(sec, 0U);
+
+ pen = &(hnd->ent);
+ while ((*pen) != NULL){
+  if ( (strcmp((char const*)(&((*pen)->nam[0])), (char const*)(&(ent->nam[0]))) == 0) &&
+       ( ((*pen)->hsh != ent->hsh) ||
+         ( (memcmp(&((*pen)->eps), &(ent->eps), sizeof(section_ps_t)) == 0) &&
+           (strcmp((char const*)(&((*pen)->egs[0])), (char const*)(&(ent->egs[0]))) == 0) ) ) ){
+   t = (void*)(*pen);
+   *pen = (*pen)->nxt;
+   incmem_i_free((incmem_ent_t*)(t));
+   hnd->ect --;
+  }else{
+   pen = &((*pen)->nxt);
+  }
+ }
+
+ ent->nxt = hnd->ent;
+ hnd->ent = ent;
+ hnd->ect ++;
+
+ if ((hnd->ect) > INCMEM_MAX){ /* Drop the oldest */
+  pen = &(hnd->ent);
+  while (((*pen)->nxt) != NULL){ pen = &((*pen)->nxt); }
+  incmem_i_free(*pen);
+  *pen = NULL;
+  hnd->ect --;
+ }
+
+ return;
+
+fault_abt:
+
+ free(bnd);
+ incmem_abort(hnd, stb);
+}
+
+
+
+/* Drops the recording in progress if any (the include can not be memoized
+** or the pass failed). */
+void  incmem_abort(incmem_t* hnd, symtab_t* stb)
+{
+ if (hnd->rec != NULL){
+  incmem_i_free(hnd->rec);
+  hnd->rec = NULL;
+  symtab_setrec(stb, NULL);
+  section_settrk(symtab_getsectob(stb), 0U);
+ }
+}
+
+
+
+/* Returns nonzero (TRUE) if an include is being recorded. */
+auint incmem_isrec(incmem_t* hnd)
+{
+ return (hnd->rec != NULL);
+}
+
+
+
+/* Records the adding of a symbol definition (called by the symbol table).
+** Names are used only if the command requests so. */
+void  incmem_radd(incmem_t* hnd, compst_t* cst, auint cmd,
+                  auint s0v, uint8 const* s0n,
+                  auint s1v, uint8 const* s1n, auint id)
+{
+ incmem_op_t* op;
+ auint        i = hnd->rec->oct;
+
+ if (hnd->bad){ return; }
+ op = incmem_i_addop(hnd, cst, INCMEM_OP_ADD);
+ if (op == NULL){ goto fault_bad; }
+ op->cmd = cmd;
+ op->v0  = s0v;
+ op->v1  = s1v;
+ if ((cmd & SYMTAB_CMD_S0N) != 0U){ if (incmem_i_addnam(hnd, s0n, &(op->n0))){ goto fault_bad; } }
+ if ((cmd & SYMTAB_CMD_S1N) != 0U){ if (incmem_i_addnam(hnd, s1n, &(op->n1))){ goto fault_bad; } }
+ if ((cmd & SYMTAB_CMD_S0I) != 0U){ if (incmem_i_mapget(hnd, s0v, &(op->v0))){ goto fault_bad; } }
+ if ((cmd & SYMTAB_CMD_S1I) != 0U){ if (incmem_i_mapget(hnd, s1v, &(op->v1))){ goto fault_bad; } }
+ if (incmem_i_mapadd(hnd, 0U, id, i)){ goto fault_bad; }
+ return;
+
+fault_bad:
+
+ hnd->bad = 1U;
+}
+
+
+
+/* Records getting a symbol definition by name (called by the symbol table).
+** 'isn' is nonzero if a dangling definition was created for it. */
+void  incmem_rget(incmem_t* hnd, compst_t* cst, uint8 const* nam, auint id, auint isn)
+{
+ incmem_op_t* op;
+ auint        i = hnd->rec->oct;
+ auint        t;
+
+ if (hnd->bad){ return; }
+ op = incmem_i_addop(hnd, cst, INCMEM_OP_GET);
+ if (op == NULL){ goto fault_bad; }
+ if (incmem_i_addnam(hnd, nam, &(op->n0))){ goto fault_bad; }
+ if (isn){
+  if (incmem_i_mapadd(hnd, 0U, id, i)){ goto fault_bad; }
+ }else if (incmem_i_mapget(hnd, id, &t)){ /* Defined outside the include */
+  if (incmem_i_mapadd(hnd, 1U, id, i)){ goto fault_bad; }
+ }
+ return;
+
+fault_bad:
+
+ hnd->bad = 1U;
+}
+
+
+
+/* Records a symbol name binding (called by the symbol table). */
+void  incmem_rbind(incmem_t* hnd, compst_t* cst, uint8 const* nam, auint id)
+{
+ incmem_op_t* op;
+
+ if (hnd->bad){ return; }
+ op = incmem_i_addop(hnd, cst, INCMEM_OP_BIND);
+ if (op == NULL){ goto fault_bad; }
+ if (incmem_i_addnam(hnd, nam, &(op->n0))){ goto fault_bad; }
+ if (incmem_i_mapget(hnd, id, &(op->v0))){ goto fault_bad; }
+ return;
+
+fault_bad:
+
+ hnd->bad = 1U;
+}
+
+
+
+/* Records a symbol usage (called by the symbol table). */
+void  incmem_ruse(incmem_t* hnd, compst_t* cst, auint id, auint sec, auint off, auint use)
+{
+ incmem_op_t* op;
+
+ if (hnd->bad){ return; }
+ op = incmem_i_addop(hnd, cst, INCMEM_OP_USE);
+ if (op == NULL){ goto fault_bad; }
+ op->sec = sec;
+ op->off = off;
+ op->use = use;
+ if (incmem_i_mapget(hnd, id, &(op->v0))){ goto fault_bad; }
+ return;
+
+fault_bad:
+
+ hnd->bad = 1U;
+}
@@ -0,0 +1,103 @@
+/**
+**  \file
+**  \brief     Include memoization
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Remembers the effects of the first pass over includes, so when the same
+**  include is met again (such as in a later assembly with the same context)
+**  in the same state, it can be replayed without parsing it.
+**
+**  While an include is parsed, the symbol table operations (definitions,
+**  bindings, usages) are recorded, and the section words it occupied are
+**  tracked. At its end the record is stored keyed by the include's name, its
+**  content hash and the state it was entered with: the section pointers and
+**  the last global label. The symbols it referred but did not define are
+**  also stored with their values at that point, as those may have decided
+**  instruction forms.
+**
+**  Only includes not containing further includes or bindata are memoized,
+**  and not using conditionals, or using or defining macros.
+**  Notes and warnings of the include are only printed when it is parsed.
+*/
+
+
+#ifndef INCMEM_H
+#define INCMEM_H
+
+
+#include "types.h"
+#include "symtab.h"
+#include "fprov.h"
+
+
+/* Include memoization object structure */
+typedef struct incmem_s incmem_t;
+
+
+/* Maximal number of includes remembered. */
+#define INCMEM_MAX  256U
+
+/* Results of incmem_begin(): Replayed, the include must not be parsed. */
+#define INCMEM_REP  0U
+/* Results of incmem_begin(): Not replayed, the include has to be parsed. */
+#define INCMEM_PAR  1U
+/* Results of incmem_begin(): Failed, fault printed. */
+#define INCMEM_ERR  2U
+
+
+
+/* Creates a new (empty) include memoization object. Returns NULL if it is
+** not possible to allocate it. */
+incmem_t* incmem_new(void);
+
+
+/* Deletes an include memoization object. */
+void  incmem_delete(incmem_t* hnd);
+
+
+/* Called before parsing an include. If a matching record exists, it is
+** replayed into the symbol table (and its sections), otherwise the recording
+** of the include is started. The file is read through the provider for its
+** content hash. Returns one of the INCMEM_ results. */
+auint incmem_begin(incmem_t* hnd, uint8 const* fnam, symtab_t* stb, fprov_t const* prv);
+
+
+/* Called at the end of the include being recorded, storing the record. */
+void  incmem_end(incmem_t* hnd, symtab_t* stb);
+
+
+/* Drops the recording in progress if any (the include can not be memoized
+** or the pass failed). */
+void  incmem_abort(incmem_t* hnd, symtab_t* stb);
+
+
+/* Returns nonzero (TRUE) if an include is being recorded. */
+auint incmem_isrec(incmem_t* hnd);
+
+
+/* Records the adding of a symbol definition (called by the symbol table).
+** Names are used only if the command requests so. */
+void  incmem_radd(incmem_t* hnd, compst_t* cst, auint cmd,
+                  auint s0v, uint8 const* s0n,
+                  auint s1v, uint8 const* s1n, auint id);
+
+
+/* Records getting a symbol definition by name (called by the symbol table).
+** 'isn' is nonzero if a dangling definition was created for it. */
+void  incmem_rget(incmem_t* hnd, compst_t* cst, uint8 const* nam, auint id, auint isn);
+
+
+/* Records a symbol name binding (called by the symbol table). */
+void  incmem_rbind(incmem_t* hnd, compst_t* cst, uint8 const* nam, auint id);
+
+
+/* Records a symbol usage (called by the symbol table). */
+void  incmem_ruse(incmem_t* hnd, compst_t* cst, auint id, auint sec, auint off, auint use);
+
+
+#endif
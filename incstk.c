@@ -11,31 +11,41 @@
 
 
 #include "incstk.h"
+#include "strpr.h"
 
 
 /* Include stack object structure - definition */
 struct incstk_s{
  auint pos;               /* Position in stack */
- FILE* fpt[INCSTK_MAX];   /* File pointer stack */
+ fprov_file_t* fpt[INCSTK_MAX]; /* File pointer stack */
  auint lin[INCSTK_MAX];   /* Line pointer stack */
  uint8 fnm[INCSTK_MAX][FILE_MAX]; /* File name stack */
+ auint icn;               /* Count of includes added */
+ uint8 inc[INCSTK_INC][FILE_MAX]; /* Include list for finding matching includes */
 };
 
 
 
-/* Note: there is a problem in C with information hiding if it would be
-** desirable to work it out without dynamic memory allocation. So a static
-** object is supplied here for use, and no need for malloc. One object is
-** enough. So this is not a "new" implementation, just a static object. */
-static incstk_t incstk_obj;
-incstk_t* incstk_getobj(void)
+/* Creates a new include stack object. Returns NULL if it is not possible to
+** allocate it. The object has to be initialized before use. */
+incstk_t* incstk_new(void)
 {
- return &incstk_obj;
+ return (incstk_t*)(malloc(sizeof(incstk_t)));
 }
 
 
 
-/* Inits an include stack object as empty. */
+/* Deletes an include stack object. Note that no file management is performed
+** here. */
+void  incstk_delete(incstk_t* hnd)
+{
+ free(hnd);
+}
+
+
+
+/* Inits an include stack object as empty. This also clears the list of
+** included files. */
 void  incstk_init(incstk_t* hnd)
 {
  memset(hnd, 0U, sizeof(hnd[0]));
@@ -47,7 +57,7 @@ void  incstk_init(incstk_t* hnd)
 ** positions (and of cource file handle & name) are preserved, so only these
 ** go on the stack. Returns nonzero (TRUE) if this is not possible. Note that
 ** no file management is performed here. */
-auint incstk_push(incstk_t* hnd, compst_t* cst, FILE* fp)
+auint incstk_push(incstk_t* hnd, compst_t* cst, fprov_file_t* fp)
 {
  if ((hnd->pos) == INCSTK_MAX){ return 1U; }
  hnd->fpt[hnd->pos] = fp;
@@ -63,7 +73,7 @@ auint incstk_push(incstk_t* hnd, compst_t* cst, FILE* fp)
 ** compilation state. Returns nonzero (TRUE) if this is not possible (since
 ** the stack is already empty). Note that no file management is performed
 ** here. Note that also resets character offset in file. */
-auint incstk_pop(incstk_t* hnd, compst_t* cst, FILE** fp)
+auint incstk_pop(incstk_t* hnd, compst_t* cst, fprov_file_t** fp)
 {
  if ((hnd->pos) == 0U){ return 1U; }
  (hnd->pos)--;
@@ -73,3 +83,40 @@ auint incstk_pop(incstk_t* hnd, compst_t* cst, FILE** fp)
  compst_setcoff(cst, 0U);
  return 0U;
 }
+
+
+
+/* Checks whether a file was already included (the name must match exactly).
+** Returns nonzero (TRUE) if so. */
+auint incstk_isinc(incstk_t* hnd, uint8 const* fnam)
+{
+ auint i;
+ for (i = 0U; i < (hnd->icn); i++){
+  if (strcmp((char const*)(fnam), (char const*)(&(hnd->inc[i][0]))) == 0){
+   return 1U;
+  }
+ }
+ return 0U;
+}
+
+
+
+/* Adds a file to the list of included files. Returns nonzero (TRUE) if this
+** is not possible (the list is full). */
+auint incstk_addinc(incstk_t* hnd, uint8 const* fnam)
+{
+ if ((hnd->icn) >= INCSTK_INC){ return 1U; }
+ strpr_copy(&(hnd->inc[hnd->icn][0]), fnam, FILE_MAX);
+ (hnd->icn)++;
+ return 0U;
+}
+
+
+
+/* Gets the name of an included file by its index in the order of addition.
+** Returns NULL if there is no such file. */
+uint8 const* incstk_getinc(incstk_t* hnd, auint idx)
+{
+ if (idx >= (hnd->icn)){ return NULL; }
+ return &(hnd->inc[idx][0]);
+}
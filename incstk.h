@@ -16,6 +16,7 @@
 
 #include "types.h"
 #include "compst.h"
+#include "fprov.h"
 
 
 /* Include stack object structure */
@@ -26,16 +27,23 @@ typedef struct incstk_s incstk_t;
 ** include chains. Not a terribly demanding resource. */
 #define INCSTK_MAX  16U
 
+/* Number of distinct includes possible. */
+#define INCSTK_INC  256U
 
 
-/* Note: there is a problem in C with information hiding if it would be
-** desirable to work it out without dynamic memory allocation. So a static
-** object is supplied here for use, and no need for malloc. One object is
-** enough. So this is not a "new" implementation, just a static object. */
-incstk_t* incstk_getobj(void);
 
+/* Creates a new include stack object. Returns NULL if it is not possible to
+** allocate it. The object has to be initialized before use. */
+incstk_t* incstk_new(void);
 
-/* Inits an include stack object as empty. */
+
+/* Deletes an include stack object. Note that no file management is performed
+** here. */
+void  incstk_delete(incstk_t* hnd);
+
+
+/* Inits an include stack object as empty. This also clears the list of
+** included files. */
 void  incstk_init(incstk_t* hnd);
 
 
@@ -43,14 +51,29 @@ void  incstk_init(incstk_t* hnd);
 ** positions (and of cource file handle & name) are preserved, so only these
 ** go on the stack. Returns nonzero (TRUE) if this is not possible. Note that
 ** no file management is performed here. */
-auint incstk_push(incstk_t* hnd, compst_t* cst, FILE* fp);
+auint incstk_push(incstk_t* hnd, compst_t* cst, fprov_file_t* fp);
 
 
 /* Pops a file from the include stack. Restores previous file data in the
 ** compilation state. Returns nonzero (TRUE) if this is not possible (since
 ** the stack is already empty). Note that no file management is performed
 ** here. Note that also resets character offset in file. */
-auint incstk_pop(incstk_t* hnd, compst_t* cst, FILE** fp);
+auint incstk_pop(incstk_t* hnd, compst_t* cst, fprov_file_t** fp);
+
+
+/* Checks whether a file was already included (the name must match exactly).
+** Returns nonzero (TRUE) if so. */
+auint incstk_isinc(incstk_t* hnd, uint8 const* fnam);
+
+
+/* Adds a file to the list of included files. Returns nonzero (TRUE) if this
+** is not possible (the list is full). */
+auint incstk_addinc(incstk_t* hnd, uint8 const* fnam);
+
+
+/* Gets the name of an included file by its index in the order of addition.
+** Returns NULL if there is no such file. */
+uint8 const* incstk_getinc(incstk_t* hnd, auint idx);
 
 
 #endif
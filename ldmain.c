@@ -0,0 +1,129 @@
+/**
+**  \file
+**  \brief     RRPGE linker main file
+**  \author    Sandor Zsuga (Jubatian)
+**  \license   2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**
+** Short usage summary:
+** rrpgeld [-o output] object.rpo [object.rpo | archive.rpl ...]
+** rrpgeld -a archive.rpl object.rpo [object.rpo ...]
+**
+** Links the relocatable object files produced by "rrpgeasm -c" into an
+** application binary. The output file name is "app.rpa" unless specified by
+** "-o". The code, data and zero sections of the objects are placed in the
+** order they are given on the command line, followed by the members of the
+** archives which are needed by them.
+**
+** With "-a" it creates an archive of the objects instead (see objlib.h).
+*/
+
+
+
+#include "types.h"
+#include "asmctx.h"
+#include "fault.h"
+#include "version.h"
+
+
+/* Application name string */
+static char const* main_appname = "RRPGE Linker. Version: " ASSEMBLER_VERSION;
+
+/* Other elements */
+static char const* main_appauth = "By: Sandor Zsuga (Jubatian)\n";
+static char const* main_copyrig = "License: 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public\nLicense) extended as RRPGEvt (temporary version of the RRPGE License):\nsee LICENSE.GPLv3 and LICENSE.RRPGEvt in the project root.\n";
+
+
+
+int main(int argc, char** argv)
+{
+ uint8      s[80];
+ asmctx_t*  ctx;
+ uint8 const** obl;                           /* Object files */
+ auint      obc = 0U;                         /* Count of object files */
+ uint8 const* ouf = (uint8 const*)("app.rpa"); /* Output file */
+ uint8 const* arf = NULL;                     /* Archive to create (if any) */
+ auint      t;
+ int        i;
+
+
+ /* Welcome message */
+
+ printf("\n");
+ printf("%s", main_appname);
+ printf("\n\n");
+ printf("%s", main_appauth);
+ printf("%s", main_copyrig);
+ printf("\n");
+
+ /* Process command line */
+
+ obl = (uint8 const**)(malloc(sizeof(uint8 const*) * (size_t)(argc)));
+ if (obl == NULL){ goto fault_mem; }
+
+ for (i = 1; i < argc; i++){
+  if (strcmp(argv[i], "-o") == 0){
+   i++;
+   if (i >= argc){ goto fault_aro; }
+   ouf = (uint8 const*)(argv[i]);
+  }else if (strcmp(argv[i], "-a") == 0){
+   i++;
+   if (i >= argc){ goto fault_ara; }
+   arf = (uint8 const*)(argv[i]);
+  }else{
+   obl[obc] = (uint8 const*)(argv[i]);
+   obc++;
+  }
+ }
+ if (obc == 0U){ goto fault_arn; }
+
+ /* Link or create archive */
+
+ ctx = asmctx_new();
+ if (ctx == NULL){ free(obl); goto fault_mem; }
+ if (arf != NULL){
+  t = asmctx_archive(ctx, obl, obc, arf);
+ }else{
+  t = asmctx_link(ctx, obl, obc, ouf);
+ }
+ asmctx_delete(ctx);
+ free(obl);
+ if (t){ goto fault_oth; }
+
+ return 0U;
+
+fault_aro:
+
+ free(obl);
+ snprintf((char*)(&s[0]), 80U, "Missing file name after \'-o\'");
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
+
+fault_ara:
+
+ free(obl);
+ snprintf((char*)(&s[0]), 80U, "Missing archive name after \'-a\'");
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
+
+fault_arn:
+
+ free(obl);
+ snprintf((char*)(&s[0]), 80U, "No object files to link");
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
+
+fault_mem:
+
+ snprintf((char*)(&s[0]), 80U, "Not enough memory for the linker");
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
+
+fault_oth:
+
+ return 1U;
+}
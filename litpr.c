@@ -13,6 +13,7 @@
 
 #include "litpr.h"
 #include "strpr.h"
+#include "peep.h"
 
 
 
@@ -23,30 +24,33 @@
 
 
 
-/* Tries to interpret and retrieve value of a literal in the given string. The
-** following outcomes are possible:
-**
-** LITPR_VAL: Valid literal found, it's value is returned in 'val'.
-** LITPR_UND: An aggregate containing symbols found. The aggregate's members
-**            are submitted appropriately to the symbol table, in 'val' the
-**            top member's ID is returned (to be used with symtab_use()).
-** LITPR_STR: String literal is found. If LITPR_VAL is set along with it, the
-**            value of the literal is returned in 'val', otherwise not (the
-**            string is longer than 4 ASCII characters).
-** LITPR_INV: Error. An appropriate fault code is printed.
-**
-** The interpretation stops when the line terminates or a seperator (,), or a
-** function ({ or }) or an addrssing mode bracket (]) is found. Returns the
-** offset of stopping (pointing at the ',', ']', '{' or '}' if any) in 'len'
-** (zero for LITPR_INV). */
-auint litpr_getval(uint8 const* src, auint* len, auint* val, symtab_t* stb)
+/* Internal result of litpr_i_prim(): failed, fault printed */
+#define LITPR_ERR 8U
+
+/* Count of binary operator precedence levels */
+#define LITPR_LVC 6U
+
+
+/* Expression operand */
+typedef struct{
+ auint typ;             /* LITPR_VAL, or LITPR_UND (a definition ID) */
+ auint val;             /* Value or definition ID */
+ auint fre;             /* Definition created for the expression */
+}litpr_opd_t;
+
+
+
+/* Internal function to interpret a single literal (number, string or symbol)
+** at the start of the string. Returns the LITPR outcome like litpr_getval()
+** (LITPR_INV if there is no literal, with no fault printed, LITPR_ERR if it
+** failed with fault printed), the end of the literal in 'len'. */
+static auint litpr_i_prim(uint8 const* src, auint* len, auint* val, symtab_t* stb)
 {
  auint e;               /* Position in string */
  auint u;               /* For generating the result in val */
  auint r = 0U;          /* Return value */
  uint8 s[LINE_MAX];
  auint t;
- compst_t* cst = symtab_getcompst(stb); /* Only for printing fault */
 
  /* Check for string */
 
@@ -129,7 +133,7 @@ auint litpr_getval(uint8 const* src, auint* len, auint* val, symtab_t* stb)
   while (strpr_issym(src[e])){ e++; }
   *val = symtab_getsymdef(stb, src);
   if ((*val) == 0U){
-   goto end_faultpr;    /* Can not get new symbol definition (fault printed) */
+   return LITPR_ERR;    /* Can not get new symbol definition (fault printed) */
   }
   if (symtab_resolvesym(stb, *val, &u)){
    goto end_val;        /* Symbol can be pre-resolved, so produces value */
@@ -140,10 +144,7 @@ auint litpr_getval(uint8 const* src, auint* len, auint* val, symtab_t* stb)
 
  /* No literal here */
 
- goto end_fault;
-
- /* Literal / symbol succesfully decoded, still need to check string validity
- ** (is there any invalid part after the literal?) */
+ return LITPR_INV;
 
 end_val:
 
@@ -152,6 +153,211 @@ end_val:
 
 end_sok:
 
+ *len = e;
+ return r;
+}
+
+
+
+/* Internal function to match a binary operator of precedence level 'lvl'
+** (0: lowest) at the start of the string. Returns its length (0 if there is
+** none), the symbol table command in 'cmd'. */
+static auint litpr_i_binop(uint8 const* src, auint lvl, auint* cmd)
+{
+ switch (lvl){
+
+  case 0U:
+   if (src[0] == (uint8)('|')){ *cmd = SYMTAB_CMD_OR;  return 1U; }
+   break;
+
+  case 1U:
+   if (src[0] == (uint8)('^')){ *cmd = SYMTAB_CMD_XOR; return 1U; }
+   break;
+
+  case 2U:
+   if (src[0] == (uint8)('&')){ *cmd = SYMTAB_CMD_AND; return 1U; }
+   break;
+
+  case 3U:
+   if ((src[0] == (uint8)('<')) && (src[1] == (uint8)('<'))){ *cmd = SYMTAB_CMD_SHL; return 2U; }
+   if ((src[0] == (uint8)('>')) && (src[1] == (uint8)('>'))){ *cmd = SYMTAB_CMD_SHR; return 2U; }
+   break;
+
+  case 4U:
+   if (src[0] == (uint8)('+')){ *cmd = SYMTAB_CMD_ADD; return 1U; }
+   if (src[0] == (uint8)('-')){ *cmd = SYMTAB_CMD_SUB; return 1U; }
+   break;
+
+  default:
+   if (src[0] == (uint8)('*')){ *cmd = SYMTAB_CMD_MUL; return 1U; }
+   if (src[0] == (uint8)('/')){ *cmd = SYMTAB_CMD_DIV; return 1U; }
+   if (src[0] == (uint8)('%')){ *cmd = SYMTAB_CMD_MOD; return 1U; }
+   break;
+
+ }
+
+ return 0U;
+}
+
+
+
+/* Internal function to combine two operands by a symbol table command into
+** 'op0'. Known values are folded, otherwise a definition is created for the
+** operation. Returns nonzero (TRUE) on failure, fault printed. */
+static auint litpr_i_comb(auint cmd, litpr_opd_t* op0, litpr_opd_t const* op1, symtab_t* stb)
+{
+ auint s0 = op0->val;
+ auint s1 = op1->val;
+ auint r;
+
+ if ((op0->typ != LITPR_VAL) || (op1->typ != LITPR_VAL)){
+  if (op0->typ != LITPR_VAL){ cmd |= SYMTAB_CMD_S0I; }
+  if (op1->typ != LITPR_VAL){ cmd |= SYMTAB_CMD_S1I; }
+  r = symtab_addsymdef(stb, cmd, s0, NULL, s1, NULL);
+  if (r == 0U){ return 1U; }
+  op0->typ = LITPR_UND;
+  op0->val = r;
+  op0->fre = 1U;
+  return 0U;
+ }
+
+ switch (cmd){
+
+  case SYMTAB_CMD_ADD: r = s0 +  s1; break;
+  case SYMTAB_CMD_SUB: r = s0 -  s1; break;
+  case SYMTAB_CMD_MUL: r = s0 *  s1; break;
+  case SYMTAB_CMD_DIV:
+   if (s1 == 0U){ goto fault_div; }
+   r = s0 / s1;
+   break;
+  case SYMTAB_CMD_MOD:
+   if (s1 == 0U){ goto fault_div; }
+   r = s0 % s1;
+   break;
+  case SYMTAB_CMD_AND: r = s0 &  s1; break;
+  case SYMTAB_CMD_OR:  r = s0 |  s1; break;
+  case SYMTAB_CMD_XOR: r = s0 ^  s1; break;
+  case SYMTAB_CMD_SHR: r = s0 >> (s1 & 31U); break;
+  default:             r = s0 << (s1 & 31U); break;
+
+ }
+
+ op0->val = r;
+ return 0U;
+
+fault_div:
+
+ fault_printat(FAULT_FAIL, (uint8 const*)("Division by zero in expression"), symtab_getcompst(stb));
+ return 1U;
+}
+
+
+
+/* Internal recursive expression parser for precedence level 'lvl' (binary
+** operators of 'lvl' and above, then unary operators and parentheses) from
+** position 'pos' in 'src', which is updated to the end of the expression.
+** Returns the LITPR outcome: for a lone literal just like litpr_i_prim(),
+** for an expression LITPR_VAL or LITPR_UND, the operand in 'opd'. */
+static auint litpr_i_expr(uint8 const* src, auint* pos, auint lvl, litpr_opd_t* opd, symtab_t* stb)
+{
+ litpr_opd_t opr;
+ auint  p = strpr_nextnw(src, *pos);
+ auint  r;
+ auint  t;
+ auint  cmd;
+
+ if (lvl < LITPR_LVC){  /* Binary operators of the level */
+
+  r = litpr_i_expr(src, pos, lvl + 1U, opd, stb);
+  while ((r & (LITPR_VAL | LITPR_UND)) != 0U){
+   p = strpr_nextnw(src, *pos);
+   t = litpr_i_binop(&(src[p]), lvl, &cmd);
+   if (t == 0U){ break; }
+   *pos = p + t;
+   t = litpr_i_expr(src, pos, lvl + 1U, &opr, stb);
+   if ((t & (LITPR_VAL | LITPR_UND)) == 0U){ return ((t == LITPR_ERR) ? LITPR_ERR : LITPR_INV); }
+   if (litpr_i_comb(cmd, opd, &opr, stb)){ return LITPR_ERR; }
+   r = opd->typ;
+  }
+  return r;
+
+ }
+
+ if (src[p] == (uint8)('-')){  /* Unary minus: subtract from zero */
+  *pos = p + 1U;
+  t = litpr_i_expr(src, pos, lvl, &opr, stb);
+  if ((t & (LITPR_VAL | LITPR_UND)) == 0U){ return ((t == LITPR_ERR) ? LITPR_ERR : LITPR_INV); }
+  opd->typ = LITPR_VAL;
+  opd->val = 0U;
+  opd->fre = 0U;
+  if (litpr_i_comb(SYMTAB_CMD_SUB, opd, &opr, stb)){ return LITPR_ERR; }
+  return opd->typ;
+ }
+
+ if (src[p] == (uint8)('~')){  /* Unary not: exclusive or with all ones */
+  *pos = p + 1U;
+  t = litpr_i_expr(src, pos, lvl, opd, stb);
+  if ((t & (LITPR_VAL | LITPR_UND)) == 0U){ return ((t == LITPR_ERR) ? LITPR_ERR : LITPR_INV); }
+  opr.typ = LITPR_VAL;
+  opr.val = 0xFFFFFFFFU;
+  opr.fre = 0U;
+  if (litpr_i_comb(SYMTAB_CMD_XOR, opd, &opr, stb)){ return LITPR_ERR; }
+  return opd->typ;
+ }
+
+ if (src[p] == (uint8)('+')){  /* Unary plus */
+  *pos = p + 1U;
+  t = litpr_i_expr(src, pos, lvl, opd, stb);
+  if ((t & (LITPR_VAL | LITPR_UND)) == 0U){ return ((t == LITPR_ERR) ? LITPR_ERR : LITPR_INV); }
+  return opd->typ;
+ }
+
+ if (src[p] == (uint8)('(')){  /* Parentheses */
+  *pos = p + 1U;
+  t = litpr_i_expr(src, pos, 0U, opd, stb);
+  if ((t & (LITPR_VAL | LITPR_UND)) == 0U){ return ((t == LITPR_ERR) ? LITPR_ERR : LITPR_INV); }
+  p = strpr_nextnw(src, *pos);
+  if (src[p] != (uint8)(')')){ return LITPR_INV; }
+  *pos = p + 1U;
+  return opd->typ;
+ }
+
+ /* Literal. Strings only have value if they are short enough */
+
+ r = litpr_i_prim(&(src[p]), &t, &(opd->val), stb);
+ if ((r & (LITPR_VAL | LITPR_UND)) != 0U){
+  opd->typ = r & (LITPR_VAL | LITPR_UND);
+  opd->fre = 0U;
+ }
+ if (r != LITPR_INV){ *pos = p + t; }
+ return r;
+}
+
+
+
+/* Internal function for litpr_getval(), also returning whether the
+** definition of a LITPR_UND outcome was created for the expression in 'fre'
+** (otherwise it is the definition of a symbol). */
+static auint litpr_i_getval(uint8 const* src, auint* len, auint* val, auint* fre, symtab_t* stb)
+{
+ litpr_opd_t opd;
+ auint e = 0U;
+ auint r;
+ compst_t* cst = symtab_getcompst(stb); /* Only for printing fault */
+
+ opd.typ = LITPR_INV;
+ opd.val = 0U;
+ opd.fre = 0U;
+
+ r = litpr_i_expr(src, &e, 0U, &opd, stb);
+ if (r == LITPR_ERR){ goto end_faultpr; }
+ if (r == LITPR_INV){ goto end_fault; }
+ if ((r & (LITPR_VAL | LITPR_UND)) != 0U){ *val = opd.val; }
+ *fre = opd.fre;
+
+ /* Literal / expression succesfully decoded, still need to check string
+ ** validity (is there any invalid part after it?) */
+
  e = strpr_nextnw(src, e);
  *len = e;
  if ( (!strpr_isend(src[e])) &&
@@ -159,7 +365,6 @@ end_sok:
       (src[e] != (uint8)('{')) &&
       (src[e] != (uint8)('}')) &&
       (src[e] != (uint8)(']')) ){ goto end_fault; }
- if (r == LITPR_INV){ goto end_fault; } /* Should not happen, but have a message if so */
  return r;
 
 end_fault:
@@ -170,7 +375,37 @@ end_faultpr:
 
  *len = 0U;
  return LITPR_INV;
+}
+
+
 
+/* Tries to interpret and retrieve value of a literal in the given string. The
+** following outcomes are possible:
+**
+** LITPR_VAL: Valid literal found, it's value is returned in 'val'.
+** LITPR_UND: An aggregate containing symbols found. The aggregate's members
+**            are submitted appropriately to the symbol table, in 'val' the
+**            top member's ID is returned (to be used with symtab_use()).
+** LITPR_STR: String literal is found. If LITPR_VAL is set along with it, the
+**            value of the literal is returned in 'val', otherwise not (the
+**            string is longer than 4 ASCII characters).
+** LITPR_INV: Error. An appropriate fault code is printed.
+**
+** The literal may be an expression of literals with the operators '|', '^',
+** '&', '<<', '>>', '+', '-', '*', '/' and '%' (in increasing order of
+** precedence, left associative), unary '-', '+' and '~', and parentheses. Parts
+** of known value are folded, so an expression only produces LITPR_UND if it
+** contains a symbol whose value is not known yet. LITPR_STR is only produced
+** for a lone string.
+**
+** The interpretation stops when the line terminates or a seperator (,), or a
+** function ({ or }) or an addrssing mode bracket (]) is found. Returns the
+** offset of stopping (pointing at the ',', ']', '{' or '}' if any) in 'len'
+** (zero for LITPR_INV). */
+auint litpr_getval(uint8 const* src, auint* len, auint* val, symtab_t* stb)
+{
+ auint fre;
+ return litpr_i_getval(src, len, val, &fre, stb);
 }
 
 
@@ -184,6 +419,7 @@ auint litpr_symdefproc(symtab_t* stb)
  auint  i;
  auint  r;
  auint  t;
+ auint  f;
  uint32 v;
  uint8 const* s;
  compst_t*  cst = symtab_getcompst(stb);
@@ -203,6 +439,9 @@ auint litpr_symdefproc(symtab_t* stb)
  if (s[i] == ':'){   /* Line label: the symbol's value is the offset */
   compst_setgsym(cst, &s[0]);      /* Add global symbol (if it is global) */
   compst_setcoffrel(cst, i + 1U);
+  if (symtab_getpeep(stb) != NULL){
+   peep_label(symtab_getpeep(stb), stb, &s[0]);
+  }
   i = symtab_addsymdef(stb, SYMTAB_CMD_ADD | SYMTAB_CMD_S1N,
                        section_getoffw(sec), NULL,
                        0U, section_getsbstr(section_getsect(sec)));
@@ -214,10 +453,13 @@ auint litpr_symdefproc(symtab_t* stb)
 
  if (compst_issymequ(NULL, &(s[i]), (uint8 const*)("equ"))){
   i = strpr_nextnw(&s[0], i + 3U); /* Skip whites after equ */
-  r = litpr_getval(&s[i], &t, &v, stb);
+  r = litpr_i_getval(&s[i], &t, &v, &f, stb);
   if ((r & LITPR_VAL) != 0U){      /* Valid literal, so can be stored */
    v = symtab_addsymdef(stb, SYMTAB_CMD_MOV, v, NULL, 0U, NULL);
    if (v == 0U){ goto fault_ot1; }
+  }else if ((r == LITPR_UND) && (f == 0U)){ /* Other symbol: refer it, don't take its definition */
+   v = symtab_addsymdef(stb, SYMTAB_CMD_MOV | SYMTAB_CMD_S0I, v, NULL, 0U, NULL);
+   if (v == 0U){ goto fault_ot1; }
   }
   if ( ((r & LITPR_VAL) != 0U) ||
        ((r & LITPR_UND) != 0U) ){  /* Valid literal or symbol aggregate */
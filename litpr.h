@@ -39,6 +39,13 @@
 **            string is longer than 4 ASCII characters).
 ** LITPR_INV: Error. An appropriate fault code is printed.
 **
+** The literal may be an expression of literals with the operators '|', '^',
+** '&', '<<', '>>', '+', '-', '*', '/' and '%' (in increasing order of
+** precedence, left associative), unary '-', '+' and '~', and parentheses. Parts
+** of known value are folded, so an expression only produces LITPR_UND if it
+** contains a symbol whose value is not known yet. LITPR_STR is only produced
+** for a lone string.
+**
 ** The interpretation stops when the line terminates or a seperator (,), or a
 ** function ({ or }) or an addrssing mode bracket (]) is found. Returns the
 ** offset of stopping (pointing at the ',', ']', '{' or '}' if any) in 'len'
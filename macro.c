@@ -0,0 +1,990 @@
+/**
+**  \file
+**  \brief     Macros
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  The definitions, their body lines, the tokens of those and the text of
+**  the tokens are kept in growing arrays, the definitions found by a chained
+**  hash table of their names.
+**
+**  The blocks of 'rept' and 'irp' are recorded as unnamed definitions (not
+**  in the hash table) and expanded right after their 'endr'. Such a
+**  definition is dropped when its expansion ends if it is the last one, so
+**  blocks nested in a repeat do not pile up recording them on every
+**  iteration.
+*/
+
+
+#include "macro.h"
+#include "compst.h"
+#include "litpr.h"
+#include "fault.h"
+#include "strpr.h"
+
+
+/* Size of the name hash table (power of 2) */
+#define MACRO_HSI   256U
+
+/* Token types: Text copied as-is */
+#define MACRO_T_TXT 0U
+/* Token types: Parameter ('off' is its index) */
+#define MACRO_T_PAR 1U
+/* Token types: Local label (the text is its name without the '@') */
+#define MACRO_T_LOC 2U
+
+/* Definition kinds: Macro */
+#define MACRO_K_MAC 0U
+/* Definition kinds: 'rept' block (the parameter is the counter) */
+#define MACRO_K_REP 1U
+/* Definition kinds: 'irp' block (the parameter takes the items) */
+#define MACRO_K_IRP 2U
+
+
+/* Token of a body line */
+typedef struct{
+ auint  typ;            /* Type (MACRO_T_ values) */
+ auint  off;            /* Offset of the text in the pool or parameter index */
+ auint  len;            /* Length of the text */
+}macro_tok_t;
+
+
+/* Body line */
+typedef struct{
+ auint  lin;            /* Line number within the defining file */
+ auint  tbe;            /* First token */
+ auint  tct;            /* Count of tokens */
+}macro_lin_t;
+
+
+/* Definition */
+typedef struct{
+ uint8  nam[SYMB_MAX];  /* Name ('rept' or 'irp' for those) */
+ uint8  fil[FILE_MAX];  /* Defining file */
+ auint  lin;            /* Line of the 'macro' keyword */
+ auint  knd;            /* Kind (MACRO_K_ values) */
+ auint  pct;            /* Count of parameters */
+ auint  lbe;            /* First body line */
+ auint  lct;            /* Count of body lines */
+ auint  tbe;            /* First token */
+ auint  xbe;            /* First byte in the text pool */
+ auint  nxt;            /* Next definition in the hash chain + 1 (0: none) */
+}macro_def_t;
+
+
+/* Running expansion */
+typedef struct{
+ auint  mac;            /* Definition being expanded */
+ auint  pos;            /* Next body line */
+ auint  num;            /* Number of the expansion (for local labels) */
+ auint  itr;            /* Iteration of a repeat */
+ auint  ict;            /* Count of iterations (1 for a macro) */
+ uint8  arg[LINE_MAX];  /* Text of the parameters (or 'irp' items) */
+ auint  aof[MACRO_IRP]; /* Offsets of the parameters in 'arg' */
+ auint  aln[MACRO_IRP]; /* Lengths of the parameters */
+ uint8  fil[FILE_MAX];  /* File of the line starting it */
+ auint  lin;            /* Line starting it */
+ auint  chr;            /* Character offset of the macro name on the line */
+ uint8  efn[FILE_MAX];  /* File name reported for the lines of the expansion */
+}macro_lvl_t;
+
+
+/* Macro manager object structure - definition */
+struct macro_s{
+ macro_def_t* def;      /* Definitions */
+ auint        dct;      /* Count of definitions */
+ auint        dsi;      /* Size of the definition array */
+ macro_lin_t* lns;      /* Body lines */
+ auint        lct;      /* Count of body lines */
+ auint        lsi;      /* Size of the body line array */
+ macro_tok_t* tok;      /* Tokens */
+ auint        tct;      /* Count of tokens */
+ auint        tsi;      /* Size of the token array */
+ uint8*       txt;      /* Text pool of the tokens */
+ auint        xct;      /* Count of bytes in the text pool */
+ auint        xsi;      /* Size of the text pool */
+ auint        hsh[MACRO_HSI]; /* Hash table of names (definition + 1) */
+ auint        rec;      /* Definition being recorded + 1 (0: none) */
+ uint8        rpn[MACRO_PAR][SYMB_MAX]; /* Parameter names of it */
+ auint        rnd;      /* Repeats nested in the repeat being recorded */
+ auint        rdp;      /* Depth of expansions when the recording began */
+ macro_lvl_t  stk[MACRO_DEP]; /* Running expansions */
+ auint        dep;      /* Depth of expansions */
+ auint        num;      /* Count of expansions */
+ auint        cnt;      /* Count of definitions and expansions */
+};
+
+
+
+/* Ensures room for 'cnt' elements of 'esz' bytes in the array 'arr' having
+** room for 'siz' elements, growing it. Returns the array (which may move),
+** NULL if there is not enough memory (the array is left intact then). */
+static void* macro_i_grow(void* arr, auint* siz, auint cnt, auint esz)
+{
+ void* r;
+ auint i = *siz;
+
+ if (cnt <= i){ return arr; }
+ if (i == 0U){ i = 64U; }
+ while (i < cnt){ i <<= 1; }
+ r = realloc(arr, (size_t)(i) * esz);
+ if (r != NULL){ *siz = i; }
+
+ return r;
+}
+
+
+
+/* Hashes a name of 'len' characters. */
+static auint macro_i_hash(uint8 const* nam, auint len)
+{
+ auint h = 2166136261U;
+ auint i;
+
+ for (i = 0U; i < len; i++){
+  h = (h ^ nam[i]) * 16777619U;
+ }
+
+ return h & (MACRO_HSI - 1U);
+}
+
+
+
+/* Finds a defined macro by a name of 'len' characters. Returns the count of
+** definitions if there is none. */
+static auint macro_i_find(macro_t const* hnd, uint8 const* nam, auint len)
+{
+ auint i = hnd->hsh[macro_i_hash(nam, len)];
+
+ while (i != 0U){
+  if ( (memcmp(&(hnd->def[i - 1U].nam[0]), nam, len) == 0) &&
+       (hnd->def[i - 1U].nam[len] == 0U) ){ return i - 1U; }
+  i = hnd->def[i - 1U].nxt;
+ }
+
+ return hnd->dct;
+}
+
+
+
+/* Gets the length of a name (macro or parameter) at 'src'. Returns zero if
+** it is not a valid name: it can not begin with a digit, '.' or '@', and it
+** has to fit in SYMB_MAX. */
+static auint macro_i_name(uint8 const* src)
+{
+ auint i = 0U;
+
+ if ( (src[0] == (uint8)('.')) || (src[0] == (uint8)('@')) ||
+      ((src[0] >= (uint8)('0')) && (src[0] <= (uint8)('9'))) ){ return 0U; }
+ while (strpr_issym(src[i])){ i++; }
+ if (i >= SYMB_MAX){ return 0U; }
+
+ return i;
+}
+
+
+
+/* Gets the end of a string literal beginning at 'src' (at the quote),
+** stopping at the terminator if it is not closed. */
+static auint macro_i_str(uint8 const* src)
+{
+ auint i = 1U;
+
+ while ((src[i] != 0U) && (src[i] != src[0])){
+  if ((src[i] == (uint8)('\\')) && (src[i + 1U] != 0U)){ i++; }
+  i++;
+ }
+ if (src[i] != 0U){ i++; }
+
+ return i;
+}
+
+
+
+/* Adds a token to the body line being recorded (the last one), text copied
+** into the pool, merged with the previous if both are text. Returns nonzero
+** (TRUE) if there is not enough memory. */
+static auint macro_i_addtok(macro_t* hnd, auint typ, uint8 const* src, auint len, auint par)
+{
+ macro_lin_t* lns = &(hnd->lns[hnd->lct - 1U]);
+ macro_tok_t* tok;
+ void*        p;
+
+ if (len != 0U){
+  p = macro_i_grow(hnd->txt, &(hnd->xsi), hnd->xct + len, 1U);
+  if (p == NULL){ return 1U; }
+  hnd->txt = (uint8*)(p);
+  memcpy(&(hnd->txt[hnd->xct]), src, len);
+ }
+
+ if ( (typ == MACRO_T_TXT) && (lns->tct != 0U) &&
+      (hnd->tok[hnd->tct - 1U].typ == MACRO_T_TXT) ){
+  hnd->tok[hnd->tct - 1U].len += len;
+ }else{
+  p = macro_i_grow(hnd->tok, &(hnd->tsi), hnd->tct + 1U, sizeof(macro_tok_t));
+  if (p == NULL){ return 1U; }
+  hnd->tok = (macro_tok_t*)(p);
+  tok = &(hnd->tok[hnd->tct]);
+  tok->typ = typ;
+  tok->off = (typ == MACRO_T_PAR) ? par : hnd->xct;
+  tok->len = len;
+  hnd->tct ++;
+  lns->tct ++;
+ }
+ hnd->xct += len;
+
+ return 0U;
+}
+
+
+
+/* Gets the offset of the first keyword on the line 'src', past a label if
+** the line begins with one. */
+static auint macro_i_kw(uint8 const* src)
+{
+ auint beg = strpr_nextnw(src, 0U);
+ auint i = beg;
+
+ while (strpr_issym(src[i])){ i++; }
+ if ((i != beg) && (src[i] == (uint8)(':'))){ beg = strpr_nextnw(src, i + 1U); }
+
+ return beg;
+}
+
+
+
+/* Starts a new definition of kind 'knd' named by 'len' characters at 'nam'
+** at the current source line (it only becomes defined by incrementing the
+** count of definitions). Returns NULL if there is not enough memory. */
+static macro_def_t* macro_i_newdef(macro_t* hnd, compst_t* cst,
+                                   uint8 const* nam, auint len, auint knd)
+{
+ macro_def_t* def;
+ void*        p;
+
+ p = macro_i_grow(hnd->def, &(hnd->dsi), hnd->dct + 1U, sizeof(macro_def_t));
+ if (p == NULL){ return NULL; }
+ hnd->def = (macro_def_t*)(p);
+ def = &(hnd->def[hnd->dct]);
+ memcpy(&(def->nam[0]), nam, len);
+ def->nam[len] = 0U;
+ strpr_copy(&(def->fil[0]), compst_getfile(cst), FILE_MAX);
+ def->lin = compst_getline(cst);
+ def->knd = knd;
+ def->pct = 0U;
+ def->lbe = hnd->lct;
+ def->lct = 0U;
+ def->tbe = hnd->tct;
+ def->xbe = hnd->xct;
+ def->nxt = 0U;
+
+ return def;
+}
+
+
+
+/* Splits up the parameters at 'src' into the arguments of 'lvl', separated
+** by commas outside of strings and parentheses. Returns the count of them,
+** or 'max' + 1 if there are more than 'max' or the list is malformed. */
+static auint macro_i_args(uint8 const* src, macro_lvl_t* lvl, auint max)
+{
+ auint i = strpr_nextnw(src, 0U);
+ auint j = 0U;
+ auint o = 0U;
+ auint d;
+ auint t;
+
+ while (!strpr_isend(src[i])){
+  if (j == max){ return max + 1U; }
+  lvl->aof[j] = o;
+  d = 0U;
+  while (1){
+   if ( (src[i] == (uint8)('\"')) || (src[i] == (uint8)('\'')) ){
+    t = macro_i_str(&(src[i]));
+    memcpy(&(lvl->arg[o]), &(src[i]), t);
+    o += t;
+    i += t;
+    continue;
+   }
+   if ( (src[i] == (uint8)('(')) || (src[i] == (uint8)('[')) ){ d ++; }
+   if ( ((src[i] == (uint8)(')')) || (src[i] == (uint8)(']'))) && (d != 0U) ){ d --; }
+   if ( (d == 0U) && ((src[i] == (uint8)(',')) || strpr_isend(src[i])) ){ break; }
+   lvl->arg[o] = src[i];
+   o ++;
+   i ++;
+  }
+  while ((o > (lvl->aof[j])) && strpr_isspc(lvl->arg[o - 1U])){ o --; }
+  lvl->aln[j] = o - (lvl->aof[j]);
+  j ++;
+  if (src[i] != (uint8)(',')){ break; }
+  i = strpr_nextnw(src, i + 1U);
+  if (strpr_isend(src[i])){ return max + 1U; }
+ }
+
+ return j;
+}
+
+
+
+/* Prepares the current iteration of the expansion 'lvl' (at depth 'dep'):
+** its number for the local labels and the file name of its lines, and the
+** counter of a 'rept'. */
+static void  macro_i_iter(macro_t* hnd, macro_lvl_t* lvl, auint dep)
+{
+ uint8        s[80];
+ macro_def_t const* def = &(hnd->def[lvl->mac]);
+ auint        i;
+ auint        j;
+
+ hnd->num ++;
+ lvl->num = hnd->num;
+ lvl->pos = 0U;
+ snprintf((char*)(&s[0]), 80U, " [%s#%u, depth %u]",
+          (char const*)(&(def->nam[0])), hnd->num, dep);
+ j = strlen((char const*)(&s[0])) + 1U;
+ i = strlen((char const*)(&(def->fil[0])));
+ if (i > (FILE_MAX - j)){ i = FILE_MAX - j; } /* Shorten the file name to fit */
+ memcpy(&(lvl->efn[0]), &(def->fil[0]), i);
+ memcpy(&(lvl->efn[i]), &s[0], j);
+
+ if (def->knd == MACRO_K_REP){
+  lvl->aof[0] = 0U;
+  lvl->aln[0] = (auint)(snprintf((char*)(&(lvl->arg[0])), 16U, "%u", lvl->itr));
+ }
+}
+
+
+
+/* Starts the expansion of the definition 'mac' from the current source line
+** (the location of the name on it at 'chr'), on the next level of the stack
+** having its parameters and 'ict' already set up. */
+static void  macro_i_start(macro_t* hnd, compst_t* cst, auint mac, auint chr)
+{
+ macro_lvl_t* lvl = &(hnd->stk[hnd->dep]);
+
+ lvl->mac = mac;
+ lvl->itr = 0U;
+ strpr_copy(&(lvl->fil[0]), compst_getfile(cst), FILE_MAX);
+ lvl->lin = compst_getline(cst);
+ lvl->chr = chr;
+ hnd->dep ++;
+ hnd->cnt ++;
+ macro_i_iter(hnd, lvl, hnd->dep);
+}
+
+
+
+/* Prints the fault of the definition being recorded not being terminated. */
+static void  macro_i_unterm(macro_t* hnd)
+{
+ uint8        s[80];
+ macro_def_t const* def = &(hnd->def[hnd->rec - 1U]);
+ fault_off_t  fof;
+
+ fof.fil = &(def->fil[0]);
+ fof.lin = def->lin;
+ fof.chr = 0U;
+ if (def->knd == MACRO_K_MAC){
+  snprintf((char*)(&s[0]), 80U, "Macro \'%s\' not terminated by \'endm\' in its file",
+           (char const*)(&(def->nam[0])));
+ }else{
+  snprintf((char*)(&s[0]), 80U, "\'%s\' not terminated by \'endr\' in its file or macro",
+           (char const*)(&(def->nam[0])));
+ }
+ fault_print(FAULT_FAIL, &s[0], &fof);
+}
+
+
+
+/* Creates a new macro manager. Returns NULL if it is not possible to
+** allocate it. The object has to be initialized before use. */
+macro_t* macro_new(void)
+{
+ return (macro_t*)(calloc(1U, sizeof(macro_t)));
+}
+
+
+
+/* Deletes a macro manager. */
+void  macro_delete(macro_t* hnd)
+{
+ if (hnd != NULL){
+  free(hnd->def);
+  free(hnd->lns);
+  free(hnd->tok);
+  free(hnd->txt);
+ }
+ free(hnd);
+}
+
+
+
+/* Initializes or resets a macro manager for a new first pass (no macros
+** defined). */
+void  macro_init(macro_t* hnd)
+{
+ memset(&(hnd->hsh[0]), 0, sizeof(hnd->hsh));
+ hnd->dct = 0U;
+ hnd->lct = 0U;
+ hnd->tct = 0U;
+ hnd->xct = 0U;
+ hnd->rec = 0U;
+ hnd->rnd = 0U;
+ hnd->rdp = 0U;
+ hnd->dep = 0U;
+ hnd->num = 0U;
+ hnd->cnt = 0U;
+}
+
+
+
+/* If a definition is being recorded, takes the current source line into it,
+** ending it on 'endm' ('endr' for a repeat, starting its expansion then).
+** Returns PARSER_OK if no definition is being recorded (the line has to be
+** processed), otherwise PARSER_END or PARSER_ERR. */
+auint macro_rec(macro_t* hnd, symtab_t* stb)
+{
+ uint8        s[80];
+ compst_t*    cst = symtab_getcompst(stb);
+ uint8 const* src = compst_getsstr(cst);
+ macro_def_t* def;
+ void*        p;
+ auint        beg;
+ auint        i;
+ auint        j;
+ auint        k;
+
+ if (hnd->rec == 0U){ return PARSER_OK; }
+ def = &(hnd->def[hnd->rec - 1U]);
+ beg = strpr_nextnw(src, 0U);
+
+ if (strpr_isend(src[beg])){ return PARSER_END; } /* Empty lines are not stored */
+
+ if       (def->knd == MACRO_K_MAC){
+
+  if (compst_issymequ(NULL, &(src[beg]), (uint8 const*)("endm"))){
+   beg = strpr_nextnw(src, beg + 4U);
+   if (!strpr_isend(src[beg])){ goto fault_end; }
+   i = macro_i_hash(&(def->nam[0]), strlen((char const*)(&(def->nam[0]))));
+   def->nxt = hnd->hsh[i];
+   hnd->hsh[i] = hnd->rec;
+   hnd->rec = 0U;
+   return PARSER_END;
+  }
+
+ }else{                  /* Repeats: nested ones are only recorded */
+
+  beg = macro_i_kw(src);
+  if       ( compst_issymequ(NULL, &(src[beg]), (uint8 const*)("rept")) ||
+             compst_issymequ(NULL, &(src[beg]), (uint8 const*)("irp")) ){
+   hnd->rnd ++;
+  }else if (compst_issymequ(NULL, &(src[beg]), (uint8 const*)("endr"))){
+   if (hnd->rnd == 0U){
+    beg = strpr_nextnw(src, beg + 4U);
+    if (!strpr_isend(src[beg])){ goto fault_ere; }
+    i = hnd->rec - 1U;
+    hnd->rec = 0U;
+    macro_i_start(hnd, cst, i, 0U);
+    return PARSER_END;
+   }
+   hnd->rnd --;
+  }else{}
+
+ }
+
+ if (compst_issymequ(NULL, &(src[beg]), (uint8 const*)("macro"))){ goto fault_nst; }
+
+ /* Split up the line (from its beginning, labels are only labels in the
+ ** first column) */
+
+ p = macro_i_grow(hnd->lns, &(hnd->lsi), hnd->lct + 1U, sizeof(macro_lin_t));
+ if (p == NULL){ goto fault_mem; }
+ hnd->lns = (macro_lin_t*)(p);
+ hnd->lns[hnd->lct].lin = compst_getline(cst);
+ hnd->lns[hnd->lct].tbe = hnd->tct;
+ hnd->lns[hnd->lct].tct = 0U;
+ hnd->lct ++;
+ def->lct ++;
+
+ i = 0U;
+ while (!strpr_isend(src[i])){
+
+  if ( (src[i] == (uint8)('\"')) || (src[i] == (uint8)('\'')) ){
+   j = i + macro_i_str(&(src[i]));
+   if (macro_i_addtok(hnd, MACRO_T_TXT, &(src[i]), j - i, 0U)){ goto fault_mem; }
+
+  }else if (strpr_issym(src[i])){
+   j = i;
+   while (strpr_issym(src[j])){ j++; }
+   for (k = 0U; k < (def->pct); k++){
+    if ( (strncmp((char const*)(&(hnd->rpn[k][0])), (char const*)(&(src[i])), j - i) == 0) &&
+         (hnd->rpn[k][j - i] == 0U) ){ break; }
+   }
+   if       (k < (def->pct)){
+    if (macro_i_addtok(hnd, MACRO_T_PAR, &(src[i]), 0U, k)){ goto fault_mem; }
+   }else if ((src[i] == (uint8)('@')) && ((j - i) > 1U)){
+    if (macro_i_addtok(hnd, MACRO_T_LOC, &(src[i + 1U]), j - i - 1U, 0U)){ goto fault_mem; }
+   }else{
+    if (macro_i_addtok(hnd, MACRO_T_TXT, &(src[i]), j - i, 0U)){ goto fault_mem; }
+   }
+
+  }else{
+   j = i + 1U;
+   if (macro_i_addtok(hnd, MACRO_T_TXT, &(src[i]), 1U, 0U)){ goto fault_mem; }
+  }
+
+  i = j;
+ }
+
+ return PARSER_END;
+
+
+fault_end:
+
+ compst_setcoff(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Extra characters after \'endm\'");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_ere:
+
+ compst_setcoff(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Extra characters after \'endr\'");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_nst:
+
+ compst_setcoff(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Macro definition within \'%s\'", (char const*)(&(def->nam[0])));
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_mem:
+
+ snprintf((char*)(&s[0]), 80U, "Not enough memory for macro \'%s\'", (char const*)(&(def->nam[0])));
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+}
+
+
+
+/* Checks the current source line at the current position for a 'macro'
+** definition, a 'rept' or 'irp' block or an expansion of a defined macro,
+** starting it. Returns one of the defined PARSER return codes (defined in
+** types.h). */
+auint macro_proc(macro_t* hnd, symtab_t* stb)
+{
+ uint8        s[80];
+ compst_t*    cst = symtab_getcompst(stb);
+ uint8 const* src = compst_getsstrcoff(cst); /* Might not be first char (Labels!) */
+ macro_def_t* def;
+ macro_lvl_t* lvl;
+ auint        cof = compst_getcoff(cst);
+ auint        beg = strpr_nextnw(src, 0U);
+ auint        len;
+ auint        mac;
+ auint        i;
+ auint        t;
+ auint        v;
+
+ if (strpr_isend(src[beg])){
+  return PARSER_END; /* No content on this line, so processed succesful */
+ }
+
+
+ /* Definition: name and parameters, then the body is recorded */
+
+ if       (compst_issymequ(NULL, &(src[beg]), (uint8 const*)("macro"))){
+
+  beg = strpr_nextnw(src, beg + 5U);
+  len = macro_i_name(&(src[beg]));
+  if (len == 0U){ goto fault_nam; }
+  if (macro_i_find(hnd, &(src[beg]), len) != (hnd->dct)){ goto fault_def; }
+  def = macro_i_newdef(hnd, cst, &(src[beg]), len, MACRO_K_MAC);
+  if (def == NULL){ goto fault_mem; }
+
+  beg = strpr_nextnw(src, beg + len);
+  while (!strpr_isend(src[beg])){
+   if (def->pct != 0U){
+    if (src[beg] != (uint8)(',')){ goto fault_par; }
+    beg = strpr_nextnw(src, beg + 1U);
+   }
+   len = macro_i_name(&(src[beg]));
+   if (len == 0U){ goto fault_par; }
+   if (def->pct == MACRO_PAR){ goto fault_pmx; }
+   memcpy(&(hnd->rpn[def->pct][0]), &(src[beg]), len);
+   hnd->rpn[def->pct][len] = 0U;
+   for (i = 0U; i < (def->pct); i++){
+    if (strcmp((char const*)(&(hnd->rpn[i][0])), (char const*)(&(hnd->rpn[def->pct][0]))) == 0){
+     goto fault_pdu;
+    }
+   }
+   def->pct ++;
+   beg = strpr_nextnw(src, beg + len);
+  }
+
+  hnd->dct ++;
+  hnd->rec = hnd->dct;
+  hnd->rdp = hnd->dep;
+  hnd->cnt ++;
+  return PARSER_END;
+
+ }else if (compst_issymequ(NULL, &(src[beg]), (uint8 const*)("endm"))){
+
+  goto fault_nom;
+
+ }else if (compst_issymequ(NULL, &(src[beg]), (uint8 const*)("endr"))){
+
+  goto fault_nor;
+
+ }else if (compst_issymequ(NULL, &(src[beg]), (uint8 const*)("rept"))){
+
+  /* Repeat: count known in the first pass, optionally a counter */
+
+  if (hnd->dep == MACRO_DEP){ goto fault_dep; }
+  lvl = &(hnd->stk[hnd->dep]);
+  def = macro_i_newdef(hnd, cst, &(src[beg]), 4U, MACRO_K_REP);
+  if (def == NULL){ goto fault_mem; }
+  beg = strpr_nextnw(src, beg + 4U);
+  compst_setcoff(cst, cof + beg);
+  t = litpr_getval(&(src[beg]), &len, &v, stb);
+  if (t == LITPR_INV){ return PARSER_ERR; }
+  if ((t & LITPR_VAL) == 0U){ goto fault_cnk; }
+  if (v > MACRO_REP){ goto fault_cnt; }
+  compst_setcoff(cst, cof);
+  lvl->ict = v;
+  beg = strpr_nextnw(src, beg + len);
+  if (src[beg] == (uint8)(',')){
+   beg = strpr_nextnw(src, beg + 1U);
+   len = macro_i_name(&(src[beg]));
+   if (len == 0U){ goto fault_par; }
+   memcpy(&(hnd->rpn[0][0]), &(src[beg]), len);
+   hnd->rpn[0][len] = 0U;
+   def->pct = 1U;
+   beg = strpr_nextnw(src, beg + len);
+  }
+  if (!strpr_isend(src[beg])){ goto fault_par; }
+
+  hnd->dct ++;
+  hnd->rec = hnd->dct;
+  hnd->rdp = hnd->dep;
+  hnd->rnd = 0U;
+  hnd->cnt ++;
+  return PARSER_END;
+
+ }else if (compst_issymequ(NULL, &(src[beg]), (uint8 const*)("irp"))){
+
+  /* Iteration: parameter taking each item of the list in turn (the items
+  ** go right in the level of the stack the expansion will use) */
+
+  if (hnd->dep == MACRO_DEP){ goto fault_dep; }
+  lvl = &(hnd->stk[hnd->dep]);
+  def = macro_i_newdef(hnd, cst, &(src[beg]), 3U, MACRO_K_IRP);
+  if (def == NULL){ goto fault_mem; }
+  beg = strpr_nextnw(src, beg + 3U);
+  len = macro_i_name(&(src[beg]));
+  if (len == 0U){ goto fault_par; }
+  memcpy(&(hnd->rpn[0][0]), &(src[beg]), len);
+  hnd->rpn[0][len] = 0U;
+  def->pct = 1U;
+  beg = strpr_nextnw(src, beg + len);
+  lvl->ict = 0U;
+  if (!strpr_isend(src[beg])){
+   if (src[beg] != (uint8)(',')){ goto fault_par; }
+   lvl->ict = macro_i_args(&(src[beg + 1U]), lvl, MACRO_IRP);
+   if (lvl->ict > MACRO_IRP){ goto fault_irp; }
+  }
+
+  hnd->dct ++;
+  hnd->rec = hnd->dct;
+  hnd->rdp = hnd->dep;
+  hnd->rnd = 0U;
+  hnd->cnt ++;
+  return PARSER_END;
+
+ }else{}
+
+
+ /* Expansion of a defined macro */
+
+ if (hnd->dct == 0U){ return PARSER_OK; }
+ len = 0U;
+ while (strpr_issym(src[beg + len])){ len ++; }
+ if ((len == 0U) || (len >= SYMB_MAX)){ return PARSER_OK; }
+ mac = macro_i_find(hnd, &(src[beg]), len);
+ if (mac == (hnd->dct)){ return PARSER_OK; }
+ def = &(hnd->def[mac]);
+
+ if (hnd->dep == MACRO_DEP){ goto fault_dep; }
+ lvl = &(hnd->stk[hnd->dep]);
+
+ /* Parameters, then start it */
+
+ i = macro_i_args(&(src[beg + len]), lvl, def->pct);
+ if (i != (def->pct)){ goto fault_arg; }
+ lvl->ict = 1U;
+ macro_i_start(hnd, cst, mac, cof + beg);
+
+ return PARSER_END;
+
+
+fault_nam:
+
+ compst_setcoffrel(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Invalid macro name");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_def:
+
+ compst_setcoffrel(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Macro already defined");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_par:
+
+ compst_setcoffrel(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Malformed macro parameter list");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_pmx:
+
+ compst_setcoffrel(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Too many macro parameters (at most %u)", MACRO_PAR);
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_pdu:
+
+ compst_setcoffrel(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Duplicate macro parameter");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_mem:
+
+ compst_setcoffrel(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Not enough memory for macro");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_nom:
+
+ compst_setcoffrel(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "\'endm\' without \'macro\'");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_nor:
+
+ compst_setcoffrel(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "\'endr\' without \'rept\' or \'irp\'");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_cnk:
+
+ snprintf((char*)(&s[0]), 80U, "Repeat count is not known in the first pass");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_cnt:
+
+ snprintf((char*)(&s[0]), 80U, "Repeat count out of range (at most %u)", MACRO_REP);
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_irp:
+
+ compst_setcoffrel(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Malformed \'irp\' list (at most %u items)", MACRO_IRP);
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_dep:
+
+ compst_setcoffrel(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Macro expansions nested too deep (at most %u)", MACRO_DEP);
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_arg:
+
+ compst_setcoffrel(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Macro \'%s\' takes %u parameter(s)",
+          (char const*)(&(def->nam[0])), def->pct);
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+}
+
+
+
+/* Gets the next line of the running expansion into the compile state. When
+** an expansion ends, the location of the line which started it is restored
+** (the 'endr' for a repeat). Returns 0 for a line, 1 if no expansion runs
+** (the next line has to be read from the source), 2 on failure (fault
+** printed). */
+auint macro_read(macro_t* hnd, compst_t* cst)
+{
+ uint8        s[80];
+ uint8        lin[LINE_MAX];
+ macro_lvl_t* lvl;
+ macro_def_t const* def;
+ macro_lin_t const* lns;
+ macro_tok_t const* tok;
+ uint8 const* src;
+ auint        len;
+ auint        o;
+ auint        i;
+
+ while (hnd->dep != 0U){
+
+  lvl = &(hnd->stk[hnd->dep - 1U]);
+  def = &(hnd->def[lvl->mac]);
+
+  if ((lvl->pos < (def->lct)) && (lvl->itr < (lvl->ict))){
+
+   lns = &(hnd->lns[def->lbe + lvl->pos]);
+   lvl->pos ++;
+   compst_setfile(cst, &(lvl->efn[0]));
+   compst_setline(cst, lns->lin);
+
+   /* Join up the tokens */
+
+   o = 0U;
+   for (i = 0U; i < (lns->tct); i++){
+    tok = &(hnd->tok[lns->tbe + i]);
+    if       (tok->typ == MACRO_T_PAR){
+     len = tok->off;
+     if (def->knd == MACRO_K_IRP){ len += lvl->itr; }
+     src = &(lvl->arg[lvl->aof[len]]);
+     len = lvl->aln[len];
+    }else if (tok->typ == MACRO_T_LOC){
+     len = (auint)(snprintf((char*)(&s[0]), 80U, ".@%u.", lvl->num));
+     if ((o + len) >= LINE_MAX){ goto fault_lng; }
+     memcpy(&(lin[o]), &s[0], len);
+     o += len;
+     src = &(hnd->txt[tok->off]);
+     len = tok->len;
+    }else{
+     src = &(hnd->txt[tok->off]);
+     len = tok->len;
+    }
+    if ((o + len) >= LINE_MAX){ goto fault_lng; }
+    memcpy(&(lin[o]), src, len);
+    o += len;
+   }
+   lin[o] = 0U;
+
+   compst_setsstr(cst, &(lin[0]));
+   compst_setcoff(cst, 0U);
+   return 0U;
+  }
+
+  /* Next iteration of a repeat */
+
+  lvl->itr ++;
+  if (lvl->itr < (lvl->ict)){
+   macro_i_iter(hnd, lvl, hnd->dep);
+   continue;
+  }
+
+  /* Expansion over, back at the line starting it. A definition begun within
+  ** has to end within. A repeat's definition is dropped if it is the last
+  ** one (the memory is reused). */
+
+  if ((hnd->rec != 0U) && (hnd->rdp == hnd->dep)){
+   macro_i_unterm(hnd);
+   return 2U;
+  }
+  compst_setfile(cst, &(lvl->fil[0]));
+  compst_setline(cst, lvl->lin);
+  if ((def->knd != MACRO_K_MAC) && ((lvl->mac + 1U) == (hnd->dct))){
+   hnd->dct = lvl->mac;
+   hnd->lct = def->lbe;
+   hnd->tct = def->tbe;
+   hnd->xct = def->xbe;
+  }
+  hnd->dep --;
+ }
+
+ return 1U;
+
+
+fault_lng:
+
+ compst_setsstr(cst, (uint8 const*)(""));
+ snprintf((char*)(&s[0]), 80U, "Source line too long after macro expansion");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return 2U;
+}
+
+
+
+/* Checks whether a definition (or repeat) is being recorded. Returns nonzero
+** (TRUE) if so. */
+auint macro_isrec(macro_t* hnd)
+{
+ return (hnd->rec != 0U);
+}
+
+
+
+/* Checks at the end of a source file that no definition (or repeat) is left
+** open. Returns nonzero (TRUE) if one is, fault printed. */
+auint macro_chkend(macro_t* hnd)
+{
+ if (hnd->rec == 0U){ return 0U; }
+ macro_i_unterm(hnd);
+ return 1U;
+}
+
+
+
+/* Prints a note for each running expansion (innermost first) at the line
+** which started it, for faults met within. */
+void  macro_trace(macro_t* hnd)
+{
+ uint8        s[80];
+ macro_lvl_t const* lvl;
+ macro_def_t const* def;
+ fault_off_t  fof;
+ auint        i;
+
+ for (i = hnd->dep; i != 0U; i--){
+  lvl = &(hnd->stk[i - 1U]);
+  def = &(hnd->def[lvl->mac]);
+  if (def->knd == MACRO_K_MAC){
+   fof.fil = &(lvl->fil[0]);
+   fof.lin = lvl->lin;
+   fof.chr = lvl->chr;
+   snprintf((char*)(&s[0]), 80U, "In expansion of \'%s\' (depth %u)",
+            (char const*)(&(def->nam[0])), i);
+  }else{                 /* Repeats: at their beginning */
+   fof.fil = &(def->fil[0]);
+   fof.lin = def->lin;
+   fof.chr = 0U;
+   snprintf((char*)(&s[0]), 80U, "In iteration %u of \'%s\' (depth %u)",
+            lvl->itr + 1U, (char const*)(&(def->nam[0])), i);
+  }
+  fault_print(FAULT_NOTE, &s[0], &fof);
+ }
+}
+
+
+
+/* Returns the count of definitions, repeats and expansions since
+** initialization. The
+** include memoization and the fragments use it to tell whether an include
+** depended on macros. */
+auint macro_getcnt(macro_t* hnd)
+{
+ return hnd->cnt;
+}
@@ -0,0 +1,113 @@
+/**
+**  \file
+**  \brief     Macros
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Manages the 'macro' - 'endm' definitions of the first pass and their
+**  expansions. A definition is stored once, its body lines split up into
+**  tokens as they are recorded: text copied as-is, parameters (by index) and
+**  local labels (symbols beginning with '@'). An expansion then only joins up
+**  the tokens of each body line with the parameters substituted, and passes
+**  the lines on to the first pass in place of reading the source.
+**
+**  The lines of an expansion are reported by the body lines of the
+**  definition, with the file name extended by the macro name, the number of
+**  the expansion and its depth (so each expansion has its lines apart for
+**  the relaxation, see relax.h).
+**
+**  The 'rept' and 'irp' blocks (ending with 'endr') are recorded the same
+**  way, and expanded right at their end, replaying the tokens of the body
+**  for each iteration. Each iteration counts as an expansion.
+*/
+
+
+#ifndef MACRO_H
+#define MACRO_H
+
+
+#include "types.h"
+#include "symtab.h"
+
+
+/* Macro manager object structure */
+typedef struct macro_s macro_t;
+
+
+/* Maximal number of parameters of a macro */
+#define MACRO_PAR  16U
+
+/* Maximal depth of nested expansions (also counting repeats) */
+#define MACRO_DEP  16U
+
+/* Maximal number of items in the list of an 'irp' */
+#define MACRO_IRP  64U
+
+/* Maximal count of a 'rept' */
+#define MACRO_REP  65536U
+
+
+
+/* Creates a new macro manager. Returns NULL if it is not possible to
+** allocate it. The object has to be initialized before use. */
+macro_t* macro_new(void);
+
+
+/* Deletes a macro manager. */
+void  macro_delete(macro_t* hnd);
+
+
+/* Initializes or resets a macro manager for a new first pass (no macros
+** defined). */
+void  macro_init(macro_t* hnd);
+
+
+/* If a definition is being recorded, takes the current source line into it,
+** ending it on 'endm' ('endr' for a repeat, starting its expansion then).
+** Returns PARSER_OK if no definition is being recorded (the line has to be
+** processed), otherwise PARSER_END or PARSER_ERR. */
+auint macro_rec(macro_t* hnd, symtab_t* stb);
+
+
+/* Checks the current source line at the current position for a 'macro'
+** definition, a 'rept' or 'irp' block or an expansion of a defined macro,
+** starting it. Returns one of the defined PARSER return codes (defined in
+** types.h). */
+auint macro_proc(macro_t* hnd, symtab_t* stb);
+
+
+/* Gets the next line of the running expansion into the compile state. When
+** an expansion ends, the location of the line which started it is restored
+** (the 'endr' for a repeat). Returns 0 for a line, 1 if no expansion runs
+** (the next line has to be read from the source), 2 on failure (fault
+** printed). */
+auint macro_read(macro_t* hnd, compst_t* cst);
+
+
+/* Checks whether a definition (or repeat) is being recorded. Returns nonzero
+** (TRUE) if so. */
+auint macro_isrec(macro_t* hnd);
+
+
+/* Checks at the end of a source file that no definition (or repeat) is left
+** open. Returns nonzero (TRUE) if one is, fault printed. */
+auint macro_chkend(macro_t* hnd);
+
+
+/* Prints a note for each running expansion (innermost first) at the line
+** which started it, for faults met within. */
+void  macro_trace(macro_t* hnd);
+
+
+/* Returns the count of definitions, repeats and expansions since
+** initialization. The
+** include memoization and the fragments use it to tell whether an include
+** depended on macros. */
+auint macro_getcnt(macro_t* hnd);
+
+
+#endif
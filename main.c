@@ -10,21 +10,44 @@
 **
 **
 ** Short usage summary:
-** rrpgeasm [input.asm]
+** rrpgeasm [-c] [-O] [-o output] [-MD] [-MF deps.d] [-j threads] [input.asm]
+** rrpgeasm -b manifest [-j threads]
+** rrpgeasm --serve socket
 **
 ** If there is no input file, it will attempt to compile "main.asm" on the
-** current path. The output file name is always "app.rpa".
+** current path. The output file name is "app.rpa" unless specified by "-o".
+**
+** With "-c" a relocatable object file is written instead of an application
+** binary (by default "app.rpo"), to be linked by rrpgeld (see ldmain.c).
+**
+** With "-MD" a make style dependency file is also written listing every
+** source and binary include read during the compilation. Its name is
+** "app.d" unless specified by "-MF" (which also implies "-MD").
+**
+** With "-O" redundant instructions are removed by a peephole optimizer (see
+** peep.h), the branches of an application are optimized by its control
+** flow (see cflow.h), and its procedures not reachable are removed (see
+** reach.h), each change reported by a note. The includes are then assembled
+** in order, so "-j" has no effect with it.
+**
+** With "-j" the includes of the input are assembled ahead on a pool of
+** threads (by default the number of processors), merged in by the first pass
+** where possible (see frag.h). The output is the same as without it.
+**
+** With "-b" every project listed in the manifest is assembled on a pool of
+** threads ("-j" gives their count, by default the number of processors).
+**
+** With "--serve" it stays resident, answering assembly requests on the given
+** Unix domain socket (see serve.h).
 */
 
 
 
 #include "types.h"
-#include "symtab.h"
-#include "bindata.h"
-#include "firead.h"
-#include "pass1.h"
-#include "pass2.h"
-#include "pass3.h"
+#include "asmctx.h"
+#include "batch.h"
+#include "serve.h"
+#include "fault.h"
 #include "version.h"
 
 
@@ -40,14 +63,18 @@ static char const* main_copyrig = "License: 2013 - 2015, GNU GPLv3 (version 3 of
 int main(int argc, char** argv)
 {
  uint8      s[80];
- uint8      e[80];
- FILE*      fp;
- FILE*      of;
- compst_t*  cst = compst_getobj();
- section_t* sec = section_getobj();
- symtab_t*  stb = symtab_getobj();
- bindata_t* bdt = bindata_getobj();
+ asmctx_t*  ctx;
+ uint8 const* inf = (uint8 const*)("main.asm"); /* Input file */
+ uint8 const* dpf = NULL;                     /* Dependency file (if any) */
+ uint8 const* bmf = NULL;                     /* Batch manifest (if any) */
+ uint8 const* skf = NULL;                     /* Server socket (if any) */
+ uint8 const* ouf = NULL;                     /* Output file (if specified) */
+ auint      obj = 0U;                         /* Object output requested */
+ auint      opt = 0U;                         /* Peephole optimizer requested */
+ auint      thc = 0U;                         /* Thread count */
+ auint      par = 0U;                         /* Thread count given */
  auint      t;
+ int        i;
 
 
  /* Welcome message */
@@ -59,61 +86,110 @@ int main(int argc, char** argv)
  printf("%s", main_copyrig);
  printf("\n");
 
- /* Initialize */
+ /* Process command line */
+
+ for (i = 1; i < argc; i++){
+  if       (strcmp(argv[i], "-MD") == 0){
+   if (dpf == NULL){ dpf = (uint8 const*)("app.d"); }
+  }else if (strcmp(argv[i], "-MF") == 0){
+   i++;
+   if (i >= argc){ goto fault_arg; }
+   dpf = (uint8 const*)(argv[i]);
+  }else if (strcmp(argv[i], "-o") == 0){
+   i++;
+   if (i >= argc){ goto fault_aro; }
+   ouf = (uint8 const*)(argv[i]);
+  }else if (strcmp(argv[i], "-c") == 0){
+   obj = 1U;
+  }else if (strcmp(argv[i], "-O") == 0){
+   opt = 1U;
+  }else if (strcmp(argv[i], "-b") == 0){
+   i++;
+   if (i >= argc){ goto fault_arb; }
+   bmf = (uint8 const*)(argv[i]);
+  }else if (strcmp(argv[i], "--serve") == 0){
+   i++;
+   if (i >= argc){ goto fault_ars; }
+   skf = (uint8 const*)(argv[i]);
+  }else if (strcmp(argv[i], "-j") == 0){
+   i++;
+   if (i >= argc){ goto fault_arj; }
+   thc = (auint)(strtoul(argv[i], NULL, 10));
+   par = 1U;
+  }else{
+   inf = (uint8 const*)(argv[i]);
+  }
+ }
 
- compst_init(cst);
- section_init(sec);
- symtab_init(stb, sec, cst);
- bindata_init(bdt);
+ /* Server mode */
 
- /* Open source file */
+ if (skf != NULL){
+  if (serve_run(skf)){ goto fault_oth; }
+  return 0U;
+ }
 
- if (argc > 1){
-  if (firead_open((uint8 const*)(   argv[1]), cst, &fp)){ goto fault_oth; }
+ /* Batch mode */
+
+ if (bmf != NULL){
+  if (batch_run(bmf, thc)){ goto fault_oth; }
+  return 0U;
+ }
+
+ /* Assemble */
+
+ ctx = asmctx_new();
+ if (ctx == NULL){ goto fault_mem; }
+ if (asmctx_setpar(ctx, par, thc)){ asmctx_delete(ctx); goto fault_mem; }
+ if (asmctx_setpeep(ctx, opt)){ asmctx_delete(ctx); goto fault_mem; }
+ if (asmctx_setcflow(ctx, opt)){ asmctx_delete(ctx); goto fault_mem; }
+ asmctx_setreach(ctx, opt);
+ asmctx_setpipe(ctx, 1U);      /* Not fatal if it can not be turned on */
+ if (obj){
+  if (ouf == NULL){ ouf = (uint8 const*)("app.rpo"); }
+  t = asmctx_object(ctx, inf, ouf, dpf);
  }else{
-  if (firead_open((uint8 const*)("main.asm"), cst, &fp)){ goto fault_oth; }
+  if (ouf == NULL){ ouf = (uint8 const*)("app.rpa"); }
+  t = asmctx_assemble(ctx, inf, ouf, dpf);
  }
+ asmctx_delete(ctx);
+ if (t){ goto fault_oth; }
 
- /* Pass1 */
+ return 0U;
 
- printf("Compilation pass1\n");
- t = pass1_run(fp, stb, bdt);
- firead_close(fp);
- if (t){ goto fault_oth; }
+fault_arg:
 
- /* Pass2 */
+ snprintf((char*)(&s[0]), 80U, "Missing file name after \'-MF\'");
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
 
- printf("Compilation pass2\n");
- if (pass2_run(stb)){ goto fault_oth; }
+fault_aro:
 
- /* Pass3 */
+ snprintf((char*)(&s[0]), 80U, "Missing file name after \'-o\'");
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
 
- printf("Compilation pass3\n");
- of = fopen("app.rpa", "wb"); /* Open destination file */
- if (of == NULL){ goto fault_ofo; }
- if (pass3_run(of, stb, bdt)){ fclose(of); goto fault_oth; }
+fault_arb:
 
- /* Done, try to close file and be happy */
+ snprintf((char*)(&s[0]), 80U, "Missing manifest name after \'-b\'");
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
 
- printf("Compilation complete\n");
- if (fclose(of)){ goto fault_ofc; }
+fault_ars:
 
- return 0U;
+ snprintf((char*)(&s[0]), 80U, "Missing socket name after \'--serve\'");
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
 
-fault_ofc:
+fault_arj:
 
- strerror_r(errno, (char*)(&e[0]), 80U);
- e[79] = 0U;
- snprintf((char*)(&s[0]), 80U, "Failed to close \'app.rpa\': %s", (char const*)(&e[0]));
- fault_printat(FAULT_FAIL, &s[0], cst);
+ snprintf((char*)(&s[0]), 80U, "Missing thread count after \'-j\'");
+ fault_printgen(FAULT_FAIL, &s[0]);
  return 1U;
 
-fault_ofo:
+fault_mem:
 
- strerror_r(errno, (char*)(&e[0]), 80U);
- e[79] = 0U;
- snprintf((char*)(&s[0]), 80U, "Failed to open \'app.rpa\': %s", (char const*)(&e[0]));
- fault_printat(FAULT_FAIL, &s[0], cst);
+ snprintf((char*)(&s[0]), 80U, "Not enough memory for the assembler");
+ fault_printgen(FAULT_FAIL, &s[0]);
  return 1U;
 
 fault_oth:
@@ -0,0 +1,135 @@
+/**
+**  \file
+**  \brief     Relocatable object files
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  An object file holds the state of the assembly after the first pass: the
+**  contents of the sections, and the symbol table with the symbol usages
+**  (relocations) and the source locations for faults. The second and third
+**  passes may then be done by the linker over several objects.
+**
+**  See objfile.h for the format.
+*/
+
+
+#include "objfile.h"
+#include "fault.h"
+
+
+/* Identifier of object files */
+static uint8 const objfile_id[4] = {'R', 'P', 'O', '\n'};
+
+
+/* Sections moved when linking (placed after the earlier objects) */
+static auint const objfile_mov[SECT_CNT] = {1U, 1U, 0U, 0U, 1U, 0U};
+
+
+
+/* Writes an object file from the state of the assembly after the first
+** pass. Returns nonzero (TRUE) on failure (errno set, no fault printed). */
+auint objfile_write(symtab_t* stb, fprov_file_t* ofl)
+{
+ if (fprov_write(ofl, &objfile_id[0], 4U)){ return 1U; }
+ if (fprov_wru32(ofl, OBJFILE_VER)){ return 1U; }
+ if (section_objout(symtab_getsectob(stb), ofl)){ return 1U; }
+ if (symtab_objout(stb, ofl)){ return 1U; }
+ return 0U;
+}
+
+
+
+/* Reads an object file from the current position of 'ifl', adding it to the
+** state of a link (sections and symbol table) after the objects added
+** earlier. 'fnam' is the name of the object for faults. Returns nonzero
+** (TRUE) on failure, fault printed. */
+auint objfile_read(symtab_t* stb, fprov_file_t* ifl, uint8 const* fnam)
+{
+ section_t* sec = symtab_getsectob(stb);
+ auint      dlt[SECT_CNT];
+ auint      i;
+
+ /* Displacements: after the contents of earlier objects */
+
+ for (i = 0U; i < SECT_CNT; i++){
+  dlt[i] = 0U;
+  if (objfile_mov[i]){
+   section_setsect(sec, i);
+   dlt[i] = section_getsize(sec);
+  }
+ }
+
+ return objfile_readat(stb, ifl, fnam, &dlt[0]);
+}
+
+
+
+/* Reads an object file from the current position of 'ifl', adding it to the
+** sections and symbol table with its contents displaced by 'dlt' (for each
+** section). 'fnam' is the name of the object for faults. Returns nonzero
+** (TRUE) on failure, fault printed. */
+auint objfile_readat(symtab_t* stb, fprov_file_t* ifl, uint8 const* fnam,
+                     auint const* dlt)
+{
+ uint8      s[80];
+ uint8      e[80];
+ uint8      b[4];
+ section_t* sec = symtab_getsectob(stb);
+ compst_t*  cst = symtab_getcompst(stb);
+ auint      r;
+
+ compst_setfile(cst, fnam);
+
+ /* Identifier */
+
+ if (fprov_read(ifl, &b[0], 4U, &r)){ goto fault_red; }
+ if ((r != 4U) || (memcmp(&b[0], &objfile_id[0], 4U) != 0)){ goto fault_fmt; }
+ if (fprov_rdu32(ifl, &r)){ goto fault_red; }
+ if (r != OBJFILE_VER){ goto fault_ver; }
+
+ /* Contents */
+
+ r = section_objin(sec, ifl, dlt);
+ if (r == SECT_ERR_RD){ goto fault_red; }
+ if (r != SECT_ERR_OK){ goto fault_sec; }
+ r = symtab_objin(stb, ifl, dlt);
+ compst_setfile(cst, fnam);
+ if (r == 2U){ goto fault_red; }
+ if (r != 0U){ goto fault_oth; }
+
+ return 0U;
+
+fault_red:
+
+ strerror_r(errno, (char*)(&e[0]), 80U);
+ e[79] = 0U;
+ snprintf((char*)(&s[0]), 80U, "Unable to read object: %.56s", (char const*)(&e[0]));
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return 1U;
+
+fault_fmt:
+
+ snprintf((char*)(&s[0]), 80U, "Not an object file");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return 1U;
+
+fault_ver:
+
+ snprintf((char*)(&s[0]), 80U, "Unsupported object format version (%u)", r);
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return 1U;
+
+fault_sec:
+
+ snprintf((char*)(&s[0]), 80U, "Overlap or out of section encountered");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return 1U;
+
+fault_oth:
+
+ return 1U;
+}
@@ -0,0 +1,75 @@
+/**
+**  \file
+**  \brief     Relocatable object files
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  An object file holds the state of the assembly after the first pass: the
+**  contents of the sections, and the symbol table with the symbol usages
+**  (relocations) and the source locations for faults. The second and third
+**  passes may then be done by the linker over several objects.
+**
+**  Every symbol bound to a name is exported (there are no file scoped
+**  symbols), and names used but not bound in the object are imported. When
+**  linking, the code, data and zero sections of the objects are placed one
+**  after the other in the order of the objects (so 'org' within these
+**  sections is relative to the object's own part). The head and desc
+**  sections are not moved, they are combined as-is.
+**
+**  The format (all values are 32 bits big endian, strings are terminated):
+**
+**  - Identifier: "RPO\n" and the format version.
+**  - For the code, data, head, desc and zero sections: the size in words,
+**    then the runs of occupied words (offset, count of words and the words
+**    unless it is the zero section), terminated by 0xFFFFFFFF.
+**  - Symbol names: size of the name pool, then the pool.
+**  - Symbol definitions: count + 1, then for each the command, the two
+**    sources, the name bound (offset in the pool), and the location (file,
+**    line, character).
+**  - Symbol usages: count + 1, then for each the section, offset, data type,
+**    definition, and the location (file, line, character).
+*/
+
+
+#ifndef OBJFILE_H
+#define OBJFILE_H
+
+
+#include "types.h"
+#include "symtab.h"
+#include "fprov.h"
+
+
+/* Version of the object format */
+#define OBJFILE_VER  1U
+
+/* Mask of the sections relocated when linking (code, data and zero) */
+#define OBJFILE_REL  ((1U << SECT_CODE) | (1U << SECT_DATA) | (1U << SECT_ZERO))
+
+
+
+/* Writes an object file from the state of the assembly after the first
+** pass. Returns nonzero (TRUE) on failure (errno set, no fault printed). */
+auint objfile_write(symtab_t* stb, fprov_file_t* ofl);
+
+
+/* Reads an object file from the current position of 'ifl', adding it to the
+** state of a link (sections and symbol table) after the objects added
+** earlier. 'fnam' is the name of the object for faults. Returns nonzero
+** (TRUE) on failure, fault printed. */
+auint objfile_read(symtab_t* stb, fprov_file_t* ifl, uint8 const* fnam);
+
+
+/* Reads an object file from the current position of 'ifl', adding it to the
+** sections and symbol table with its contents displaced by 'dlt' (for each
+** section). 'fnam' is the name of the object for faults. Returns nonzero
+** (TRUE) on failure, fault printed. */
+auint objfile_readat(symtab_t* stb, fprov_file_t* ifl, uint8 const* fnam,
+                     auint const* dlt);
+
+
+#endif
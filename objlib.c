@@ -0,0 +1,400 @@
+/**
+**  \file
+**  \brief     Object libraries (archives)
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  An archive bundles object files along with an index of the symbols each
+**  of them defines, so a link only adds the members it needs.
+**
+**  See objlib.h for the format.
+*/
+
+
+#include "objlib.h"
+#include "objfile.h"
+#include "compst.h"
+#include "fault.h"
+
+
+/* Identifier of archives */
+static uint8 const objlib_id[4] = {'R', 'P', 'L', '\n'};
+
+
+/* Archive member */
+typedef struct{
+ uint8  nam[FILE_MAX];  /* Name of the member (the object it was made from) */
+ uint8* sym;            /* Names of symbols defined, each terminated */
+ auint  sln;            /* Size of the names */
+ auint  scn;            /* Count of names */
+ uint8* dat;            /* The object */
+ auint  len;            /* Size of the object */
+ auint  lnk;            /* Nonzero if already added to the link */
+}objlib_mem_t;
+
+/* Object library structure - definition */
+struct objlib_s{
+ objlib_mem_t* mem;     /* Members */
+ auint         cnt;     /* Count of members */
+ auint         siz;     /* Size of the member array */
+};
+
+
+
+/* Adds a new empty member to the library. Returns NULL on failure (errno
+** set). */
+static objlib_mem_t* objlib_i_newmem(objlib_t* hnd, uint8 const* nam)
+{
+ objlib_mem_t* t;
+ auint         siz;
+
+ if ((hnd->cnt) == (hnd->siz)){
+  siz = ((hnd->siz) == 0U) ? 16U : ((hnd->siz) << 1);
+  t = (objlib_mem_t*)(realloc(hnd->mem, sizeof(objlib_mem_t) * siz));
+  if (t == NULL){ errno = ENOMEM; return NULL; }
+  hnd->mem = t;
+  hnd->siz = siz;
+ }
+
+ t = &(hnd->mem[hnd->cnt]);
+ memset(t, 0U, sizeof(objlib_mem_t));
+ strncpy((char*)(&(t->nam[0])), (char const*)(nam), FILE_MAX - 1U);
+ hnd->cnt ++;
+
+ return t;
+}
+
+
+
+/* Appends a symbol name to the index of a member. Returns nonzero (TRUE) on
+** failure (errno set). */
+static auint objlib_i_addsym(objlib_mem_t* mem, uint8 const* nam)
+{
+ auint  len = strlen((char const*)(nam)) + 1U;
+ uint8* t;
+
+ t = (uint8*)(realloc(mem->sym, (mem->sln) + len));
+ if (t == NULL){ errno = ENOMEM; return 1U; }
+ mem->sym = t;
+ memcpy(&(mem->sym[mem->sln]), nam, len);
+ mem->sln += len;
+ mem->scn ++;
+
+ return 0U;
+}
+
+
+
+/* Set of the names used but not defined by the link, sorted for lookup */
+typedef struct{
+ uint8*         str;    /* The names, each terminated */
+ auint          sln;    /* Size of the names */
+ auint          ssz;    /* Size of the name buffer */
+ uint8 const**  lst;    /* Sorted list of the names (after objlib_i_undset()) */
+ auint          cnt;    /* Count of names */
+ auint          err;    /* Nonzero if collecting the names failed */
+}objlib_und_t;
+
+
+
+/* Collects an undefined name into the set (callback of symtab_undefs()). */
+static void objlib_i_undadd(void* ctx, uint8 const* nam)
+{
+ objlib_und_t* und = (objlib_und_t*)(ctx);
+ auint         len = strlen((char const*)(nam)) + 1U;
+ auint         siz;
+ uint8*        t;
+
+ if (und->err){ return; }
+ if (((und->sln) + len) > (und->ssz)){
+  siz = ((und->ssz) == 0U) ? 4096U : (und->ssz);
+  while (((und->sln) + len) > siz){ siz <<= 1; }
+  t = (uint8*)(realloc(und->str, siz));
+  if (t == NULL){ und->err = 1U; return; }
+  und->str = t;
+  und->ssz = siz;
+ }
+ memcpy(&(und->str[und->sln]), nam, len);
+ und->sln += len;
+ und->cnt ++;
+}
+
+
+
+/* Name comparator for sorting and searching the undefined names. */
+static int objlib_i_undcmp(void const* a, void const* b)
+{
+ return strcmp(*(char const* const*)(a), *(char const* const*)(b));
+}
+
+
+
+/* Builds the set of names used but not defined by the link in 'stb'. Returns
+** nonzero (TRUE) on failure (errno set). */
+static auint objlib_i_undset(objlib_und_t* und, symtab_t* stb)
+{
+ auint i;
+ auint p = 0U;
+
+ und->sln = 0U;
+ und->cnt = 0U;
+ und->err = 0U;
+ if (symtab_undefs(stb, &objlib_i_undadd, und)){ und->err = 1U; }
+ if (und->err){ errno = ENOMEM; return 1U; }
+
+ free(und->lst);
+ und->lst = (uint8 const**)(malloc(sizeof(uint8 const*) * ((und->cnt) + 1U)));
+ if (und->lst == NULL){ errno = ENOMEM; return 1U; }
+ for (i = 0U; i < (und->cnt); i++){
+  und->lst[i] = &(und->str[p]);
+  p += strlen((char const*)(&(und->str[p]))) + 1U;
+ }
+ qsort(und->lst, und->cnt, sizeof(uint8 const*), &objlib_i_undcmp);
+
+ return 0U;
+}
+
+
+
+/* Checks whether a member is needed by the link (defines a symbol in the set
+** of those used but not defined yet). Returns nonzero (TRUE) if so. */
+static auint objlib_i_needed(objlib_mem_t const* mem, objlib_und_t const* und)
+{
+ uint8 const* nam;
+ auint        p = 0U;
+
+ if ((und->cnt) == 0U){ return 0U; }
+
+ while (p < (mem->sln)){
+  nam = &(mem->sym[p]);
+  if (bsearch(&nam, und->lst, und->cnt, sizeof(uint8 const*), &objlib_i_undcmp) != NULL){ return 1U; }
+  p += strlen((char const*)(nam)) + 1U;
+ }
+
+ return 0U;
+}
+
+
+
+/* Creates a new (empty) object library. Returns NULL if it is not possible
+** to allocate it. */
+objlib_t* objlib_new(void)
+{
+ return (objlib_t*)(calloc(1U, sizeof(objlib_t)));
+}
+
+
+
+/* Deletes an object library. */
+void  objlib_delete(objlib_t* hnd)
+{
+ auint i;
+
+ if (hnd == NULL){ return; }
+ for (i = 0U; i < (hnd->cnt); i++){
+  free(hnd->mem[i].sym);
+  free(hnd->mem[i].dat);
+ }
+ free(hnd->mem);
+ free(hnd);
+}
+
+
+
+/* Adds an object to the library as a new member. The object file 'fnam' is
+** read through the provider, the names of the symbols it defines are taken
+** from 'stb' which should hold only this object. Returns nonzero (TRUE) on
+** failure (errno set, no fault printed). */
+auint objlib_add(objlib_t* hnd, uint8 const* fnam, fprov_t const* prv,
+                 symtab_t* stb)
+{
+ objlib_mem_t* mem;
+ fprov_file_t* fp;
+ uint8 const*  nam;
+ uint8*        t;
+ auint         siz = 4096U;
+ auint         pos = 0U;
+ auint         r;
+
+ mem = objlib_i_newmem(hnd, fnam);
+ if (mem == NULL){ return 1U; }
+
+ /* Index */
+
+ while (1){
+  nam = symtab_getbound(stb, &pos);
+  if (nam == NULL){ break; }
+  if (objlib_i_addsym(mem, nam)){ return 1U; }
+ }
+
+ /* The object itself */
+
+ mem->dat = (uint8*)(malloc(siz));
+ if (mem->dat == NULL){ errno = ENOMEM; return 1U; }
+ fp = fprov_open(prv, fnam, FPROV_M_RDB);
+ if (fp == NULL){ return 1U; }
+ while (1){
+  if (fprov_read(fp, &(mem->dat[mem->len]), siz - (mem->len), &r)){
+   fprov_close(fp);
+   return 1U;
+  }
+  mem->len += r;
+  if ((mem->len) != siz){ break; } /* End of file */
+  t = (uint8*)(realloc(mem->dat, siz << 1));
+  if (t == NULL){ fprov_close(fp); errno = ENOMEM; return 1U; }
+  mem->dat = t;
+  siz    <<= 1;
+ }
+ fprov_close(fp);              /* It was read only, don't care for errors */
+
+ return 0U;
+}
+
+
+
+/* Writes the library as an archive. Returns nonzero (TRUE) on failure (errno
+** set, no fault printed). */
+auint objlib_write(objlib_t* hnd, fprov_file_t* ofl)
+{
+ objlib_mem_t* mem;
+ auint         i;
+
+ if (fprov_write(ofl, &objlib_id[0], 4U)){ return 1U; }
+ if (fprov_wru32(ofl, OBJLIB_VER)){ return 1U; }
+ if (fprov_wru32(ofl, hnd->cnt)){ return 1U; }
+
+ for (i = 0U; i < (hnd->cnt); i++){
+  mem = &(hnd->mem[i]);
+  if (fprov_wrstr(ofl, &(mem->nam[0]))){ return 1U; }
+  if (fprov_wru32(ofl, mem->scn)){ return 1U; }
+  if (fprov_write(ofl, mem->sym, mem->sln)){ return 1U; }
+  if (fprov_wru32(ofl, mem->len)){ return 1U; }
+  if (fprov_write(ofl, mem->dat, mem->len)){ return 1U; }
+ }
+
+ return 0U;
+}
+
+
+
+/* Reads an archive into the (empty) library. Returns one of the OBJLIB_
+** results, no fault printed. */
+auint objlib_read(objlib_t* hnd, fprov_file_t* ifl)
+{
+ uint8         nam[LINE_MAX];
+ uint8         b[4];
+ objlib_mem_t* mem;
+ auint         cnt;
+ auint         scn;
+ auint         i;
+ auint         j;
+ auint         r;
+
+ if (fprov_read(ifl, &b[0], 4U, &r)){ return OBJLIB_ERR; }
+ if ((r != 4U) || (memcmp(&b[0], &objlib_id[0], 4U) != 0)){ return OBJLIB_NARC; }
+ if (fprov_rdu32(ifl, &r)){ return OBJLIB_ERR; }
+ if (r != OBJLIB_VER){ errno = EINVAL; return OBJLIB_ERR; }
+
+ if (fprov_rdu32(ifl, &cnt)){ return OBJLIB_ERR; }
+ for (i = 0U; i < cnt; i++){
+  if (fprov_rdstr(ifl, &nam[0], FILE_MAX)){ return OBJLIB_ERR; }
+  mem = objlib_i_newmem(hnd, &nam[0]);
+  if (mem == NULL){ return OBJLIB_ERR; }
+  if (fprov_rdu32(ifl, &scn)){ return OBJLIB_ERR; }
+  for (j = 0U; j < scn; j++){
+   if (fprov_rdstr(ifl, &nam[0], LINE_MAX)){ return OBJLIB_ERR; }
+   if (objlib_i_addsym(mem, &nam[0])){ return OBJLIB_ERR; }
+  }
+  if (fprov_rdu32(ifl, &(mem->len))){ return OBJLIB_ERR; }
+  mem->dat = (uint8*)(malloc((mem->len) + 1U));
+  if (mem->dat == NULL){ errno = ENOMEM; return OBJLIB_ERR; }
+  if (fprov_read(ifl, mem->dat, mem->len, &r)){ return OBJLIB_ERR; }
+  if (r != (mem->len)){ errno = EIO; return OBJLIB_ERR; }
+ }
+
+ return OBJLIB_OK;
+}
+
+
+
+/* Adds the members of the library needed by the link in 'stb' (defining
+** symbols which are used but not defined). Members are only added once, and
+** in their order within the archive. 'fnam' is the name of the archive for
+** faults. The count of members added is added to 'cnt'. Returns nonzero
+** (TRUE) on failure, fault printed. */
+auint objlib_pull(objlib_t* hnd, symtab_t* stb, uint8 const* fnam, auint* cnt)
+{
+ uint8         s[80];
+ uint8         mnm[FILE_MAX];
+ objlib_mem_t* mem;
+ fprov_mfile_t mfl;
+ fprov_mem_t   mct;
+ fprov_t       prv;
+ fprov_file_t* fp;
+ objlib_und_t  und;
+ auint         n;
+ auint         i;
+ auint         t;
+
+ mct.fil = &mfl;
+ mct.cnt = 1U;
+ mct.fbk = NULL;
+ fprov_initmem(&prv, &mct);
+ memset(&und, 0U, sizeof(und));
+
+ /* The set of undefined names is built once, and only rebuilt after adding
+ ** a member (which may define some and use new ones), so checking the index
+ ** of each member is a lookup. */
+
+ if (objlib_i_undset(&und, stb)){ goto fault_mem; }
+
+ do{
+
+  n = 0U;
+
+  for (i = 0U; i < (hnd->cnt); i++){
+
+   mem = &(hnd->mem[i]);
+   if (mem->lnk){ continue; }
+   if (!objlib_i_needed(mem, &und)){ continue; }
+
+   snprintf((char*)(&mnm[0]), FILE_MAX, "%.38s(%.38s)", (char const*)(fnam), (char const*)(&(mem->nam[0])));
+   mfl.nam = &mnm[0];
+   mfl.dat = mem->dat;
+   mfl.len = mem->len;
+   mfl.wct = 0U;
+   fp = fprov_open(&prv, &mnm[0], FPROV_M_RDB);
+   if (fp == NULL){ goto fault_mem; }
+   t = objfile_read(stb, fp, &mnm[0]);
+   fprov_close(fp);
+   if (t){ goto fault_oth; }
+
+   mem->lnk = 1U;
+   n ++;
+   (*cnt) ++;
+
+   if (objlib_i_undset(&und, stb)){ goto fault_mem; }
+
+  }
+
+ }while (n != 0U);
+
+ free(und.str);
+ free(und.lst);
+ return 0U;
+
+fault_mem:
+
+ snprintf((char*)(&s[0]), 80U, "Not enough memory for the archive member");
+ fault_printat(FAULT_FAIL, &s[0], symtab_getcompst(stb));
+
+fault_oth:
+
+ free(und.str);
+ free(und.lst);
+ return 1U;
+}
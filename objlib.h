@@ -0,0 +1,86 @@
+/**
+**  \file
+**  \brief     Object libraries (archives)
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  An archive bundles object files (see objfile.h) along with an index of
+**  the symbols each of them defines. When linking, a member of an archive is
+**  only added if it defines a symbol which is used but not defined by the
+**  objects added so far. As the members added may use further symbols, this
+**  is repeated until no more members are needed.
+**
+**  The format (all values are 32 bits big endian, strings are terminated):
+**
+**  - Identifier: "RPL\n" and the format version.
+**  - Count of members.
+**  - For each member: its name, the count of symbols it defines followed by
+**    their names, then the size of the object and the object itself.
+*/
+
+
+#ifndef OBJLIB_H
+#define OBJLIB_H
+
+
+#include "types.h"
+#include "symtab.h"
+#include "fprov.h"
+
+
+/* Object library structure */
+typedef struct objlib_s objlib_t;
+
+
+/* Version of the archive format */
+#define OBJLIB_VER  1U
+
+/* Results of objlib_read(): Success */
+#define OBJLIB_OK   0U
+/* Results of objlib_read(): Failed to read or malformed (errno set) */
+#define OBJLIB_ERR  1U
+/* Results of objlib_read(): Not an archive */
+#define OBJLIB_NARC 2U
+
+
+
+/* Creates a new (empty) object library. Returns NULL if it is not possible
+** to allocate it. */
+objlib_t* objlib_new(void);
+
+
+/* Deletes an object library. */
+void  objlib_delete(objlib_t* hnd);
+
+
+/* Adds an object to the library as a new member. The object file 'fnam' is
+** read through the provider, the names of the symbols it defines are taken
+** from 'stb' which should hold only this object. Returns nonzero (TRUE) on
+** failure (errno set, no fault printed). */
+auint objlib_add(objlib_t* hnd, uint8 const* fnam, fprov_t const* prv,
+                 symtab_t* stb);
+
+
+/* Writes the library as an archive. Returns nonzero (TRUE) on failure (errno
+** set, no fault printed). */
+auint objlib_write(objlib_t* hnd, fprov_file_t* ofl);
+
+
+/* Reads an archive into the (empty) library. Returns one of the OBJLIB_
+** results, no fault printed. */
+auint objlib_read(objlib_t* hnd, fprov_file_t* ifl);
+
+
+/* Adds the members of the library needed by the link in 'stb' (defining
+** symbols which are used but not defined). Members are only added once, and
+** in their order within the archive. 'fnam' is the name of the archive for
+** faults. The count of members added is added to 'cnt'. Returns nonzero
+** (TRUE) on failure, fault printed. */
+auint objlib_pull(objlib_t* hnd, symtab_t* stb, uint8 const* fnam, auint* cnt);
+
+
+#endif
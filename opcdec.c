@@ -560,6 +560,10 @@ auint opcdec_proc(symtab_t* stb, opcdec_ds_t* ods)
 
   r = opcdec_dec(stb, ods, OPCDEC_I_JMS);
 
+ }else if (compst_issymequ(NULL, &(src[beg]), (uint8 const*)("jmp"))){
+
+  r = opcdec_dec(stb, ods, OPCDEC_I_JMP);
+
  }else if (compst_issymequ(NULL, &(src[beg]), (uint8 const*)("jsv"))){
 
   r = opcdec_dec(stb, ods, OPCDEC_I_JSV);
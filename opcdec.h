@@ -80,6 +80,8 @@ typedef struct{
 #define OPCDEC_I_PSH   14U
 /* POP */
 #define OPCDEC_I_POP   15U
+/* JMP: relaxable jump, JMS or JMA */
+#define OPCDEC_I_JMP   16U
 
 
 /* Operand and parameter formatting */
@@ -14,6 +14,8 @@
 #include "opcdec.h"
 #include "fault.h"
 #include "valwr.h"
+#include "peep.h"
+#include "cflow.h"
 
 
 
@@ -32,12 +34,70 @@ static auint opcpr_pushw(symtab_t* stb, auint opv)
 
 
 
+/* Writes an operand value at 'off' by the given usage (as defined in
+** valwr.h), registering a symbol usage if the operand is a symbol. Relative
+** usages of constant targets are also left for the second pass (by an
+** anonymous symbol definition holding the target), so the code remains
+** relocatable. May emit fault. Returns nonzero (TRUE) on success. */
+static auint opcpr_wrval(symtab_t* stb, auint opv, auint off, auint use)
+{
+ section_t*   sec = symtab_getsectob(stb);
+ compst_t*    cst = symtab_getcompst(stb);
+ auint  def;
+
+ if ((opv & OPCDEC_O_SYM) != 0U){
+  if (symtab_use(stb, opv & 0xFFFFFFU, off, use)){ return 0U; }
+ }else if ( (use == VALWR_R16) ||
+            (use == VALWR_R10) ||
+            (use == VALWR_J10) ||
+            (use == VALWR_R7) ){
+  def = symtab_addsymdef(stb, SYMTAB_CMD_MOV, opv & 0xFFFFU, NULL, 0U, NULL);
+  if (def == 0U){ return 0U; }
+  if (symtab_use(stb, def, off, use)){ return 0U; }
+ }else{
+  if (valwr_writecs(sec, opv & 0xFFFFU, off, use, cst)){ return 0U; }
+ }
+ return 1U;
+}
+
+
+
+/* Applies the relaxation (see relax.h) of a symbolic immediate operand in
+** 'opv' to be written by 'use' (VALWR_X16, VALWR_M16 or VALWR_P16) for the
+** instruction at 'off'. If an earlier round found its value fitting a
+** shorter form, the value is substituted in 'opv', so the shorter form gets
+** encoded, and a check is registered to fail if the value changes. May emit
+** fault. Returns nonzero (TRUE) on success. */
+static auint opcpr_relaxed(symtab_t* stb, auint* opv, auint off, auint use)
+{
+ compst_t*    cst = symtab_getcompst(stb);
+ relax_t*     rlx = symtab_getrlx(stb);
+ auint  def;
+ auint  val;
+
+ if ( (((*opv) & OPCDEC_O_SYM) == 0U) || (rlx == NULL) ){ return 1U; }
+ if (relax_get(rlx, compst_getfile(cst), compst_getline(cst), &val) != RELAX_SHORT){ return 1U; }
+ if (valwr_isshort(use, val) == 0U){ return 1U; }
+
+ def = symtab_addsymdef(stb, SYMTAB_CMD_SUB | SYMTAB_CMD_S0I,
+                        (*opv) & 0xFFFFFFU, NULL, val, NULL);
+ if (def == 0U){ return 0U; }
+ if (symtab_use(stb, def, off, VALWR_CHK)){ return 0U; }
+
+ *opv = ((*opv) & (~(OPCDEC_O_SYM | 0xFFFFFFU))) | val;
+ return 1U;
+}
+
+
+
 /* Write out address by the passed opcode field. It only alters the addressing
 ** mode bits of the first opcode word (must be pushed beforehands), and will
 ** encode the second as a NOP if necessary. The "use" parameter selects the
-** usage of the immediate encoded, can be VALWR_A16 or VALWR_R16. Works around
-** symbols if necessary, appropriately. May emit fault. Returns nonzero (TRUE)
-** on success. */
+** usage of the immediate encoded, can be VALWR_A16, VALWR_R16, or one of the
+** relaxable usages (VALWR_X16, VALWR_M16 or VALWR_P16, see valwr.h) for
+** symbolic immediates which may have shorter forms. Works around symbols if
+** necessary, appropriately. May emit fault. Returns nonzero (TRUE) on
+** success. */
 static auint opcpr_addr(symtab_t* stb, auint opv, auint use)
 {
  section_t*   sec = symtab_getsectob(stb);
@@ -52,6 +112,19 @@ static auint opcpr_addr(symtab_t* stb, auint opv, auint use)
   return 0U;
  }
 
+ /* Relaxable usages: only immediates have the special forms, stack space
+ ** only has the short form, others have none. */
+
+ if ( (use == VALWR_X16) ||
+      (use == VALWR_M16) ||
+      (use == VALWR_P16) ){
+  if      (adr == 0x20U){ }
+  else if (adr == 0x2CU){ use = VALWR_X16; }
+  else                  { use = VALWR_A16; }
+  if ( (use != VALWR_A16) &&
+       (opcpr_relaxed(stb, &opv, off, use) == 0U) ){ return 0U; }
+ }
+
  /* Check for short forms and encode those */
 
  if ( (adr == 0x20U) ||         /* Immediate */
@@ -78,12 +151,7 @@ static auint opcpr_addr(symtab_t* stb, auint opv, auint use)
 
  section_setw(sec, off, adr);
  if (opcpr_pushw(stb, 0xC000U) == 0U){ return 0U; } /* Prepare second NOP word */
- if ((opv & OPCDEC_O_SYM) != 0U){
-  if (symtab_use(stb, opv & 0xFFFFFFU, off, use)){ return 0U; }
- }else{
-  if (valwr_writecs(sec, opv & 0xFFFFU, off, use, cst)){ return 0U; }
- }
- return 1U;                     /* Successfully encoded it */
+ return opcpr_wrval(stb, opv, off, use);
 }
 
 
@@ -158,7 +226,7 @@ static auint opcpr_eops(symtab_t* stb, opcdec_ds_t* ods, auint swp)
  /* Encode */
 
  section_setw(sec, off, ((reg >> OPCDEC_S_ADR) & 0x7U) << 6); /* Add the register */
- return opcpr_addr(stb, adr, VALWR_A16);
+ return opcpr_addr(stb, adr, VALWR_X16);
 }
 
 
@@ -227,7 +295,7 @@ static auint opcpr_irb(symtab_t* stb, opcdec_ds_t* ods)
 
  /* First operand is the address */
 
- return opcpr_addr(stb, ods->op[0], VALWR_A16);
+ return opcpr_addr(stb, ods->op[0], VALWR_X16);
 }
 
 
@@ -268,39 +336,8 @@ static auint opcpr_inop(symtab_t* stb, opcdec_ds_t* ods)
 
 
 
-/* MOV rx, imx table for 0000 011r rrpq iiii */
-static const uint16 opcpr_mov_tb0[64] = {
- 0x0280U, 0xFF0FU, 0xF0FFU, 0x0180U, 0x0300U, 0x01C0U, 0x0F00U, 0x0118U,
- 0x0140U, 0x0168U, 0x0190U, 0x01B8U, 0x01E0U, 0x0208U, 0x0230U, 0x0258U,
- 0x0010U, 0x0011U, 0x0012U, 0x0013U, 0x0014U, 0x0015U, 0x0016U, 0x0017U,
- 0x0018U, 0x0019U, 0x001AU, 0x001BU, 0x001CU, 0x001DU, 0x001EU, 0x001FU,
- 0x0020U, 0x0021U, 0x0022U, 0x0023U, 0x0024U, 0x0025U, 0x0026U, 0x0027U,
- 0x0028U, 0x0029U, 0x002AU, 0x002BU, 0x002CU, 0x002DU, 0x002EU, 0x002FU,
- 0x0030U, 0x0031U, 0x0032U, 0x0033U, 0x0034U, 0x0035U, 0x0036U, 0x0037U,
- 0x0038U, 0x0039U, 0x003AU, 0x003BU, 0x003CU, 0x003DU, 0x003EU, 0x003FU};
-/* MOV rx, imx table for 0100 011r rrpq iiii */
-static const uint16 opcpr_mov_tb1[64] = {
- 0x0040U, 0x0041U, 0x0042U, 0x0043U, 0x0044U, 0x0045U, 0x0046U, 0x0047U,
- 0x0048U, 0x0049U, 0x004AU, 0x004BU, 0x004CU, 0x004DU, 0x004EU, 0x004FU,
- 0x0050U, 0x0051U, 0x0052U, 0x0053U, 0x0054U, 0x0055U, 0x0056U, 0x0057U,
- 0x0058U, 0x0059U, 0x005AU, 0x005BU, 0x005CU, 0x005DU, 0x005EU, 0x005FU,
- 0x0060U, 0x0061U, 0x0062U, 0x0063U, 0x0064U, 0x0065U, 0x0066U, 0x0067U,
- 0x0068U, 0x0069U, 0x006AU, 0x006BU, 0x006CU, 0x006DU, 0x006EU, 0x006FU,
- 0x0070U, 0x0071U, 0x0072U, 0x0073U, 0x0074U, 0x0075U, 0x0076U, 0x0077U,
- 0x0078U, 0x0079U, 0x007AU, 0x007BU, 0x007CU, 0x007DU, 0x007EU, 0x007FU};
-/* MOV rx, imx table for 1100 011r rrpq iiii */
-static const uint16 opcpr_mov_tb2[64] = {
- 0x0080U, 0x0088U, 0x0090U, 0x0098U, 0x0010U, 0x0020U, 0x0040U, 0x0080U,
- 0x0100U, 0x0200U, 0x0400U, 0x0800U, 0x1000U, 0x2000U, 0x4000U, 0x8000U,
- 0x00A0U, 0x00A8U, 0x00B0U, 0x00B8U, 0xFFEFU, 0xFFDFU, 0xFFBFU, 0xFF7FU,
- 0xFEFFU, 0xFDFFU, 0xFBFFU, 0xF7FFU, 0xEFFFU, 0xDFFFU, 0xBFFFU, 0x7FFFU,
- 0x00C0U, 0x00C8U, 0x00D0U, 0x00D8U, 0xFFE0U, 0xFFC0U, 0xFF80U, 0xFF00U,
- 0xFE00U, 0xFC00U, 0xF800U, 0xF000U, 0xE000U, 0xC000U, 0x8000U, 0x0000U,
- 0x00E0U, 0x00E8U, 0x00F0U, 0x00F8U, 0x001FU, 0x003FU, 0x007FU, 0x00FFU,
- 0x01FFU, 0x03FFU, 0x07FFU, 0x0FFFU, 0x1FFFU, 0x3FFFU, 0x7FFFU, 0xFFFFU};
-
-/* Encode MOV. Many special cases. May produce fault. Returns nonzero (TRUE)
-** on success. */
+/* Encode MOV. Many special cases (the MOV rx, imx forms are provided by
+** valwr_movimx()). May produce fault. Returns nonzero (TRUE) on success. */
 static auint opcpr_imov(symtab_t* stb, opcdec_ds_t* ods)
 {
  section_t*   sec = symtab_getsectob(stb);
@@ -309,7 +346,6 @@ static auint opcpr_imov(symtab_t* stb, opcdec_ds_t* ods)
  auint  reg;
  auint  adr;
  auint  v;
- auint  i;
 
  /* Check count of parameters and operands */
 
@@ -361,48 +397,33 @@ static auint opcpr_imov(symtab_t* stb, opcdec_ds_t* ods)
 
  if (((reg >> OPCDEC_S_ADR) & 0x38U) == 0x30U){        /* Normal reg. */
 
+  if (((adr >> OPCDEC_S_ADR) & 0x3FU) == 0x20U){        /* Immediate */
+   if (opcpr_relaxed(stb, &adr, off, VALWR_M16) == 0U){ return 0U; }
+  }
+
   if ( (((adr >> OPCDEC_S_ADR) & 0x38U) == 0x20U) &&   /* Immediate: specials here */
        ((adr & OPCDEC_O_SYM) == 0U) ){                 /* Only if not symbol (so value present) */
 
-   v = adr & 0xFFFFU;              /* Value to encode */
-
-   if (v >= 0xFFF0U){              /* NOT rx, adr */
-    section_setw(sec, off, 0x2000U | (((reg >> OPCDEC_S_ADR) & 0x7U) << 6) | (~v));
+   v = valwr_movimx(adr & 0xFFFFU);
+   if (v != 0U){
+    section_setw(sec, off, v | (((reg >> OPCDEC_S_ADR) & 0x7U) << 6));
     return 1U;
    }
 
-   for (i = 0U; i < 64U; i++){     /* MOV rx, imx (0000) */
-    if (v == opcpr_mov_tb0[i]){
-     section_setw(sec, off, 0x0600U | (((reg >> OPCDEC_S_ADR) & 0x7U) << 6) | i);
-     return 1U;
-    }
-   }
-
-   for (i = 0U; i < 64U; i++){     /* MOV rx, imx (0100) */
-    if (v == opcpr_mov_tb1[i]){
-     section_setw(sec, off, 0x4600U | (((reg >> OPCDEC_S_ADR) & 0x7U) << 6) | i);
-     return 1U;
-    }
-   }
-
-   for (i = 0U; i < 64U; i++){     /* MOV rx, imx (1100) */
-    if (v == opcpr_mov_tb2[i]){
-     section_setw(sec, off, 0x8600U | (((reg >> OPCDEC_S_ADR) & 0x7U) << 6) | i);
-     return 1U;
-    }
-   }
-
   }
 
   /* Encode ordinary MOV */
 
   section_setw(sec, off, 0x0000U | (((reg >> OPCDEC_S_ADR) & 0x7U) << 6));
-  return opcpr_addr(stb, adr, VALWR_A16);
+  return opcpr_addr(stb, adr, VALWR_M16);
  }
 
  /* Special register MOVs */
 
  if ((reg & (OPCDEC_E_SP)) != 0U){
+  if (((adr >> OPCDEC_S_ADR) & 0x3FU) == 0x20U){       /* Immediate */
+   if (opcpr_relaxed(stb, &adr, off, VALWR_P16) == 0U){ return 0U; }
+  }
   if ( (((adr >> OPCDEC_S_ADR) & 0x38U) == 0x20U) &&   /* Immediate: specials here */
        ((adr & OPCDEC_O_SYM) == 0U) ){                 /* Only if not symbol (so value present) */
    v = adr & 0xFFFFU;
@@ -415,13 +436,13 @@ static auint opcpr_imov(symtab_t* stb, opcdec_ds_t* ods)
 
  if ((reg & (OPCDEC_E_SP | OPCDEC_E_XM | OPCDEC_E_XB)) != 0U){
   section_setw(sec, off, 0x8000U | ((reg & 0x7U) << 6));
-  return opcpr_addr(stb, adr, VALWR_A16);
+  return opcpr_addr(stb, adr, ((reg & (OPCDEC_E_SP)) != 0U) ? VALWR_P16 : VALWR_X16);
  }
 
  if ((reg & (OPCDEC_E_XM0 | OPCDEC_E_XM1 | OPCDEC_E_XM2 | OPCDEC_E_XM3 |
              OPCDEC_E_XB0 | OPCDEC_E_XB1 | OPCDEC_E_XB2 | OPCDEC_E_XB3)) != 0U){
   section_setw(sec, off, 0x4000U | ((reg & 0x7U) << 6));
-  return opcpr_addr(stb, adr, VALWR_A16);
+  return opcpr_addr(stb, adr, VALWR_X16);
  }
 
  fault_printat(FAULT_FAIL, (uint8 const*)("Invalid MOV"), cst);
@@ -454,12 +475,7 @@ static auint opcpr_ijms(symtab_t* stb, opcdec_ds_t* ods)
  /* Encode */
 
  if (opcpr_pushw(stb, 0x8C00U) == 0U){ return 0U; }
- if ((opv & OPCDEC_O_SYM) != 0U){
-  if (symtab_use(stb, opv & 0xFFFFFFU, off, VALWR_R10)){ return 0U; }
- }else{
-  if (valwr_writecs(sec, opv & 0xFFFFU, off, VALWR_R10, cst)){ return 0U; }
- }
- return 1U;
+ return opcpr_wrval(stb, opv, off, VALWR_R10);
 }
 
 
@@ -496,12 +512,7 @@ static auint opcpr_ijnz(symtab_t* stb, opcdec_ds_t* ods)
  /* Encode */
 
  if (opcpr_pushw(stb, 0x8800U | (((op0 >> OPCDEC_S_ADR) & 0x7U) << 6)) == 0U){ return 0U; }
- if ((op1 & OPCDEC_O_SYM) != 0U){
-  if (symtab_use(stb, op1 & 0xFFFFFFU, off, VALWR_R7)){ return 0U; }
- }else{
-  if (valwr_writecs(sec, op1 & 0xFFFFU, off, VALWR_R7, cst)){ return 0U; }
- }
- return 1U;
+ return opcpr_wrval(stb, op1, off, VALWR_R7);
 }
 
 
@@ -557,6 +568,45 @@ static auint opcpr_ijma(symtab_t* stb, opcdec_ds_t* ods)
 
 
 
+/* Encode JMP: a relaxable jump. It is encoded as a JMS unless the jump
+** relaxation tells its target was out of range (then it is a JMA). Targets
+** in the first 16 words and operands other than immediates always get a JMA
+** (the first being just as short). May produce fault. Returns nonzero (TRUE)
+** on success. */
+static auint opcpr_ijmx(symtab_t* stb, opcdec_ds_t* ods)
+{
+ section_t*   sec = symtab_getsectob(stb);
+ compst_t*    cst = symtab_getcompst(stb);
+ relax_t*     rlx = symtab_getrlx(stb);
+ auint  off = section_getoffw(sec);
+ auint  opv = (ods->op[0]);
+ auint  val;
+
+ /* Check count of parameters and operands */
+
+ if (opcpr_nofunc(stb, ods) == 0U){ return 0U; }
+ if (opcpr_opcount(stb, ods, 1U) == 0U){ return 0U; }
+ if (opcpr_nocy(stb, ods) == 0U){ return 0U; }
+
+ /* Long form (JMA) where necessary */
+
+ if ( (((opv >> OPCDEC_S_ADR) & 0x38U) != 0x20U) ||
+      ( ((opv & OPCDEC_O_SYM) == 0U) &&
+        ((opv & 0xFFFFU) < 0x10U) ) ||
+      ( (rlx != NULL) &&
+        (relax_get(rlx, compst_getfile(cst), compst_getline(cst), &val) == RELAX_LONG) ) ){
+  if (opcpr_pushw(stb, 0x8500U) == 0U){ return 0U; }
+  return opcpr_addr(stb, opv, VALWR_A16);
+ }
+
+ /* Short form (JMS) */
+
+ if (opcpr_pushw(stb, 0x8C00U) == 0U){ return 0U; }
+ return opcpr_wrval(stb, opv, off, VALWR_J10);
+}
+
+
+
 /* Encode parameter list of a function. The opcode must be set up already,
 ** with off pointing at it. Returns nonzero (TRUE) on success. */
 static auint opcpr_fnpar(symtab_t* stb, opcdec_ds_t* ods, auint off)
@@ -699,7 +749,7 @@ static auint opcpr_irfn(symtab_t* stb, opcdec_ds_t* ods)
  if (((ods->id) & OPCDEC_I_C) != 0U){
   section_setw(sec, off, 0x0040U);
  }
- return opcpr_addr(stb, ods->op[1], VALWR_A16);
+ return opcpr_addr(stb, ods->op[1], VALWR_X16);
 }
 
 
@@ -754,7 +804,7 @@ static auint opcpr_ixxx(symtab_t* stb, opcdec_ds_t* ods, auint msk0, auint msk1,
 
  /* Add address operand */
 
- return opcpr_addr(stb, adr, VALWR_A16);
+ return opcpr_addr(stb, adr, VALWR_X16);
 }
 
 
@@ -868,18 +918,28 @@ static auint opcpr_ipop(symtab_t* stb, opcdec_ds_t* ods)
 ** source line of the compile state. It uses the offset in the current section
 ** to write into the passed code memory block, and increments the offset
 ** afterwards. While processing it also deals with any symbol or literal
-** encountered, encodes them or submits them to pass2 as needed. Generates and
-** outputs faults where necessary. Returns one of the defined PARSER return
-** codes (defined in types.h). */
+** encountered, encodes them or submits them to pass2 as needed. If the symbol
+** table carries a peephole optimizer (see peep.h), the instruction is passed
+** to it first, and it is not encoded if found redundant. Branches are
+** recorded in the control flow optimizer (see cflow.h) if any is carried.
+** Generates and outputs faults where necessary. Returns one of the defined
+** PARSER return codes (defined in types.h). */
 auint opcpr_proc(symtab_t* stb)
 {
  opcdec_ds_t ods;
+ peep_t*     pep = symtab_getpeep(stb);
+ cflow_t*    cfl = symtab_getcflow(stb);
+ auint       off = section_getoffw(symtab_getsectob(stb));
  auint       r = 1U;
 
  if (opcdec_proc(stb, &ods) == 0){
   return PARSER_ERR;
  }
 
+ if ((pep != NULL) && (peep_ins(pep, stb, &ods) != 0U)){
+  return PARSER_END;     /* Removed by the peephole optimizer */
+ }
+
  if       ((ods.id & OPCDEC_I_R) != 0U){
   r = opcpr_ir (stb, &ods);
  }else if ((ods.id & OPCDEC_I_RB) != 0U){
@@ -903,10 +963,13 @@ auint opcpr_proc(symtab_t* stb)
    case OPCDEC_I_JNZ: r = opcpr_ijnz(stb, &ods); break;
    case OPCDEC_I_PSH: r = opcpr_ipsh(stb, &ods); break;
    case OPCDEC_I_POP: r = opcpr_ipop(stb, &ods); break;
+   case OPCDEC_I_JMP: r = opcpr_ijmx(stb, &ods); break;
    default: break;
   }
  }
 
- if (r){ return PARSER_END; }
- else  { return PARSER_ERR; }
+ if (r == 0U){ return PARSER_ERR; }
+ if (pep != NULL){ peep_done(pep, stb); }
+ if ((cfl != NULL) && (cflow_ins(cfl, stb, &ods, off) != 0U)){ return PARSER_ERR; }
+ return PARSER_END;
 }
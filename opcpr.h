@@ -22,9 +22,12 @@
 ** source line of the compile state. It uses the offset in the current section
 ** to write into the passed code memory block, and increments the offset
 ** afterwards. While processing it also deals with any symbol or literal
-** encountered, encodes them or submits them to pass2 as needed. Generates and
-** outputs faults where necessary. Returns one of the defined PARSER return
-** codes (defined in types.h). */
+** encountered, encodes them or submits them to pass2 as needed. If the symbol
+** table carries a peephole optimizer (see peep.h), the instruction is passed
+** to it first, and it is not encoded if found redundant. Branches are
+** recorded in the control flow optimizer (see cflow.h) if any is carried.
+** Generates and outputs faults where necessary. Returns one of the defined
+** PARSER return codes (defined in types.h). */
 auint opcpr_proc(symtab_t* stb);
 
 
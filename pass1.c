@@ -17,53 +17,153 @@
 #include "litpr.h"
 #include "opcpr.h"
 #include "firead.h"
-#include "incstk.h"
+#include "macro.h"
+#include "cond.h"
+#include "tabgen.h"
+#include "reach.h"
 
 
 
-/* Number of distinct includes possible */
-#define INC_MAX  256U
+/* Unwinds include stack closing all files except bottommost, for fault
+** handlers */
+static void pass1_stkunw(incstk_t* ist, compst_t* hnd, fprov_file_t* cf)
+{
+ fprov_file_t* pf = cf;
+ while (!incstk_pop(ist, hnd, &cf)){
+  if (pf != NULL){ firead_close(pf); }
+  pf = cf;
+ }
+}
+
+
 
-/* Include list for finding matching includes */
-static uint8 pass1_inclist[INC_MAX][FILE_MAX];
-/* Count of includes added */
-static auint pass1_inccnt;
+/* Checks whether the record of the reader is the include 'fnam'. Returns
+** nonzero (TRUE) if so. */
+static auint pass1_rdisinc(srcrd_rec_t const* rec, uint8 const* fnam)
+{
+ return ( (rec->typ == SRCRD_INC) &&
+          (strcmp((char const*)(&(rec->str[0])), (char const*)(fnam)) == 0) );
+}
 
 
 
-/* Attempts to find a match in the include table, returns nonzero (TRUE) if a
-** match could be found. */
-static auint pass1_findinc(uint8 const* src)
+/* Checks whether the next record of the reader is the include 'fnam' which
+** the first pass is about to enter or skip. Returns nonzero (TRUE) if not,
+** fault printed. */
+static auint pass1_rdinc(srcrd_rec_t const* rec, uint8 const* fnam, compst_t* cst)
 {
- auint i;
- for (i = 0U; i < pass1_inccnt; i++){
-  if (strcmp((const char*)(src), (const char*)(&(pass1_inclist[i][0]))) == 0){
-   return 1U;
+ uint8  s[80];
+
+ if (pass1_rdisinc(rec, fnam)){ return 0U; }
+
+ snprintf((char*)(&s[0]), 80U, "Source reader out of sync at include %s", (char const*)(fnam));
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return 1U;
+}
+
+
+
+/* Gets the next line from the reader into the compile state like
+** firead_read() and firead_iseof() would. Returns 0 for a line, 1 at the end
+** of the file, 2 on failure (fault printed). */
+static auint pass1_rdnext(srcrd_t* rdr, compst_t* cst)
+{
+ uint8  s[80];
+ uint8  serrn[80];
+ srcrd_rec_t const* rec = srcrd_get(rdr);
+ auint  r = 1U;
+
+ compst_setline(cst, rec->lin);
+ compst_setcoff(cst, 0U);
+
+ if       (rec->typ == SRCRD_LIN){
+  if (rec->lng){
+   snprintf((char*)(&s[0]), 80U, "Source line too long");
+   fault_printat(FAULT_NOTE, &s[0], cst);
   }
+  compst_setsstr(cst, &(rec->str[0]));
+  r = 0U;
+ }else if (rec->typ == SRCRD_ERR){
+  strerror_r(rec->err, (char*)(&serrn[0]), 80U);
+  serrn[79] = 0U;
+  snprintf((char*)(&s[0]), 80U, "Failed to read source: %.56s", (char const*)(&serrn[0]));
+  fault_printat(FAULT_FAIL, &s[0], cst);
+  r = 2U;
+ }else{                  /* End of file (SRCRD_END or SRCRD_EOF) */
+  compst_setsstr(cst, (uint8 const*)(""));
  }
- return 0U;
+
+ srcrd_next(rdr);
+ return r;
 }
 
 
 
-/* Unwinds include stack closing all files except bottommost, for fault
-** handlers */
-static void pass1_stkunw(incstk_t* ist, compst_t* hnd, FILE* cf)
+/* Enters the include 'fnam' through the reader like firead_open() would.
+** Returns nonzero (TRUE) on failure, fault printed. */
+static auint pass1_rdopen(srcrd_t* rdr, uint8 const* fnam, compst_t* cst)
 {
- FILE* pf = cf;
- while (!incstk_pop(ist, hnd, &cf)){
-  if (pf != NULL){ fclose(pf); }
-  pf = cf;
+ uint8  s[80];
+ uint8  serrn[80];
+ srcrd_rec_t const* rec = srcrd_get(rdr);
+
+ if (pass1_rdinc(rec, fnam, cst)){ return 1U; }
+ if (rec->dsc == 0U){
+  strerror_r(rec->err, (char*)(&serrn[0]), 80U);
+  serrn[79] = 0U;
+  snprintf((char*)(&s[0]), 80U, "Failed to open %.30s: %.32s", (char const*)(fnam), (char const*)(&serrn[0]));
+  fault_printat(FAULT_FAIL, &s[0], cst);
+  return 1U;
  }
+ srcrd_next(rdr);
+
+ compst_setfile(cst, fnam);
+ compst_setline(cst, 0U);
+ compst_setcoff(cst, 0U);
+
+ return (pass1_rdnext(rdr, cst) == 2U);
+}
+
+
+
+/* Skips the records of the include 'fnam' which is not parsed (replayed or
+** merged). Returns nonzero (TRUE) on failure, fault printed. */
+static auint pass1_rdskip(srcrd_t* rdr, uint8 const* fnam, compst_t* cst)
+{
+ srcrd_rec_t const* rec = srcrd_get(rdr);
+ auint  dep;
+
+ if (pass1_rdinc(rec, fnam, cst)){ return 1U; }
+ dep = rec->dsc;
+ srcrd_next(rdr);
+
+ while (dep != 0U){
+  rec = srcrd_get(rdr);
+  if       (rec->typ == SRCRD_INC){ dep += rec->dsc; }
+  else if  (rec->typ == SRCRD_END){ dep --; }
+  else if  (rec->typ == SRCRD_EOF){ return pass1_rdinc(rec, fnam, cst); }
+  srcrd_next(rdr);
+ }
+
+ return 0U;
 }
 
 
 
+
 /* Executes the first pass. Uses the passed file handle for assembler source,
 ** processes it line by line generating code and header data (if necessary
-** opening source includes as well), also filling up state for pass2 and
-** pass3. Returns nonzero (TRUE) if failed (printing it's cause). */
-auint pass1_run(FILE* sf, symtab_t* stb, bindata_t* bdt)
+** opening source includes as well through the file provider), also filling
+** up state for pass2 and pass3. The include stack is used for the includes,
+** and every include opened is recorded in the dependency list. If 'mem' is
+** not NULL, includes are memoized in it, replaying those met earlier in the
+** same state. If 'frg' is not NULL, the fragments assembled ahead by it are
+** merged in for the includes where possible. If 'rdr' is not NULL, it must
+** be started on 'sf', then the lines are taken from it instead of reading
+** the sources. The macros are defined and expanded through 'mac', the
+** conditionals are processed through 'cnd', the procedures through 'rch'.
+** Returns nonzero (TRUE) if failed (printing it's cause). */
+auint pass1_run(fprov_file_t* sf, symtab_t* stb, bindata_t* bdt, macro_t* mac, cond_t* cnd, reach_t* rch, incstk_t* ist, deplst_t* dls, fprov_t const* prv, incmem_t* mem, frag_t* frg, srcrd_t* rdr)
 {
  uint8        s[80];
  uint8        ste[LINE_MAX];
@@ -71,37 +171,94 @@ auint pass1_run(FILE* sf, symtab_t* stb, bindata_t* bdt)
  uint8 const* src;
  auint        beg;
  auint        i;
- incstk_t*    ist = incstk_getobj();
- FILE*        tf;
+ auint        act;
+ auint        dir = 0U;
+ auint        bdc = 0U;
+ auint        mdc = 0U;
+ auint        cdc = 0U;
+ fprov_file_t* tf;
 
  incstk_init(ist);
- pass1_inccnt = 0U;
 
  /* Main compiling loop. Note that line 0 is already read in! */
 
  while (1){
 
-  /* Check for includes and operate the include stack accordingly */
-
   src = compst_getsstr(cst);
   beg = strpr_nextnw(src, 0);
-  i   = 1U;              /* Marks if compile may continue for the line */
+
+  /* Conditional assembly and procedures: directives, and the lines skipped
+  ** by them (the lines of a macro definition are only recorded) */
+
+  act = 1U;              /* Marks if the line is assembled */
+  if (macro_isrec(mac) == 0U){
+   i = cond_proc(cnd, stb);
+   if (i == PARSER_OK){ i = reach_proc(rch, stb); }
+   if (i == PARSER_ERR){ goto fault_oth; }
+   act = (i == PARSER_OK);
+  }
+  i = act;               /* Marks if compile may continue for the line */
+
+  /* Check for includes and operate the include stack accordingly */
 
   if (compst_issymequ(NULL, &(src[beg]), (uint8 const*)("include"))){
+   if (macro_isrec(mac)){ goto fault_inm; }
+   if (mem != NULL){ incmem_abort(mem, stb); } /* An include containing includes (even skipped ones) is not memoized */
    beg = strpr_nextnw(src, beg + 7U);
    i = strpr_extstr(&(ste[0]), &(src[beg]), LINE_MAX);
    if (i == 0){ goto fault_inc; }
 
-   if (pass1_findinc(&(ste[0])) == 0U){ /* Not yet included */
+   if (act == 0U){       /* Skipped, but the reader may have entered it */
+    if ( (rdr != NULL) && (dir == 0U) &&
+         (pass1_rdisinc(srcrd_get(rdr), &(ste[0]))) ){
+     if (pass1_rdskip(rdr, &(ste[0]), cst)){ goto fault_oth; }
+    }
+    i = 0U;
+   }else if (incstk_isinc(ist, &(ste[0])) == 0U){ /* Not yet included */
 
-    if (pass1_inccnt >= INC_MAX){ goto fault_imx; }
-    strpr_copy(&(pass1_inclist[pass1_inccnt][0]), &(ste[0]), FILE_MAX);
-    pass1_inccnt++;
-    if (incstk_push(ist, cst, sf)){ goto fault_ins; }
-    if (firead_open(&(ste[0]), cst, &sf)){ goto fault_oth; }
     beg = strpr_nextnw(src, beg + i);
     if (!strpr_isend(src[beg])){ goto fault_inc; }
-    i = 1U;              /* Continue compiling with the newly read line from the include */
+    if (incstk_addinc(ist, &(ste[0]))){ goto fault_imx; }
+    if (deplst_add(dls, &(ste[0]), cst)){ goto fault_oth; }
+
+    i = INCMEM_PAR;
+    if (macro_getcnt(mac) == 0U){ /* After macros it is parsed (it may use them) */
+     if (frg != NULL){   /* Assembled ahead: merge if possible */
+      if (mem != NULL){ incmem_abort(mem, stb); }
+      i = frag_merge(frg, &(ste[0]), stb, ist, dls);
+      if (i == FRAG_ERR){ goto fault_oth; }
+      i = (i == FRAG_MRG) ? INCMEM_REP : INCMEM_PAR;
+     }
+     if ((mem != NULL) && (i == INCMEM_PAR)){ /* Only includes without further includes are memoized */
+      i = incmem_begin(mem, &(ste[0]), stb, prv);
+      if (i == INCMEM_ERR){ goto fault_oth; }
+      bdc = bindata_getcnt(bdt);
+      mdc = macro_getcnt(mac);
+      cdc = cond_getcnt(cnd);
+     }
+    }
+
+    if (i == INCMEM_REP){ /* Replayed or merged, nothing more to do */
+     if ( (rdr != NULL) && (dir == 0U) &&
+          (pass1_rdisinc(srcrd_get(rdr), &(ste[0]))) ){
+      if (pass1_rdskip(rdr, &(ste[0]), cst)){ goto fault_oth; }
+     }
+     i = 0U;
+    }else{
+     if (incstk_push(ist, cst, sf)){ goto fault_ins; }
+     if ( (rdr != NULL) && (dir == 0U) &&
+          (pass1_rdisinc(srcrd_get(rdr), &(ste[0]))) ){ /* Includes are opened by the reader */
+      sf = NULL;
+      if (pass1_rdopen(rdr, &(ste[0]), cst)){ goto fault_oth; }
+     }else{              /* Read directly (with a reader, one it met in a skipped region) */
+      if (rdr != NULL){ dir ++; }
+      if (firead_open(&(ste[0]), cst, prv, &sf)){ goto fault_oth; }
+     }
+     i = cond_proc(cnd, stb); /* Continue with the newly read line from the include */
+     if (i == PARSER_OK){ i = reach_proc(rch, stb); }
+     if (i == PARSER_ERR){ goto fault_oth; }
+     i = (i == PARSER_OK);
+    }
 
    }else{                /* Already included, nothing to do */
     i = 0U;              /* Don't continue compilation */
@@ -112,19 +269,38 @@ auint pass1_run(FILE* sf, symtab_t* stb, bindata_t* bdt)
 
   if (i != 0U){
 
-   i = litpr_symdefproc(stb);
+   i = macro_rec(mac, stb);
    if (i == PARSER_ERR){ goto fault_oth; }
-   if (i == PARSER_OK){  /* Further elements may follow */
+   if (i == PARSER_OK){  /* Not part of a macro definition */
 
-    i = ps1sup_parsmisc(stb);
+    i = litpr_symdefproc(stb);
     if (i == PARSER_ERR){ goto fault_oth; }
     if (i == PARSER_OK){ /* Further elements may follow */
 
-     i = bindata_proc(bdt, stb);
+     i = macro_proc(mac, stb);
      if (i == PARSER_ERR){ goto fault_oth; }
-     if (i == PARSER_OK){   /* Further elements may follow */
+     if ( (i == PARSER_OK) && /* Further elements may follow (not in a procedure dropped) */
+          (reach_isskip(rch) == 0U) ){
+
+      i = ps1sup_parsmisc(stb);
+      if (i == PARSER_ERR){ goto fault_oth; }
+      if (i == PARSER_OK){  /* Further elements may follow */
+
+       i = tabgen_proc(stb);
+       if (i == PARSER_ERR){ goto fault_oth; }
+       if (i == PARSER_OK){ /* Further elements may follow */
+
+        i = bindata_proc(bdt, stb);
+        if (i == PARSER_ERR){ goto fault_oth; }
+        if (i == PARSER_OK){ /* Further elements may follow */
+
+         if (opcpr_proc(stb) == PARSER_ERR){ goto fault_oth; }
 
-      if (opcpr_proc(stb) == PARSER_ERR){ goto fault_oth; }
+        }
+
+       }
+
+      }
 
      }
 
@@ -134,19 +310,42 @@ auint pass1_run(FILE* sf, symtab_t* stb, bindata_t* bdt)
 
   }
 
-  /* Read next line, exit if eof reached and the include stack is clear */
-
-  if (firead_read(cst, sf)){ goto fault_oth; }
-  if (firead_iseof(cst, sf)){ /* File ended, try to pop include stack */
+  /* Read next line (from the running macro expansion if any), exit if eof
+  ** reached and the include stack is clear */
+
+  i = macro_read(mac, cst);
+  if (i == 2U){ goto fault_oth; }
+  if (i != 0U){          /* No expansion: from the source */
+   if ((rdr != NULL) && (dir == 0U)){
+    i = pass1_rdnext(rdr, cst);
+    if (i == 2U){ goto fault_oth; }
+   }else{
+    if (firead_read(cst, sf)){ goto fault_oth; }
+    i = firead_iseof(cst, sf);
+   }
+  }
+  if (i != 0U){          /* File ended, try to pop include stack */
+   if (macro_chkend(mac)){ goto fault_oth; }
+   if (cond_chkend(cnd, compst_getfile(cst))){ goto fault_oth; }
+   if (reach_chkend(rch, compst_getfile(cst))){ goto fault_oth; }
    tf = sf;
    if (incstk_pop(ist, cst, &sf)){ break; } /* End of primary source */
-   fclose(tf);           /* Close the include */
+   if (tf != NULL){ firead_close(tf); } /* Close the include (unless the reader's) */
+   if (dir != 0U){ dir --; }
+   if ((mem != NULL) && incmem_isrec(mem)){
+    if ( (bindata_getcnt(bdt) == bdc) &&
+         (macro_getcnt(mac) == mdc) &&
+         (cond_getcnt(cnd) == cdc) ){ incmem_end(mem, stb); }
+    else{ incmem_abort(mem, stb); } /* Depends on binary data, macros or conditionals */
+   }
   }
 
  }
 
  /* OK, compilation over, only the primary source remained open */
 
+ if (cond_chkend(cnd, NULL)){ return 1U; }
+ if (reach_chkend(rch, NULL)){ return 1U; }
  return 0U;
 
 
@@ -174,8 +373,17 @@ fault_inc:
  fault_printat(FAULT_FAIL, &s[0], cst);
  return 1U;
 
+fault_inm:
+
+ pass1_stkunw(ist, cst, sf);
+ compst_setcoff(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Include within macro or repeat definition");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return 1U;
+
 fault_oth:
 
+ macro_trace(mac);
  pass1_stkunw(ist, cst, sf);
  return 1U;
 
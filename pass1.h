@@ -17,14 +17,31 @@
 #include "types.h"
 #include "symtab.h"
 #include "bindata.h"
+#include "incstk.h"
+#include "deplst.h"
+#include "fprov.h"
+#include "incmem.h"
+#include "frag.h"
+#include "srcrd.h"
+#include "macro.h"
+#include "cond.h"
+#include "reach.h"
 
 
 
 /* Executes the first pass. Uses the passed file handle for assembler source,
 ** processes it line by line generating code and header data (if necessary
-** opening source includes as well), also filling up state for pass2 and
-** pass3. Returns nonzero (TRUE) if failed (printing it's cause). */
-auint pass1_run(FILE* sf, symtab_t* stb, bindata_t* bdt);
+** opening source includes as well through the file provider), also filling
+** up state for pass2 and pass3. The include stack is used for the includes,
+** and every include opened is recorded in the dependency list. If 'mem' is
+** not NULL, includes are memoized in it, replaying those met earlier in the
+** same state. If 'frg' is not NULL, the fragments assembled ahead by it are
+** merged in for the includes where possible. If 'rdr' is not NULL, it must
+** be started on 'sf', then the lines are taken from it instead of reading
+** the sources. The macros are defined and expanded through 'mac', the
+** conditionals are processed through 'cnd', the procedures through 'rch'.
+** Returns nonzero (TRUE) if failed (printing it's cause). */
+auint pass1_run(fprov_file_t* sf, symtab_t* stb, bindata_t* bdt, macro_t* mac, cond_t* cnd, reach_t* rch, incstk_t* ist, deplst_t* dls, fprov_t const* prv, incmem_t* mem, frag_t* frg, srcrd_t* rdr);
 
 
 #endif
@@ -13,6 +13,10 @@
 #include "pass3.h"
 
 
+/* Size of the output buffer in words */
+#define PASS3_BUF 1024U
+
+
 /* Sections to process into the output file */
 static const auint pass3_secout[4] = {SECT_HEAD, SECT_DESC, SECT_CODE, SECT_DATA};
 
@@ -20,28 +24,34 @@ static const auint pass3_secout[4] = {SECT_HEAD, SECT_DESC, SECT_CODE, SECT_DATA
 /* Executes the third pass. This combines the application components prepared
 ** in pass 2 with the FILE section binary data blocks into a new application
 ** binary file. Returns nonzero on failure. */
-auint pass3_run(FILE* obi, symtab_t* stb, bindata_t* bdt)
+auint pass3_run(fprov_file_t* obi, symtab_t* stb, bindata_t* bdt)
 {
  uint8  s[80];
  uint8  e[80];
  section_t* sec = symtab_getsectob(stb);
  auint  i;
  auint  j;
+ auint  k;
+ auint  l;
  auint  ssi;
- uint16 const* d;
- uint8  c[2];
+ uint16 d[PASS3_BUF];
+ uint8  c[PASS3_BUF * 2U];
 
  /* Write out sections in order. The FILE section will have zero size here, so
  ** no problem including it. */
 
  for (i = 0U; i < (sizeof(pass3_secout) / sizeof(pass3_secout[0])); i++){
   section_setsect(sec, pass3_secout[i]);
-  d   = section_getdata(sec);
   ssi = section_getsize(sec);
-  for (j = 0U; j < ssi; j++){
-   c[0] = d[j] >> 8;
-   c[1] = d[j] & 0xFFU;
-   if (fwrite(&c[0], 1U, 2U, obi) != 2U){ goto fault_wrt; }
+  for (j = 0U; j < ssi; j += k){
+   k = ssi - j;
+   if (k > PASS3_BUF){ k = PASS3_BUF; }
+   section_read(sec, j, &d[0], k);
+   for (l = 0U; l < k; l++){
+    c[(l << 1)     ] = d[l] >> 8;
+    c[(l << 1) + 1U] = d[l] & 0xFFU;
+   }
+   if (fprov_write(obi, &c[0], k << 1)){ goto fault_wrt; }
   }
  }
 
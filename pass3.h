@@ -17,12 +17,13 @@
 #include "types.h"
 #include "bindata.h"
 #include "symtab.h"
+#include "fprov.h"
 
 
 /* Executes the third pass. This combines the application components prepared
 ** in pass 2 with the FILE section binary data blocks into a new application
 ** binary file. Returns nonzero on failure. */
-auint pass3_run(FILE* obi, symtab_t* stb, bindata_t* bdt);
+auint pass3_run(fprov_file_t* obi, symtab_t* stb, bindata_t* bdt);
 
 
 #endif
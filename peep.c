@@ -0,0 +1,388 @@
+/**
+**  \file
+**  \brief     Peephole optimizer
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  The patterns are matched on the opcode identifiers and the operands as
+**  decoded (see opcdec.h). Only register operands and literal immediates are
+**  compared, so nothing depends on symbols not resolved yet, except for the
+**  jumps, where the label met is checked against the target's name.
+*/
+
+
+#include "peep.h"
+#include "compst.h"
+#include "section.h"
+#include "relax.h"
+#include "fault.h"
+#include "strpr.h"
+
+
+/* Instruction class of opcodes with an encoding mask (not in patterns) */
+#define PEEP_C_OTH  0xFFFEU
+/* Instruction class of a label (for patterns removing the instruction before
+** it) */
+#define PEEP_C_LAB  0xFFFFU
+
+/* Pattern action: Remove the current instruction */
+#define PEEP_A_CUR  0U
+/* Pattern action: Remove the previous and the current instruction */
+#define PEEP_A_BOTH 1U
+/* Pattern action: Remove the previous instruction (at a label) */
+#define PEEP_A_PRV  2U
+
+
+/* Pattern */
+typedef struct{
+ auint  pcl;            /* Class of the previous instruction (OPCDEC_I_NUL: not used) */
+ auint  ccl;            /* Class of the current instruction (or PEEP_C_LAB) */
+ auint  (*mat)(opcdec_ds_t const* prv, opcdec_ds_t const* cur); /* Match */
+ auint  act;            /* Action (PEEP_A_CUR, PEEP_A_BOTH or PEEP_A_PRV) */
+ char const* dsc;       /* Note printed for the removed instructions */
+}peep_pat_t;
+
+/* An instruction */
+typedef struct{
+ opcdec_ds_t ods;       /* Decoded instruction */
+ auint  sec;            /* Section */
+ auint  beg;            /* Offset of the instruction in the section */
+ auint  end;            /* Offset after the instruction */
+ uint8  fil[FILE_MAX];  /* File name of the line */
+ auint  lin;            /* Line */
+ auint  skp;            /* Nonzero if it is a skip */
+ auint  shd;            /* Nonzero if it is in the shadow of a skip */
+}peep_ins_t;
+
+
+/* Peephole optimizer object structure - definition */
+struct peep_s{
+ peep_ins_t cur;        /* Instruction submitted, waiting to be encoded */
+ peep_ins_t prv;        /* Instruction encoded before */
+ auint  pnd;            /* Nonzero if 'cur' is waiting to be encoded */
+ auint  pvl;            /* Nonzero if 'prv' may be used in patterns */
+ auint  lvl;            /* Nonzero if the last instruction is known */
+ auint  lsc;            /* Section of the last instruction */
+ auint  lof;            /* Offset after the last instruction */
+ auint  lsk;            /* Nonzero if the last instruction is a skip */
+};
+
+
+
+/* Checks whether an operand is a normal register (A - X3). */
+static auint peep_i_isreg(auint opv)
+{
+ return (((opv >> OPCDEC_S_ADR) & 0x38U) == 0x30U);
+}
+
+
+
+/* Checks whether an operand is a literal immediate. */
+static auint peep_i_islit(auint opv)
+{
+ return ( (((opv >> OPCDEC_S_ADR) & 0x3FU) == 0x20U) &&
+          ((opv & OPCDEC_O_SYM) == 0U) );
+}
+
+
+
+/* Pattern: mov X, X (X: normal register). */
+static auint peep_i_mself(opcdec_ds_t const* prv, opcdec_ds_t const* cur)
+{
+ (void)(prv);
+ return ( (cur->opc == 2U) &&
+          (peep_i_isreg(cur->op[0])) &&
+          (cur->op[0] == cur->op[1]) );
+}
+
+
+
+/* Pattern: mov X, Y; mov Y, X (X, Y: normal registers). */
+static auint peep_i_mback(opcdec_ds_t const* prv, opcdec_ds_t const* cur)
+{
+ return ( (prv->opc == 2U) &&
+          (cur->opc == 2U) &&
+          (peep_i_isreg(prv->op[0])) &&
+          (peep_i_isreg(prv->op[1])) &&
+          (cur->op[0] == prv->op[1]) &&
+          (cur->op[1] == prv->op[0]) );
+}
+
+
+
+/* Pattern: mov X, Y; mov X, Y (X: normal register, Y: normal register or
+** literal immediate). */
+static auint peep_i_mrept(opcdec_ds_t const* prv, opcdec_ds_t const* cur)
+{
+ return ( (prv->opc == 2U) &&
+          (cur->opc == 2U) &&
+          (peep_i_isreg(prv->op[0])) &&
+          ( (peep_i_isreg(prv->op[1])) ||
+            (peep_i_islit(prv->op[1])) ) &&
+          (cur->op[0] == prv->op[0]) &&
+          (cur->op[1] == prv->op[1]) );
+}
+
+
+
+/* Pattern: psh R...; pop R... (the same set of registers). */
+static auint peep_i_pshpop(opcdec_ds_t const* prv, opcdec_ds_t const* cur)
+{
+ auint i;
+ auint j;
+
+ if ((prv->opc == 0U) || (prv->opc != cur->opc)){ return 0U; }
+
+ for (i = 0U; i < (cur->opc); i++){
+  for (j = 0U; j < (prv->opc); j++){
+   if (cur->op[i] == prv->op[j]){ break; }
+  }
+  if (j == (prv->opc)){ return 0U; }
+ }
+ for (i = 0U; i < (prv->opc); i++){
+  for (j = 0U; j < (cur->opc); j++){
+   if (prv->op[i] == cur->op[j]){ break; }
+  }
+  if (j == (cur->opc)){ return 0U; }
+ }
+
+ return 1U;
+}
+
+
+
+/* Pattern: jump to a symbol, before a label (which is checked to be the
+** symbol by the caller). */
+static auint peep_i_jmpnx(opcdec_ds_t const* prv, opcdec_ds_t const* cur)
+{
+ (void)(cur);
+ return ( (prv->opc == 1U) &&
+          (((prv->op[0] >> OPCDEC_S_ADR) & 0x3FU) == 0x20U) &&
+          ((prv->op[0] & OPCDEC_O_SYM) != 0U) );
+}
+
+
+
+/* Pattern table. The index of a pattern is stored in the relaxation for the
+** instructions dropped by it. */
+static peep_pat_t const peep_pat[] = {
+ {OPCDEC_I_NUL, OPCDEC_I_MOV, &peep_i_mself,  PEEP_A_CUR,  "Removed: moves a register to itself"},
+ {OPCDEC_I_MOV, OPCDEC_I_MOV, &peep_i_mback,  PEEP_A_CUR,  "Removed: moves back the value just moved"},
+ {OPCDEC_I_MOV, OPCDEC_I_MOV, &peep_i_mrept,  PEEP_A_CUR,  "Removed: repeats the previous move"},
+ {OPCDEC_I_PSH, OPCDEC_I_POP, &peep_i_pshpop, PEEP_A_BOTH, "Removed: pops what was just pushed"},
+ {OPCDEC_I_JMS, PEEP_C_LAB,   &peep_i_jmpnx,  PEEP_A_PRV,  "Removed: jumps to the next instruction"},
+ {OPCDEC_I_JMR, PEEP_C_LAB,   &peep_i_jmpnx,  PEEP_A_PRV,  "Removed: jumps to the next instruction"},
+ {OPCDEC_I_JMA, PEEP_C_LAB,   &peep_i_jmpnx,  PEEP_A_PRV,  "Removed: jumps to the next instruction"},
+ {OPCDEC_I_JMP, PEEP_C_LAB,   &peep_i_jmpnx,  PEEP_A_PRV,  "Removed: jumps to the next instruction"}
+};
+
+/* Count of patterns */
+#define PEEP_PAT_CNT (sizeof(peep_pat) / sizeof(peep_pat[0]))
+
+
+
+/* Gets the class of an instruction for the patterns. */
+static auint peep_i_class(opcdec_ds_t const* ods)
+{
+ if ((ods->id & (OPCDEC_I_R | OPCDEC_I_RB | OPCDEC_I_RS)) != 0U){
+  return PEEP_C_OTH;
+ }
+ return (ods->id & OPCDEC_I_MASK);
+}
+
+
+
+/* Checks whether an instruction may skip the next one. The bit skips and the
+** symmetric opcodes are all taken as such. */
+static auint peep_i_isskip(opcdec_ds_t const* ods)
+{
+ if ((ods->id & (OPCDEC_I_RB | OPCDEC_I_RS)) != 0U){ return 1U; }
+ if ((ods->id & OPCDEC_I_R) != 0U){
+  return ((ods->id & OPCDEC_I_MASK) == 0xB400U); /* xsg, xsl */
+ }
+ return ( ((ods->id & OPCDEC_I_MASK) == OPCDEC_I_XEQ) ||
+          ((ods->id & OPCDEC_I_MASK) == OPCDEC_I_XNE) ||
+          ((ods->id & OPCDEC_I_MASK) == OPCDEC_I_XUG) );
+}
+
+
+
+/* Checks whether an instruction may take part in a pattern at all. */
+static auint peep_i_isplain(peep_ins_t const* ins)
+{
+ return ( ((ins->ods.id & OPCDEC_I_C) == 0U) &&
+          (ins->ods.prc == 0U) &&
+          (ins->skp == 0U) &&
+          (ins->shd == 0U) );
+}
+
+
+
+/* Creates a new peephole optimizer. Returns NULL if it is not possible to
+** allocate it. The object has to be initialized before use. */
+peep_t* peep_new(void)
+{
+ return (peep_t*)(calloc(1U, sizeof(peep_t)));
+}
+
+
+
+/* Deletes a peephole optimizer. */
+void  peep_delete(peep_t* hnd)
+{
+ free(hnd);
+}
+
+
+
+/* Initializes or resets a peephole optimizer for a new first pass. */
+void  peep_init(peep_t* hnd)
+{
+ hnd->pnd = 0U;
+ hnd->pvl = 0U;
+ hnd->lvl = 0U;
+}
+
+
+
+/* Submits the decoded instruction 'ods' of the current source line before it
+** is encoded. Returns nonzero (TRUE) if it is removed (then it must not be
+** encoded), note printed. */
+auint peep_ins(peep_t* hnd, symtab_t* stb, opcdec_ds_t const* ods)
+{
+ section_t*   sec = symtab_getsectob(stb);
+ compst_t*    cst = symtab_getcompst(stb);
+ relax_t*     rlx = symtab_getrlx(stb);
+ peep_ins_t*  cur = &(hnd->cur);
+ peep_ins_t*  prv = &(hnd->prv);
+ peep_pat_t const* pat;
+ auint  adj;
+ auint  val;
+ auint  i;
+
+ hnd->pnd = 0U;
+ if (ods->id == OPCDEC_I_NUL){ return 0U; } /* Empty line */
+
+ /* Dropped by an earlier round: as if it was not there */
+
+ if ( (rlx != NULL) &&
+      (relax_get(rlx, compst_getfile(cst), compst_getline(cst), &val) == RELAX_DROP) ){
+  fault_printat(FAULT_NOTE, (uint8 const*)(peep_pat[val].dsc), cst);
+  return 1U;
+ }
+
+ /* Take the instruction, pending until encoded */
+
+ cur->ods = *ods;
+ cur->sec = section_getsect(sec);
+ cur->beg = section_getoffw(sec);
+ strpr_copy(&(cur->fil[0]), compst_getfile(cst), FILE_MAX);
+ cur->lin = compst_getline(cst);
+ cur->skp = peep_i_isskip(ods);
+ cur->shd = ( (hnd->lvl != 0U) &&
+              (hnd->lsk != 0U) &&
+              (hnd->lsc == cur->sec) &&
+              (hnd->lof == cur->beg) );
+ hnd->pnd = 1U;
+
+ /* Look for a matching pattern */
+
+ if ( (cur->shd != 0U) ||
+      ((ods->id & OPCDEC_I_C) != 0U) ||
+      (ods->prc != 0U) ){ return 0U; }
+ adj = ( (hnd->pvl != 0U) &&
+         (peep_i_isplain(prv)) &&
+         (prv->sec == cur->sec) &&
+         (prv->end == cur->beg) );
+
+ for (i = 0U; i < PEEP_PAT_CNT; i++){
+  pat = &(peep_pat[i]);
+  if (pat->ccl != peep_i_class(ods)){ continue; }
+  if (pat->pcl == OPCDEC_I_NUL){
+   if (pat->mat(NULL, ods) == 0U){ continue; }
+  }else{
+   if ( (adj == 0U) ||
+        (pat->pcl != peep_i_class(&(prv->ods))) ){ continue; }
+   if (pat->mat(&(prv->ods), ods) == 0U){ continue; }
+  }
+  if (pat->act == PEEP_A_BOTH){
+   if (rlx == NULL){ continue; }
+   if (relax_set(rlx, &(cur->fil[0]), cur->lin, RELAX_DROP, i) == 0U){ continue; }
+   if (relax_set(rlx, &(prv->fil[0]), prv->lin, RELAX_DROP, i) == 0U){ continue; }
+   hnd->pvl = 0U;       /* What was before the previous is not known */
+   hnd->lsk = 0U;       /* The previous was not a skip */
+  }
+  fault_printat(FAULT_NOTE, (uint8 const*)(pat->dsc), cst);
+  hnd->pnd = 0U;
+  return 1U;
+ }
+
+ return 0U;
+}
+
+
+
+/* Tells that the instruction submitted last by peep_ins() was encoded. */
+void  peep_done(peep_t* hnd, symtab_t* stb)
+{
+ section_t*   sec = symtab_getsectob(stb);
+
+ if (hnd->pnd == 0U){ return; }
+
+ hnd->pnd = 0U;
+ hnd->prv = hnd->cur;
+ hnd->prv.end = section_getoffw(sec);
+ hnd->pvl = 1U;
+ hnd->lvl = 1U;
+ hnd->lsc = hnd->prv.sec;
+ hnd->lof = hnd->prv.end;
+ hnd->lsk = hnd->prv.skp;
+}
+
+
+
+/* Submits the label 'nam' defined at the current offset, before it is bound.
+** An instruction encoded before it is not looked at together with the next
+** one. */
+void  peep_label(peep_t* hnd, symtab_t* stb, uint8 const* nam)
+{
+ section_t*   sec = symtab_getsectob(stb);
+ relax_t*     rlx = symtab_getrlx(stb);
+ peep_ins_t*  prv = &(hnd->prv);
+ peep_pat_t const* pat;
+ auint  i;
+
+ if ( (hnd->pvl != 0U) &&
+      (rlx != NULL) &&
+      (peep_i_isplain(prv)) &&
+      (prv->sec == section_getsect(sec)) &&
+      (prv->end == section_getoffw(sec)) ){
+
+  for (i = 0U; i < PEEP_PAT_CNT; i++){
+   pat = &(peep_pat[i]);
+   if ( (pat->ccl != PEEP_C_LAB) ||
+        (pat->pcl != peep_i_class(&(prv->ods))) ){ continue; }
+   if (pat->mat(&(prv->ods), NULL) == 0U){ continue; }
+   if (symtab_isref(stb, prv->ods.op[0] & 0xFFFFFFU, nam) == 0U){ continue; }
+   relax_set(rlx, &(prv->fil[0]), prv->lin, RELAX_DROP, i);
+   break;
+  }
+
+ }
+
+ hnd->pvl = 0U;         /* Branch target: the window ends here */
+}
+
+
+
+/* Ends the window at the current offset like a label, but no jump to it is
+** removed (used at the start of a procedure, which may be removed itself,
+** see reach.h). */
+void  peep_bound(peep_t* hnd)
+{
+ hnd->pvl = 0U;
+}
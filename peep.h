@@ -0,0 +1,79 @@
+/**
+**  \file
+**  \brief     Peephole optimizer
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Removes redundant instructions by a table of patterns, working on the
+**  decoded instructions of the first pass before they are encoded. It looks
+**  at the instruction being encoded and the one encoded right before it, and
+**  only if nothing came between them:
+**
+**  - No label (a label may be the target of a branch).
+**  - No data or other words in the section.
+**
+**  An instruction right after a skip (xeq, xne, xug, xsg and the likes) is
+**  never touched, neither anything relying on what such an instruction does.
+**
+**  The current instruction is simply not encoded if it is redundant. If an
+**  earlier one has to be removed too, it is set dropped in the relaxation
+**  (see relax.h), so it is left out when the assembly is repeated. Without a
+**  relaxation only the current instruction may be removed. Every removal is
+**  reported by a note on its line.
+*/
+
+
+#ifndef PEEP_H
+#define PEEP_H
+
+
+#include "types.h"
+#include "symtab.h"
+#include "opcdec.h"
+
+
+/* Peephole optimizer object structure */
+typedef struct peep_s peep_t;
+
+
+
+/* Creates a new peephole optimizer. Returns NULL if it is not possible to
+** allocate it. The object has to be initialized before use. */
+peep_t* peep_new(void);
+
+
+/* Deletes a peephole optimizer. */
+void  peep_delete(peep_t* hnd);
+
+
+/* Initializes or resets a peephole optimizer for a new first pass. */
+void  peep_init(peep_t* hnd);
+
+
+/* Submits the decoded instruction 'ods' of the current source line before it
+** is encoded. Returns nonzero (TRUE) if it is removed (then it must not be
+** encoded), note printed. */
+auint peep_ins(peep_t* hnd, symtab_t* stb, opcdec_ds_t const* ods);
+
+
+/* Tells that the instruction submitted last by peep_ins() was encoded. */
+void  peep_done(peep_t* hnd, symtab_t* stb);
+
+
+/* Submits the label 'nam' defined at the current offset, before it is bound.
+** An instruction encoded before it is not looked at together with the next
+** one. */
+void  peep_label(peep_t* hnd, symtab_t* stb, uint8 const* nam);
+
+
+/* Ends the window at the current offset like a label, but no jump to it is
+** removed (used at the start of a procedure, which may be removed itself,
+** see reach.h). */
+void  peep_bound(peep_t* hnd);
+
+
+#endif
@@ -149,10 +149,7 @@ auint ps1sup_parsmisc(symtab_t* stb)
   if ( (t != LITPR_VAL) || (v > 0xFFFFU) ){
    goto fault_ind;
   }
-  while (v != 0U){
-   if (section_pushw(sec, 0U) != 0U){ goto fault_ovr; }
-   v --;
-  }
+  if (section_reserve(sec, v, &off) != 0U){ goto fault_dso; }
 
   beg = beg + u;                     /* End of string? */
   if (!strpr_isend(src[beg])){ goto fault_ind; }
@@ -171,12 +168,8 @@ auint ps1sup_parsmisc(symtab_t* stb)
 
    if ((t & LITPR_STR) != 0U){       /* String (any) */
     if (strpr_extstr(&(ste[0]), &(src[beg]), LINE_MAX)==0){ goto fault_inx; }
-    t = 0U;
-    while (1){
-     if (ste[t] == 0U){ break; }
-     if (section_pushb(sec, ste[t]) != 0U){ goto fault_ovr; }
-     t++;
-    }
+    t = strlen((char const*)(&(ste[0])));
+    if (section_pushbs(sec, &(ste[0]), t) != 0U){ goto fault_ovr; }
 
    }else if ((t & LITPR_VAL) != 0U){ /* Value */
     if (section_pushb(sec, v) != 0U){ goto fault_ovr; }
@@ -273,6 +266,13 @@ fault_ind:
  fault_printat(FAULT_FAIL, &s[0], cst);
  return PARSER_ERR;
 
+fault_dso:
+
+ compst_setcoffrel(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Overlap or out of section at %04X in \'ds\'", off);
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
 fault_dxs:
 
  compst_setcoffrel(cst, beg);
@@ -0,0 +1,446 @@
+/**
+**  \file
+**  \brief     Procedures and their reachability
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  The procedures are looked up by their section and start offset, ordered
+**  by those. The usages of labels between them are collected as edges (the
+**  index of the using procedure in the high, of the used in the low half),
+**  ordered by the using one, so the marking can walk them from each
+**  procedure reached.
+*/
+
+
+#include "reach.h"
+#include "compst.h"
+#include "section.h"
+#include "relax.h"
+#include "peep.h"
+#include "fault.h"
+#include "strpr.h"
+
+
+/* No procedure (for lookups) */
+#define REACH_NONE  0xFFFFFFFFU
+
+
+/* Procedure */
+typedef struct{
+ uint8  nam[SYMB_MAX];  /* Name */
+ uint8  fil[FILE_MAX];  /* File of the 'proc' */
+ auint  lin;            /* Line of the 'proc' */
+ auint  chr;            /* Character offset of the 'proc' */
+ auint  sec;            /* Section */
+ auint  beg;            /* Start offset */
+ auint  end;            /* End offset */
+ auint  mrk;            /* Nonzero if reachable */
+}reach_prc_t;
+
+
+/* Procedure reachability object structure - definition */
+struct reach_s{
+ reach_prc_t* prc;      /* Procedures collected */
+ auint        cnt;      /* Count of procedures */
+ auint        siz;      /* Size of the procedure array */
+ reach_prc_t  cur;      /* Procedure open or dropped */
+ auint        opn;      /* Nonzero if a procedure is open */
+ auint        skp;      /* Nonzero if within a procedure dropped */
+ auint        ena;      /* Nonzero if the elimination is on */
+ uint64*      ord;      /* Procedures ordered (section, start, index) */
+ uint64*      edg;      /* Edges between procedures */
+ auint        ect;      /* Count of edges */
+ auint        esi;      /* Size of the edge array */
+ auint        fal;      /* Nonzero if an edge could not be added */
+};
+
+
+
+/* Checks for the keyword 'kw' (not a label of the same name) at 'src'.
+** Returns nonzero (TRUE) if it is there. */
+static auint reach_i_iskw(uint8 const* src, char const* kw)
+{
+ return ( (compst_issymequ(NULL, src, (uint8 const*)(kw))) &&
+          (src[strlen(kw)] != (uint8)(':')) );
+}
+
+
+
+/* Compares two ordered entries (for qsort). */
+static int   reach_i_cmp(void const* a, void const* b)
+{
+ uint64 x = *((uint64 const*)(a));
+ uint64 y = *((uint64 const*)(b));
+ return (x > y) - (x < y);
+}
+
+
+
+/* Finds the procedure containing the offset 'off' of section 'sec'. Returns
+** its index or REACH_NONE. */
+static auint reach_i_find(reach_t* hnd, auint sec, auint off)
+{
+ reach_prc_t const* prc;
+ uint64 key = (((uint64)(sec) << 24) | (uint64)(off)) << 32;
+ auint  l = 0U;
+ auint  h = hnd->cnt;
+ auint  m;
+
+ key |= 0xFFFFFFFFU;
+ while (l < h){          /* First after the key */
+  m = (l + h) >> 1;
+  if (hnd->ord[m] <= key){ l = m + 1U; }
+  else{ h = m; }
+ }
+ if (l == 0U){ return REACH_NONE; }
+
+ m = (auint)(hnd->ord[l - 1U] & 0xFFFFFFFFU);
+ prc = &(hnd->prc[m]);
+ if ( (prc->sec != sec) ||
+      ((off >= prc->end) && (off != prc->beg)) ){ return REACH_NONE; }
+ return m;
+}
+
+
+
+/* Collects the use of the label at 'lof' in section 'lsc' by 'uof' in
+** section 'usc' (callback of symtab_labrefs()). */
+static void  reach_i_ref(void* ctx, auint usc, auint uof, auint lsc, auint lof)
+{
+ reach_t* hnd = (reach_t*)(ctx);
+ uint64*  edg;
+ auint    s;
+ auint    d;
+
+ d = reach_i_find(hnd, lsc, lof);
+ if (d == REACH_NONE){ return; }
+ s = reach_i_find(hnd, usc, uof);
+ if (s == d){ return; }
+
+ if (s == REACH_NONE){   /* Used from outside: reachable */
+  hnd->prc[d].mrk = 1U;
+  return;
+ }
+
+ if (hnd->ect == hnd->esi){
+  edg = (uint64*)(realloc(hnd->edg, ((hnd->esi) + 256U) * 2U * sizeof(uint64)));
+  if (edg == NULL){ hnd->fal = 1U; return; }
+  hnd->edg = edg;
+  hnd->esi = ((hnd->esi) + 256U) * 2U;
+ }
+ hnd->edg[hnd->ect] = ((uint64)(s) << 32) | (uint64)(d);
+ hnd->ect ++;
+}
+
+
+
+/* Creates a new procedure reachability object. Returns NULL if it is not
+** possible to allocate it. The object has to be initialized before use. */
+reach_t* reach_new(void)
+{
+ return (reach_t*)(calloc(1U, sizeof(reach_t)));
+}
+
+
+
+/* Deletes a procedure reachability object. */
+void  reach_delete(reach_t* hnd)
+{
+ if (hnd != NULL){
+  free(hnd->prc);
+  free(hnd->ord);
+  free(hnd->edg);
+ }
+ free(hnd);
+}
+
+
+
+/* Initializes or resets a procedure reachability object for a new first pass
+** (no procedures). If 'ena' is nonzero, the procedures are collected for
+** reach_run(), and those set dropped in the relaxation are left out. */
+void  reach_init(reach_t* hnd, auint ena)
+{
+ hnd->cnt = 0U;
+ hnd->opn = 0U;
+ hnd->skp = 0U;
+ hnd->ena = ena;
+}
+
+
+
+/* Checks the current source line for a 'proc' or 'endp' directive,
+** processing it. Returns PARSER_OK if the line has to be assembled (see
+** reach_isskip()), PARSER_END if it was a directive, PARSER_ERR on failure
+** (fault printed). */
+auint reach_proc(reach_t* hnd, symtab_t* stb)
+{
+ uint8        s[80];
+ uint8        lbl[SYMB_MAX + 1U];
+ compst_t*    cst = symtab_getcompst(stb);
+ section_t*   sec = symtab_getsectob(stb);
+ relax_t*     rlx = symtab_getrlx(stb);
+ peep_t*      pep = symtab_getpeep(stb);
+ uint8 const* src = compst_getsstr(cst);
+ reach_prc_t* prc = &(hnd->cur);
+ reach_prc_t* prn;
+ auint        beg = strpr_nextnw(src, 0U);
+ auint        cof = beg;
+ auint        nof;
+ auint        i;
+ auint        v;
+
+ if       (reach_i_iskw(&(src[beg]), "endp")){
+
+  if ((hnd->opn == 0U) && (hnd->skp == 0U)){ goto fault_nop; }
+  beg = strpr_nextnw(src, beg + 4U);
+  if (!strpr_isend(src[beg])){ goto fault_ext; }
+  if (hnd->skp != 0U){
+   hnd->skp = 0U;
+   return PARSER_END;
+  }
+  if ( (section_getsect(sec) != prc->sec) ||
+       (section_getoffw(sec) < prc->beg) ){ goto fault_sec; }
+  prc->end = section_getoffw(sec);
+  hnd->opn = 0U;
+
+  if (hnd->ena != 0U){   /* Collected for finding those not reachable */
+   if (hnd->cnt == hnd->siz){
+    prn = (reach_prc_t*)(realloc(hnd->prc, ((hnd->siz) + 16U) * 2U * sizeof(reach_prc_t)));
+    if (prn == NULL){ goto fault_mem; }
+    hnd->prc = prn;
+    hnd->siz = ((hnd->siz) + 16U) * 2U;
+   }
+   memcpy(&(hnd->prc[hnd->cnt]), prc, sizeof(reach_prc_t));
+   hnd->cnt ++;
+  }
+  return PARSER_END;
+
+ }else if (!reach_i_iskw(&(src[beg]), "proc")){
+
+  return PARSER_OK;
+
+ }else{}
+
+ if ((hnd->opn != 0U) || (hnd->skp != 0U)){ goto fault_nst; }
+ prc->chr = cof;
+ nof = strpr_nextnw(src, beg + 4U);
+ beg = nof;
+ if (!strpr_issym(src[beg])){ goto fault_sym; }
+ compst_copysym(cst, &(prc->nam[0]), &(src[beg]));
+ for (i = 0U; (strpr_issym(src[beg])) && (i < (SYMB_MAX - 1U)); i++){
+  lbl[i] = src[beg];     /* As a line label, to be the global symbol */
+  beg ++;
+ }
+ lbl[i] = (uint8)(':');
+ lbl[i + 1U] = 0U;
+ while (strpr_issym(src[beg])){ beg ++; }
+ beg = strpr_nextnw(src, beg);
+ if (!strpr_isend(src[beg])){ goto fault_ext; }
+
+ strpr_copy(&(prc->fil[0]), compst_getfile(cst), FILE_MAX);
+ prc->lin = compst_getline(cst);
+ prc->sec = section_getsect(sec);
+ prc->beg = section_getoffw(sec);
+ prc->end = prc->beg;
+ prc->mrk = 0U;
+
+ if ( (hnd->ena != 0U) && (rlx != NULL) &&
+      (relax_get(rlx, compst_getfile(cst), compst_getline(cst), &v) == RELAX_DROP) ){
+  hnd->skp = 1U;
+  compst_setcoff(cst, prc->chr);
+  snprintf((char*)(&s[0]), 80U, "Procedure \'%s\' removed, not reachable (%u words)", (char const*)(&(prc->nam[0])), v);
+  fault_printat(FAULT_NOTE, &s[0], cst);
+ }else{
+  hnd->opn = 1U;
+ }
+
+ /* The name is a label (also of a procedure dropped, so its symbols may
+ ** still be referred). With the elimination a jump to it must stay, it
+ ** might not be reached by falling through. */
+
+ compst_setcoff(cst, nof);
+ compst_setgsym(cst, &(lbl[0]));
+ if (pep != NULL){
+  if (hnd->ena != 0U){ peep_bound(pep); }
+  else{ peep_label(pep, stb, &(lbl[0])); }
+ }
+ i = symtab_addsymdef(stb, SYMTAB_CMD_ADD | SYMTAB_CMD_S1N,
+                      section_getoffw(sec), NULL,
+                      0U, section_getsbstr(section_getsect(sec)));
+ if (i == 0U){ return PARSER_ERR; }
+ if (symtab_bind(stb, &(lbl[0]), i)){ return PARSER_ERR; }
+
+ return PARSER_END;
+
+
+fault_nop:
+
+ compst_setcoff(cst, cof);
+ snprintf((char*)(&s[0]), 80U, "\'endp\' without \'proc\'");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_ext:
+
+ compst_setcoff(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Extra characters after procedure directive");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_sec:
+
+ compst_setcoff(cst, cof);
+ snprintf((char*)(&s[0]), 80U, "Procedure has to end in its section after its start");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_mem:
+
+ compst_setcoff(cst, cof);
+ snprintf((char*)(&s[0]), 80U, "Not enough memory for procedures");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_nst:
+
+ compst_setcoff(cst, cof);
+ snprintf((char*)(&s[0]), 80U, "Procedure within procedure");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_sym:
+
+ compst_setcoff(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "Procedure name expected");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+}
+
+
+
+/* Returns nonzero (TRUE) if the current line is within a procedure dropped,
+** then only its symbol definitions and macros have to be processed. */
+auint reach_isskip(reach_t* hnd)
+{
+ return hnd->skp;
+}
+
+
+
+/* Checks at the end of the source file 'fil' (NULL: the end of the first
+** pass) that no procedure begun in it is left open. Returns nonzero (TRUE)
+** if one is, fault printed. */
+auint reach_chkend(reach_t* hnd, uint8 const* fil)
+{
+ uint8        s[80];
+ reach_prc_t const* prc = &(hnd->cur);
+ fault_off_t  fof;
+
+ if ((hnd->opn == 0U) && (hnd->skp == 0U)){ return 0U; }
+ if ( (fil != NULL) &&
+      (strcmp((char const*)(&(prc->fil[0])), (char const*)(fil)) != 0) ){ return 0U; }
+
+ fof.fil = &(prc->fil[0]);
+ fof.lin = prc->lin;
+ fof.chr = prc->chr;
+ snprintf((char*)(&s[0]), 80U, "Procedure not closed by \'endp\'");
+ fault_print(FAULT_FAIL, &s[0], &fof);
+ return 1U;
+}
+
+
+
+/* Finds the procedures not reachable after the first pass (before resolving
+** the symbols), and sets them dropped in the relaxation of the symbol table
+** if any. Does nothing if the elimination is off. Returns nonzero (TRUE) on
+** failure, fault printed. */
+auint reach_run(reach_t* hnd, symtab_t* stb)
+{
+ uint8        s[80];
+ relax_t*     rlx = symtab_getrlx(stb);
+ reach_prc_t* prc;
+ uint64*      ord;
+ auint        spc;
+ auint        l;
+ auint        h;
+ auint        m;
+ auint        i;
+ auint        d;
+
+ if ((hnd->ena == 0U) || (rlx == NULL) || (hnd->cnt == 0U)){ return 0U; }
+ prc = hnd->prc;
+
+ /* Procedures ordered for the lookups */
+
+ ord = (uint64*)(realloc(hnd->ord, (hnd->cnt) * sizeof(uint64)));
+ if (ord == NULL){ goto fault_mem; }
+ hnd->ord = ord;
+ for (i = 0U; i < (hnd->cnt); i++){
+  ord[i] = (((uint64)(prc[i].sec) << 24) | (uint64)(prc[i].beg)) << 32;
+  ord[i] |= (uint64)(i);
+  prc[i].mrk = 0U;
+ }
+ qsort(ord, hnd->cnt, sizeof(uint64), reach_i_cmp);
+
+ /* Edges by the usages of labels. Those used from outside the procedures
+ ** are marked reachable, and so is the one at the start of the code. */
+
+ hnd->ect = 0U;
+ hnd->fal = 0U;
+ if (symtab_labrefs(stb, reach_i_ref, hnd)){ goto fault_mem; }
+ if (hnd->fal != 0U){ goto fault_mem; }
+ i = reach_i_find(hnd, SECT_CODE, 0U);
+ if (i != REACH_NONE){ prc[i].mrk = 1U; }
+ qsort(hnd->edg, hnd->ect, sizeof(uint64), reach_i_cmp);
+
+ /* Mark along the edges from the reachable procedures (the ordered array is
+ ** the stack, each procedure is pushed only once) */
+
+ spc = 0U;
+ for (i = 0U; i < (hnd->cnt); i++){
+  if (prc[i].mrk != 0U){
+   ord[spc] = i;
+   spc ++;
+  }
+ }
+ while (spc != 0U){
+  spc --;
+  i = (auint)(ord[spc]);
+  l = 0U;
+  h = hnd->ect;
+  while (l < h){         /* First edge from the procedure */
+   m = (l + h) >> 1;
+   if ((hnd->edg[m] >> 32) < i){ l = m + 1U; }
+   else{ h = m; }
+  }
+  for (; (l < hnd->ect) && ((hnd->edg[l] >> 32) == i); l++){
+   d = (auint)(hnd->edg[l] & 0xFFFFFFFFU);
+   if (prc[d].mrk == 0U){
+    prc[d].mrk = 1U;
+    ord[spc] = d;
+    spc ++;
+   }
+  }
+ }
+
+ /* The rest are dropped when assembling again */
+
+ for (i = 0U; i < (hnd->cnt); i++){
+  if (prc[i].mrk == 0U){
+   relax_set(rlx, &(prc[i].fil[0]), prc[i].lin, RELAX_DROP, prc[i].end - prc[i].beg);
+  }
+ }
+
+ return 0U;
+
+fault_mem:
+
+ snprintf((char*)(&s[0]), 80U, "Not enough memory to find the procedures not reachable");
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
+}
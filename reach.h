@@ -0,0 +1,84 @@
+/**
+**  \file
+**  \brief     Procedures and their reachability
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Manages the 'proc' and 'endp' directives of the first pass, which enclose
+**  a procedure or a block of data:
+**
+**  proc name
+**  ...
+**  endp
+**
+**  The 'proc' defines 'name' as a label. When the elimination is on, the
+**  procedures are collected, and after the first pass those not reachable
+**  are found by the symbol usages (see symtab_labrefs()): everything outside
+**  the procedures, and the procedure at the start of the code is reachable,
+**  and so is any procedure a label of which is used by a reachable one. The
+**  rest are set dropped in the relaxation (see relax.h), and when the
+**  assembly is repeated, their contents are left out, so everything after
+**  them moves. Only their labels and 'equ' symbols are defined (at the
+**  offset they would start at), and their macros are expanded to keep the
+**  rest of the source the same. Every removal is reported by a note.
+*/
+
+
+#ifndef REACH_H
+#define REACH_H
+
+
+#include "types.h"
+#include "symtab.h"
+
+
+/* Procedure reachability object structure */
+typedef struct reach_s reach_t;
+
+
+
+/* Creates a new procedure reachability object. Returns NULL if it is not
+** possible to allocate it. The object has to be initialized before use. */
+reach_t* reach_new(void);
+
+
+/* Deletes a procedure reachability object. */
+void  reach_delete(reach_t* hnd);
+
+
+/* Initializes or resets a procedure reachability object for a new first pass
+** (no procedures). If 'ena' is nonzero, the procedures are collected for
+** reach_run(), and those set dropped in the relaxation are left out. */
+void  reach_init(reach_t* hnd, auint ena);
+
+
+/* Checks the current source line for a 'proc' or 'endp' directive,
+** processing it. Returns PARSER_OK if the line has to be assembled (see
+** reach_isskip()), PARSER_END if it was a directive, PARSER_ERR on failure
+** (fault printed). */
+auint reach_proc(reach_t* hnd, symtab_t* stb);
+
+
+/* Returns nonzero (TRUE) if the current line is within a procedure dropped,
+** then only its symbol definitions and macros have to be processed. */
+auint reach_isskip(reach_t* hnd);
+
+
+/* Checks at the end of the source file 'fil' (NULL: the end of the first
+** pass) that no procedure begun in it is left open. Returns nonzero (TRUE)
+** if one is, fault printed. */
+auint reach_chkend(reach_t* hnd, uint8 const* fil);
+
+
+/* Finds the procedures not reachable after the first pass (before resolving
+** the symbols), and sets them dropped in the relaxation of the symbol table
+** if any. Does nothing if the elimination is off. Returns nonzero (TRUE) on
+** failure, fault printed. */
+auint reach_run(reach_t* hnd, symtab_t* stb);
+
+
+#endif
@@ -0,0 +1,204 @@
+/**
+**  \file
+**  \brief     Jump relaxation
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  The lines are kept in an open addressing hash table keyed by the file
+**  (index of its name) and the line number. The table is grown to keep it at
+**  most half full.
+*/
+
+
+#include "relax.h"
+#include "compst.h"
+#include "strpr.h"
+
+
+/* Initial size of the hash table (power of 2) */
+#define RELAX_HSI  256U
+
+
+/* Line entry */
+typedef struct{
+ auint  fid;            /* File index + 1 (0: empty slot) */
+ auint  lin;            /* Line number */
+ auint  frm;            /* Form (one of the RELAX_ forms except RELAX_NONE) */
+ auint  val;            /* Value of the form (RELAX_SHORT or RELAX_DROP) */
+}relax_ent_t;
+
+
+/* Jump relaxation object structure - definition */
+struct relax_s{
+ relax_ent_t* ent;      /* Hash table of lines */
+ auint        esi;      /* Size of the hash table */
+ auint        cnt;      /* Count of lines */
+ auint        chg;      /* Count of changes */
+ uint8*       fnm;      /* File names (FILE_MAX bytes each) */
+ auint        fct;      /* Count of file names */
+ auint        fsi;      /* Capacity of file names */
+};
+
+
+
+/* Finds the index of a file name. Returns the count of file names if it is
+** not present. */
+static auint relax_i_file(relax_t const* hnd, uint8 const* fil)
+{
+ auint i;
+
+ for (i = 0U; i < (hnd->fct); i++){
+  if (strcmp((char const*)(&(hnd->fnm[i * FILE_MAX])), (char const*)(fil)) == 0){ break; }
+ }
+
+ return i;
+}
+
+
+
+/* Finds the slot of a line in the hash table: either the one holding it, or
+** the empty slot where it would go. 'fid' is the file index + 1. */
+static auint relax_i_slot(relax_ent_t const* ent, auint esi, auint fid, auint lin)
+{
+ auint i = ((lin * 0x9E3779B1U) ^ (fid * 0x85EBCA6BU)) & (esi - 1U);
+
+ while (ent[i].fid != 0U){
+  if ((ent[i].fid == fid) && (ent[i].lin == lin)){ break; }
+  i = (i + 1U) & (esi - 1U);
+ }
+
+ return i;
+}
+
+
+
+/* Creates a new jump relaxation object. Returns NULL if it is not possible
+** to allocate it. The object has to be initialized before use. */
+relax_t* relax_new(void)
+{
+ return (relax_t*)(calloc(1U, sizeof(relax_t)));
+}
+
+
+
+/* Deletes a jump relaxation object. */
+void  relax_delete(relax_t* hnd)
+{
+ if (hnd != NULL){
+  free(hnd->ent);
+  free(hnd->fnm);
+ }
+ free(hnd);
+}
+
+
+
+/* Initializes or resets a jump relaxation object as empty (no forms set). */
+void  relax_init(relax_t* hnd)
+{
+ if (hnd->ent != NULL){
+  memset(hnd->ent, 0, sizeof(relax_ent_t) * (hnd->esi));
+ }
+ hnd->cnt = 0U;
+ hnd->chg = 0U;
+ hnd->fct = 0U;
+}
+
+
+
+/* Sets the form 'frm' (RELAX_SHORT or RELAX_DROP with the value 'val', or
+** RELAX_LONG) for the line 'lin' of file 'fil'. Only moves the line to a
+** later form. Returns nonzero (TRUE) if the form was changed, zero if it
+** already had this or a later form, or if it can not be changed (no
+** memory). */
+auint relax_set(relax_t* hnd, uint8 const* fil, auint lin, auint frm, auint val)
+{
+ relax_ent_t* ent;
+ uint8*       fnm;
+ auint        esi;
+ auint        fid;
+ auint        i;
+ auint        j;
+
+ /* File name */
+
+ fid = relax_i_file(hnd, fil);
+ if (fid == (hnd->fct)){
+  if ((hnd->fct) == (hnd->fsi)){
+   i = ((hnd->fsi) == 0U) ? 16U : ((hnd->fsi) << 1);
+   fnm = (uint8*)(realloc(hnd->fnm, (size_t)(i) * FILE_MAX));
+   if (fnm == NULL){ return 0U; }
+   hnd->fnm = fnm;
+   hnd->fsi = i;
+  }
+  strpr_copy(&(hnd->fnm[fid * FILE_MAX]), fil, FILE_MAX);
+  hnd->fct ++;
+ }
+ fid ++;
+
+ /* Grow the table if it would get over half full */
+
+ if ( ((hnd->esi) == 0U) ||
+      (((hnd->cnt + 1U) << 1) > (hnd->esi)) ){
+  esi = ((hnd->esi) == 0U) ? RELAX_HSI : ((hnd->esi) << 1);
+  ent = (relax_ent_t*)(calloc(esi, sizeof(relax_ent_t)));
+  if (ent == NULL){ return 0U; }
+  for (i = 0U; i < (hnd->esi); i++){
+   if (hnd->ent[i].fid != 0U){
+    j = relax_i_slot(ent, esi, hnd->ent[i].fid, hnd->ent[i].lin);
+    ent[j] = hnd->ent[i];
+   }
+  }
+  free(hnd->ent);
+  hnd->ent = ent;
+  hnd->esi = esi;
+ }
+
+ /* Add the line or move it to the later form */
+
+ i = relax_i_slot(hnd->ent, hnd->esi, fid, lin);
+ if (hnd->ent[i].fid == 0U){
+  hnd->ent[i].fid = fid;
+  hnd->ent[i].lin = lin;
+  hnd->cnt ++;
+ }else if (hnd->ent[i].frm >= frm){
+  return 0U;
+ }else{}
+ hnd->ent[i].frm = frm;
+ hnd->ent[i].val = val;
+ hnd->chg ++;
+
+ return 1U;
+}
+
+
+
+/* Gets the form of the line 'lin' of file 'fil' (one of the RELAX_ forms),
+** for RELAX_SHORT and RELAX_DROP the value in 'val'. May be called
+** concurrently while nothing is set. */
+auint relax_get(relax_t const* hnd, uint8 const* fil, auint lin, auint* val)
+{
+ auint fid;
+ auint i;
+
+ if ((hnd->cnt) == 0U){ return RELAX_NONE; }
+ fid = relax_i_file(hnd, fil);
+ if (fid == (hnd->fct)){ return RELAX_NONE; }
+ i = relax_i_slot(hnd->ent, hnd->esi, fid + 1U, lin);
+ if (hnd->ent[i].fid == 0U){ return RELAX_NONE; }
+
+ *val = hnd->ent[i].val;
+ return hnd->ent[i].frm;
+}
+
+
+
+/* Gets the count of changes since the initialization. */
+auint relax_count(relax_t const* hnd)
+{
+ return hnd->chg;
+}
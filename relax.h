@@ -0,0 +1,85 @@
+/**
+**  \file
+**  \brief     Jump relaxation
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Collects the instruction forms to use on source lines, found by earlier
+**  rounds of the assembly:
+**
+**  - Relaxable jumps ('jmp') are first encoded in their short form (JMS). If
+**    the target turns out to be out of range when resolving the symbols, the
+**    line is set long, and the assembly is repeated, encoding it long (JMA).
+**  - Symbolic immediates not known in the first pass are encoded long. If
+**    the value turns out to fit a shorter form when resolving, the line is
+**    set short with the value, and in the next round it is encoded as if the
+**    value was known (checking it when resolving). If it changes (since code
+**    moved), the line is set long, so it stays long from then.
+**  - Instructions found redundant by the peephole optimizer (see peep.h)
+**    which were encoded earlier are set dropped, and they are not encoded in
+**    the next round.
+**
+**  This goes on until a round needs no more changes. The form of a line only
+**  changes in one direction (from none to short to long to dropped), so this
+**  ends.
+*/
+
+
+#ifndef RELAX_H
+#define RELAX_H
+
+
+#include "types.h"
+
+
+/* Jump relaxation object structure */
+typedef struct relax_s relax_t;
+
+
+/* Forms of a line: Not set (the initial form) */
+#define RELAX_NONE  0U
+/* Forms of a line: Short, with the value of the immediate */
+#define RELAX_SHORT 1U
+/* Forms of a line: Long */
+#define RELAX_LONG  2U
+/* Forms of a line: Dropped, with the peephole pattern (see peep.h) */
+#define RELAX_DROP  3U
+
+
+
+/* Creates a new jump relaxation object. Returns NULL if it is not possible
+** to allocate it. The object has to be initialized before use. */
+relax_t* relax_new(void);
+
+
+/* Deletes a jump relaxation object. */
+void  relax_delete(relax_t* hnd);
+
+
+/* Initializes or resets a jump relaxation object as empty (no forms set). */
+void  relax_init(relax_t* hnd);
+
+
+/* Sets the form 'frm' (RELAX_SHORT or RELAX_DROP with the value 'val', or
+** RELAX_LONG) for the line 'lin' of file 'fil'. Only moves the line to a
+** later form. Returns nonzero (TRUE) if the form was changed, zero if it
+** already had this or a later form, or if it can not be changed (no
+** memory). */
+auint relax_set(relax_t* hnd, uint8 const* fil, auint lin, auint frm, auint val);
+
+
+/* Gets the form of the line 'lin' of file 'fil' (one of the RELAX_ forms),
+** for RELAX_SHORT and RELAX_DROP the value in 'val'. May be called
+** concurrently while nothing is set. */
+auint relax_get(relax_t const* hnd, uint8 const* fil, auint lin, auint* val);
+
+
+/* Gets the count of changes since the initialization. */
+auint relax_count(relax_t const* hnd);
+
+
+#endif
@@ -2,19 +2,25 @@
 **  \file
 **  \brief     Section & Data management
 **  \author    Sandor Zsuga (Jubatian)
-**  \copyright 2013 - 2014, GNU GPLv3 (version 3 of the GNU General Public
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
 **             License) extended as RRPGEvt (temporary version of the RRPGE
 **             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
 **             root.
-**  \date      2015.02.17
+**  \date      2015.10.01
 **
-**  Manages the sections and their data during the compilation. Currently
-**  singleton, but desinged so it is possible to extend later.
+**  Manages the sections and their data during the compilation.
+**
+**  The section data and occupation maps are stored in pages, which are only
+**  allocated when something is first written in them. Areas in pages not
+**  allocated are unoccupied, and read as zero.
 */
 
 
 
 #include "section.h"
+#ifdef TARGET_DEBUG
+#include "fault.h"
+#endif
 
 
 
@@ -26,21 +32,23 @@
 
 
 
-/* Section sizes and start offsets in a combined data block */
+/* Section sizes */
 #define CODE_S 65536U
 #define DATA_S SECT_MAXRAM
 #define HEAD_S 65536U
 #define DESC_S 32U
 #define ZERO_S SECT_MAXRAM
-#define CODE_O (0U)
-#define DATA_O (CODE_O + CODE_S)
-#define HEAD_O (DATA_O + DATA_S)
-#define DESC_O (HEAD_O + HEAD_S)
-#define ZERO_O (DESC_O + DESC_S)
 
 /* Maximal section size */
 #define SECT_MAX 65536U
 
+/* Page size in words (as shift), and mask for offset within page */
+#define SECT_PGS 10U
+#define SECT_PGW (1U << SECT_PGS)
+#define SECT_PGM (SECT_PGW - 1U)
+/* Maximal count of pages in a section */
+#define SECT_PGC (SECT_MAX >> SECT_PGS)
+
 /* Maximal section ID which has data */
 #define SECT_IDM_D SECT_DESC
 /* Maximal section ID which has map */
@@ -50,14 +58,28 @@
 
 
 
+/* Section page structure. Pages of sections without data are allocated
+** without the data part. */
+typedef struct{
+ uint32 o[SECT_PGW >> 5];  /* Occupation map */
+ uint16 d[SECT_PGW];       /* Data */
+}section_pg_t;
+
+
 /* Section object structure - definition */
 struct section_s{
  auint  s;              /* Currently selected section */
  auint  p[6];           /* Current pointer within section */
  auint  b[6];           /* Byte sub-offset (0 for high byte, 1 for low) */
  auint  a[6];           /* Base offset */
- uint16 d[(CODE_S + DATA_S + HEAD_S + DESC_S)];               /* Section data */
- uint32 o[(CODE_S + DATA_S + HEAD_S + DESC_S + ZERO_S) >> 5]; /* Section occupation map */
+ auint  h[6];           /* High-water mark: last occupied word + 1 */
+ section_pg_t* g[5][SECT_PGC]; /* Pages (NULL: not allocated yet) */
+ uint32* t;             /* Occupation tracking marks (NULL: tracking off) */
+ auint  dtr;            /* Dependence tracking on */
+ auint  drl;            /* Dependence tracking: mask of relocated sections */
+ auint  dsl;            /* Dependence tracking: a section was selected */
+ auint  dor;            /* Dependence tracking: mask of sections set (org) */
+ auint  dep;            /* Dependence tracking: depends on starting state */
 };
 
 
@@ -70,14 +92,6 @@ static auint const section_s[5] = {
  DESC_S,                /* Desc */
  ZERO_S};               /* Zero */
 
-/* Section start offsets within section data */
-static auint const section_o[5] = {
- CODE_O,                /* Code */
- DATA_O,                /* Data */
- HEAD_O,                /* Head */
- DESC_O,                /* Desc */
- ZERO_O};               /* Zero (in map only) */
-
 
 
 /* Section base symbols */
@@ -92,36 +106,230 @@ static uint8 const* section_secbs[6] = {
 
 
 
-/* Internal section object */
-static section_t section_obj;
+/* Internal function to get the page holding the given word offset of a
+** section having map. If 'alc' is nonzero, the page is allocated if it does
+** not exist yet. Returns NULL if the page does not exist (or can not be
+** allocated). */
+static section_pg_t* section_i_getpg(section_t* hnd, auint s, auint off, auint alc)
+{
+ section_pg_t* pg = hnd->g[s][off >> SECT_PGS];
 
+ if ((pg == NULL) && (alc != 0U)){
+  if (s <= SECT_IDM_D){  /* Sections with data */
+   pg = calloc(1U, sizeof(section_pg_t));
+  }else{                 /* Map only */
+   pg = calloc(1U, sizeof(section_pg_t) - sizeof(pg->d));
+  }
+  hnd->g[s][off >> SECT_PGS] = pg;
+ }
+
+ return pg;
+}
 
 
-/* Internal set function for an occupation map */
-static void  section_i_setocc(auint off, uint32* map, auint siz)
+
+/* Internal get function for the occupation map of a section having map. */
+static auint section_i_getocc(section_t* hnd, auint s, auint off)
 {
- if (siz > off){
-  map[off >> 5] |= (auint)(1U) << (off & 0x1FU);
+ section_pg_t* pg;
+
+ if (section_s[s] > off){
+  pg = hnd->g[s][off >> SECT_PGS];
+  if (pg != NULL){
+   off &= SECT_PGM;
+   return ((pg->o[off >> 5] >> (off & 0x1FU)) & 1U);
+  }
  }
+ return 0U;
 }
 
 
 
-/* Internal get function for an occupation map */
-static auint section_i_getocc(auint off, uint32 const* map, auint siz)
+/* Internal function to find the first occupied word within a range of the
+** occupation map ('beg' inclusive, 'end' exclusive). Works a map word at a
+** time, skipping pages not allocated. Returns 'end' if the range is free. */
+static auint section_i_findocc(section_t* hnd, auint s, auint beg, auint end)
 {
- if (siz > off){
-  return ((map[off >> 5] >> (off & 0x1FU)) & 1U);
+ section_pg_t* pg;
+ auint  i;
+ uint32 m;
+
+ while (beg < end){
+  pg = hnd->g[s][beg >> SECT_PGS];
+  if (pg == NULL){       /* Nothing occupied in this page */
+   beg = (beg & ~(auint)(SECT_PGM)) + SECT_PGW;
+   continue;
+  }
+  i = (beg & SECT_PGM) >> 5;
+  m = pg->o[i] & ((uint32)(0xFFFFFFFFU) << (beg & 0x1FU));
+  if ((end - (beg & ~(auint)(0x1FU))) < 32U){ /* Range ends in this map word */
+   m &= ((uint32)(1U) << (end & 0x1FU)) - 1U;
+  }
+  if (m != 0U){
+   beg = beg & ~(auint)(0x1FU);
+   while ((m & 1U) == 0U){ m >>= 1; beg ++; }
+   return beg;
+  }
+  beg = (beg & ~(auint)(0x1FU)) + 32U;
+ }
+
+ return end;
+}
+
+
+
+/* Internal function to occupy a range of the occupation map ('beg'
+** inclusive, 'end' exclusive). Works a map word at a time. The range must be
+** within the section. The necessary pages are allocated first, so nothing is
+** occupied if it fails. Returns nonzero (TRUE) on failure. */
+static auint section_i_setoccr(section_t* hnd, auint s, auint beg, auint end)
+{
+ section_pg_t* pg;
+ auint  i;
+ uint32 m;
+
+ if (beg >= end){ return 0U; }
+
+ for (i = (beg >> SECT_PGS); i <= ((end - 1U) >> SECT_PGS); i++){
+  if (section_i_getpg(hnd, s, i << SECT_PGS, 1U) == NULL){ return 1U; }
+ }
+
+ while (beg < end){
+  pg = hnd->g[s][beg >> SECT_PGS];
+  i = (beg & SECT_PGM) >> 5;
+  m = (uint32)(0xFFFFFFFFU) << (beg & 0x1FU);
+  if ((end - (beg & ~(auint)(0x1FU))) < 32U){ /* Range ends in this map word */
+   m &= ((uint32)(1U) << (end & 0x1FU)) - 1U;
+  }
+  pg->o[i] |= m;
+  if (hnd->t != NULL){
+   hnd->t[(s * (SECT_MAX >> 5)) + (beg >> 5)] |= m;
+  }
+  beg = (beg & ~(auint)(0x1FU)) + 32U;
  }
+
  return 0U;
 }
 
 
 
-/* Get built-in singleton object handle. */
-section_t* section_getobj(void)
+/* Internal function to occupy a single word of a section having map,
+** allocating the page if necessary. Returns the page, or NULL if it can not
+** be allocated. */
+static section_pg_t* section_i_setocc(section_t* hnd, auint s, auint off)
+{
+ section_pg_t* pg = section_i_getpg(hnd, s, off, 1U);
+
+ if (pg != NULL){
+  pg->o[(off & SECT_PGM) >> 5] |= (uint32)(1U) << (off & 0x1FU);
+  if (hnd->t != NULL){
+   hnd->t[(s * (SECT_MAX >> 5)) + (off >> 5)] |= (uint32)(1U) << (off & 0x1FU);
+  }
+ }
+
+ return pg;
+}
+
+
+
+/* Internal function to raise the high-water mark of a section to cover the
+** given (just occupied) word offset. */
+static void  section_i_sethwm(section_t* hnd, auint s, auint off)
+{
+ if ((hnd->h[s]) <= off){
+  hnd->h[s] = off + 1U;
+ }
+}
+
+
+
+#ifdef TARGET_DEBUG
+/* Internal function to find the size of a section having map (last occupied
+** word + 1) by scanning the occupation map from the top, one map word at a
+** time, skipping pages not allocated. Only used to verify the high-water
+** marks in test builds. */
+static auint section_i_scansize(section_t* hnd, auint s)
+{
+ auint  i = (section_s[s] + 31U) >> 5;
+ uint32 m;
+ auint  r;
+ section_pg_t* pg;
+
+ while (i != 0U){
+  i --;
+  pg = hnd->g[s][(i << 5) >> SECT_PGS];
+  if (pg == NULL){       /* Skip to the previous page */
+   i &= ~(auint)((SECT_PGW >> 5) - 1U);
+   continue;
+  }
+  m = pg->o[i & ((SECT_PGW >> 5) - 1U)];
+  if (m != 0U){
+#if defined(__GNUC__)
+   r = 32U - (auint)(__builtin_clz(m));
+#else
+   r = 0U;
+   while (m != 0U){ m >>= 1; r ++; }
+#endif
+   return ((i << 5) + r);
+  }
+ }
+
+ return 0U;
+}
+#endif
+
+
+
+/* Internal function to free all pages and the tracking marks of a section
+** object. */
+static void  section_i_freepg(section_t* hnd)
+{
+ auint i;
+ auint j;
+
+ free(hnd->t);
+ hnd->t = NULL;
+
+ for (i = 0U; i <= SECT_IDM_M; i++){
+  for (j = 0U; j < SECT_PGC; j++){
+   free(hnd->g[i][j]);
+   hnd->g[i][j] = NULL;
+  }
+ }
+}
+
+
+
+/* Marks the use of the pointer of the current section for dependence
+** tracking: it depends on the starting state if no section was selected
+** yet, or the section is not relocated and its pointer was not set. */
+static void  section_i_dep(section_t* hnd)
+{
+ if (hnd->dtr == 0U){ return; }
+ if ( ((hnd->dsl) == 0U) ||
+      ((((hnd->drl) | (hnd->dor)) & (1U << (hnd->s))) == 0U) ){
+  hnd->dep = 1U;
+ }
+}
+
+
+
+/* Creates a new section object. Returns NULL if it is not possible to
+** allocate it. The object has to be initialized before use. */
+section_t* section_new(void)
 {
- return &section_obj;
+ return (section_t*)(calloc(1U, sizeof(section_t))); /* No pages yet */
+}
+
+
+
+/* Deletes a section object, freeing any page allocated for it. */
+void  section_delete(section_t* hnd)
+{
+ if (hnd != NULL){
+  section_i_freepg(hnd);
+ }
+ free(hnd);
 }
 
 
@@ -139,9 +347,11 @@ uint8 const* section_getsbstr(auint sec)
 
 
 
-/* Initializes or resets a section object. */
+/* Initializes or resets a section object. Any page allocated earlier is
+** freed. */
 void  section_init(section_t* hnd)
 {
+ section_i_freepg(hnd);
  memset(hnd, 0U, sizeof(section_t));
  hnd->s = SECT_CODE; /* Select code section initially */
 }
@@ -153,6 +363,7 @@ void  section_setsect(section_t* hnd, auint sect)
 {
  if (sect <= SECT_IDM){
   hnd->s = sect;
+  hnd->dsl = 1U;
  }
 }
 
@@ -169,6 +380,11 @@ auint section_getsect(section_t* hnd)
 /* Sets offset within section, word granularity. */
 void  section_setoffw(section_t* hnd, auint off)
 {
+ if (hnd->dtr != 0U){
+  if ( ((hnd->dsl) == 0U) ||
+       (((hnd->drl) & (1U << (hnd->s))) != 0U) ){ hnd->dep = 1U; }
+  hnd->dor |= 1U << (hnd->s);
+ }
  hnd->p[hnd->s] = off;
  hnd->b[hnd->s] = 0U;
 }
@@ -180,6 +396,8 @@ auint section_getoffw(section_t* hnd)
 {
  auint s = hnd->s;
 
+ section_i_dep(hnd);
+
  if (hnd->b[s] != 0U){ /* Need to advance to next word (partially used word) */
   hnd->p[s] ++;
   hnd->b[s] = 0U;
@@ -193,6 +411,7 @@ auint section_getoffw(section_t* hnd)
 /* Gets byte offset for a subsequent use with section_setb(). */
 auint section_getoffb(section_t* hnd)
 {
+ section_i_dep(hnd);
  return (((hnd->p[hnd->s]) << 1) + (hnd->b[hnd->s]));
 }
 
@@ -204,6 +423,9 @@ auint section_getoffb(section_t* hnd)
 auint section_pushw(section_t* hnd, auint data)
 {
  auint s = hnd->s;
+ section_pg_t* pg;
+
+ section_i_dep(hnd);
 
  if (hnd->b[s] != 0U){ /* Need to advance to next word */
   hnd->p[s] ++;
@@ -215,13 +437,17 @@ auint section_pushw(section_t* hnd, auint data)
   if (section_s[s] <= (hnd->p[s])){
    return SECT_ERR_OVF;   /* Offset too large for section */
   }
-  if (section_i_getocc(hnd->p[s], &(hnd->o[section_o[s] >> 5]), section_s[s]) != 0U){
+  if (section_i_getocc(hnd, s, hnd->p[s]) != 0U){
    return SECT_ERR_OVR;   /* Already occupied */
   }
 
-  section_i_setocc(hnd->p[s], &(hnd->o[section_o[s] >> 5]), section_s[s]);
+  pg = section_i_setocc(hnd, s, hnd->p[s]);
+  if (pg == NULL){
+   return SECT_ERR_MEM;   /* No memory for page */
+  }
+  section_i_sethwm(hnd, s, hnd->p[s]);
   if (s <= SECT_IDM_D){   /* Sections with data: add it */
-   hnd->d[section_o[s] + hnd->p[s]] |= (uint16)(data);
+   pg->d[hnd->p[s] & SECT_PGM] |= (uint16)(data);
   }
 
  }
@@ -237,6 +463,9 @@ auint section_pushw(section_t* hnd, auint data)
 auint section_pushb(section_t* hnd, auint data)
 {
  auint s = hnd->s;
+ section_pg_t* pg;
+
+ section_i_dep(hnd);
 
  if (s <= SECT_IDM_M){    /* Sections with map: test */
 
@@ -244,14 +473,18 @@ auint section_pushb(section_t* hnd, auint data)
    return SECT_ERR_OVF;   /* Offset too large for section */
   }
   if ((hnd->b[s]) == 0U){ /* Only check overlap on boundary */
-   if (section_i_getocc(hnd->p[s], &(hnd->o[section_o[s] >> 5]), section_s[s]) != 0U){
+   if (section_i_getocc(hnd, s, hnd->p[s]) != 0U){
     return SECT_ERR_OVR;  /* Already occupied */
    }
   }
 
-  section_i_setocc(hnd->p[s], &(hnd->o[section_o[s] >> 5]), section_s[s]);
+  pg = section_i_setocc(hnd, s, hnd->p[s]);
+  if (pg == NULL){
+   return SECT_ERR_MEM;   /* No memory for page */
+  }
+  section_i_sethwm(hnd, s, hnd->p[s]);
   if (s <= SECT_IDM_D){   /* Sections with data: add it */
-   hnd->d[section_o[s] + hnd->p[s]] |= (uint16)((data & 0xFFU) << ((1U ^ (hnd->b[s])) << 3));
+   pg->d[hnd->p[s] & SECT_PGM] |= (uint16)((data & 0xFFU) << ((1U ^ (hnd->b[s])) << 3));
   }
 
  }
@@ -268,17 +501,209 @@ auint section_pushb(section_t* hnd, auint data)
 
 
 
+/* Pushes a span of byte data to the section, equivalent to pushing the bytes
+** one by one with section_pushb(), but checking and occupying the whole range
+** in one pass. Returns error code on failure (overlap or out of section's
+** allowed size), then nothing is pushed. */
+auint section_pushbs(section_t* hnd, uint8 const* src, auint len)
+{
+ auint   s = hnd->s;
+ auint   fw;              /* First newly occupied word */
+ auint   nw;              /* Count of newly occupied words */
+ auint   bc;              /* Count of bytes going in new words */
+ auint   i;
+ auint   j;
+ auint   k;
+ uint16* d;
+ uint8*  db;
+
+ section_i_dep(hnd);
+
+ if (len == 0U){ return SECT_ERR_OK; }
+
+ fw = hnd->p[s] + hnd->b[s];
+ bc = len - hnd->b[s];
+ nw = (bc + 1U) >> 1;
+
+ if (s <= SECT_IDM_M){    /* Sections with map: test */
+
+  if (section_s[s] <= (hnd->p[s])){
+   return SECT_ERR_OVF;   /* Offset too large for section */
+  }
+  if ((section_s[s] - fw) < nw){
+   return SECT_ERR_OVF;   /* Span extends beyond the section */
+  }
+  if (section_i_findocc(hnd, s, fw, fw + nw) != (fw + nw)){
+   return SECT_ERR_OVR;   /* Already occupied */
+  }
+
+  if (nw != 0U){
+   if (section_i_setoccr(hnd, s, fw, fw + nw)){
+    return SECT_ERR_MEM;  /* No memory for pages */
+   }
+   section_i_sethwm(hnd, s, fw + nw - 1U);
+  }
+
+  if (s <= SECT_IDM_D){   /* Sections with data: add it */
+   if (hnd->b[s] != 0U){  /* Complete the partially used word first */
+    hnd->g[s][hnd->p[s] >> SECT_PGS]->d[hnd->p[s] & SECT_PGM] |= (uint16)(src[0]);
+    src ++;
+   }
+   /* The new words are unoccupied, so they are zero: copy the bytes in page
+   ** by page, then convert them from Big Endian in place. */
+   i = 0U;
+   while (i < nw){
+    d  = &(hnd->g[s][(fw + i) >> SECT_PGS]->d[(fw + i) & SECT_PGM]);
+    db = (uint8*)(d);
+    k  = SECT_PGW - ((fw + i) & SECT_PGM); /* Words until end of page */
+    if (k > (nw - i)){ k = nw - i; }
+    j  = k << 1;                           /* Bytes in these words */
+    if (j > (bc - (i << 1))){              /* Last word half filled */
+     j = bc - (i << 1);
+     db[j] = 0U;
+    }
+    memcpy(db, &(src[i << 1]), j);
+    for (j = 0U; j < k; j++){
+     d[j] = (uint16)(((auint)(db[(j << 1)     ]) << 8) |
+                      (auint)(db[(j << 1) + 1U]));
+    }
+    i += k;
+   }
+  }
+
+ }
+
+ i = (hnd->p[s] << 1) + hnd->b[s] + len;
+ hnd->p[s] = i >> 1;
+ hnd->b[s] = i &  1U;
+ return SECT_ERR_OK;
+}
+
+
+
+/* Pushes a span of word data to the section, equivalent to pushing the words
+** one by one with section_pushw(), but checking and occupying the whole range
+** in one pass. Returns error code on failure (overlap or out of section's
+** allowed size), then nothing is pushed. */
+auint section_pushws(section_t* hnd, uint16 const* src, auint len)
+{
+ auint s = hnd->s;
+ auint i;
+ auint k;
+ auint o;
+
+ section_i_dep(hnd);
+
+ if (len == 0U){ return SECT_ERR_OK; }
+
+ if (hnd->b[s] != 0U){ /* Need to advance to next word */
+  hnd->p[s] ++;
+  hnd->b[s] = 0U;
+ }
+
+ if (s <= SECT_IDM_M){    /* Sections with map: test */
+
+  if (section_s[s] <= (hnd->p[s])){
+   return SECT_ERR_OVF;   /* Offset too large for section */
+  }
+  if ((section_s[s] - (hnd->p[s])) < len){
+   return SECT_ERR_OVF;   /* Span extends beyond the section */
+  }
+  if (section_i_findocc(hnd, s, hnd->p[s], hnd->p[s] + len) != (hnd->p[s] + len)){
+   return SECT_ERR_OVR;   /* Already occupied */
+  }
+
+  if (section_i_setoccr(hnd, s, hnd->p[s], hnd->p[s] + len)){
+   return SECT_ERR_MEM;   /* No memory for pages */
+  }
+  section_i_sethwm(hnd, s, hnd->p[s] + len - 1U);
+  if (s <= SECT_IDM_D){   /* Sections with data: add it (the area was zero) */
+   i = 0U;
+   while (i < len){
+    o = hnd->p[s] + i;
+    k = SECT_PGW - (o & SECT_PGM);         /* Words until end of page */
+    if (k > (len - i)){ k = len - i; }
+    memcpy(&(hnd->g[s][o >> SECT_PGS]->d[o & SECT_PGM]), &(src[i]), k * sizeof(uint16));
+    i += k;
+   }
+  }
+
+ }
+
+ hnd->p[s] += len;
+ return SECT_ERR_OK;
+}
+
+
+
+/* Reserves a range of words in the section, as if the given count of zero
+** words were pushed. If necessary, aligns offset to word boundary first. The
+** range is checked and occupied in one pass. Returns error code on failure
+** (overlap or out of section's allowed size), then nothing is occupied, and
+** the first conflicting offset is returned in 'cof'. */
+auint section_reserve(section_t* hnd, auint cnt, auint* cof)
+{
+ auint s = hnd->s;
+ auint i;
+
+ section_i_dep(hnd);
+
+ if (cnt == 0U){ return SECT_ERR_OK; }
+
+ if (hnd->b[s] != 0U){ /* Need to advance to next word */
+  hnd->p[s] ++;
+  hnd->b[s] = 0U;
+ }
+
+ if (s <= SECT_IDM_M){    /* Sections with map: test */
+
+  if (section_s[s] <= (hnd->p[s])){
+   *cof = hnd->p[s];
+   return SECT_ERR_OVF;   /* Offset too large for section */
+  }
+  if ((section_s[s] - (hnd->p[s])) < cnt){
+   *cof = section_s[s];
+   return SECT_ERR_OVF;   /* Range extends beyond the section */
+  }
+  i = section_i_findocc(hnd, s, hnd->p[s], hnd->p[s] + cnt);
+  if (i != (hnd->p[s] + cnt)){
+   *cof = i;
+   return SECT_ERR_OVR;   /* Already occupied */
+  }
+
+  if (section_i_setoccr(hnd, s, hnd->p[s], hnd->p[s] + cnt)){
+   *cof = hnd->p[s];
+   return SECT_ERR_MEM;   /* No memory for pages */
+  }
+  section_i_sethwm(hnd, s, hnd->p[s] + cnt - 1U);
+
+ }
+
+ hnd->p[s] += cnt;
+ return SECT_ERR_OK;
+}
+
+
+
 /* Changes an unit of word data at a given offset. This is meant to be used by
 ** second pass to substitue values which could not be resolved earlier. Will
 ** only have effect in areas already occupied. OR combines. */
 void  section_setw(section_t* hnd, auint off, auint data)
 {
- auint s = hnd->s;
+ section_setsw(hnd, hnd->s, off, data);
+}
+
 
- if (s <= SECT_IDM_D){    /* Only for sections with data */
 
-  if (section_i_getocc(off, &(hnd->o[section_o[s] >> 5]), section_s[s]) != 0U){
-   hnd->d[section_o[s] + off] |= (uint16)(data);
+/* Like section_setw(), but in the given section, without selecting it. Only
+** reads the section object otherwise, so it may be called concurrently for
+** distinct words. */
+void  section_setsw(section_t* hnd, auint sect, auint off, auint data)
+{
+ if (sect <= SECT_IDM_D){ /* Only for sections with data */
+
+  if (section_i_getocc(hnd, sect, off) != 0U){
+   hnd->g[sect][off >> SECT_PGS]->d[off & SECT_PGM] |= (uint16)(data);
   }
 
  }
@@ -292,11 +717,12 @@ void  section_setw(section_t* hnd, auint off, auint data)
 void  section_setb(section_t* hnd, auint off, auint data)
 {
  auint s = hnd->s;
+ auint o = off >> 1;
 
  if (s <= SECT_IDM_D){    /* Only for sections with data */
 
-  if (section_i_getocc(off >> 1, &(hnd->o[section_o[s] >> 5]), section_s[s]) != 0U){
-   hnd->d[section_o[s] + (off >> 1)] |= (uint16)((data & 0xFFU) << ((1U ^ (off & 1U)) << 3));
+  if (section_i_getocc(hnd, s, o) != 0U){
+   hnd->g[s][o >> SECT_PGS]->d[o & SECT_PGM] |= (uint16)((data & 0xFFU) << ((1U ^ (off & 1U)) << 3));
   }
 
  }
@@ -306,16 +732,20 @@ void  section_setb(section_t* hnd, auint off, auint data)
 
 /* Forces an unit of word data into the section, overriding if anything is
 ** there. This is meant to be used by autofills. Sets occupation for the
-** forced word. */
+** forced word. Has no effect if no memory is available for the page. */
 void  section_fsetw(section_t* hnd, auint off, auint data)
 {
  auint s = hnd->s;
+ section_pg_t* pg;
 
  if (s <= SECT_IDM_D){    /* Only for sections with data */
 
   if (off < section_s[s]){
-   hnd->d[section_o[s] + off] = (uint16)(data);
-   section_i_setocc(off, &(hnd->o[section_o[s] >> 5]), section_s[s]);
+   pg = section_i_setocc(hnd, s, off);
+   if (pg != NULL){
+    pg->d[off & SECT_PGM] = (uint16)(data);
+    section_i_sethwm(hnd, s, off);
+   }
   }
 
  }
@@ -329,23 +759,28 @@ void  section_fsetw(section_t* hnd, auint off, auint data)
 void  section_strpad(section_t* hnd, auint off)
 {
  auint s = hnd->s;
+ section_pg_t* pg;
 
  if (s <= SECT_IDM_D){    /* Only for sections with data */
 
   if (off < section_s[s]){
 
-   if (section_i_getocc(off, &(hnd->o[section_o[s] >> 5]), section_s[s]) == 0U){
+   if (section_i_getocc(hnd, s, off) == 0U){
 
-    hnd->d[section_o[s] + off] = 0x2020U;
-    section_i_setocc(off, &(hnd->o[section_o[s] >> 5]), section_s[s]);
+    pg = section_i_setocc(hnd, s, off);
+    if (pg != NULL){
+     pg->d[off & SECT_PGM] = 0x2020U;
+     section_i_sethwm(hnd, s, off);
+    }
 
    }else{
 
-    if ((hnd->d[section_o[s] + off] & 0x00FFU) == 0U){
-     hnd->d[section_o[s] + off] |= 0x0020U;
+    pg = hnd->g[s][off >> SECT_PGS];
+    if ((pg->d[off & SECT_PGM] & 0x00FFU) == 0U){
+     pg->d[off & SECT_PGM] |= 0x0020U;
     }
-    if ((hnd->d[section_o[s] + off] & 0xFF00U) == 0U){
-     hnd->d[section_o[s] + off] |= 0x2000U;
+    if ((pg->d[off & SECT_PGM] & 0xFF00U) == 0U){
+     pg->d[off & SECT_PGM] |= 0x2000U;
     }
 
    }
@@ -378,28 +813,285 @@ auint section_getaddr(section_t* hnd, auint off)
 ** of the section. The FILE section always returns zero size. */
 auint section_getsize(section_t* hnd)
 {
- auint i = SECT_MAX;
  auint s = hnd->s;
+#ifdef TARGET_DEBUG
+ auint i;
+#endif
+
+ if (s > SECT_IDM_M){     /* Possible only for sections having map */
+  return 0U;              /* Other sections return zero size */
+ }
+
+#ifdef TARGET_DEBUG
+ /* Cross-check the high-water mark against the occupation map */
+ i = section_i_scansize(hnd, s);
+ if (i != (hnd->h[s])){
+  fault_printgen(FAULT_WARN, (uint8 const*)("Section size tracking mismatch"));
+  hnd->h[s] = i;
+ }
+#endif
+
+ return (hnd->h[s]);
+}
 
- if (s <= SECT_IDM_M){    /* Possible only for sections having map */
-  while (i != 0U){
-   if (section_i_getocc(i - 1U, &(hnd->o[section_o[s] >> 5]), section_s[s]) != 0U){
-    break; /* Topmost occupation found: Size of section */
+
+
+/* Reads section data for combining into an application binary. Copies 'len'
+** words beginning with word offset 'off' into 'dst'. Words in areas never
+** written read as zero, as do words of sections without data. */
+void  section_read(section_t* hnd, auint off, uint16* dst, auint len)
+{
+ auint s = hnd->s;
+ auint i = 0U;
+ auint k;
+ auint o;
+ section_pg_t* pg;
+
+ while (i < len){
+  o = off + i;
+  k = SECT_PGW - (o & SECT_PGM);           /* Words until end of page */
+  if (k > (len - i)){ k = len - i; }
+  pg = NULL;
+  if ((s <= SECT_IDM_D) && (o < section_s[s])){
+   pg = hnd->g[s][o >> SECT_PGS];
+  }
+  if (pg != NULL){
+   memcpy(&(dst[i]), &(pg->d[o & SECT_PGM]), k * sizeof(uint16));
+  }else{
+   memset(&(dst[i]), 0U, k * sizeof(uint16));
+  }
+  i += k;
+ }
+}
+
+
+
+/* Gets the pointer state of the sections. */
+void  section_getps(section_t* hnd, section_ps_t* pst)
+{
+ pst->s = hnd->s;
+ memcpy(&(pst->p[0]), &(hnd->p[0]), sizeof(pst->p));
+ memcpy(&(pst->b[0]), &(hnd->b[0]), sizeof(pst->b));
+}
+
+
+
+/* Sets the pointer state of the sections. */
+void  section_setps(section_t* hnd, section_ps_t const* pst)
+{
+ hnd->s = pst->s;
+ memcpy(&(hnd->p[0]), &(pst->p[0]), sizeof(pst->p));
+ memcpy(&(hnd->b[0]), &(pst->b[0]), sizeof(pst->b));
+}
+
+
+
+/* Starts (nonzero 'ena') or stops tracking of occupation: while tracking is
+** on, every word occupied is marked, so the words occupied since the start
+** can be retrieved. Starting clears earlier marks. Returns nonzero (TRUE) if
+** tracking can not be started (no memory). */
+auint section_settrk(section_t* hnd, auint ena)
+{
+ auint siz = (SECT_IDM_M + 1U) * (SECT_MAX >> 5) * sizeof(uint32);
+
+ if (ena == 0U){
+  free(hnd->t);
+  hnd->t = NULL;
+  return 0U;
+ }
+
+ if (hnd->t == NULL){
+  hnd->t = (uint32*)(malloc(siz));
+  if (hnd->t == NULL){ return 1U; }
+ }
+ memset(hnd->t, 0U, siz);
+ return 0U;
+}
+
+
+
+/* Finds the next run of words marked by occupation tracking in the given
+** section (having map), beginning at 'beg'. Returns the start of the run,
+** filling its length in 'len', or 0x10000 if there are no more marked words.
+** Returns 0x10000 if tracking is off. */
+auint section_nexttrk(section_t* hnd, auint s, auint beg, auint* len)
+{
+ uint32 const* t;
+ auint  end;
+
+ if ((hnd->t == NULL) || (s > SECT_IDM_M)){ return SECT_MAX; }
+ t = &(hnd->t[s * (SECT_MAX >> 5)]);
+
+ while (beg < SECT_MAX){   /* Find start, skipping empty map words */
+  if ((t[beg >> 5] >> (beg & 0x1FU)) == 0U){
+   beg = (beg & ~(auint)(0x1FU)) + 32U;
+  }else if (((t[beg >> 5] >> (beg & 0x1FU)) & 1U) == 0U){
+   beg ++;
+  }else{
+   break;
+  }
+ }
+ if (beg >= SECT_MAX){ return SECT_MAX; }
+
+ end = beg;
+ while (end < SECT_MAX){   /* Find end, skipping full map words */
+  if (((end & 0x1FU) == 0U) && (t[end >> 5] == 0xFFFFFFFFU)){
+   end += 32U;
+  }else if (((t[end >> 5] >> (end & 0x1FU)) & 1U) != 0U){
+   end ++;
+  }else{
+   break;
+  }
+ }
+
+ *len = end - beg;
+ return beg;
+}
+
+
+
+/* Checks whether a range of words in the given section (having map) is free
+** to occupy. Returns nonzero (TRUE) if it is within the section, and not
+** occupied yet. */
+auint section_isfree(section_t* hnd, auint s, auint off, auint len)
+{
+ if (s > SECT_IDM_M){ return 0U; }
+ if ( (section_s[s] < off) ||
+      ((section_s[s] - off) < len) ){ return 0U; }
+ return (section_i_findocc(hnd, s, off, off + len) == (off + len));
+}
+
+
+
+/* Starts tracking whether the contents depend on the pointer state the
+** sections had at the start (as if that was unknown): the current section
+** may not be used before selecting one, and the pointers of sections not in
+** the 'rel' mask may not be used before setting them (org). Sections in the
+** mask are relocated later, so their pointers may not be set. Reset by
+** section_init(). */
+void  section_setdtr(section_t* hnd, auint rel)
+{
+ hnd->dtr = 1U;
+ hnd->drl = rel;
+ hnd->dsl = 0U;
+ hnd->dor = 0U;
+ hnd->dep = 0U;
+}
+
+
+
+/* Gets the result of dependence tracking. Returns nonzero (TRUE) if the
+** contents depend on the starting state. 'sel' is set nonzero if a section
+** was selected, 'org' to the mask of sections whose pointer was set. */
+auint section_getdtr(section_t* hnd, auint* sel, auint* org)
+{
+ *sel = hnd->dsl;
+ *org = hnd->dor;
+ return (hnd->dep);
+}
+
+
+
+/* Writes the contents of the sections having map (the occupied runs with
+** their data) into an object file. Returns nonzero (TRUE) on failure (errno
+** set). */
+auint section_objout(section_t* hnd, fprov_file_t* ofl)
+{
+ auint  t = hnd->s;
+ auint  s;
+ auint  o;
+ auint  e;
+ auint  i;
+ auint  k;
+ auint  l;
+ uint16 d[SECT_PGW];
+ uint8  c[SECT_PGW * 2U];
+
+ for (s = 0U; s <= SECT_IDM_M; s++){
+
+  if (fprov_wru32(ofl, hnd->h[s])){ return 1U; }
+
+  o = 0U;
+  while (1){                /* Runs of occupied words */
+   o = section_i_findocc(hnd, s, o, hnd->h[s]);
+   if (o >= (hnd->h[s])){ break; }
+   e = o;
+   while ((e < (hnd->h[s])) && (section_i_getocc(hnd, s, e) != 0U)){ e++; }
+   if (fprov_wru32(ofl, o)){ return 1U; }
+   if (fprov_wru32(ofl, e - o)){ return 1U; }
+   if (s <= SECT_IDM_D){    /* Data of the run */
+    for (i = o; i < e; i += k){
+     k = e - i;
+     if (k > SECT_PGW){ k = SECT_PGW; }
+     hnd->s = s;
+     section_read(hnd, i, &d[0], k);
+     hnd->s = t;
+     for (l = 0U; l < k; l++){
+      c[(l << 1)     ] = d[l] >> 8;
+      c[(l << 1) + 1U] = d[l] & 0xFFU;
+     }
+     if (fprov_write(ofl, &c[0], k << 1)){ return 1U; }
+    }
    }
-   i --;
+   o = e;
   }
- }else{                   /* Other sections return zero size */
-  i = 0U;
+  if (fprov_wru32(ofl, 0xFFFFFFFFU)){ return 1U; } /* End of runs */
+
  }
 
- return i;
+ return 0U;
 }
 
 
 
-/* Get section data pointer for reading, combining into an application binary.
-** The size of the memory area can be retrieved by section_getsize(), */
-uint16 const* section_getdata(section_t* hnd)
+/* Reads section contents written by section_objout() from an object file,
+** adding them to the sections. 'dlt' gives the displacement of the object
+** for each section: its contents are placed that much higher. Returns error
+** code on failure (overlap, out of section's allowed size or read failure),
+** then the contents may be partially added. */
+auint section_objin(section_t* hnd, fprov_file_t* ifl, auint const* dlt)
 {
- return (&(hnd->d[section_o[hnd->s]]));
+ auint  s;
+ auint  o;
+ auint  n;
+ auint  i;
+ auint  k;
+ auint  l;
+ auint  r;
+ uint16 d[SECT_PGW];
+ uint8  c[SECT_PGW * 2U];
+
+ for (s = 0U; s <= SECT_IDM_M; s++){
+
+  if (fprov_rdu32(ifl, &o)){ return SECT_ERR_RD; } /* Size, not needed */
+
+  while (1){
+   if (fprov_rdu32(ifl, &o)){ return SECT_ERR_RD; }
+   if (o == 0xFFFFFFFFU){ break; }
+   if (fprov_rdu32(ifl, &n)){ return SECT_ERR_RD; }
+   if ( (o >= SECT_MAX) || (n > (SECT_MAX - o)) ){ return SECT_ERR_OVF; }
+   hnd->s = s;
+   hnd->p[s] = o + dlt[s];
+   hnd->b[s] = 0U;
+   if (s <= SECT_IDM_D){
+    for (i = 0U; i < n; i += k){
+     k = n - i;
+     if (k > SECT_PGW){ k = SECT_PGW; }
+     if (fprov_read(ifl, &c[0], k << 1, &r)){ return SECT_ERR_RD; }
+     if (r != (k << 1)){ errno = EIO; return SECT_ERR_RD; }
+     for (l = 0U; l < k; l++){
+      d[l] = ((uint16)(c[(l << 1)]) << 8) | (uint16)(c[(l << 1) + 1U]);
+     }
+     r = section_pushws(hnd, &d[0], k);
+     if (r != SECT_ERR_OK){ return r; }
+    }
+   }else{
+    r = section_reserve(hnd, n, &i);
+    if (r != SECT_ERR_OK){ return r; }
+   }
+  }
+
+ }
+
+ return SECT_ERR_OK;
 }
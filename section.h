@@ -8,8 +8,10 @@
 **             root.
 **  \date      2014.10.29
 **
-**  Manages the sections and their data during the compilation. Currently
-**  singleton, but desinged so it is possible to extend later.
+**  Manages the sections and their data during the compilation.
+**
+**  The section data is stored in pages allocated on the first write, so only
+**  the parts of the sections actually used take memory.
 */
 
 
@@ -18,6 +20,7 @@
 
 
 #include "types.h"
+#include "fprov.h"
 
 
 /* Section object structure */
@@ -46,14 +49,33 @@ typedef struct section_s section_t;
 #define SECT_MAXRAM   (0x10000U - 0x800U - 0x40U)
 
 
-/* Error codes. OVR: Overlap. OVF: Overflow (out of range). */
+/* Error codes. OVR: Overlap. OVF: Overflow (out of range). MEM: Out of
+** memory (no storage could be allocated for the data). */
 #define SECT_ERR_OK   0U
 #define SECT_ERR_OVR  1U
 #define SECT_ERR_OVF  2U
+#define SECT_ERR_MEM  3U
+/* Error code for reading from an object file: RD: Read failure (errno set,
+** EIO if the object is truncated). */
+#define SECT_ERR_RD   4U
+
+
+/* Section pointer state: the selected section, and the current pointers
+** within the sections. */
+typedef struct{
+ auint  s;              /* Currently selected section */
+ auint  p[SECT_CNT];    /* Current pointer within section */
+ auint  b[SECT_CNT];    /* Byte sub-offset (0 for high byte, 1 for low) */
+}section_ps_t;
+
 
+/* Creates a new section object. Returns NULL if it is not possible to
+** allocate it. The object has to be initialized before use. */
+section_t* section_new(void);
 
-/* Get built-in singleton object handle. */
-section_t* section_getobj(void);
+
+/* Deletes a section object, freeing any page allocated for it. */
+void  section_delete(section_t* hnd);
 
 
 /* Retrieves string for identifying the section base symbol. These are:
@@ -61,7 +83,8 @@ section_t* section_getobj(void);
 uint8 const* section_getsbstr(auint sec);
 
 
-/* Initializes or resets a section object. */
+/* Initializes or resets a section object. Any page allocated earlier is
+** freed. */
 void  section_init(section_t* hnd);
 
 
@@ -96,12 +119,40 @@ auint section_pushw(section_t* hnd, auint data);
 auint section_pushb(section_t* hnd, auint data);
 
 
+/* Pushes a span of byte data to the section, equivalent to pushing the bytes
+** one by one with section_pushb(), but checking and occupying the whole range
+** in one pass. Returns error code on failure (overlap or out of section's
+** allowed size), then nothing is pushed. */
+auint section_pushbs(section_t* hnd, uint8 const* src, auint len);
+
+
+/* Pushes a span of word data to the section, equivalent to pushing the words
+** one by one with section_pushw(), but checking and occupying the whole range
+** in one pass. Returns error code on failure (overlap or out of section's
+** allowed size), then nothing is pushed. */
+auint section_pushws(section_t* hnd, uint16 const* src, auint len);
+
+
+/* Reserves a range of words in the section, as if the given count of zero
+** words were pushed. If necessary, aligns offset to word boundary first. The
+** range is checked and occupied in one pass. Returns error code on failure
+** (overlap or out of section's allowed size), then nothing is occupied, and
+** the first conflicting offset is returned in 'cof'. */
+auint section_reserve(section_t* hnd, auint cnt, auint* cof);
+
+
 /* Changes an unit of word data at a given offset. This is meant to be used by
 ** second pass to substitue values which could not be resolved earlier. Will
 ** only have effect in areas already occupied. OR combines. */
 void  section_setw(section_t* hnd, auint off, auint data);
 
 
+/* Like section_setw(), but in the given section, without selecting it. Only
+** reads the section object otherwise, so it may be called concurrently for
+** distinct words. */
+void  section_setsw(section_t* hnd, auint sect, auint off, auint data);
+
+
 /* Changes an unit of byte data at a given (byte) offset. This is meant to be
 ** used by second pass to substitue values which could not be resolved
 ** earlier. Will only have effect in areas already occupied. OR combines. */
@@ -110,7 +161,7 @@ void  section_setb(section_t* hnd, auint off, auint data);
 
 /* Forces an unit of word data into the section, overriding if anything is
 ** there. This is meant to be used by autofills. Sets occupation for the
-** forced word. */
+** forced word. Has no effect if no memory is available for the page. */
 void  section_fsetw(section_t* hnd, auint off, auint data);
 
 
@@ -134,9 +185,67 @@ auint section_getaddr(section_t* hnd, auint off);
 auint section_getsize(section_t* hnd);
 
 
-/* Get section data pointer for reading, combining into an application binary.
-** The size of the memory area can be retrieved by section_getsize(), */
-uint16 const* section_getdata(section_t* hnd);
+/* Reads section data for combining into an application binary. Copies 'len'
+** words beginning with word offset 'off' into 'dst'. Words in areas never
+** written read as zero, as do words of sections without data. */
+void  section_read(section_t* hnd, auint off, uint16* dst, auint len);
+
+
+/* Gets the pointer state of the sections. */
+void  section_getps(section_t* hnd, section_ps_t* pst);
+
+
+/* Sets the pointer state of the sections. */
+void  section_setps(section_t* hnd, section_ps_t const* pst);
+
+
+/* Starts (nonzero 'ena') or stops tracking of occupation: while tracking is
+** on, every word occupied is marked, so the words occupied since the start
+** can be retrieved. Starting clears earlier marks. Returns nonzero (TRUE) if
+** tracking can not be started (no memory). */
+auint section_settrk(section_t* hnd, auint ena);
+
+
+/* Finds the next run of words marked by occupation tracking in the given
+** section (having map), beginning at 'beg'. Returns the start of the run,
+** filling its length in 'len', or 0x10000 if there are no more marked words.
+** Returns 0x10000 if tracking is off. */
+auint section_nexttrk(section_t* hnd, auint s, auint beg, auint* len);
+
+
+/* Checks whether a range of words in the given section (having map) is free
+** to occupy. Returns nonzero (TRUE) if it is within the section, and not
+** occupied yet. */
+auint section_isfree(section_t* hnd, auint s, auint off, auint len);
+
+
+/* Starts tracking whether the contents depend on the pointer state the
+** sections had at the start (as if that was unknown): the current section
+** may not be used before selecting one, and the pointers of sections not in
+** the 'rel' mask may not be used before setting them (org). Sections in the
+** mask are relocated later, so their pointers may not be set. Reset by
+** section_init(). */
+void  section_setdtr(section_t* hnd, auint rel);
+
+
+/* Gets the result of dependence tracking. Returns nonzero (TRUE) if the
+** contents depend on the starting state. 'sel' is set nonzero if a section
+** was selected, 'org' to the mask of sections whose pointer was set. */
+auint section_getdtr(section_t* hnd, auint* sel, auint* org);
+
+
+/* Writes the contents of the sections having map (the occupied runs with
+** their data) into an object file. Returns nonzero (TRUE) on failure (errno
+** set). */
+auint section_objout(section_t* hnd, fprov_file_t* ofl);
+
+
+/* Reads section contents written by section_objout() from an object file,
+** adding them to the sections. 'dlt' gives the displacement of the object
+** for each section: its contents are placed that much higher. Returns error
+** code on failure (overlap, out of section's allowed size or read failure),
+** then the contents may be partially added. */
+auint section_objin(section_t* hnd, fprov_file_t* ifl, auint const* dlt);
 
 
 #endif
@@ -0,0 +1,308 @@
+/**
+**  \file
+**  \brief     Assembler server
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  A resident assembler answering requests on a Unix domain socket. Every
+**  file read is kept in a file cache, and is watched (inotify), so on a new
+**  request only the files changed since are read again.
+**
+**  A request is a single line, an entry source and an output name, just like
+**  a line of a batch manifest. The reply holds the fault messages of the
+**  assembly followed by a status line, either "OK <output> <size in bytes>"
+**  or "FAIL". The connection is closed after the reply. The request "quit"
+**  stops the server.
+**
+**  Only available on Linux.
+*/
+
+
+#include "serve.h"
+#include "fault.h"
+
+#ifdef TARGET_LINUX
+
+#include "asmctx.h"
+#include "batch.h"
+#include "fcache.h"
+#include "compst.h"
+#include "strpr.h"
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/inotify.h>
+
+
+/* Events of watched files which invalidate them */
+#define SERVE_WEV (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF)
+
+
+/* Server state */
+typedef struct{
+ int       ino;                       /* Inotify descriptor */
+ fcache_t* fca;                       /* File cache */
+ auint     wct;                       /* Count of watches */
+ int       wds[SERVE_WMX];            /* Watch descriptors */
+ uint8     wnm[SERVE_WMX][FILE_MAX];  /* Watched file names */
+}serve_t;
+
+
+
+/* File cache load callback: adds a watch for the file loaded. If it can not
+** be watched, it is dropped from the cache after the request. */
+static void serve_i_watch(void* ctx, uint8 const* fnam)
+{
+ serve_t* srv = (serve_t*)(ctx);
+ int      wd;
+ auint    i;
+
+ wd = inotify_add_watch(srv->ino, (char const*)(fnam), SERVE_WEV);
+ for (i = 0U; i < (srv->wct); i++){
+  if (strcmp((char const*)(fnam), (char const*)(&(srv->wnm[i][0]))) == 0){
+   srv->wds[i] = wd;
+   return;
+  }
+ }
+ if ((srv->wct) < SERVE_WMX){
+  srv->wds[srv->wct] = wd;
+  strpr_copy(&(srv->wnm[srv->wct][0]), fnam, FILE_MAX);
+  (srv->wct)++;
+ }
+}
+
+
+
+/* Processes pending inotify events, dropping the changed files from the
+** cache. Files which could not be watched are also dropped. */
+static void serve_i_update(serve_t* srv)
+{
+ char  b[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+ struct inotify_event const* ev;
+ ssize_t l;
+ ssize_t p;
+ auint   i;
+
+ while (1){
+  l = read(srv->ino, &b[0], sizeof(b));
+  if (l <= 0){ break; }        /* No more events (nonblocking) */
+  for (p = 0; p < l; p += (ssize_t)(sizeof(struct inotify_event) + ev->len)){
+   ev = (struct inotify_event const*)(&b[p]);
+   for (i = 0U; i < (srv->wct); i++){
+    if (srv->wds[i] == ev->wd){
+     fcache_drop(srv->fca, &(srv->wnm[i][0]));
+     srv->wds[i] = -1;         /* Watch again when reloaded */
+    }
+   }
+  }
+ }
+
+ for (i = 0U; i < (srv->wct); i++){
+  if (srv->wds[i] < 0){
+   fcache_drop(srv->fca, &(srv->wnm[i][0]));
+  }
+ }
+}
+
+
+
+/* Reads a request line from a connection. Returns nonzero (TRUE) on
+** failure. */
+static auint serve_i_getreq(int con, uint8* lin)
+{
+ auint   i = 0U;
+ uint8   c;
+
+ while (1){
+  if (read(con, &c, 1U) != 1){ break; }
+  if ((c == (uint8)('\n')) || (c == (uint8)('\r'))){ break; }
+  if (i >= (LINE_MAX - 1U)){ return 1U; }
+  lin[i] = c;
+  i++;
+ }
+ lin[i] = 0U;
+
+ return (i == 0U);
+}
+
+
+
+/* Writes a string to a connection. Failures are ignored (the client went
+** away). */
+static void serve_i_put(int con, char const* str, size_t len)
+{
+ ssize_t r;
+
+ while (len != 0U){
+  r = write(con, str, len);
+  if (r <= 0){ return; }
+  str += r;
+  len -= (size_t)(r);
+ }
+}
+
+
+
+/* Serves a request on a connection. Returns nonzero (TRUE) if the server
+** should stop. */
+static auint serve_i_req(serve_t* srv, asmctx_t* ctx, int con)
+{
+ uint8       lin[LINE_MAX];
+ uint8       ent[FILE_MAX];
+ uint8       out[FILE_MAX];
+ char        s[FILE_MAX + 80U];
+ char*       dbf = NULL;
+ size_t      dsz = 0U;
+ FILE*       dfl;
+ struct stat sta;
+ auint       r;
+
+ if (serve_i_getreq(con, &lin[0])){ return 0U; }
+ if (strcmp((char const*)(&lin[0]), "quit") == 0){ return 1U; }
+
+ if (batch_parsel(&lin[0], 0U, &ent[0], &out[0]) != 0U){
+  snprintf(&s[0], sizeof(s), "FAIL Malformed request\n");
+  serve_i_put(con, &s[0], strlen(&s[0]));
+  return 0U;
+ }
+
+ /* Assemble with the fault messages collected for the reply */
+
+ serve_i_update(srv);
+ dfl = open_memstream(&dbf, &dsz);
+ fault_setout(dfl);
+ r = asmctx_assemble(ctx, &ent[0], &out[0], NULL);
+ fault_setout(NULL);
+ if (dfl != NULL){
+  fclose(dfl);
+  serve_i_put(con, dbf, dsz);
+  free(dbf);
+ }
+
+ if (r == 0U){
+  if (stat((char const*)(&out[0]), &sta) != 0){ sta.st_size = 0; }
+  snprintf(&s[0], sizeof(s), "OK %s %u\n", (char const*)(&out[0]), (auint)(sta.st_size));
+ }else{
+  snprintf(&s[0], sizeof(s), "FAIL\n");
+ }
+ serve_i_put(con, &s[0], strlen(&s[0]));
+
+ return 0U;
+}
+
+#endif
+
+
+
+/* Runs the assembler server on the given socket path. Returns when it is
+** stopped by a "quit" request, or on failure. Returns nonzero (TRUE) on
+** failure, fault printed. */
+auint serve_run(uint8 const* sck)
+{
+ uint8  s[80];
+#ifdef TARGET_LINUX
+ uint8  e[80];
+ serve_t*  srv;
+ asmctx_t* ctx;
+ fprov_t   prv;
+ struct sockaddr_un adr;
+ int    lsn;
+ int    con;
+ auint  r = 0U;
+
+ srv = (serve_t*)(calloc(1U, sizeof(serve_t)));
+ ctx = asmctx_new();
+ if ((srv == NULL) || (ctx == NULL)){ goto fault_mem; }
+ srv->fca = fcache_new();
+ if (srv->fca == NULL){ goto fault_mem; }
+ srv->ino = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+ if (srv->ino < 0){ goto fault_ino; }
+
+ fcache_setlcb(srv->fca, &serve_i_watch, (void*)(srv));
+ fcache_getprov(srv->fca, &prv);
+ asmctx_setprov(ctx, &prv);
+ asmctx_setverb(ctx, 0U);
+ asmctx_setmemo(ctx, 1U);      /* Not fatal if it can not be turned on */
+
+ /* Set up socket */
+
+ memset(&adr, 0U, sizeof(adr));
+ adr.sun_family = AF_UNIX;
+ if (strlen((char const*)(sck)) >= sizeof(adr.sun_path)){ errno = ENAMETOOLONG; goto fault_sck; }
+ strcpy(&(adr.sun_path[0]), (char const*)(sck));
+ lsn = socket(AF_UNIX, SOCK_STREAM, 0);
+ if (lsn < 0){ goto fault_sck; }
+ unlink(&(adr.sun_path[0]));
+ if ( (bind(lsn, (struct sockaddr*)(&adr), sizeof(adr)) != 0) ||
+      (listen(lsn, 8) != 0) ){
+  close(lsn);
+  goto fault_sck;
+ }
+ signal(SIGPIPE, SIG_IGN);     /* Clients going away must not kill it */
+
+ printf("Serving on %s\n", (char const*)(sck));
+ fflush(stdout);
+
+ /* Serve requests */
+
+ while (r == 0U){
+  con = accept(lsn, NULL, NULL);
+  if (con < 0){
+   if (errno == EINTR){ continue; }
+   break;
+  }
+  r = serve_i_req(srv, ctx, con);
+  close(con);
+ }
+
+ close(lsn);
+ unlink(&(adr.sun_path[0]));
+ close(srv->ino);
+ fcache_delete(srv->fca);
+ asmctx_delete(ctx);
+ free(srv);
+ return 0U;
+
+fault_sck:
+
+ strerror_r(errno, (char*)(&e[0]), 80U);
+ e[79] = 0U;
+ snprintf((char*)(&s[0]), 80U, "Failed to set up socket: %.54s", (char const*)(&e[0]));
+ fault_printgen(FAULT_FAIL, &s[0]);
+ close(srv->ino);
+ fcache_delete(srv->fca);
+ asmctx_delete(ctx);
+ free(srv);
+ return 1U;
+
+fault_ino:
+
+ strerror_r(errno, (char*)(&e[0]), 80U);
+ e[79] = 0U;
+ snprintf((char*)(&s[0]), 80U, "Failed to set up file watching: %.47s", (char const*)(&e[0]));
+ fault_printgen(FAULT_FAIL, &s[0]);
+ fcache_delete(srv->fca);
+ asmctx_delete(ctx);
+ free(srv);
+ return 1U;
+
+fault_mem:
+
+ snprintf((char*)(&s[0]), 80U, "Not enough memory for the server");
+ fault_printgen(FAULT_FAIL, &s[0]);
+ if (srv != NULL){ fcache_delete(srv->fca); }
+ asmctx_delete(ctx);
+ free(srv);
+ return 1U;
+#else
+ snprintf((char*)(&s[0]), 80U, "Server mode is only supported on Linux");
+ fault_printgen(FAULT_FAIL, &s[0]);
+ return 1U;
+#endif
+}
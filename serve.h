@@ -0,0 +1,43 @@
+/**
+**  \file
+**  \brief     Assembler server
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  A resident assembler answering requests on a Unix domain socket. Every
+**  file read is kept in a file cache, and is watched (inotify), so on a new
+**  request only the files changed since are read again.
+**
+**  A request is a single line, an entry source and an output name, just like
+**  a line of a batch manifest. The reply holds the fault messages of the
+**  assembly followed by a status line, either "OK <output> <size in bytes>"
+**  or "FAIL". The connection is closed after the reply. The request "quit"
+**  stops the server.
+**
+**  Only available on Linux.
+*/
+
+
+#ifndef SERVE_H
+#define SERVE_H
+
+
+#include "types.h"
+
+
+/* Maximal number of watched files. */
+#define SERVE_WMX   1024U
+
+
+
+/* Runs the assembler server on the given socket path. Returns when it is
+** stopped by a "quit" request, or on failure. Returns nonzero (TRUE) on
+** failure, fault printed. */
+auint serve_run(uint8 const* sck);
+
+
+#endif
@@ -0,0 +1,340 @@
+/**
+**  \file
+**  \brief     Pipelined source reader
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  The ring is indexed by two free running counters: the count of records
+**  produced (only written by the reader) and the count of records consumed
+**  (only written by the first pass). A side waiting for the other spins for
+**  a while, then sleeps until the other signals progress (which it only does
+**  when a side is asleep, so the lines normally pass without locking).
+*/
+
+
+#include "srcrd.h"
+#include "firead.h"
+#include "incstk.h"
+#include "strpr.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+
+/* Spins before sleeping when waiting */
+#define SRCRD_SPN  64U
+
+
+/* Source reader object structure - definition */
+struct srcrd_s{
+ srcrd_rec_t   rng[SRCRD_RNG]; /* Ring of records */
+ atomic_uint   hed;     /* Count of records produced */
+ atomic_uint   tal;     /* Count of records consumed */
+ atomic_uint   stp;     /* Nonzero if stop was requested */
+ atomic_uint   slp;     /* Count of sides asleep waiting for the other */
+ pthread_mutex_t mtx;   /* Lock for sleeping */
+ pthread_cond_t  cnd;   /* Signals progress of either side */
+ auint         run;     /* Nonzero if the reader thread was started */
+ pthread_t     thr;     /* Reader thread */
+ fprov_t       prv;     /* File provider */
+ fprov_file_t* fpt[INCSTK_MAX + 1U]; /* Files open (0: primary source) */
+ auint         lin[INCSTK_MAX + 1U]; /* Line numbers within them */
+ auint         dep;     /* Current depth of includes */
+ uint8         inc[INCSTK_INC][FILE_MAX]; /* Includes met */
+ auint         icn;     /* Count of includes met */
+ uint8         cur[LINE_MAX]; /* Current line */
+};
+
+
+
+/* Waits a bit for the other side, 'n' counting the waits. After spinning
+** for a while, sleeps until either counter differs from 'hed' and 'tal' (as
+** seen by the caller), or stop is requested. */
+static void  srcrd_i_wait(srcrd_t* hnd, auint* n, auint hed, auint tal)
+{
+ if ((*n) < SRCRD_SPN){ (*n) ++; return; }
+
+ pthread_mutex_lock(&(hnd->mtx));
+ atomic_fetch_add(&(hnd->slp), 1U);
+ while ( (atomic_load(&(hnd->hed)) == hed) &&
+         (atomic_load(&(hnd->tal)) == tal) &&
+         (atomic_load(&(hnd->stp)) == 0U) ){
+  pthread_cond_wait(&(hnd->cnd), &(hnd->mtx));
+ }
+ atomic_fetch_sub(&(hnd->slp), 1U);
+ pthread_mutex_unlock(&(hnd->mtx));
+ *n = 0U;
+}
+
+
+
+/* Wakes up the other side if it is asleep, after changing a counter. */
+static void  srcrd_i_wake(srcrd_t* hnd)
+{
+ atomic_thread_fence(memory_order_seq_cst); /* The counter is visible before checking */
+ if (atomic_load(&(hnd->slp)) != 0U){
+  pthread_mutex_lock(&(hnd->mtx));
+  pthread_cond_broadcast(&(hnd->cnd));
+  pthread_mutex_unlock(&(hnd->mtx));
+ }
+}
+
+
+
+/* Gets the next free record of the ring, waiting for room. Returns NULL if
+** the reader has to stop. */
+static srcrd_rec_t* srcrd_i_put(srcrd_t* hnd)
+{
+ auint hed = atomic_load_explicit(&(hnd->hed), memory_order_relaxed);
+ auint tal;
+ auint n   = 0U;
+
+ while (1){
+  tal = atomic_load_explicit(&(hnd->tal), memory_order_acquire);
+  if ((hed - tal) < SRCRD_RNG){ break; }
+  if (atomic_load_explicit(&(hnd->stp), memory_order_relaxed)){ return NULL; }
+  srcrd_i_wait(hnd, &n, hed, tal);
+ }
+
+ return &(hnd->rng[hed % SRCRD_RNG]);
+}
+
+
+
+/* Submits the record got by srcrd_i_put(). */
+static void  srcrd_i_push(srcrd_t* hnd)
+{
+ atomic_store_explicit(&(hnd->hed),
+                       atomic_load_explicit(&(hnd->hed), memory_order_relaxed) + 1U,
+                       memory_order_release);
+ srcrd_i_wake(hnd);
+}
+
+
+
+/* Checks whether the current line includes a file not met yet, like the
+** first pass does (malformed includes are left for it to fail on). Returns
+** nonzero (TRUE) if so, the name of the file in 'nam' (LINE_MAX bytes). */
+static auint srcrd_i_isinc(srcrd_t* hnd, uint8* nam)
+{
+ uint8 const* src = &(hnd->cur[0]);
+ auint        beg = strpr_nextnw(src, 0U);
+ auint        i;
+
+ if (!compst_issymequ(NULL, &(src[beg]), (uint8 const*)("include"))){ return 0U; }
+ beg = strpr_nextnw(src, beg + 7U);
+ i = strpr_extstr(nam, &(src[beg]), LINE_MAX);
+ if (i == 0U){ return 0U; }
+
+ for (i = 0U; i < (hnd->icn); i++){
+  if (strcmp((char const*)(nam), (char const*)(&(hnd->inc[i][0]))) == 0){ return 0U; }
+ }
+
+ beg = strpr_nextnw(src, beg + strpr_extstr(nam, &(src[beg]), LINE_MAX));
+ return strpr_isend(src[beg]);
+}
+
+
+
+/* Reads the next line of the current file into the ring. At the end of the
+** file (or on failure) it is closed, returning to the including file. The
+** first line of a file is never taken as its end. Returns nonzero (TRUE) if
+** the reader has to exit (end of primary source, or stop requested). */
+static auint srcrd_i_read(srcrd_t* hnd, auint fst)
+{
+ srcrd_rec_t* rec;
+ auint        dep = hnd->dep;
+ auint        lng;
+
+ hnd->lin[dep] ++;
+
+ if (firead_getline(hnd->fpt[dep], &(hnd->cur[0]), &lng)){
+  rec = srcrd_i_put(hnd);
+  if (rec == NULL){ return 1U; }
+  rec->typ = SRCRD_ERR;
+  rec->lin = hnd->lin[dep];
+  rec->err = errno;
+  srcrd_i_push(hnd);
+ }else if ( (fst) ||
+            (hnd->cur[0] != 0U) ||
+            (!fprov_iseof(hnd->fpt[dep])) ){
+  rec = srcrd_i_put(hnd);
+  if (rec == NULL){ return 1U; }
+  rec->typ = SRCRD_LIN;
+  rec->lin = hnd->lin[dep];
+  rec->lng = lng;
+  memcpy(&(rec->str[0]), &(hnd->cur[0]), strlen((char const*)(&(hnd->cur[0]))) + 1U);
+  srcrd_i_push(hnd);
+  return 0U;
+ }
+
+ /* End of file */
+
+ rec = srcrd_i_put(hnd);
+ if (rec == NULL){ return 1U; }
+ rec->lin = hnd->lin[dep];
+ if (dep == 0U){
+  rec->typ = SRCRD_EOF;
+  srcrd_i_push(hnd);
+  return 1U;
+ }
+ rec->typ = SRCRD_END;
+ srcrd_i_push(hnd);
+ fprov_close(hnd->fpt[dep]);   /* It was read only, don't care for errors */
+ hnd->dep --;
+ hnd->cur[0] = 0U;
+ return 0U;
+}
+
+
+
+/* Reader thread: reads the sources until the end of the primary source. */
+static void* srcrd_i_reader(void* ptr)
+{
+ srcrd_t*      hnd = (srcrd_t*)(ptr);
+ srcrd_rec_t*  rec;
+ fprov_file_t* fp;
+ uint8         nam[LINE_MAX];
+ auint         fst;
+ auint         chk = 1U;
+
+ while (1){
+
+  fst = 0U;
+
+  if ((chk) && (srcrd_i_isinc(hnd, &nam[0]))){
+   rec = srcrd_i_put(hnd);
+   if (rec == NULL){ break; }
+   rec->typ = SRCRD_INC;
+   rec->lin = hnd->lin[hnd->dep];
+   rec->err = 0U;
+   rec->dsc = 0U;
+   strpr_copy(&(rec->str[0]), &nam[0], LINE_MAX);
+   fp = NULL;
+   if ((hnd->icn) < INCSTK_INC){ /* Otherwise the first pass fails on it */
+    strpr_copy(&(hnd->inc[hnd->icn][0]), &nam[0], FILE_MAX);
+    hnd->icn ++;
+    if ((hnd->dep) < INCSTK_MAX){
+     fp = fprov_open(&(hnd->prv), &nam[0], FPROV_M_RDT);
+     if (fp == NULL){ rec->err = errno; }
+     else           { rec->dsc = 1U; }
+    }
+   }
+   srcrd_i_push(hnd);
+   if (fp != NULL){
+    hnd->dep ++;
+    hnd->fpt[hnd->dep] = fp;
+    hnd->lin[hnd->dep] = 0U;
+    fst = 1U;
+   }
+  }
+
+  if (srcrd_i_read(hnd, fst)){ break; }
+  chk = !fst;            /* The first line of an include is not checked */
+
+ }
+
+ while ((hnd->dep) != 0U){
+  fprov_close(hnd->fpt[hnd->dep]);
+  hnd->dep --;
+ }
+ return NULL;
+}
+
+
+
+/* Creates a new source reader. Returns NULL if it is not possible to
+** allocate it. */
+srcrd_t* srcrd_new(void)
+{
+ return (srcrd_t*)(calloc(1U, sizeof(srcrd_t)));
+}
+
+
+
+/* Deletes a source reader, stopping it if necessary. */
+void  srcrd_delete(srcrd_t* hnd)
+{
+ if (hnd == NULL){ return; }
+ srcrd_stop(hnd);
+ free(hnd);
+}
+
+
+
+/* Starts reading the primary source 'sf' (opened by firead_open(), its
+** current line being in the compile state) with its includes opened through
+** the provider. The records start with the line after the current. The
+** primary source is not closed by the reader. Returns nonzero (TRUE) if the
+** reader thread can not be started. */
+auint srcrd_start(srcrd_t* hnd, fprov_file_t* sf, compst_t* cst, fprov_t const* prv)
+{
+ srcrd_stop(hnd);
+
+ atomic_store(&(hnd->hed), 0U);
+ atomic_store(&(hnd->tal), 0U);
+ atomic_store(&(hnd->stp), 0U);
+ atomic_store(&(hnd->slp), 0U);
+ hnd->prv    = *prv;
+ hnd->fpt[0] = sf;
+ hnd->lin[0] = compst_getline(cst);
+ hnd->dep    = 0U;
+ hnd->icn    = 0U;
+ strpr_copy(&(hnd->cur[0]), compst_getsstr(cst), LINE_MAX);
+
+ pthread_mutex_init(&(hnd->mtx), NULL);
+ pthread_cond_init(&(hnd->cnd), NULL);
+ if (pthread_create(&(hnd->thr), NULL, &srcrd_i_reader, (void*)(hnd)) != 0){
+  pthread_mutex_destroy(&(hnd->mtx));
+  pthread_cond_destroy(&(hnd->cnd));
+  return 1U;
+ }
+ hnd->run = 1U;
+ return 0U;
+}
+
+
+
+/* Gets the next record, waiting for it if necessary. It remains valid until
+** srcrd_next(). */
+srcrd_rec_t const* srcrd_get(srcrd_t* hnd)
+{
+ auint tal = atomic_load_explicit(&(hnd->tal), memory_order_relaxed);
+ auint n   = 0U;
+
+ while (atomic_load_explicit(&(hnd->hed), memory_order_acquire) == tal){
+  srcrd_i_wait(hnd, &n, tal, tal);
+ }
+
+ return &(hnd->rng[tal % SRCRD_RNG]);
+}
+
+
+
+/* Releases the record got by srcrd_get(), moving on to the next. */
+void  srcrd_next(srcrd_t* hnd)
+{
+ atomic_store_explicit(&(hnd->tal),
+                       atomic_load_explicit(&(hnd->tal), memory_order_relaxed) + 1U,
+                       memory_order_release);
+ srcrd_i_wake(hnd);
+}
+
+
+
+/* Stops the reader, closing the includes it opened. */
+void  srcrd_stop(srcrd_t* hnd)
+{
+ if (hnd->run == 0U){ return; }
+ atomic_store(&(hnd->stp), 1U);
+ pthread_mutex_lock(&(hnd->mtx));
+ pthread_cond_broadcast(&(hnd->cnd));
+ pthread_mutex_unlock(&(hnd->mtx));
+ pthread_join(hnd->thr, NULL);
+ pthread_mutex_destroy(&(hnd->mtx));
+ pthread_cond_destroy(&(hnd->cnd));
+ hnd->run = 0U;
+}
@@ -0,0 +1,98 @@
+/**
+**  \file
+**  \brief     Pipelined source reader
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Reads the source on its own thread ahead of the first pass, passing it on
+**  as line records through a lock-free single producer - single consumer
+**  ring. The reader follows the includes on its own, just like the first
+**  pass would parse them (an include is entered only once, the first line of
+**  an include is not checked for includes), marking where it entered and
+**  left each. The first pass may still decide not to parse an include (such
+**  as one replayed or merged), then it skips its records.
+**
+**  Faults met by the reader are not printed, but passed on in the records,
+**  so the first pass outputs them in order.
+*/
+
+
+#ifndef SRCRD_H
+#define SRCRD_H
+
+
+#include "types.h"
+#include "compst.h"
+#include "fprov.h"
+
+
+/* Source reader object structure */
+typedef struct srcrd_s srcrd_t;
+
+
+/* Record types: A line of source */
+#define SRCRD_LIN  0U
+/* Record types: Include met (not included earlier). 'str' is its name. If
+** 'dsc' is nonzero, the reader entered it, its lines follow up to the
+** matching SRCRD_END. Otherwise 'err' is the errno of opening it if it could
+** not be opened (zero if the reader ran out of include slots). */
+#define SRCRD_INC  1U
+/* Record types: End of an include */
+#define SRCRD_END  2U
+/* Record types: End of the primary source, no more records */
+#define SRCRD_EOF  3U
+/* Record types: Failed to read a line ('err' is the errno). The file is
+** ended after it. */
+#define SRCRD_ERR  4U
+
+/* Size of the ring in records */
+#define SRCRD_RNG  256U
+
+
+/* Line record */
+typedef struct{
+ auint  typ;            /* Type of record (SRCRD_*) */
+ auint  lin;            /* Line number within the file */
+ auint  err;            /* errno of failures */
+ auint  lng;            /* Line was too long (truncated) */
+ auint  dsc;            /* Include was entered */
+ uint8  str[LINE_MAX];  /* Line or include name */
+}srcrd_rec_t;
+
+
+
+/* Creates a new source reader. Returns NULL if it is not possible to
+** allocate it. */
+srcrd_t* srcrd_new(void);
+
+
+/* Deletes a source reader, stopping it if necessary. */
+void  srcrd_delete(srcrd_t* hnd);
+
+
+/* Starts reading the primary source 'sf' (opened by firead_open(), its
+** current line being in the compile state) with its includes opened through
+** the provider. The records start with the line after the current. The
+** primary source is not closed by the reader. Returns nonzero (TRUE) if the
+** reader thread can not be started. */
+auint srcrd_start(srcrd_t* hnd, fprov_file_t* sf, compst_t* cst, fprov_t const* prv);
+
+
+/* Gets the next record, waiting for it if necessary. It remains valid until
+** srcrd_next(). */
+srcrd_rec_t const* srcrd_get(srcrd_t* hnd);
+
+
+/* Releases the record got by srcrd_get(), moving on to the next. */
+void  srcrd_next(srcrd_t* hnd);
+
+
+/* Stops the reader, closing the includes it opened. */
+void  srcrd_stop(srcrd_t* hnd);
+
+
+#endif
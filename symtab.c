@@ -11,13 +11,26 @@
 
 
 #include "symtab.h"
+#include "incmem.h"
+#include "peep.h"
+#include "cflow.h"
 #include "fault.h"
+#include <pthread.h>
+#include <unistd.h>
 
 
 
 /* Maximal hop count to pass during resolving */
 #define MAX_HOPS 16U
 
+/* Maximal count of threads used for resolving */
+#define SYMTAB_THR     64U
+/* Minimal count of definitions in a level (or of usages) to share among
+** threads when resolving */
+#define SYMTAB_PAR_MIN 2048U
+/* Level of a definition not determined yet */
+#define SYMTAB_LVL_NO  0xFFFFFFFFU
+
 
 /* Symbol definition structure */
 /* Note: currently memory-wise this is quite inefficient due to the large
@@ -56,19 +69,35 @@ struct symtab_s{
  uint8*        str;     /* String pool */
  auint         spt;     /* Free slot index within string pool */
  auint         ssi;     /* String pool size */
+ incmem_t*     rec;     /* Include memoization recording (NULL: none) */
+ relax_t*      rlx;     /* Jump relaxation (NULL: none) */
+ peep_t*       pep;     /* Peephole optimizer (NULL: none) */
+ cflow_t*      cfl;     /* Control flow optimizer (NULL: none) */
+ auint         thc;     /* Threads used for resolving (0: by processors) */
 };
 
 
-
-/* Built-in singleton object's components */
-static symtab_def_t symtab_def[SYMTAB_DEF_SIZE];
-static symtab_use_t symtab_usd[SYMTAB_USE_SIZE];
-static uint8        symtab_str[SYMTAB_STR_SIZE];
-static symtab_t     symtab_tab = {
- NULL, NULL,
- symtab_def, 0U, SYMTAB_DEF_SIZE,
- symtab_usd, 0U, SYMTAB_USE_SIZE,
- symtab_str, 0U, SYMTAB_STR_SIZE};
+/* State of resolving the table by levels */
+typedef struct{
+ symtab_t*     stb;     /* Symbol table resolved */
+ auint*        sid;     /* Source IDs of definitions (2 each, 0: value) */
+ auint*        val;     /* Values of definitions */
+ auint*        lvl;     /* Levels of definitions */
+ auint*        ord;     /* Definitions ordered by level */
+ uint64*       uso;     /* Usages ordered by section and offset */
+ uint8*        urs;     /* Results of usages (VALWR_R_ results) */
+ auint         beg;     /* First definition of the level in 'ord' */
+ auint         cnt;     /* Count of definitions in the level */
+ auint         thc;     /* Count of threads sharing the work */
+ auint         upb[SYMTAB_THR + 1U]; /* Usage partitions in 'uso' */
+ auint         fal[SYMTAB_THR]; /* Failures by thread */
+}symtab_res_t;
+
+/* Resolver thread parameters */
+typedef struct{
+ symtab_res_t* res;     /* State of resolving */
+ auint         tid;     /* Index of thread */
+}symtab_rth_t;
 
 
 
@@ -134,10 +163,41 @@ static auint symtab_snfindadd(symtab_t* hnd, uint8 const* nam)
 
 
 
-/* Get built-in singleton object handle. */
-symtab_t* symtab_getobj(void)
+/* Creates a new symbol table object. Returns NULL if it is not possible to
+** allocate it. The object has to be initialized before use. */
+symtab_t* symtab_new(void)
+{
+ symtab_t* hnd = (symtab_t*)(calloc(1U, sizeof(symtab_t)));
+
+ if (hnd == NULL){ return NULL; }
+ hnd->def = (symtab_def_t*)(malloc(sizeof(symtab_def_t) * SYMTAB_DEF_SIZE));
+ hnd->use = (symtab_use_t*)(malloc(sizeof(symtab_use_t) * SYMTAB_USE_SIZE));
+ hnd->str = (uint8*)(malloc(SYMTAB_STR_SIZE));
+ if ( (hnd->def == NULL) ||
+      (hnd->use == NULL) ||
+      (hnd->str == NULL) ){
+  symtab_delete(hnd);
+  return NULL;
+ }
+ hnd->dsi = SYMTAB_DEF_SIZE;
+ hnd->usi = SYMTAB_USE_SIZE;
+ hnd->ssi = SYMTAB_STR_SIZE;
+ hnd->thc = 1U;
+
+ return hnd;
+}
+
+
+
+/* Deletes a symbol table object. */
+void  symtab_delete(symtab_t* hnd)
 {
- return &symtab_tab;
+ if (hnd != NULL){
+  free(hnd->def);
+  free(hnd->use);
+  free(hnd->str);
+ }
+ free(hnd);
 }
 
 
@@ -152,6 +212,10 @@ void  symtab_init(symtab_t* hnd, section_t* sec, compst_t* cst)
  hnd->uct = 1U;
  hnd->spt = 1U;
  hnd->str[0] = 0U;
+ hnd->rec = NULL;
+ hnd->rlx = NULL;
+ hnd->pep = NULL;
+ hnd->cfl = NULL;
 }
 
 
@@ -214,6 +278,12 @@ auint symtab_addsymdef(symtab_t* hnd, auint cmd,
  hnd->def[hnd->dct].bdi = 0U;
  fault_fofget(&(hnd->def[hnd->dct].fof), hnd->cst, &(hnd->def[hnd->dct].fil[0]));
  hnd->dct ++;
+ if (hnd->rec != NULL){
+  incmem_radd(hnd->rec, hnd->cst, cmd,
+              s0v, &(hnd->str[((cmd & SYMTAB_CMD_S0N) != 0U) ? s0v : 0U]),
+              s1v, &(hnd->str[((cmd & SYMTAB_CMD_S1N) != 0U) ? s1v : 0U]),
+              hnd->dct - 1U);
+ }
  return (hnd->dct - 1U);
 
 fault_sde:
@@ -241,9 +311,11 @@ fault_ot0:
 ** not possible to do this (fault code printed). */
 auint symtab_getsymdef(symtab_t* hnd, uint8 const* nam)
 {
+ incmem_t* rec = hnd->rec;
  auint i;
  auint j;
  auint r = 0U;
+ auint n = 0U;
 
  i = symtab_snfind(hnd, nam);
 
@@ -260,8 +332,17 @@ auint symtab_getsymdef(symtab_t* hnd, uint8 const* nam)
 
  if (r == 0U){ /* Does not exist: add "dangling" symbol definition */
 
+  hnd->rec = NULL;       /* Recorded as a get, not as an add */
   r = symtab_addsymdef(hnd, SYMTAB_CMD_MOV | SYMTAB_CMD_S0N, 0, nam, 0, NULL);
+  hnd->rec = rec;
+  if (r == 0U){ return 0U; }
+  i = hnd->def[r].s0i;
+  n = 1U;
+
+ }
 
+ if (rec != NULL){
+  incmem_rget(rec, hnd->cst, &(hnd->str[i]), r, n);
  }
 
  return r;
@@ -295,6 +376,9 @@ auint symtab_bind(symtab_t* hnd, uint8 const* nam, auint id)
  }
 
  hnd->def[id].bdi = i; /* Bind it */
+ if (hnd->rec != NULL){
+  incmem_rbind(hnd->rec, hnd->cst, &(hnd->str[i]), id);
+ }
  return 0U;
 
 fault_rdf:
@@ -337,6 +421,9 @@ auint symtab_use(symtab_t* hnd, auint def, auint off, auint use)
  hnd->use[hnd->uct].bdi = def;
  fault_fofget(&(hnd->use[hnd->uct].fof), hnd->cst, &(hnd->use[hnd->uct].fil[0]));
  hnd->uct ++;
+ if (hnd->rec != NULL){
+  incmem_ruse(hnd->rec, hnd->cst, def, hnd->use[hnd->uct - 1U].sec, off, use);
+ }
  return 0U;
 
 fault_sus:
@@ -401,13 +488,13 @@ static auint symtab_recres(symtab_def_t* def, auint i, auint dct, auint hops, au
 
  if ((def[i].cmd & SYMTAB_CMD_S0I) != 0U){ /* Need to resolve Source 0 */
   t = symtab_recres(def, def[i].s0i, dct, hops + 1U, &r);
-  if      (t == 0U){ def[i].s0i = r; }
+  if      (t == 0U){ def[i].s0i = r; def[i].cmd &= ~(auint)(SYMTAB_CMD_S0I); }
   else if (t >= 2U){ goto fault_uds; }
   else             { goto fault_ot3; }
  }
  if ((def[i].cmd & SYMTAB_CMD_S1I) != 0U){ /* Need to resolve Source 1 */
   t = symtab_recres(def, def[i].s1i, dct, hops + 1U, &r);
-  if      (t == 0U){ def[i].s1i = r; }
+  if      (t == 0U){ def[i].s1i = r; def[i].cmd &= ~(auint)(SYMTAB_CMD_S1I); }
   else if (t >= 2U){ goto fault_uds; }
   else             { goto fault_ot3; }
  }
@@ -490,19 +577,846 @@ auint symtab_resolvesym(symtab_t* hnd, auint id, auint* val)
 
 
 
-/* Resolves the symbol table into the bound section. Prints fault and returns
-** nonzero if it is not possible to resolve. */
+/* Attempts to resolve a symbol by name to it's value, like
+** symtab_resolvesym(), but without creating a definition if the name is not
+** bound. Returns nonzero on success, filling in 'val'. */
+auint symtab_resolvenam(symtab_t* hnd, uint8 const* nam, auint* val)
+{
+ auint i;
+ auint j;
+
+ i = symtab_snfind(hnd, nam);
+ if (i == 0U){ return 0U; }
+
+ for (j = 1U; j < (hnd->dct); j++){
+  if ((hnd->def[j].bdi) == i){
+   return symtab_resolvesym(hnd, j, val);
+  }
+ }
+
+ return 0U;
+}
+
+
+
+/* Writes the symbol table (names, definitions and usages) into an object
+** file. Returns nonzero (TRUE) on failure (errno set). */
+auint symtab_objout(symtab_t* hnd, fprov_file_t* ofl)
+{
+ auint i;
+
+ if (fprov_wru32(ofl, hnd->spt)){ return 1U; }
+ if (fprov_write(ofl, hnd->str, hnd->spt)){ return 1U; }
+
+ if (fprov_wru32(ofl, hnd->dct)){ return 1U; }
+ for (i = 1U; i < (hnd->dct); i++){
+  if (fprov_wru32(ofl, hnd->def[i].cmd)){ return 1U; }
+  if (fprov_wru32(ofl, hnd->def[i].s0i)){ return 1U; }
+  if (fprov_wru32(ofl, hnd->def[i].s1i)){ return 1U; }
+  if (fprov_wru32(ofl, hnd->def[i].bdi)){ return 1U; }
+  if (fprov_wrstr(ofl, &(hnd->def[i].fil[0]))){ return 1U; }
+  if (fprov_wru32(ofl, hnd->def[i].fof.lin)){ return 1U; }
+  if (fprov_wru32(ofl, hnd->def[i].fof.chr)){ return 1U; }
+ }
+
+ if (fprov_wru32(ofl, hnd->uct)){ return 1U; }
+ for (i = 1U; i < (hnd->uct); i++){
+  if (fprov_wru32(ofl, hnd->use[i].sec)){ return 1U; }
+  if (fprov_wru32(ofl, hnd->use[i].off)){ return 1U; }
+  if (fprov_wru32(ofl, hnd->use[i].use)){ return 1U; }
+  if (fprov_wru32(ofl, hnd->use[i].bdi)){ return 1U; }
+  if (fprov_wrstr(ofl, &(hnd->use[i].fil[0]))){ return 1U; }
+  if (fprov_wru32(ofl, hnd->use[i].fof.lin)){ return 1U; }
+  if (fprov_wru32(ofl, hnd->use[i].fof.chr)){ return 1U; }
+ }
+
+ return 0U;
+}
+
+
+
+/* Internal function for symtab_objin(): converts a source of an object's
+** symbol definition. Names of section bases are replaced by the IDs of the
+** displaced bases ('sid'), other IDs are moved by 'fst' (the ID of the
+** object's first definition), 'cur' is the definition's own index within the
+** object. Returns nonzero (TRUE) if the source is malformed. */
+static auint symtab_objsrc(uint8 const* str, auint spt, auint const* sid,
+                           auint fst, auint cur,
+                           auint* cmd, auint fln, auint fli, auint* v)
+{
+ auint k;
+
+ if ((*cmd & fln) != 0U){
+  if ((*v) >= spt){ return 1U; }
+  for (k = 0U; k < SECT_CNT; k++){
+   if (strcmp((char const*)(&(str[*v])), (char const*)(section_getsbstr(k))) == 0){
+    *cmd = ((*cmd) & ~fln) | fli;
+    *v   = sid[k];
+    break;
+   }
+  }
+ }else if ((*cmd & fli) != 0U){
+  if (((*v) == 0U) || ((*v) >= cur)){ return 1U; }
+  *v = fst + (*v) - 1U;
+ }
+
+ return 0U;
+}
+
+
+
+/* Internal function for symtab_objin(): checks whether the name 'nam' is
+** bound to a constant of the same value as the definition 'id' already (such
+** as one of a header included by several objects). Returns nonzero (TRUE) if
+** so, then the definition is left anonymous. */
+static auint symtab_i_samecon(symtab_t* hnd, uint8 const* nam, auint id)
+{
+ auint i;
+ auint j;
+
+ if ((hnd->def[id].cmd) != SYMTAB_CMD_MOV){ return 0U; }
+ i = symtab_snfind(hnd, nam);
+ if (i == 0U){ return 0U; }
+
+ for (j = 1U; j < id; j++){
+  if ((hnd->def[j].bdi) == i){
+   return ( ((hnd->def[j].cmd) == SYMTAB_CMD_MOV) &&
+            ((hnd->def[j].s0i) == (hnd->def[id].s0i)) );
+  }
+ }
+
+ return 0U;
+}
+
+
+
+/* Reads a symbol table written by symtab_objout() from an object file,
+** adding its definitions and usages to this table. 'dlt' gives the
+** displacement of the object for each section: usage offsets are moved
+** accordingly, and the object's references of section bases are replaced by
+** the section base plus its displacement. A name already bound to a
+** constant of the same value (such as from a header included by several
+** objects) is not a redefinition. Returns 0 on success, 1 on failure (fault
+** printed, such as symbol redefinition), 2 if the object can not be read or
+** is malformed (errno set, no fault printed). */
+auint symtab_objin(symtab_t* hnd, fprov_file_t* ifl, auint const* dlt)
+{
+ uint8  fil[FILE_MAX];
+ uint8* str = NULL;
+ auint  sid[SECT_CNT];
+ auint  spt;
+ auint  cnt;
+ auint  fst;
+ auint  i;
+ auint  r;
+ auint  cmd;
+ auint  s0v;
+ auint  s1v;
+ auint  bdi;
+ auint  sec;
+ auint  off;
+ auint  use;
+ auint  lin;
+ auint  chr;
+
+ /* Names */
+
+ if (fprov_rdu32(ifl, &spt)){ goto fault_red; }
+ if ((spt == 0U) || (spt > (hnd->ssi))){ goto fault_inv; }
+ str = (uint8*)(malloc(spt));
+ if (str == NULL){ errno = ENOMEM; goto fault_red; }
+ if (fprov_read(ifl, str, spt, &r)){ goto fault_red; }
+ if (r != spt){ errno = EIO; goto fault_red; }
+ if (str[spt - 1U] != 0U){ goto fault_inv; }
+
+ /* Displaced section bases of the object */
+
+ for (i = 0U; i < SECT_CNT; i++){
+  sid[i] = symtab_addsymdef(hnd, SYMTAB_CMD_ADD | SYMTAB_CMD_S0N,
+                            0U, section_getsbstr(i), dlt[i], NULL);
+  if (sid[i] == 0U){ goto fault_oth; }
+ }
+
+ /* Definitions */
+
+ if (fprov_rdu32(ifl, &cnt)){ goto fault_red; }
+ fst = hnd->dct;
+ for (i = 1U; i < cnt; i++){
+  if (fprov_rdu32(ifl, &cmd)){ goto fault_red; }
+  if (fprov_rdu32(ifl, &s0v)){ goto fault_red; }
+  if (fprov_rdu32(ifl, &s1v)){ goto fault_red; }
+  if (fprov_rdu32(ifl, &bdi)){ goto fault_red; }
+  if (fprov_rdstr(ifl, &fil[0], FILE_MAX)){ goto fault_red; }
+  if (fprov_rdu32(ifl, &lin)){ goto fault_red; }
+  if (fprov_rdu32(ifl, &chr)){ goto fault_red; }
+  if (symtab_objsrc(str, spt, &sid[0], fst, i, &cmd, SYMTAB_CMD_S0N, SYMTAB_CMD_S0I, &s0v)){ goto fault_inv; }
+  if (symtab_objsrc(str, spt, &sid[0], fst, i, &cmd, SYMTAB_CMD_S1N, SYMTAB_CMD_S1I, &s1v)){ goto fault_inv; }
+  if (bdi >= spt){ goto fault_inv; }
+  compst_setfile(hnd->cst, &fil[0]);
+  compst_setline(hnd->cst, lin);
+  compst_setcoff(hnd->cst, chr);
+  r = symtab_addsymdef(hnd, cmd,
+                       s0v, ((cmd & SYMTAB_CMD_S0N) != 0U) ? &(str[s0v]) : NULL,
+                       s1v, ((cmd & SYMTAB_CMD_S1N) != 0U) ? &(str[s1v]) : NULL);
+  if (r == 0U){ goto fault_oth; }
+  if ( (bdi != 0U) &&
+       (symtab_i_samecon(hnd, &(str[bdi]), r) == 0U) ){
+   if (symtab_bind(hnd, &(str[bdi]), r)){ goto fault_oth; }
+  }
+ }
+
+ /* Usages */
+
+ if (fprov_rdu32(ifl, &cnt)){ goto fault_red; }
+ for (i = 1U; i < cnt; i++){
+  if (fprov_rdu32(ifl, &sec)){ goto fault_red; }
+  if (fprov_rdu32(ifl, &off)){ goto fault_red; }
+  if (fprov_rdu32(ifl, &use)){ goto fault_red; }
+  if (fprov_rdu32(ifl, &bdi)){ goto fault_red; }
+  if (fprov_rdstr(ifl, &fil[0], FILE_MAX)){ goto fault_red; }
+  if (fprov_rdu32(ifl, &lin)){ goto fault_red; }
+  if (fprov_rdu32(ifl, &chr)){ goto fault_red; }
+  if ((sec >= SECT_CNT) || (bdi == 0U) || (bdi >= (hnd->dct - fst + 1U))){ goto fault_inv; }
+  compst_setfile(hnd->cst, &fil[0]);
+  compst_setline(hnd->cst, lin);
+  compst_setcoff(hnd->cst, chr);
+  section_setsect(hnd->sec, sec);
+  if (symtab_use(hnd, fst + bdi - 1U, off + dlt[sec], use)){ goto fault_oth; }
+ }
+
+ free(str);
+ return 0U;
+
+fault_inv:
+
+ errno = EINVAL;
+
+fault_red:
+
+ free(str);
+ return 2U;
+
+fault_oth:
+
+ free(str);
+ return 1U;
+}
+
+
+
+/* Gets the names bound to definitions one by one. 'pos' should start at
+** zero, it is advanced by each call. Returns NULL when there are no more
+** names. */
+uint8 const* symtab_getbound(symtab_t* hnd, auint* pos)
+{
+ auint i;
+
+ for (i = (*pos) + 1U; i < (hnd->dct); i++){
+  if ((hnd->def[i].bdi) != 0U){
+   *pos = i;
+   return &(hnd->str[hnd->def[i].bdi]);
+  }
+ }
+
+ *pos = hnd->dct;
+ return NULL;
+}
+
+
+
+/* Checks whether a name is bound to a definition. Returns nonzero (TRUE) if
+** so. */
+auint symtab_isbound(symtab_t* hnd, uint8 const* nam)
+{
+ auint i;
+ auint j;
+
+ i = symtab_snfind(hnd, nam);
+ if (i == 0U){ return 0U; }     /* Not used at all */
+
+ for (j = 1U; j < (hnd->dct); j++){
+  if ((hnd->def[j].bdi) == i){ return 1U; }
+ }
+
+ return 0U;
+}
+
+
+
+/* Checks whether the definition 'id' is a reference to the name 'nam' (a
+** definition got by symtab_getsymdef() before the name was bound). Returns
+** nonzero (TRUE) if so. */
+auint symtab_isref(symtab_t* hnd, auint id, uint8 const* nam)
+{
+ if ((id == 0U) || (id >= (hnd->dct))){ return 0U; }
+ if ((hnd->def[id].cmd) != (SYMTAB_CMD_MOV | SYMTAB_CMD_S0N)){ return 0U; }
+ return compst_issymequ(hnd->cst, nam, &(hnd->str[hnd->def[id].s0i]));
+}
+
+
+
+/* Removes the name binding of a definition, so it remains as an anonymous
+** definition (the definitions referring it by ID are unaffected). */
+void  symtab_unbind(symtab_t* hnd, auint id)
+{
+ if ((id != 0U) && (id < (hnd->dct))){
+  hnd->def[id].bdi = 0U;
+ }
+}
+
+
+
+/* Calls 'cb' for every name used but not bound to any definition (with the
+** names of the section bases). Returns nonzero (TRUE) if it is not possible
+** (no memory). */
+auint symtab_undefs(symtab_t* hnd, void (*cb)(void* ctx, uint8 const* nam), void* ctx)
+{
+ uint8* bnd;
+ auint  i;
+ auint  p = 0U;
+
+ bnd = (uint8*)(calloc(hnd->spt, 1U));
+ if (bnd == NULL){ return 1U; }
+ for (i = 1U; i < (hnd->dct); i++){
+  bnd[hnd->def[i].bdi] = 1U;
+ }
+
+ for (i = 1U; i < (hnd->spt); i++){
+  if ((p == 0U) && (hnd->str[i] != 0U) && (bnd[i] == 0U)){
+   cb(ctx, &(hnd->str[i]));
+  }
+  p = hnd->str[i];
+ }
+
+ free(bnd);
+ return 0U;
+}
+
+
+
+/* Calls 'cb' for every usage with each label its value depends on, following
+** the definitions from it (a label is an offset added to the base of a
+** section, see litpr_symdefproc()). The usage is given by its section and
+** offset ('usc', 'uof'), the label by its section and offset ('lsc', 'lof').
+** Must be called before resolving. Returns nonzero (TRUE) if it is not
+** possible (no memory). */
+auint symtab_labrefs(symtab_t* hnd,
+                     void (*cb)(void* ctx, auint usc, auint uof, auint lsc, auint lof),
+                     void* ctx)
+{
+ symtab_def_t const* def = hnd->def;
+ auint  sbi[SECT_CNT];
+ auint* map;
+ auint* vis;
+ auint* stk;
+ auint  spc;
+ auint  i;
+ auint  j;
+ auint  k;
+ auint  t;
+
+ /* Map of string pool offsets to the first definition bound to them, marks
+ ** of the definitions visited for a usage, and the stack of those to visit
+ ** (each visited pushes at most two). */
+
+ map = (auint*)(calloc(hnd->spt, sizeof(auint)));
+ vis = (auint*)(calloc(hnd->dct, sizeof(auint)));
+ stk = (auint*)(malloc((((hnd->dct) << 1) + 1U) * sizeof(auint)));
+ if ((map == NULL) || (vis == NULL) || (stk == NULL)){
+  free(map);
+  free(vis);
+  free(stk);
+  return 1U;
+ }
+ for (i = (hnd->dct) - 1U; i != 0U; i--){
+  if (def[i].bdi < hnd->spt){ map[def[i].bdi] = i; }
+ }
+ for (k = 0U; k < SECT_CNT; k++){
+  sbi[k] = symtab_snfind(hnd, section_getsbstr(k));
+ }
+
+ for (j = 0U; j < (hnd->uct); j++){
+
+  spc = 0U;
+  stk[spc] = hnd->use[j].bdi;
+  spc ++;
+
+  while (spc != 0U){
+   spc --;
+   i = stk[spc];
+   if ((i == 0U) || (i >= hnd->dct) || (vis[i] == (j + 1U))){ continue; }
+   vis[i] = j + 1U;
+
+   if (def[i].cmd == (SYMTAB_CMD_ADD | SYMTAB_CMD_S1N)){
+    for (k = 0U; k < SECT_CNT; k++){
+     if ((sbi[k] != 0U) && (def[i].s1i == sbi[k])){ break; }
+    }
+    if (k < SECT_CNT){   /* A label: its dependencies are not followed */
+     cb(ctx, hnd->use[j].sec, hnd->use[j].off, k, def[i].s0i);
+     continue;
+    }
+   }
+
+   for (k = 0U; k < 2U; k++){
+    t = (k == 0U) ? def[i].s0i : def[i].s1i;
+    if      ((def[i].cmd & (SYMTAB_CMD_S0N << k)) != 0U){ /* By name */
+     t = (t < hnd->spt) ? map[t] : 0U;
+    }else if ((def[i].cmd & (SYMTAB_CMD_S0I << k)) == 0U){ /* Value */
+     t = 0U;
+    }else{}
+    if (t != 0U){
+     stk[spc] = t;
+     spc ++;
+    }
+   }
+  }
+
+ }
+
+ free(map);
+ free(vis);
+ free(stk);
+ return 0U;
+}
+
+/* Sets the include memoization to record the adding of definitions, bindings
+** and usages into (NULL stops recording). Reset by symtab_init(). */
+void  symtab_setrec(symtab_t* hnd, struct incmem_s* rec)
+{
+ hnd->rec = rec;
+}
+
+
+
+/* Sets the relaxation to use (NULL: none). The first pass checks it for the
+** form of the relaxable jumps and immediates, and when resolving, those
+** which need an other form are set in it (see symtab_resolve()). Reset by
+** symtab_init(). */
+void  symtab_setrlx(symtab_t* hnd, relax_t* rlx)
+{
+ hnd->rlx = rlx;
+}
+
+
+
+/* Gets the relaxation in use (NULL: none). */
+relax_t* symtab_getrlx(symtab_t* hnd)
+{
+ return hnd->rlx;
+}
+
+
+
+/* Sets the peephole optimizer the first pass feeds the instructions and
+** labels into (NULL: none). Reset by symtab_init(). */
+void  symtab_setpeep(symtab_t* hnd, struct peep_s* pep)
+{
+ hnd->pep = pep;
+}
+
+
+
+/* Gets the peephole optimizer in use (NULL: none). */
+struct peep_s* symtab_getpeep(symtab_t* hnd)
+{
+ return hnd->pep;
+}
+
+
+
+/* Sets the control flow optimizer the first pass records the branches into
+** (NULL: none). Reset by symtab_init(). */
+void  symtab_setcflow(symtab_t* hnd, struct cflow_s* cfl)
+{
+ hnd->cfl = cfl;
+}
+
+
+
+/* Gets the control flow optimizer in use (NULL: none). */
+struct cflow_s* symtab_getcflow(symtab_t* hnd)
+{
+ return hnd->cfl;
+}
+
+
+
+/* Sets the count of threads used for resolving (0: by the number of
+** processors). Large tables are resolved sharing the work among these. One
+** thread is used after creation, not reset by symtab_init(). */
+void  symtab_setthr(symtab_t* hnd, auint thc)
+{
+ hnd->thc = thc;
+}
+
+
+
+/* Internal function to determine the level of definition 'i': 0 if it
+** depends on no other definition, otherwise one more than the highest level
+** among those it depends on. 'dep' is the depth of recursion. Returns
+** MAX_HOPS if the level reaches it (including circular dependencies), then
+** resolving it might exceed the hop count. */
+static auint symtab_i_level(symtab_res_t* res, auint i, auint dep)
+{
+ auint l = 0U;
+ auint k;
+ auint t;
+
+ if (res->lvl[i] != SYMTAB_LVL_NO){ return res->lvl[i]; }
+ if (dep >= MAX_HOPS){ return MAX_HOPS; }
+
+ for (k = 0U; k < 2U; k++){
+  if (res->sid[(i << 1) + k] != 0U){
+   t = symtab_i_level(res, res->sid[(i << 1) + k], dep + 1U) + 1U;
+   if (t >= MAX_HOPS){ return MAX_HOPS; }
+   if (l < t){ l = t; }
+  }
+ }
+
+ res->lvl[i] = l;
+ return l;
+}
+
+
+
+/* Internal function to evaluate definition 'i' whose sources are already
+** evaluated. Returns nonzero (TRUE) on division by zero. */
+static auint symtab_i_eval(symtab_res_t* res, auint i)
+{
+ symtab_def_t const* def = &(res->stb->def[i]);
+ auint s0 = def->s0i;
+ auint s1 = def->s1i;
+ auint r;
+
+ if (res->sid[(i << 1)     ] != 0U){ s0 = res->val[res->sid[(i << 1)     ]]; }
+ if (res->sid[(i << 1) + 1U] != 0U){ s1 = res->val[res->sid[(i << 1) + 1U]]; }
+
+ switch (def->cmd & 0xFFU){
+
+  case SYMTAB_CMD_ADD: r = s0 +  s1; break;
+  case SYMTAB_CMD_SUB: r = s0 -  s1; break;
+  case SYMTAB_CMD_MUL: r = s0 *  s1; break;
+  case SYMTAB_CMD_DIV:
+   if (s1 == 0U){ return 1U; }
+   r = s0 / s1;
+   break;
+  case SYMTAB_CMD_MOD:
+   if (s1 == 0U){ return 1U; }
+   r = s0 % s1;
+   break;
+  case SYMTAB_CMD_AND: r = s0 &  s1; break;
+  case SYMTAB_CMD_OR:  r = s0 |  s1; break;
+  case SYMTAB_CMD_XOR: r = s0 ^  s1; break;
+  case SYMTAB_CMD_SHR: r = s0 >> (s1 & 31U); break;
+  case SYMTAB_CMD_SHL: r = s0 << (s1 & 31U); break;
+  default:             r = s0; break;
+
+ }
+
+ res->val[i] = r;
+ return 0U;
+}
+
+
+
+/* Resolver thread: evaluates its share of the definitions of a level. */
+static void* symtab_i_evalthr(void* ptr)
+{
+ symtab_rth_t* rth = (symtab_rth_t*)(ptr);
+ symtab_res_t* res = rth->res;
+ auint beg = res->beg + (uint32)(((uint64)(res->cnt) * (rth->tid)) / (res->thc));
+ auint end = res->beg + (uint32)(((uint64)(res->cnt) * (rth->tid + 1U)) / (res->thc));
+
+ for (; beg < end; beg++){
+  if (symtab_i_eval(res, res->ord[beg])){ res->fal[rth->tid] = 1U; }
+ }
+
+ return NULL;
+}
+
+
+
+/* Resolver thread: writes out the usages of its partition. */
+static void* symtab_i_usethr(void* ptr)
+{
+ symtab_rth_t* rth = (symtab_rth_t*)(ptr);
+ symtab_res_t* res = rth->res;
+ symtab_use_t const* use;
+ auint i;
+ auint j;
+
+ for (i = res->upb[rth->tid]; i < res->upb[rth->tid + 1U]; i++){
+  j   = (auint)(res->uso[i] & 0xFFFFFFU);
+  use = &(res->stb->use[j]);
+  res->urs[j] = valwr_writes(res->stb->sec, use->sec, res->stb->def[use->bdi].s0i, use->off, use->use);
+ }
+
+ return NULL;
+}
+
+
+
+/* Internal function to run 'fn' on 'thc' threads. Shares that could not get
+** a thread of their own are run on the calling thread. */
+static void  symtab_i_run(symtab_res_t* res, void* (*fn)(void*), auint thc)
+{
+ pthread_t    thr[SYMTAB_THR];
+ symtab_rth_t rth[SYMTAB_THR];
+ auint        sta[SYMTAB_THR];
+ auint        i;
+
+ res->thc = thc;
+ for (i = 0U; i < thc; i++){
+  rth[i].res = res;
+  rth[i].tid = i;
+  res->fal[i] = 0U;
+ }
+ for (i = 1U; i < thc; i++){
+  sta[i] = (pthread_create(&(thr[i]), NULL, fn, (void*)(&rth[i])) == 0);
+ }
+ fn((void*)(&rth[0]));
+ for (i = 1U; i < thc; i++){
+  if (sta[i]){ pthread_join(thr[i], NULL); }
+  else       { fn((void*)(&rth[i])); }
+ }
+}
+
+
+
+/* Compares usage ordering keys for qsort() */
+static int   symtab_i_usecmp(void const* a, void const* b)
+{
+ uint64 ka = *(uint64 const*)(a);
+ uint64 kb = *(uint64 const*)(b);
+ return (ka > kb) - (ka < kb);
+}
+
+
+
+/* Internal function to convert the sources of the definitions to IDs, so the
+** dependencies between them are known. Returns nonzero (TRUE) if a symbol
+** name is not defined, or an ID is not valid. */
+static auint symtab_i_link(symtab_res_t* res)
+{
+ symtab_t*     hnd = res->stb;
+ symtab_def_t* def = hnd->def;
+ auint*        map;
+ auint         i;
+ auint         k;
+ auint         t;
+
+ /* Map of string pool offsets to the first definition bound to them. */
+
+ map = (auint*)(calloc(hnd->spt, sizeof(auint)));
+ if (map == NULL){ return 1U; }
+ for (i = (hnd->dct) - 1U; i != 0U; i--){
+  if (def[i].bdi < hnd->spt){ map[def[i].bdi] = i; }
+ }
+
+ for (i = 1U; i < (hnd->dct); i++){
+  for (k = 0U; k < 2U; k++){
+   t = (k == 0U) ? def[i].s0i : def[i].s1i;
+   if      ((def[i].cmd & (SYMTAB_CMD_S0N << k)) != 0U){ /* By name */
+    t = ((t != 0U) && (t < hnd->spt)) ? map[t] : 0U;
+    if (t == 0U){ goto fault_lnk; }
+   }else if ((def[i].cmd & (SYMTAB_CMD_S0I << k)) != 0U){ /* By ID */
+    if ((t == 0U) || (t >= hnd->dct)){ goto fault_lnk; }
+   }else{                                                /* Value */
+    t = 0U;
+   }
+   res->sid[(i << 1) + k] = t;
+  }
+ }
+
+ free(map);
+ return 0U;
+
+fault_lnk:
+
+ free(map);
+ return 1U;
+}
+
+
+
+/* Internal function to resolve the table by levels, definitions of a level
+** (and the usages, partitioned by section and offset) shared among threads.
+** Prints no fault, returns nonzero (TRUE) if the table can not be resolved
+** this way (the table is not changed then), or if any usage has faults
+** (then only the usages are written). */
+static auint symtab_i_reslvl(symtab_t* hnd)
+{
+ symtab_res_t res;
+ auint        lvb[MAX_HOPS + 1U];
+ auint        dct = hnd->dct;
+ auint        uct = hnd->uct;
+ auint        thc = hnd->thc;
+ auint        r   = 1U;
+ auint        i;
+ auint        j;
+ auint        t;
+
+#ifdef _SC_NPROCESSORS_ONLN
+ if (thc == 0U){ thc = (auint)(sysconf(_SC_NPROCESSORS_ONLN)); }
+#endif
+ if (thc == 0U){ thc = 1U; }
+ if (thc > SYMTAB_THR){ thc = SYMTAB_THR; }
+
+ memset(&res, 0, sizeof(res));
+ res.stb = hnd;
+ res.sid = (auint*)(malloc(sizeof(auint) * dct * 2U));
+ res.val = (auint*)(malloc(sizeof(auint) * dct));
+ res.lvl = (auint*)(malloc(sizeof(auint) * dct));
+ res.ord = (auint*)(malloc(sizeof(auint) * dct));
+ res.uso = (uint64*)(malloc(sizeof(uint64) * uct));
+ res.urs = (uint8*)(malloc(uct));
+ if ( (res.sid == NULL) ||
+      (res.val == NULL) ||
+      (res.lvl == NULL) ||
+      (res.ord == NULL) ||
+      (res.uso == NULL) ||
+      (res.urs == NULL) ||
+      (uct > 0x1000000U) ){ goto end; }
+
+ /* Determine levels, definitions ordered by them */
+
+ if (symtab_i_link(&res)){ goto end; }
+ for (i = 1U; i < dct; i++){ res.lvl[i] = SYMTAB_LVL_NO; }
+ for (i = 0U; i <= MAX_HOPS; i++){ lvb[i] = 0U; }
+ for (i = 1U; i < dct; i++){
+  t = symtab_i_level(&res, i, 0U);
+  if (t >= MAX_HOPS){ goto end; } /* Might exceed hop count */
+  lvb[t + 1U] ++;
+ }
+ for (i = 1U; i <= MAX_HOPS; i++){ lvb[i] += lvb[i - 1U]; }
+ for (i = 1U; i < dct; i++){
+  res.ord[lvb[res.lvl[i]]] = i;
+  lvb[res.lvl[i]] ++;
+ }
+
+ /* Evaluate level by level (now lvb[] holds level ends) */
+
+ for (i = 0U; i < MAX_HOPS; i++){
+  res.beg = (i == 0U) ? 0U : lvb[i - 1U];
+  res.cnt = lvb[i] - res.beg;
+  if (res.cnt == 0U){ break; }
+  t = (res.cnt >= SYMTAB_PAR_MIN) ? thc : 1U;
+  symtab_i_run(&res, &symtab_i_evalthr, t);
+  for (j = 0U; j < t; j++){
+   if (res.fal[j] != 0U){ goto end; } /* Division by zero */
+  }
+ }
+
+ /* Resolved, convert definitions to MOVs */
+
+ for (i = 1U; i < dct; i++){
+  if (res.sid[(i << 1) + 1U] != 0U){ hnd->def[i].s1i = res.val[res.sid[(i << 1) + 1U]]; }
+  hnd->def[i].cmd = SYMTAB_CMD_MOV;
+  hnd->def[i].s0i = res.val[i];
+ }
+
+ /* Write usages, partitioned so no two partitions touch the same word */
+
+ for (i = 1U; i < uct; i++){
+  res.uso[i - 1U] = ((uint64)(hnd->use[i].sec) << 56) |
+                    ((uint64)(hnd->use[i].off) << 24) | (uint64)(i);
+ }
+ qsort(res.uso, uct - 1U, sizeof(uint64), &symtab_i_usecmp);
+ t = (uct - 1U >= SYMTAB_PAR_MIN) ? thc : 1U;
+ res.upb[0] = 0U;
+ for (i = 1U; i < t; i++){
+  j = (uint32)(((uint64)(uct - 1U) * i) / t);
+  if (j < res.upb[i - 1U]){ j = res.upb[i - 1U]; }
+  while ( (j != 0U) && (j < (uct - 1U)) &&
+          ((res.uso[j] >> 56) == (res.uso[j - 1U] >> 56)) &&
+          (((res.uso[j] >> 24) & 0xFFFFFFFFU) <= (((res.uso[j - 1U] >> 24) & 0xFFFFFFFFU) + 1U)) ){
+   j ++;             /* Usages may write two words */
+  }
+  res.upb[i] = j;
+ }
+ res.upb[t] = uct - 1U;
+ symtab_i_run(&res, &symtab_i_usethr, t);
+
+ /* Select the section of the last usage as writing them in order would */
+
+ if (uct > 1U){ section_setsect(hnd->sec, hnd->use[uct - 1U].sec); }
+
+ r = 0U;
+ for (i = 1U; i < uct; i++){
+  if (res.urs[i] != VALWR_R_OK){ r = 1U; }
+ }
+
+end:
+
+ free(res.sid);
+ free(res.val);
+ free(res.lvl);
+ free(res.ord);
+ free(res.uso);
+ free(res.urs);
+ return r;
+}
+
+
+
+/* Internal function to set the relaxable immediates fitting a shorter form
+** short (see relax.h), the definitions resolved. Returns nonzero (TRUE) if
+** any line changed its form. */
+static auint symtab_i_shrink(symtab_t* hnd)
+{
+ symtab_use_t* use = hnd->use;
+ uint32 val;
+ auint  r = 0U;
+ auint  i;
+
+ for (i = 1U; i < (hnd->uct); i++){
+  if ( (use[i].use == VALWR_X16) ||
+       (use[i].use == VALWR_M16) ||
+       (use[i].use == VALWR_P16) ){
+   val = hnd->def[use[i].bdi].s0i;
+   if ( (valwr_isshort(use[i].use, val)) &&
+        (relax_set(hnd->rlx, use[i].fof.fil, use[i].fof.lin, RELAX_SHORT, val)) ){
+    r = 1U;
+   }
+  }
+ }
+
+ return r;
+}
+
+
+
+/* Resolves the symbol table into the bound section. Definitions are
+** evaluated by levels of dependence, and the usages are written partitioned
+** by section and offset, both sharing the work among threads for large
+** tables. Faults are the same as if everything was resolved in order: the
+** first failure in order is printed. Prints fault and returns nonzero if it
+** is not possible to resolve. If a relaxation is set (see relax.h), the
+** usages are relaxed by it where possible instead of failing, and if any
+** line changed its form, it returns nonzero without a fault (the assembly
+** has to be repeated). */
 auint symtab_resolve(symtab_t* hnd)
 {
  uint8 s[80];
  auint i;
  auint dum;
  auint t;
+ auint rlx = 0U;
  symtab_use_t* use = hnd->use;
  symtab_def_t* def = hnd->def;
  auint uct = hnd->uct;
  auint dct = hnd->dct;
 
+ /* Resolve by levels where possible. If it fails, the resolution is done in
+ ** order below to get the faults (or notes) in order: definitions are left
+ ** unchanged if any of those failed, and writing usages again has no effect
+ ** on the data. */
+
+ if (symtab_i_reslvl(hnd) == 0U){
+  if (hnd->rlx != NULL){ return symtab_i_shrink(hnd); }
+  return 0U;
+ }
+
  /* Resolve all symbol definitions into MOVs */
 
  for (i = 1U; i < dct; i++){
@@ -511,10 +1425,23 @@ auint symtab_resolve(symtab_t* hnd)
   if (t >= 2U){ goto fault_udd; } /* Undefined symbol: string pool offset + 2U in 't' */
  }
 
+ /* Shorter forms first: the jumps are only relaxed once the code shrunk. */
+
+ if ( (hnd->rlx != NULL) &&
+      (symtab_i_shrink(hnd)) ){ return 1U; }
+
  /* Resolve symbol usages into the appropriate section:offset locations */
 
  for (i = 1U; i < uct; i++){
   section_setsect(hnd->sec, use[i].sec);
+  if ( ( (use[i].use == VALWR_J10) ||         /* Jump out of range */
+         (use[i].use == VALWR_CHK) ) &&       /* Relaxed immediate changed */
+       (hnd->rlx != NULL) &&
+       (valwr_writes(hnd->sec, use[i].sec, def[use[i].bdi].s0i, use[i].off, use[i].use) == VALWR_R_FAIL) &&
+       (relax_set(hnd->rlx, use[i].fof.fil, use[i].fof.lin, RELAX_LONG, 0U)) ){
+   rlx = 1U;            /* Relaxed, so the assembly will be repeated */
+   continue;
+  }
   if (valwr_write(hnd->sec, def[use[i].bdi].s0i, use[i].off, use[i].use, &(use[i].fof))){
    goto fault_ot4;
   }
@@ -522,7 +1449,7 @@ auint symtab_resolve(symtab_t* hnd)
 
  /* All done */
 
- return 0U;
+ return rlx;
 
 fault_udd:
 
@@ -9,7 +9,6 @@
 **  \date      2014.11.13
 **
 **  Manages the symbol table: creates entries, and for pass2, resolves those.
-**  Currently singleton, but designed so it is possible to extend later.
 **
 **  Symbols in the source are identified by strings: the symbol table supports
 **  the resolution of these indexed by the strings. Internally however the
@@ -17,7 +16,7 @@
 **  definitions (such as parts of an expression).
 **
 **  The component is built so it may work with arbitrary (fixed) sizes,
-**  however for the singleton, these sizes are fixed and are controlled by the
+**  however objects are currently created with the sizes controlled by the
 **  size definitions.
 **
 **  Section base offsets are meant to be applied using special symbols added
@@ -33,11 +32,22 @@
 #include "section.h"
 #include "compst.h"
 #include "valwr.h"
+#include "fprov.h"
+#include "relax.h"
 
 
 /* Symbol table data structure */
 typedef struct symtab_s symtab_t;
 
+/* Include memoization (see "incmem.h"), recording symbol table operations */
+struct incmem_s;
+
+/* Peephole optimizer (see "peep.h"), carried for the first pass */
+struct peep_s;
+
+/* Control flow optimizer (see "cflow.h"), carried for the first pass */
+struct cflow_s;
+
 
 /* Maximal number of symbol definitions. */
 #define SYMTAB_DEF_SIZE 32768U
@@ -80,8 +90,13 @@ typedef struct symtab_s symtab_t;
 
 
 
-/* Get built-in singleton object handle. */
-symtab_t* symtab_getobj(void);
+/* Creates a new symbol table object. Returns NULL if it is not possible to
+** allocate it. The object has to be initialized before use. */
+symtab_t* symtab_new(void);
+
+
+/* Deletes a symbol table object. */
+void  symtab_delete(symtab_t* hnd);
 
 
 /* Initialize or resets a symbol table object (size is unchanged). The given
@@ -139,8 +154,117 @@ auint symtab_use(symtab_t* hnd, auint def, auint off, auint use);
 auint symtab_resolvesym(symtab_t* hnd, auint id, auint* val);
 
 
-/* Resolves the symbol table into the bound section. Prints fault and returns
-** nonzero if it is not possible to resolve. */
+/* Attempts to resolve a symbol by name to it's value, like
+** symtab_resolvesym(), but without creating a definition if the name is not
+** bound. Returns nonzero on success, filling in 'val'. */
+auint symtab_resolvenam(symtab_t* hnd, uint8 const* nam, auint* val);
+
+
+/* Writes the symbol table (names, definitions and usages) into an object
+** file. Returns nonzero (TRUE) on failure (errno set). */
+auint symtab_objout(symtab_t* hnd, fprov_file_t* ofl);
+
+
+/* Reads a symbol table written by symtab_objout() from an object file,
+** adding its definitions and usages to this table. 'dlt' gives the
+** displacement of the object for each section: usage offsets are moved
+** accordingly, and the object's references of section bases are replaced by
+** the section base plus its displacement. A name already bound to a
+** constant of the same value (such as from a header included by several
+** objects) is not a redefinition. Returns 0 on success, 1 on failure (fault
+** printed, such as symbol redefinition), 2 if the object can not be read or
+** is malformed (errno set, no fault printed). */
+auint symtab_objin(symtab_t* hnd, fprov_file_t* ifl, auint const* dlt);
+
+
+/* Gets the names bound to definitions one by one. 'pos' should start at
+** zero, it is advanced by each call. Returns NULL when there are no more
+** names. */
+uint8 const* symtab_getbound(symtab_t* hnd, auint* pos);
+
+
+/* Checks whether a name is bound to a definition. Returns nonzero (TRUE) if
+** so. */
+auint symtab_isbound(symtab_t* hnd, uint8 const* nam);
+
+
+/* Checks whether the definition 'id' is a reference to the name 'nam' (a
+** definition got by symtab_getsymdef() before the name was bound). Returns
+** nonzero (TRUE) if so. */
+auint symtab_isref(symtab_t* hnd, auint id, uint8 const* nam);
+
+
+/* Removes the name binding of a definition, so it remains as an anonymous
+** definition (the definitions referring it by ID are unaffected). */
+void  symtab_unbind(symtab_t* hnd, auint id);
+
+
+/* Calls 'cb' for every name used but not bound to any definition (with the
+** names of the section bases). Returns nonzero (TRUE) if it is not possible
+** (no memory). */
+auint symtab_undefs(symtab_t* hnd, void (*cb)(void* ctx, uint8 const* nam), void* ctx);
+
+
+/* Calls 'cb' for every usage with each label its value depends on, following
+** the definitions from it (a label is an offset added to the base of a
+** section, see litpr_symdefproc()). The usage is given by its section and
+** offset ('usc', 'uof'), the label by its section and offset ('lsc', 'lof').
+** Must be called before resolving. Returns nonzero (TRUE) if it is not
+** possible (no memory). */
+auint symtab_labrefs(symtab_t* hnd,
+                     void (*cb)(void* ctx, auint usc, auint uof, auint lsc, auint lof),
+                     void* ctx);
+
+
+/* Sets the include memoization to record the adding of definitions, bindings
+** and usages into (NULL stops recording). Reset by symtab_init(). */
+void  symtab_setrec(symtab_t* hnd, struct incmem_s* rec);
+
+
+/* Sets the relaxation to use (NULL: none). The first pass checks it for the
+** form of the relaxable jumps and immediates, and when resolving, those
+** which need an other form are set in it (see symtab_resolve()). Reset by
+** symtab_init(). */
+void  symtab_setrlx(symtab_t* hnd, relax_t* rlx);
+
+
+/* Gets the relaxation in use (NULL: none). */
+relax_t* symtab_getrlx(symtab_t* hnd);
+
+
+/* Sets the peephole optimizer the first pass feeds the instructions and
+** labels into (NULL: none). Reset by symtab_init(). */
+void  symtab_setpeep(symtab_t* hnd, struct peep_s* pep);
+
+
+/* Gets the peephole optimizer in use (NULL: none). */
+struct peep_s* symtab_getpeep(symtab_t* hnd);
+
+
+/* Sets the control flow optimizer the first pass records the branches into
+** (NULL: none). Reset by symtab_init(). */
+void  symtab_setcflow(symtab_t* hnd, struct cflow_s* cfl);
+
+
+/* Gets the control flow optimizer in use (NULL: none). */
+struct cflow_s* symtab_getcflow(symtab_t* hnd);
+
+
+/* Sets the count of threads used for resolving (0: by the number of
+** processors). Large tables are resolved sharing the work among these. One
+** thread is used after creation, not reset by symtab_init(). */
+void  symtab_setthr(symtab_t* hnd, auint thc);
+
+
+/* Resolves the symbol table into the bound section. Definitions are
+** evaluated by levels of dependence, and the usages are written partitioned
+** by section and offset, both sharing the work among threads for large
+** tables. Faults are the same as if everything was resolved in order: the
+** first failure in order is printed. Prints fault and returns nonzero if it
+** is not possible to resolve. If a relaxation is set (see relax.h), the
+** usages are relaxed by it where possible instead of failing, and if any
+** line changed its form, it returns nonzero without a fault (the assembly
+** has to be repeated). */
 auint symtab_resolve(symtab_t* hnd);
 
 
@@ -0,0 +1,510 @@
+/**
+**  \file
+**  \brief     Table generator
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  The expression is compiled once into a postfix program of operations,
+**  which is then run for each index. The table is built in a buffer, and
+**  pushed into the section in one go.
+*/
+
+
+#include "tabgen.h"
+#include "compst.h"
+#include "section.h"
+#include "litpr.h"
+#include "fault.h"
+#include "strpr.h"
+#include <math.h>
+
+
+/* Value of pi */
+#define TABGEN_PI    3.14159265358979323846
+
+/* Operations: Push a constant */
+#define TABGEN_O_NUM 0U
+/* Operations: Push the index */
+#define TABGEN_O_IDX 1U
+/* Operations: Add */
+#define TABGEN_O_ADD 2U
+/* Operations: Subtract */
+#define TABGEN_O_SUB 3U
+/* Operations: Multiply */
+#define TABGEN_O_MUL 4U
+/* Operations: Divide */
+#define TABGEN_O_DIV 5U
+/* Operations: Remainder */
+#define TABGEN_O_MOD 6U
+/* Operations: Negate */
+#define TABGEN_O_NEG 7U
+/* Operations: Function (index in the function table) */
+#define TABGEN_O_FUN 8U
+
+/* Compile results: OK */
+#define TABGEN_E_OK  0U
+/* Compile results: Malformed expression */
+#define TABGEN_E_SYN 1U
+/* Compile results: Unknown function */
+#define TABGEN_E_FUN 2U
+/* Compile results: Wrong count of function arguments */
+#define TABGEN_E_ARG 3U
+/* Compile results: Symbol of unknown value */
+#define TABGEN_E_UNK 4U
+/* Compile results: Failed, fault printed */
+#define TABGEN_E_FLT 5U
+
+
+/* Function */
+typedef struct{
+ char const* nam;       /* Name */
+ auint       arc;       /* Count of arguments */
+}tabgen_fn_t;
+
+
+/* The functions. The evaluation refers them by index. */
+static const tabgen_fn_t tabgen_fns[] = {
+ {"sin",   1U},         /*  0 */
+ {"cos",   1U},         /*  1 */
+ {"tan",   1U},         /*  2 */
+ {"atan",  1U},         /*  3 */
+ {"sqrt",  1U},         /*  4 */
+ {"pow",   2U},         /*  5 */
+ {"exp",   1U},         /*  6 */
+ {"log",   1U},         /*  7 */
+ {"abs",   1U},         /*  8 */
+ {"floor", 1U},         /*  9 */
+ {"ceil",  1U},         /* 10 */
+ {"round", 1U},         /* 11 */
+ {"min",   2U},         /* 12 */
+ {"max",   2U},         /* 13 */
+ {"clamp", 3U},         /* 14 */
+ {"fix",   2U}          /* 15 */
+};
+
+/* Count of functions */
+#define TABGEN_FNC   (sizeof(tabgen_fns) / sizeof(tabgen_fns[0]))
+
+
+/* Operation */
+typedef struct{
+ auint  opc;            /* Operation (TABGEN_O_ values) */
+ auint  fun;            /* Function for TABGEN_O_FUN */
+ double val;            /* Constant for TABGEN_O_NUM */
+}tabgen_op_t;
+
+
+/* Compile state */
+typedef struct{
+ symtab_t*    stb;      /* Symbol table for the symbols */
+ uint8 const* src;      /* Source line */
+ auint        pos;      /* Position on it */
+ uint8 const* idx;      /* Name of the index */
+ auint        iln;      /* Length of the name of the index */
+ tabgen_op_t  ops[LINE_MAX]; /* Program (an operation takes at least a character) */
+ auint        cnt;      /* Count of operations */
+}tabgen_cmp_t;
+
+
+
+static auint tabgen_i_expr(tabgen_cmp_t* cmp, auint lvl);
+
+
+
+/* Adds an operation to the program. Returns a compile result. */
+static auint tabgen_i_op(tabgen_cmp_t* cmp, auint opc, auint fun, double val)
+{
+ if (cmp->cnt == LINE_MAX){ return TABGEN_E_SYN; }
+ cmp->ops[cmp->cnt].opc = opc;
+ cmp->ops[cmp->cnt].fun = fun;
+ cmp->ops[cmp->cnt].val = val;
+ cmp->cnt ++;
+ return TABGEN_E_OK;
+}
+
+
+
+/* Compiles a numeric literal at the current position. Hexadecimal and
+** binary literals are interpreted like by litpr, decimal literals may have
+** a fraction and an exponent. Returns a compile result. */
+static auint tabgen_i_num(tabgen_cmp_t* cmp)
+{
+ uint8 const* src = &(cmp->src[cmp->pos]);
+ uint8        s[LINE_MAX];
+ auint        e = 0U;
+ auint        u;
+ auint        v;
+ auint        t;
+
+ if ( (src[0] == (uint8)('0')) &&
+      ((src[1] == (uint8)('x')) || (src[1] == (uint8)('b'))) ){
+  while (strpr_issym(src[e])){ s[e] = src[e]; e++; }
+  s[e] = 0U;
+  t = litpr_getval(&(s[0]), &u, &v, cmp->stb);
+  if (t == LITPR_INV){ return TABGEN_E_FLT; }
+  if ((t != LITPR_VAL) || (u != e)){ return TABGEN_E_SYN; }
+  cmp->pos += e;
+  return tabgen_i_op(cmp, TABGEN_O_NUM, 0U, (double)(v));
+ }
+
+ while ((src[e] >= (uint8)('0')) && (src[e] <= (uint8)('9'))){ e++; }
+ if (src[e] == (uint8)('.')){
+  e++;
+  while ((src[e] >= (uint8)('0')) && (src[e] <= (uint8)('9'))){ e++; }
+ }
+ if ( (src[e] == (uint8)('e')) || (src[e] == (uint8)('E')) ){
+  u = e + 1U;
+  if ( (src[u] == (uint8)('+')) || (src[u] == (uint8)('-')) ){ u++; }
+  if ((src[u] >= (uint8)('0')) && (src[u] <= (uint8)('9'))){
+   e = u;
+   while ((src[e] >= (uint8)('0')) && (src[e] <= (uint8)('9'))){ e++; }
+  }
+ }
+ if (strpr_issym(src[e])){ return TABGEN_E_SYN; }
+
+ memcpy(&(s[0]), src, e);
+ s[e] = 0U;
+ cmp->pos += e;
+ return tabgen_i_op(cmp, TABGEN_O_NUM, 0U, strtod((char const*)(&(s[0])), NULL));
+}
+
+
+
+/* Compiles a name at the current position: a function call, the index, pi,
+** or a symbol which has to have a known value. Returns a compile result. */
+static auint tabgen_i_name(tabgen_cmp_t* cmp)
+{
+ uint8 const* src = cmp->src;
+ uint8        s[LINE_MAX];
+ auint        beg = cmp->pos;
+ auint        len = 0U;
+ auint        f;
+ auint        n;
+ auint        r;
+ auint        u;
+ auint        v;
+
+ while (strpr_issym(src[beg + len])){ len ++; }
+ cmp->pos = strpr_nextnw(src, beg + len);
+
+ if (src[cmp->pos] == (uint8)('(')){  /* Function */
+
+  for (f = 0U; f < TABGEN_FNC; f++){
+   if ( (strlen(tabgen_fns[f].nam) == len) &&
+        (memcmp(tabgen_fns[f].nam, &(src[beg]), len) == 0) ){ break; }
+  }
+  if (f == TABGEN_FNC){ cmp->pos = beg; return TABGEN_E_FUN; }
+
+  n = 0U;
+  cmp->pos = strpr_nextnw(src, cmp->pos + 1U);
+  if (src[cmp->pos] != (uint8)(')')){
+   while (1){
+    r = tabgen_i_expr(cmp, 0U);
+    if (r != TABGEN_E_OK){ return r; }
+    n ++;
+    cmp->pos = strpr_nextnw(src, cmp->pos);
+    if (src[cmp->pos] != (uint8)(',')){ break; }
+    cmp->pos ++;
+   }
+   if (src[cmp->pos] != (uint8)(')')){ return TABGEN_E_SYN; }
+  }
+  cmp->pos ++;
+  if (n != tabgen_fns[f].arc){ cmp->pos = beg; return TABGEN_E_ARG; }
+  return tabgen_i_op(cmp, TABGEN_O_FUN, f, 0.0);
+
+ }
+
+ cmp->pos = beg + len;
+
+ if ( (len == cmp->iln) && (memcmp(cmp->idx, &(src[beg]), len) == 0) ){
+  return tabgen_i_op(cmp, TABGEN_O_IDX, 0U, 0.0);
+ }
+ if ( (len == 2U) && (memcmp("pi", &(src[beg]), 2U) == 0) ){
+  return tabgen_i_op(cmp, TABGEN_O_NUM, 0U, TABGEN_PI);
+ }
+
+ memcpy(&(s[0]), &(src[beg]), len);
+ s[len] = 0U;
+ r = litpr_getval(&(s[0]), &u, &v, cmp->stb);
+ if (r == LITPR_INV){ return TABGEN_E_FLT; }
+ if ((r & LITPR_VAL) == 0U){ cmp->pos = beg; return TABGEN_E_UNK; }
+ return tabgen_i_op(cmp, TABGEN_O_NUM, 0U, (double)((sint32)(v)));
+}
+
+
+
+/* Compiles an unary operator or a primary (literal, name or parenthesized
+** expression) at the current position. Returns a compile result. */
+static auint tabgen_i_una(tabgen_cmp_t* cmp)
+{
+ uint8 const* src = cmp->src;
+ auint        r;
+
+ cmp->pos = strpr_nextnw(src, cmp->pos);
+
+ if       (src[cmp->pos] == (uint8)('-')){
+  cmp->pos ++;
+  r = tabgen_i_una(cmp);
+  if (r != TABGEN_E_OK){ return r; }
+  return tabgen_i_op(cmp, TABGEN_O_NEG, 0U, 0.0);
+ }else if (src[cmp->pos] == (uint8)('+')){
+  cmp->pos ++;
+  return tabgen_i_una(cmp);
+ }else if (src[cmp->pos] == (uint8)('(')){
+  cmp->pos ++;
+  r = tabgen_i_expr(cmp, 0U);
+  if (r != TABGEN_E_OK){ return r; }
+  cmp->pos = strpr_nextnw(src, cmp->pos);
+  if (src[cmp->pos] != (uint8)(')')){ return TABGEN_E_SYN; }
+  cmp->pos ++;
+  return TABGEN_E_OK;
+ }else if ( (src[cmp->pos] >= (uint8)('0')) && (src[cmp->pos] <= (uint8)('9')) ){
+  return tabgen_i_num(cmp);
+ }else if (strpr_issym(src[cmp->pos])){
+  return tabgen_i_name(cmp);
+ }else{
+  return TABGEN_E_SYN;
+ }
+}
+
+
+
+/* Compiles an expression of binary operators of precedence level 'lvl' (0:
+** '+' and '-', 1: '*', '/' and '%') and above at the current position.
+** Returns a compile result. */
+static auint tabgen_i_expr(tabgen_cmp_t* cmp, auint lvl)
+{
+ uint8 const* src = cmp->src;
+ auint        opc;
+ auint        r;
+
+ if (lvl == 2U){ return tabgen_i_una(cmp); }
+
+ r = tabgen_i_expr(cmp, lvl + 1U);
+ while (r == TABGEN_E_OK){
+  cmp->pos = strpr_nextnw(src, cmp->pos);
+  if (lvl == 0U){
+   if      (src[cmp->pos] == (uint8)('+')){ opc = TABGEN_O_ADD; }
+   else if (src[cmp->pos] == (uint8)('-')){ opc = TABGEN_O_SUB; }
+   else{ break; }
+  }else{
+   if      (src[cmp->pos] == (uint8)('*')){ opc = TABGEN_O_MUL; }
+   else if (src[cmp->pos] == (uint8)('/')){ opc = TABGEN_O_DIV; }
+   else if (src[cmp->pos] == (uint8)('%')){ opc = TABGEN_O_MOD; }
+   else{ break; }
+  }
+  cmp->pos ++;
+  r = tabgen_i_expr(cmp, lvl + 1U);
+  if (r == TABGEN_E_OK){ r = tabgen_i_op(cmp, opc, 0U, 0.0); }
+ }
+
+ return r;
+}
+
+
+
+/* Runs the program for the index 'idx' using the stack 'stk' (room for as
+** many values as operations). Returns the result. */
+static double tabgen_i_run(tabgen_op_t const* ops, auint cnt, double idx, double* stk)
+{
+ auint  d = 0U;
+ auint  i;
+ double* a;
+
+ for (i = 0U; i < cnt; i++){
+  switch (ops[i].opc){
+   case TABGEN_O_NUM: stk[d] = ops[i].val; d++; break;
+   case TABGEN_O_IDX: stk[d] = idx;        d++; break;
+   case TABGEN_O_ADD: d--; stk[d - 1U] = stk[d - 1U] + stk[d]; break;
+   case TABGEN_O_SUB: d--; stk[d - 1U] = stk[d - 1U] - stk[d]; break;
+   case TABGEN_O_MUL: d--; stk[d - 1U] = stk[d - 1U] * stk[d]; break;
+   case TABGEN_O_DIV: d--; stk[d - 1U] = stk[d - 1U] / stk[d]; break;
+   case TABGEN_O_MOD: d--; stk[d - 1U] = fmod(stk[d - 1U], stk[d]); break;
+   case TABGEN_O_NEG: stk[d - 1U] = -stk[d - 1U]; break;
+   default:           /* TABGEN_O_FUN */
+    d -= tabgen_fns[ops[i].fun].arc;
+    a = &(stk[d]);
+    switch (ops[i].fun){
+     case  0U: a[0] = sin(a[0]); break;
+     case  1U: a[0] = cos(a[0]); break;
+     case  2U: a[0] = tan(a[0]); break;
+     case  3U: a[0] = atan(a[0]); break;
+     case  4U: a[0] = sqrt(a[0]); break;
+     case  5U: a[0] = pow(a[0], a[1]); break;
+     case  6U: a[0] = exp(a[0]); break;
+     case  7U: a[0] = log(a[0]); break;
+     case  8U: a[0] = fabs(a[0]); break;
+     case  9U: a[0] = floor(a[0]); break;
+     case 10U: a[0] = ceil(a[0]); break;
+     case 11U: a[0] = floor(a[0] + 0.5); break;
+     case 12U: a[0] = (a[1] < a[0]) ? a[1] : a[0]; break;
+     case 13U: a[0] = (a[1] > a[0]) ? a[1] : a[0]; break;
+     case 14U: a[0] = (a[0] < a[1]) ? a[1] : ((a[0] > a[2]) ? a[2] : a[0]); break;
+     default:  a[0] = floor((a[0] * pow(2.0, a[1])) + 0.5); break;
+    }
+    d++;
+    break;
+  }
+ }
+
+ return stk[0];
+}
+
+
+
+/* Checks the current source line at the current position for a 'dtab'
+** directive, generating the table into the current section. Returns one of
+** the defined PARSER return codes (defined in types.h). */
+auint tabgen_proc(symtab_t* stb)
+{
+ uint8        s[80];
+ compst_t*    cst = symtab_getcompst(stb);
+ section_t*   sec = symtab_getsectob(stb);
+ uint8 const* src = compst_getsstrcoff(cst); /* Might not be first char (Labels!) */
+ auint        sid = section_getsect(sec);
+ auint        cof = compst_getcoff(cst);
+ auint        beg = strpr_nextnw(src, 0U);
+ tabgen_cmp_t cmp;
+ double       stk[LINE_MAX];
+ double       d;
+ uint16*      tab;
+ auint        fst;
+ auint        lst;
+ auint        u;
+ auint        t;
+ auint        i;
+
+ if (!compst_issymequ(NULL, &(src[beg]), (uint8 const*)("dtab"))){
+  return PARSER_OK;
+ }
+ if ((sid == SECT_ZERO) || (sid == SECT_FILE)){ goto fault_sec; }
+
+ /* Name of the index and the range */
+
+ beg = strpr_nextnw(src, beg + 4U);
+ cmp.idx = &(src[beg]);
+ cmp.iln = 0U;
+ while (strpr_issym(src[beg + cmp.iln])){ cmp.iln ++; }
+ if ( (cmp.iln == 0U) ||
+      ((src[beg] >= (uint8)('0')) && (src[beg] <= (uint8)('9'))) ){ goto fault_inx; }
+ beg = strpr_nextnw(src, beg + cmp.iln);
+ if (src[beg] != (uint8)(',')){ goto fault_inx; }
+
+ beg = strpr_nextnw(src, beg + 1U);
+ compst_setcoff(cst, cof + beg);
+ t = litpr_getval(&(src[beg]), &u, &fst, stb);
+ if (t == LITPR_INV){ return PARSER_ERR; }
+ if ((t & LITPR_VAL) == 0U){ goto fault_unk; }
+ beg = strpr_nextnw(src, beg + u);
+ if (src[beg] != (uint8)(',')){ goto fault_inx; }
+
+ beg = strpr_nextnw(src, beg + 1U);
+ compst_setcoff(cst, cof + beg);
+ t = litpr_getval(&(src[beg]), &u, &lst, stb);
+ if (t == LITPR_INV){ return PARSER_ERR; }
+ if ((t & LITPR_VAL) == 0U){ goto fault_unk; }
+ if ( ((sint32)(lst) < (sint32)(fst)) ||
+      (((lst - fst) & 0xFFFFFFFFU) >= TABGEN_MAX) ){ goto fault_rng; }
+ beg = strpr_nextnw(src, beg + u);
+ if (src[beg] != (uint8)(',')){ goto fault_inx; }
+
+ /* Compile the expression */
+
+ cmp.stb = stb;
+ cmp.src = src;
+ beg = strpr_nextnw(src, beg + 1U);
+ cmp.pos = beg;
+ cmp.cnt = 0U;
+ compst_setcoff(cst, cof + beg);
+ t = tabgen_i_expr(&cmp, 0U);
+ if (t == TABGEN_E_OK){
+  cmp.pos = strpr_nextnw(src, cmp.pos);
+  if (!strpr_isend(src[cmp.pos])){ t = TABGEN_E_SYN; }
+ }
+ compst_setcoff(cst, cof + cmp.pos);
+ if (t != TABGEN_E_OK){ goto fault_exp; }
+ compst_setcoff(cst, cof + beg);
+
+ /* Generate and push it */
+
+ u = ((lst - fst) & 0xFFFFFFFFU) + 1U;
+ tab = (uint16*)(malloc(sizeof(uint16) * u));
+ if (tab == NULL){ goto fault_mem; }
+ for (i = 0U; i < u; i++){
+  d = tabgen_i_run(&(cmp.ops[0]), cmp.cnt, (double)((sint32)(fst + i)), &(stk[0]));
+  d = floor(d + 0.5);
+  if (!((d >= -32768.0) && (d <= 65535.0))){ goto fault_val; } /* Also catches NaN */
+  tab[i] = (uint16)(((sint32)(d)) & 0xFFFF);
+ }
+ t = section_pushws(sec, tab, u);
+ free(tab);
+ if (t != 0U){ goto fault_ovr; }
+
+ return PARSER_END;
+
+
+fault_sec:
+
+ compst_setcoffrel(cst, beg);
+ snprintf((char*)(&s[0]), 80U, "\'dtab\' is only allowed in code, data, head or desc");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_inx:
+
+ compst_setcoff(cst, cof + beg);
+ snprintf((char*)(&s[0]), 80U, "Malformed \'dtab\'");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_unk:
+
+ snprintf((char*)(&s[0]), 80U, "Range of \'dtab\' is not known in the first pass");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_rng:
+
+ snprintf((char*)(&s[0]), 80U, "Range of \'dtab\' is empty or too large (at most %u)", TABGEN_MAX);
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_exp:
+
+ if       (t == TABGEN_E_FUN){
+  snprintf((char*)(&s[0]), 80U, "Unknown function in \'dtab\'");
+ }else if (t == TABGEN_E_ARG){
+  snprintf((char*)(&s[0]), 80U, "Wrong count of function arguments in \'dtab\'");
+ }else if (t == TABGEN_E_UNK){
+  snprintf((char*)(&s[0]), 80U, "Symbol in \'dtab\' is not known in the first pass");
+ }else if (t == TABGEN_E_SYN){
+  snprintf((char*)(&s[0]), 80U, "Malformed \'dtab\' expression");
+ }else{
+  return PARSER_ERR;     /* Fault already printed */
+ }
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_mem:
+
+ snprintf((char*)(&s[0]), 80U, "Not enough memory for \'dtab\'");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_val:
+
+ free(tab);
+ snprintf((char*)(&s[0]), 80U, "Value of \'dtab\' out of range at index %d", (int)((sint32)(fst + i)));
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+
+fault_ovr:
+
+ snprintf((char*)(&s[0]), 80U, "Overlap or out of section encountered");
+ fault_printat(FAULT_FAIL, &s[0], cst);
+ return PARSER_ERR;
+}
@@ -0,0 +1,42 @@
+/**
+**  \file
+**  \brief     Table generator
+**  \author    Sandor Zsuga (Jubatian)
+**  \copyright 2013 - 2015, GNU GPLv3 (version 3 of the GNU General Public
+**             License) extended as RRPGEvt (temporary version of the RRPGE
+**             License): see LICENSE.GPLv3 and LICENSE.RRPGEvt in the project
+**             root.
+**  \date      2015.10.01
+**
+**  Processes the 'dtab' directive of the first pass, generating a table of
+**  words by evaluating an expression for each index of a range:
+**
+**  dtab name, first, last, expression
+**
+**  The expression is evaluated in floating point, the index taking the value
+**  of 'name' in it, with functions for trigonometry, rounding, clamping and
+**  fixed-point scaling. Each result is rounded to the nearest integer, which
+**  has to fit in a word (signed or unsigned).
+*/
+
+
+#ifndef TABGEN_H
+#define TABGEN_H
+
+
+#include "types.h"
+#include "symtab.h"
+
+
+/* Maximal count of words in a table */
+#define TABGEN_MAX  65536U
+
+
+
+/* Checks the current source line at the current position for a 'dtab'
+** directive, generating the table into the current section. Returns one of
+** the defined PARSER return codes (defined in types.h). */
+auint tabgen_proc(symtab_t* stb);
+
+
+#endif
@@ -14,77 +14,124 @@
 
 
 
-/* Attempts to write out value at a given offset in the current section. In
-** 'use' supply the form by which to write out. Returns nonzero (TRUE) if some
-** severe failure arises where compilation shouldn't continue. Before writing
-** the value, the area should be occupied by normal section data pushes. */
-auint valwr_write(section_t* dst, uint32 val, auint off, auint use, fault_off_t const* fof)
+/* MOV rx, imx table for 0000 011r rrpq iiii */
+static const uint16 valwr_mov_tb0[64] = {
+ 0x0280U, 0xFF0FU, 0xF0FFU, 0x0180U, 0x0300U, 0x01C0U, 0x0F00U, 0x0118U,
+ 0x0140U, 0x0168U, 0x0190U, 0x01B8U, 0x01E0U, 0x0208U, 0x0230U, 0x0258U,
+ 0x0010U, 0x0011U, 0x0012U, 0x0013U, 0x0014U, 0x0015U, 0x0016U, 0x0017U,
+ 0x0018U, 0x0019U, 0x001AU, 0x001BU, 0x001CU, 0x001DU, 0x001EU, 0x001FU,
+ 0x0020U, 0x0021U, 0x0022U, 0x0023U, 0x0024U, 0x0025U, 0x0026U, 0x0027U,
+ 0x0028U, 0x0029U, 0x002AU, 0x002BU, 0x002CU, 0x002DU, 0x002EU, 0x002FU,
+ 0x0030U, 0x0031U, 0x0032U, 0x0033U, 0x0034U, 0x0035U, 0x0036U, 0x0037U,
+ 0x0038U, 0x0039U, 0x003AU, 0x003BU, 0x003CU, 0x003DU, 0x003EU, 0x003FU};
+/* MOV rx, imx table for 0100 011r rrpq iiii */
+static const uint16 valwr_mov_tb1[64] = {
+ 0x0040U, 0x0041U, 0x0042U, 0x0043U, 0x0044U, 0x0045U, 0x0046U, 0x0047U,
+ 0x0048U, 0x0049U, 0x004AU, 0x004BU, 0x004CU, 0x004DU, 0x004EU, 0x004FU,
+ 0x0050U, 0x0051U, 0x0052U, 0x0053U, 0x0054U, 0x0055U, 0x0056U, 0x0057U,
+ 0x0058U, 0x0059U, 0x005AU, 0x005BU, 0x005CU, 0x005DU, 0x005EU, 0x005FU,
+ 0x0060U, 0x0061U, 0x0062U, 0x0063U, 0x0064U, 0x0065U, 0x0066U, 0x0067U,
+ 0x0068U, 0x0069U, 0x006AU, 0x006BU, 0x006CU, 0x006DU, 0x006EU, 0x006FU,
+ 0x0070U, 0x0071U, 0x0072U, 0x0073U, 0x0074U, 0x0075U, 0x0076U, 0x0077U,
+ 0x0078U, 0x0079U, 0x007AU, 0x007BU, 0x007CU, 0x007DU, 0x007EU, 0x007FU};
+/* MOV rx, imx table for 1100 011r rrpq iiii */
+static const uint16 valwr_mov_tb2[64] = {
+ 0x0080U, 0x0088U, 0x0090U, 0x0098U, 0x0010U, 0x0020U, 0x0040U, 0x0080U,
+ 0x0100U, 0x0200U, 0x0400U, 0x0800U, 0x1000U, 0x2000U, 0x4000U, 0x8000U,
+ 0x00A0U, 0x00A8U, 0x00B0U, 0x00B8U, 0xFFEFU, 0xFFDFU, 0xFFBFU, 0xFF7FU,
+ 0xFEFFU, 0xFDFFU, 0xFBFFU, 0xF7FFU, 0xEFFFU, 0xDFFFU, 0xBFFFU, 0x7FFFU,
+ 0x00C0U, 0x00C8U, 0x00D0U, 0x00D8U, 0xFFE0U, 0xFFC0U, 0xFF80U, 0xFF00U,
+ 0xFE00U, 0xFC00U, 0xF800U, 0xF000U, 0xE000U, 0xC000U, 0x8000U, 0x0000U,
+ 0x00E0U, 0x00E8U, 0x00F0U, 0x00F8U, 0x001FU, 0x003FU, 0x007FU, 0x00FFU,
+ 0x01FFU, 0x03FFU, 0x07FFU, 0x0FFFU, 0x1FFFU, 0x3FFFU, 0x7FFFU, 0xFFFFU};
+
+
+
+/* Internal function writing out value at a given offset in section 'sct'.
+** Faults are printed only if 'fof' is not NULL. Returns one of the VALWR_R_
+** results. */
+static auint valwr_i_write(section_t* dst, auint sct, uint32 val, auint off, auint use, fault_off_t const* fof)
 {
  uint8 s[80];
  auint t;
+ auint r = VALWR_R_OK;
 
  switch (use){
 
   case VALWR_C16:
-   section_setw(dst, off, val & 0xFFFFU);
+   section_setsw(dst, sct, off, val & 0xFFFFU);
    break;
 
   case VALWR_C8H:
-   section_setw(dst, off, val & 0xFF00U);
+   section_setsw(dst, sct, off, val & 0xFF00U);
    break;
 
   case VALWR_C8L:
-   section_setw(dst, off, val & 0x00FFU);
+   section_setsw(dst, sct, off, val & 0x00FFU);
    break;
 
   case VALWR_A4:
    if (val > 0xFU){
-    snprintf((char*)(&s[0]), 80U, "Value is too large, truncated");
-    fault_print(FAULT_NOTE, &s[0], fof);
+    if (fof != NULL){
+     snprintf((char*)(&s[0]), 80U, "Value is too large, truncated");
+     fault_print(FAULT_NOTE, &s[0], fof);
+    }
+    r = VALWR_R_NOTE;
    }
-   section_setw(dst, off, val & 0x000FU);
+   section_setsw(dst, sct, off, val & 0x000FU);
    break;
 
   case VALWR_A16:
-   section_setw(dst, off, (val >> 14) & 0x3U);
-   section_setw(dst, off + 1U, val & 0x3FFFU);
+  case VALWR_X16:
+  case VALWR_M16:
+  case VALWR_P16:
+   section_setsw(dst, sct, off, (val >> 14) & 0x3U);
+   section_setsw(dst, sct, off + 1U, val & 0x3FFFU);
    break;
 
   case VALWR_B4:
    if (val > 0xFU){
-    snprintf((char*)(&s[0]), 80U, "Value is too large, truncated");
-    fault_print(FAULT_NOTE, &s[0], fof);
+    if (fof != NULL){
+     snprintf((char*)(&s[0]), 80U, "Value is too large, truncated");
+     fault_print(FAULT_NOTE, &s[0], fof);
+    }
+    r = VALWR_R_NOTE;
    }
-   section_setw(dst, off, (val & 0xFU) << 6);
+   section_setsw(dst, sct, off, (val & 0xFU) << 6);
    break;
 
   case VALWR_S6:
    if (val > 0x3FU){
-    snprintf((char*)(&s[0]), 80U, "Operand value is too large for JSV");
-    fault_print(FAULT_FAIL, &s[0], fof);
-    return 1U;
+    if (fof != NULL){
+     snprintf((char*)(&s[0]), 80U, "Operand value is too large for JSV");
+     fault_print(FAULT_FAIL, &s[0], fof);
+    }
+    return VALWR_R_FAIL;
    }
-   section_setw(dst, off, val & 0x3FU);
+   section_setsw(dst, sct, off, val & 0x3FU);
    break;
 
   case VALWR_R16:
    /* This is for relative jumps, 16 bit offset (no range check necessary). */
    t = (val - off) & 0xFFFFU;
-   section_setw(dst, off, (t >> 14) & 0x3U);
-   section_setw(dst, off + 1U, t & 0x3FFFU);
+   section_setsw(dst, sct, off, (t >> 14) & 0x3U);
+   section_setsw(dst, sct, off + 1U, t & 0x3FFFU);
    break;
 
   case VALWR_R10:
+  case VALWR_J10:
    /* This is for relative jumps. It has to be determined whether the jump
    ** from 'o' to 'val' is within the relative jump's range (-512 - 511). */
    t = (val - off) & 0xFFFFU;
    if ( (val > 0xFFFFU) ||
         ( (t > 0x01FFU) && (t < 0xFE00U) ) ){
-    snprintf((char*)(&s[0]), 80U, "Relative jump target is out of range");
-    fault_print(FAULT_FAIL, &s[0], fof);
-    return 1U;
+    if (fof != NULL){
+     snprintf((char*)(&s[0]), 80U, "Relative jump target is out of range");
+     fault_print(FAULT_FAIL, &s[0], fof);
+    }
+    return VALWR_R_FAIL;
    }
-   section_setw(dst, off, t & 0x03FFU);
+   section_setsw(dst, sct, off, t & 0x03FFU);
    break;
 
   case VALWR_R7:
@@ -93,21 +140,60 @@ auint valwr_write(section_t* dst, uint32 val, auint off, auint use, fault_off_t
    t = (val - off) & 0xFFFFU;
    if ( (val > 0xFFFFU) ||
         ( (t > 0x003FU) && (t < 0xFFC0U) ) ){
-    snprintf((char*)(&s[0]), 80U, "Nonzero jump target is out of range");
-    fault_print(FAULT_FAIL, &s[0], fof);
-    return 1U;
+    if (fof != NULL){
+     snprintf((char*)(&s[0]), 80U, "Nonzero jump target is out of range");
+     fault_print(FAULT_FAIL, &s[0], fof);
+    }
+    return VALWR_R_FAIL;
+   }
+   section_setsw(dst, sct, off, (t & 0x003FU) | ((t & 0x0040U) << 3));
+   break;
+
+  case VALWR_CHK:
+   /* This is for relaxed immediates: the value got changed since the
+   ** instruction was encoded by it. */
+   if (val != 0U){
+    if (fof != NULL){
+     snprintf((char*)(&s[0]), 80U, "Immediate changed since it was relaxed");
+     fault_print(FAULT_FAIL, &s[0], fof);
+    }
+    return VALWR_R_FAIL;
    }
-   section_setw(dst, off, (t & 0x003FU) | ((t & 0x0040U) << 3));
    break;
 
   default:
-   snprintf((char*)(&s[0]), 80U, "Illegal use of value");
-   fault_print(FAULT_FAIL, &s[0], fof);
-   return 1U;
+   if (fof != NULL){
+    snprintf((char*)(&s[0]), 80U, "Illegal use of value");
+    fault_print(FAULT_FAIL, &s[0], fof);
+   }
+   return VALWR_R_FAIL;
 
  }
 
- return 0U;
+ return r;
+}
+
+
+
+/* Attempts to write out value at a given offset in the current section. In
+** 'use' supply the form by which to write out. Returns nonzero (TRUE) if some
+** severe failure arises where compilation shouldn't continue. Before writing
+** the value, the area should be occupied by normal section data pushes. */
+auint valwr_write(section_t* dst, uint32 val, auint off, auint use, fault_off_t const* fof)
+{
+ return (valwr_i_write(dst, section_getsect(dst), val, off, use, fof) == VALWR_R_FAIL);
+}
+
+
+
+/* Like valwr_write(), but into section 'sct' without selecting it and
+** without printing faults, so it may be used concurrently on distinct words
+** (see section_setsw()). Returns one of the VALWR_R_ results. Writing it
+** again through valwr_write() has no further effect on the data, but prints
+** the faults. */
+auint valwr_writes(section_t* dst, auint sct, uint32 val, auint off, auint use)
+{
+ return valwr_i_write(dst, sct, val, off, use, NULL);
 }
 
 
@@ -122,3 +208,49 @@ auint valwr_writecs(section_t* dst, uint32 val, auint off, auint use, compst_t*
  fault_fofget(&fof, cof, &fil[0]);
  return valwr_write(dst, val, off, use, &fof);
 }
+
+
+
+/* Gets the one word encoding of a MOV rx, imx (with the register bits
+** clear) for the value 'val', these are the NOT rx, imx form for values from
+** 0xFFF0, and the three tables of MOV rx, imx. Returns zero if there is no
+** such encoding for the value. */
+auint valwr_movimx(uint32 val)
+{
+ auint i;
+
+ if (val > 0xFFFFU){ return 0U; }
+
+ if (val >= 0xFFF0U){            /* NOT rx, adr */
+  return 0x2000U | ((~val) & 0xFU);
+ }
+
+ for (i = 0U; i < 64U; i++){     /* MOV rx, imx (0000) */
+  if (val == valwr_mov_tb0[i]){ return 0x0600U | i; }
+ }
+
+ for (i = 0U; i < 64U; i++){     /* MOV rx, imx (0100) */
+  if (val == valwr_mov_tb1[i]){ return 0x4600U | i; }
+ }
+
+ for (i = 0U; i < 64U; i++){     /* MOV rx, imx (1100) */
+  if (val == valwr_mov_tb2[i]){ return 0x8600U | i; }
+ }
+
+ return 0U;
+}
+
+
+
+/* Checks whether the value 'val' of a relaxable usage (VALWR_X16, VALWR_M16
+** or VALWR_P16) could be encoded in a shorter form. Returns nonzero (TRUE)
+** if so. */
+auint valwr_isshort(auint use, uint32 val)
+{
+ switch (use){
+  case VALWR_X16: return (val < 0x10U);
+  case VALWR_M16: return ((val < 0x10U) || (valwr_movimx(val) != 0U));
+  case VALWR_P16: return (val < 0x20U);
+  default:        return 0U;
+ }
+}
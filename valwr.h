@@ -40,10 +40,36 @@
 #define VALWR_R10  8
 /* Value usage: 7 bit relative used in JNZ */
 #define VALWR_R7   9
+/* Value usage: 10 bit relative used in a relaxable jump (JMS of a 'jmp').
+** Written just like VALWR_R10, but when resolving, a target out of range
+** may get the jump relaxed (see relax.h) instead of failing. */
+#define VALWR_J10  10
+/* Value usage: 16 bit immediate in addressing mode, which could be encoded
+** in the short form if it was below 16. Written just like VALWR_A16, but
+** when resolving, it may get relaxed (see relax.h) to the short form. */
+#define VALWR_X16  11
+/* Value usage: 16 bit immediate of a MOV to a normal register, which could
+** be encoded in one of the special forms (see valwr_isshort()). Otherwise
+** like VALWR_X16. */
+#define VALWR_M16  12
+/* Value usage: 16 bit immediate of a MOV to SP, which could be encoded in
+** one of the short forms if it was below 32. Otherwise like VALWR_X16. */
+#define VALWR_P16  13
+/* Value usage: check of a relaxed immediate (see relax.h). Nothing is
+** written, it only fails if the value (the difference of the immediate and
+** the value it was encoded by) is not zero. */
+#define VALWR_CHK  14
 
 /* Where "truncates silently" is noted, out of range values are simply bit
 ** masked. Other places if such is necessary warnings are raised. */
 
+/* Results of valwr_writes(): Written */
+#define VALWR_R_OK    0U
+/* Results of valwr_writes(): Written, but a note would be printed */
+#define VALWR_R_NOTE  1U
+/* Results of valwr_writes(): Failed, nothing written */
+#define VALWR_R_FAIL  2U
+
 
 /* Attempts to write out value at a given offset in the current section. In
 ** 'use' supply the form by which to write out. Returns nonzero (TRUE) if some
@@ -52,9 +78,30 @@
 auint valwr_write(section_t* dst, uint32 val, auint off, auint use, fault_off_t const* fof);
 
 
+/* Like valwr_write(), but into section 'sct' without selecting it and
+** without printing faults, so it may be used concurrently on distinct words
+** (see section_setsw()). Returns one of the VALWR_R_ results. Writing it
+** again through valwr_write() has no further effect on the data, but prints
+** the faults. */
+auint valwr_writes(section_t* dst, auint sct, uint32 val, auint off, auint use);
+
+
 /* Like valwr_write(), but uses the current compile state for outputting
 ** fault messages. */
 auint valwr_writecs(section_t* dst, uint32 val, auint off, auint use, compst_t* cof);
 
 
+/* Gets the one word encoding of a MOV rx, imx (with the register bits
+** clear) for the value 'val', these are the NOT rx, imx form for values from
+** 0xFFF0, and the three tables of MOV rx, imx. Returns zero if there is no
+** such encoding for the value. */
+auint valwr_movimx(uint32 val);
+
+
+/* Checks whether the value 'val' of a relaxable usage (VALWR_X16, VALWR_M16
+** or VALWR_P16) could be encoded in a shorter form. Returns nonzero (TRUE)
+** if so. */
+auint valwr_isshort(auint use, uint32 val);
+
+
 #endif